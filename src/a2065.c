@@ -16,7 +16,7 @@
 #include "custom.h"
 #include "newcpu.h"
 #include "a2065.h"
-//#include "win32_uaenet.h"
+#include "uaenet.h"
 #include "crc32.h"
 #include "savestate.h"
 #include "autoconf.h"
@@ -342,7 +342,7 @@ static void gotfunc (struct s2devstruct *dev, const uae_u8 *databuf, int len)
 		}
 	}
 
-	// winpcap does not include checksum bytes
+	// host network drivers (winpcap, TAP, raw sockets) do not include checksum bytes
 	crc32 = get_crc32 (d, len);
 	d[len++] = crc32 >> 24;
 	d[len++] = crc32 >> 16;
@@ -593,9 +593,9 @@ static void chip_init (void)
 	uaenet_close (sysdata);
 	if (td != NULL) {
 		if (!sysdata)
-			sysdata = xcalloc (uae_u8, uaenet_getdatalenght());
+			sysdata = xcalloc (uae_u8, uaenet_getdatalength());
 		if (!uaenet_open (sysdata, td, NULL, gotfunc, getfunc, prom || fakeprom)) {
-			write_log ("A2065: failed to initialize winpcap driver\n");
+			write_log ("A2065: failed to open network device '%s'\n", td->name);
 		}
 	}
 }
@@ -293,15 +293,7 @@ static uae_u32 akiko_result[8];
 
 static void akiko_c2p_do (void)
 {
-	int i;
-
-	for (i = 0; i < 8; i++)
-		akiko_result[i] = 0;
-	/* FIXME: better c2p algoritm than this piece of crap.... */
-	for (i = 0; i < 8 * 32; i++) {
-		if (akiko_buffer[7 - (i >> 5)] & (1 << (i & 31)))
-			akiko_result[i & 7] |= 1 << (i >> 3);
-	}
+	akiko_c2p_convert (akiko_buffer, akiko_result);
 }
 
 static void akiko_c2p_write (int offset, uae_u32 v)
@@ -316,6 +308,27 @@ static void akiko_c2p_write (int offset, uae_u32 v)
 	akiko_read_offset = 0;
 }
 
+/* Longword accesses are what C2P routines use (MOVE.L/MOVEM.L bursts of
+ * 8 writes followed by 8 reads), handle them without splitting into bytes */
+static void akiko_c2p_write_long (uae_u32 v)
+{
+	akiko_buffer[akiko_write_offset] = v;
+	akiko_write_offset = (akiko_write_offset + 1) & 7;
+	akiko_read_offset = 0;
+}
+
+static uae_u32 akiko_c2p_read_long (void)
+{
+	uae_u32 v;
+
+	if (akiko_read_offset == 0)
+		akiko_c2p_do ();
+	akiko_write_offset = 0;
+	v = akiko_result[akiko_read_offset];
+	akiko_read_offset = (akiko_read_offset + 1) & 7;
+	return v;
+}
+
 static uae_u32 akiko_c2p_read (int offset)
 {
 	uae_u32 v;
@@ -1451,6 +1464,8 @@ static uae_u32 REGPARAM2 akiko_lget (uaecptr addr)
 	special_mem |= S_READ;
 #endif
 	addr &= 0xffff;
+	if (addr == 0x38 && currprefs.cs_cd32c2p)
+		return akiko_c2p_read_long ();
 	v = akiko_bget2 (addr + 3, 0);
 	v |= akiko_bget2 (addr + 2, 0) << 8;
 	v |= akiko_bget2 (addr + 1, 0) << 16;
@@ -1597,6 +1612,10 @@ static void REGPARAM2 akiko_lput (uaecptr addr, uae_u32 v)
 	special_mem |= S_WRITE;
 #endif
 	addr &= 0xffff;
+	if (addr == 0x38 && currprefs.cs_cd32c2p) {
+		akiko_c2p_write_long (v);
+		return;
+	}
 	if(addr < 0x30 && AKIKO_DEBUG_IO)
 		write_log ("akiko_lput %08X: %08X=%08X\n", M68K_GETPC, addr, v);
 	akiko_bput2 (addr + 3, (v >> 0) & 0xff, 0);
@@ -31,6 +31,7 @@
 #include "gui.h"
 #include "xwin.h"
 #include "debug.h"
+#include "hostprof.h"
 #ifdef AVIOUTPUT
 #include "avioutput.h"
 #endif
@@ -1716,6 +1717,7 @@ void update_audio (void)
 	unsigned long int n_cycles = 0;
 	static int samplecounter;
 
+	HOSTPROF_ENTER (HP_AUDIO);
 	if (!isaudio ())
 		goto end;
 	if (isrestore ())
@@ -1780,7 +1782,9 @@ void update_audio (void)
 					}
 				}
 #endif
-				(*sample_handler) ();
+				/* run-ahead frames are heard when emulated again */
+				if (!runahead_frame)
+					(*sample_handler) ();
 #if SOUNDSTUFF > 1
 				if (outputsample == 0)
 					outputsample = -1;
@@ -1803,6 +1807,7 @@ void update_audio (void)
 	}
 end:
 	last_cycles = get_cycles () - n_cycles;
+	HOSTPROF_LEAVE ();
 }
 
 void audio_evhandler (void)
@@ -2069,6 +2074,13 @@ uae_u8 *restore_audio (int nr, uae_u8 *src)
 	return src;
 }
 
+const struct runahead_var audio_runahead_vars[] = {
+	RUNAHEAD_VAR (audio_channel),
+	RUNAHEAD_VAR (last_cycles),
+	RUNAHEAD_VAR (next_sample_evtime),
+	{ NULL, 0 }
+};
+
 #endif /* SAVESTATE */
 
 #if defined SAVESTATE || defined DEBUGGER
@@ -27,6 +27,7 @@
 #include "blit.h"
 #include "savestate.h"
 #include "debug.h"
+#include "hostprof.h"
 #include "writelog.h"
 #include "zfile.h"
 
@@ -1003,7 +1004,7 @@ static void do_startcycles (int hpos)
 	}
 }
 
-void decide_blitter (int hpos)
+static void decide_blitter_1 (int hpos)
 {
 	int hsync = hpos < 0;
 
@@ -1117,6 +1118,13 @@ void decide_blitter (int hpos)
 	if (hsync)
 		last_blitter_hpos = 0;
 }
+
+void decide_blitter (int hpos)
+{
+	HOSTPROF_ENTER (HP_BLITTER);
+	decide_blitter_1 (hpos);
+	HOSTPROF_LEAVE ();
+}
 #else
 void decide_blitter (int hpos) { }
 #endif
@@ -1410,6 +1418,7 @@ static void do_blitter2 (int hpos, int copper)
 
 void do_blitter (int hpos, int copper)
 {
+	HOSTPROF_COUNT (HPC_BLITS);
 	if (bltstate == BLT_done || !currprefs.blitter_cycle_exact) {
 		do_blitter2 (hpos, copper);
 		return;
@@ -1743,4 +1752,71 @@ uae_u8 *save_blitter_new (int *len, uae_u8 *dstptr)
 	return dstbak;
 }
 
+/* For run-ahead a blit in progress is continued where it was, unlike
+ * save_blitter_new () which has it started again. */
+const struct runahead_var blitter_runahead_vars[] = {
+	RUNAHEAD_VAR (bltcon0),
+	RUNAHEAD_VAR (bltcon1),
+	RUNAHEAD_VAR (bltapt),
+	RUNAHEAD_VAR (bltbpt),
+	RUNAHEAD_VAR (bltcpt),
+	RUNAHEAD_VAR (bltdpt),
+	RUNAHEAD_VAR (blitter_nasty),
+	RUNAHEAD_VAR (original_ch),
+	RUNAHEAD_VAR (original_fill),
+	RUNAHEAD_VAR (original_line),
+	RUNAHEAD_VAR (blinea_shift),
+	RUNAHEAD_VAR (blinea),
+	RUNAHEAD_VAR (blineb),
+	RUNAHEAD_VAR (blitline),
+	RUNAHEAD_VAR (blitfc),
+	RUNAHEAD_VAR (blitfill),
+	RUNAHEAD_VAR (blitife),
+	RUNAHEAD_VAR (blitsing),
+	RUNAHEAD_VAR (blitdesc),
+	RUNAHEAD_VAR (blitonedot),
+	RUNAHEAD_VAR (blitsign),
+	RUNAHEAD_VAR (blitlinepixel),
+	RUNAHEAD_VAR (blit_add),
+	RUNAHEAD_VAR (blit_modadda),
+	RUNAHEAD_VAR (blit_modaddb),
+	RUNAHEAD_VAR (blit_modaddc),
+	RUNAHEAD_VAR (blit_modaddd),
+	RUNAHEAD_VAR (blit_ch),
+	RUNAHEAD_VAR (blt_info),
+	RUNAHEAD_VAR (blit_masktable),
+	RUNAHEAD_VAR (bltstate),
+	RUNAHEAD_VAR (blit_cyclecounter),
+	RUNAHEAD_VAR (blit_waitcyclecounter),
+	RUNAHEAD_VAR (blit_maxcyclecounter),
+	RUNAHEAD_VAR (blit_slowdown),
+	RUNAHEAD_VAR (blit_totalcyclecounter),
+	RUNAHEAD_VAR (blit_startcycles),
+	RUNAHEAD_VAR (blit_misscyclecounter),
+	RUNAHEAD_VAR (blit_firstline_cycles),
+	RUNAHEAD_VAR (blit_first_cycle),
+	RUNAHEAD_VAR (blit_last_cycle),
+	RUNAHEAD_VAR (blit_dmacount),
+	RUNAHEAD_VAR (blit_dmacount2),
+	RUNAHEAD_VAR (blit_linecycles),
+	RUNAHEAD_VAR (blit_extracycles),
+	RUNAHEAD_VAR (blit_nod),
+	RUNAHEAD_VAR (blit_diag),
+	RUNAHEAD_VAR (blit_frozen),
+	RUNAHEAD_VAR (blit_faulty),
+	RUNAHEAD_VAR (blit_final),
+	RUNAHEAD_VAR (blt_delayed_irq),
+	RUNAHEAD_VAR (ddat1),
+	RUNAHEAD_VAR (ddat2),
+	RUNAHEAD_VAR (ddat1use),
+	RUNAHEAD_VAR (ddat2use),
+	RUNAHEAD_VAR (blit_interrupt),
+	RUNAHEAD_VAR (last_blitter_hpos),
+	RUNAHEAD_VAR (blitter_hcounter1),
+	RUNAHEAD_VAR (blitter_hcounter2),
+	RUNAHEAD_VAR (blitter_vcounter1),
+	RUNAHEAD_VAR (blitter_vcounter2),
+	{ NULL, 0 }
+};
+
 #endif /* SAVESTATE */
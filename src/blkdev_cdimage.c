@@ -4,8 +4,9 @@
  * CD image file support
  *
  * - iso (2048/2352 block size)
- * - cue/bin, cue/bin/wav, cue/bin/mp3
+ * - cue/bin, cue/bin/wav, cue/bin/mp3, cue/bin/flac
  * - ccd/img and ccd/img/sub
+ * - cso (block compressed iso/bin, unpacked on demand)
  *
  * Copyright 2010 Toni Wilen
  *
@@ -20,6 +21,7 @@
 #include "fsdb.h"
 #include "threaddep/thread.h"
 #include "scsidev.h"
+#include "cdda_stream.h"
 #include <mp3decoder.h>
 #include <memory.h>
 #ifdef RETROPLATFORM
@@ -37,6 +39,8 @@ struct cdtoc
 	struct zfile *handle;
 	int offset;
 	uae_u8 *data;
+	struct cdda_stream *stream;
+	uae_sem_t stream_lock; // FLAC tracks only, guards stream and the use of handle
 	struct zfile *subhandle;
 	int suboffset;
 	uae_u8 *subdata;
@@ -49,7 +53,6 @@ struct cdtoc
 	int size;
 	int skipsize; // bytes to skip after each block
 	audenc enctype;
-	int writeoffset;
 	int subcode;
 };
 
@@ -68,6 +71,8 @@ struct cdunit {
 	int cdda_volume[2];
 	int cdda_scan;
 	int cd_last_pos;
+	struct cdtoc *ra_track;
+	int ra_next;
 	int cdda_start, cdda_end;
 	play_subchannel_callback cdda_subfunc;
 	play_status_callback cdda_statusfunc;
@@ -76,6 +81,8 @@ struct cdunit {
 	int imagechange;
 	TCHAR newfile[MAX_DPATH];
 	uae_sem_t sub_sem;
+	uae_sem_t stream_sem;
+	struct cdtoc *stream_track; // FLAC track with an open stream
 	struct device_info di;
 };
 
@@ -118,92 +125,55 @@ static struct cdtoc *findtoc (struct cdunit *cdu, int *sectorp)
 	return NULL;
 }
 
-// WOHOO, library that supports virtual file access functions. Perfect!
-static void flac_metadata_callback (const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data)
+/* Only the FLAC track last played or read keeps its decoder and ring,
+ * the previous one is closed when the unit moves to another track. */
+static void cdda_stream_switch (struct cdunit *cdu, struct cdtoc *t)
 {
-	struct cdtoc *t = (struct cdtoc*)client_data;
-	if (t->data)
+	struct cdtoc *old;
+
+	uae_sem_wait (&cdu->stream_sem);
+	old = cdu->stream_track;
+	cdu->stream_track = t;
+	uae_sem_post (&cdu->stream_sem);
+	if (!old || old == t)
 		return;
-	if(metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
-		t->filesize = metadata->data.stream_info.total_samples * (metadata->data.stream_info.bits_per_sample / 8) * metadata->data.stream_info.channels;
-	}
-}
-static void flac_error_callback (const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
-{
-	return;
-}
-static FLAC__StreamDecoderWriteStatus flac_write_callback (const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
-{
-	struct cdtoc *t = (struct cdtoc*)client_data;
-	uae_u16 *p = (uae_u16*)(t->data + t->writeoffset);
-	int size = 4;
-	unsigned int i;
-	for (i = 0; i < frame->header.blocksize && t->writeoffset < t->filesize - size; i++, t->writeoffset += size) {
-		*p++ = (FLAC__int16)buffer[0][i];
-		*p++ = (FLAC__int16)buffer[1][i];
-	}
-	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
-}
-static FLAC__StreamDecoderReadStatus file_read_callback (const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
-{
-	struct cdtoc *t = (struct cdtoc*)client_data;
-	if (zfile_ftell (t->handle) >= zfile_size (t->handle))
-		return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
-	return zfile_fread (buffer, *bytes, 1, t->handle) ? FLAC__STREAM_DECODER_READ_STATUS_CONTINUE : FLAC__STREAM_DECODER_READ_STATUS_ABORT;
-}
-static FLAC__StreamDecoderSeekStatus file_seek_callback (const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data)
-{
-	struct cdtoc *t = (struct cdtoc*)client_data;
-	zfile_fseek (t->handle, absolute_byte_offset, SEEK_SET);
-	return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
-}
-static FLAC__StreamDecoderTellStatus file_tell_callback (const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data)
-{
-	struct cdtoc *t = (struct cdtoc*)client_data;
-	*absolute_byte_offset = zfile_ftell (t->handle);
-	return FLAC__STREAM_DECODER_TELL_STATUS_OK;
-}
-static FLAC__StreamDecoderLengthStatus file_len_callback (const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data)
-{
-	struct cdtoc *t = (struct cdtoc*)client_data;
-	*stream_length = zfile_size (t->handle);
-	return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
-}
-static FLAC__bool file_eof_callback (const FLAC__StreamDecoder *decoder, void *client_data)
-{
-	struct cdtoc *t = (struct cdtoc*)client_data;
-	return zfile_ftell (t->handle) >= zfile_size (t->handle);
+	uae_sem_wait (&old->stream_lock);
+	cdda_stream_close (old->stream);
+	old->stream = NULL;
+	uae_sem_post (&old->stream_lock);
 }
 
-static void flac_get_size (struct cdtoc *t)
+// read one audio sector worth of PCM data from a track, whatever its encoding
+static void cdda_read_audio (struct cdunit *cdu, struct cdtoc *t, uae_u8 *dst, int sector)
 {
-	FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new ();
-	if (decoder) {
-		FLAC__stream_decoder_set_md5_checking (decoder, false);
-		int init_status = FLAC__stream_decoder_init_stream (decoder,
-			&file_read_callback, &file_seek_callback, &file_tell_callback,
-			&file_len_callback, &file_eof_callback,
-			&flac_write_callback, &flac_metadata_callback, &flac_error_callback, t);
-		FLAC__stream_decoder_process_until_end_of_metadata (decoder);
-		FLAC__stream_decoder_delete (decoder);
-	}
-}
-static uae_u8 *flac_get_data (struct cdtoc *t)
-{
-	write_log ("FLAC: unpacking '%s'..\n", zfile_getname (t->handle));
-	t->writeoffset = 0;
-	FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new ();
-	if (decoder) {
-		FLAC__stream_decoder_set_md5_checking (decoder, false);
-		int init_status = FLAC__stream_decoder_init_stream (decoder,
-			&file_read_callback, &file_seek_callback, &file_tell_callback,
-			&file_len_callback, &file_eof_callback,
-			&flac_write_callback, &flac_metadata_callback, &flac_error_callback, t);
-		FLAC__stream_decoder_process_until_end_of_stream (decoder);
-		FLAC__stream_decoder_delete (decoder);
-		write_log ("FLAC: %s unpacked\n", zfile_getname (t->handle));
+	int totalsize = t->size + t->skipsize;
+	uae_s64 pos = (uae_s64)sector * totalsize + t->offset;
+	int got = 0;
+
+	if (t->enctype == AUDENC_FLAC) {
+		if (pos + t->size <= t->filesize) {
+			cdda_stream_switch (cdu, t);
+			// the unpack, play and raw read threads can all get here
+			uae_sem_wait (&t->stream_lock);
+			if (!t->stream)
+				t->stream = cdda_stream_open (t->handle);
+			if (t->stream) {
+				cdda_stream_read (t->stream, dst, pos, t->size);
+				got = t->size; // zero filled past what could be decoded
+			}
+			uae_sem_post (&t->stream_lock);
+		}
+	} else if (t->enctype == AUDENC_MP3) {
+		if (t->data && t->filesize >= pos + t->size) {
+			memcpy (dst, t->data + pos, t->size);
+			got = t->size;
+		}
+	} else if (t->enctype != AUDENC_PCM || pos + t->size <= t->filesize) {
+		zfile_fseek (t->handle, pos, SEEK_SET);
+		got = zfile_fread (dst, 1, t->size, t->handle);
 	}
-	return t->data;
+	if (got < t->size)
+		memset (dst + got, 0, t->size - got);
 }
 
 #ifdef _WIN32
@@ -347,28 +317,34 @@ static void *cdda_unpack_func (void *v)
 		struct cdunit *cdu = &cdunits[cduidx];
 		struct cdtoc *t = &cdu->toc[tocidx];
 		if (t->handle) {
-			// force unpack if handle points to delayed zipped file
+			// force unpack if handle points to delayed zipped file,
+			// a FLAC track's decoder may be using it right now
+			if (t->enctype == AUDENC_FLAC)
+				uae_sem_wait (&t->stream_lock);
 			uae_s64 pos = zfile_ftell (t->handle);
 			zfile_fseek (t->handle, -1, SEEK_END);
 			uae_u8 b;
 			zfile_fread (&b, 1, 1, t->handle);
 			zfile_fseek (t->handle, pos, SEEK_SET);
-			if (!t->data && (t->enctype == AUDENC_MP3 || t->enctype == AUDENC_FLAC)) {
+			if (t->enctype == AUDENC_FLAC)
+				uae_sem_post (&t->stream_lock);
+			// FLAC is streamed, only MP3 still needs the whole track unpacked
+			if (!t->data && t->enctype == AUDENC_MP3) {
 				t->data = xcalloc (uae_u8, t->filesize + 2352);
 				cdimage_unpack_active = 1;
 				if (t->data) {
-					if (t->enctype == AUDENC_MP3) {
-						if (!mp3dec) {
-							try {
-								mp3dec = new mp3decoder();
-							} catch (exception) { };
-						}
-						if (mp3dec)
-							t->data = mp3dec->get (t->handle, t->data, t->filesize);
-					} else if (t->enctype == AUDENC_FLAC) {
-						flac_get_data (t);
+					if (!mp3dec) {
+						try {
+							mp3dec = new mp3decoder();
+						} catch (exception) { };
 					}
+					if (mp3dec)
+						t->data = mp3dec->get (t->handle, t->data, t->filesize);
 				}
+			} else if (t->enctype == AUDENC_FLAC) {
+				// prime the decoder so the first buffers don't wait for it
+				uae_u8 tmp[2352];
+				cdda_read_audio (cdu, t, tmp, 0);
 			}
 		}
 		cdimage_unpack_active = 2;
@@ -501,18 +477,8 @@ static void *cdda_play_func (void *v)
 
 				t = findtoc (cdu, &sector);
 				if (t) {
-					if (t->handle && !(t->ctrl & 4)) {
-						int totalsize = t->size + t->skipsize;
-						if ((t->enctype == AUDENC_MP3 || t->enctype == AUDENC_FLAC) && t->data) {
-							if (t->filesize >= sector * totalsize + t->offset + t->size)
-								memcpy (dst, t->data + sector * totalsize + t->offset, t->size);
-						} else if (t->enctype == AUDENC_PCM) {
-							if (sector * totalsize + t->offset + totalsize < t->filesize) {
-								zfile_fseek (t->handle, sector * totalsize + t->offset, SEEK_SET);
-								zfile_fread (dst, t->size, 1, t->handle);
-							}
-						}
-					}
+					if (t->handle && !(t->ctrl & 4) && t->enctype != AUDENC_NONE)
+						cdda_read_audio (cdu, t, dst, sector);
 					getsub_deinterleaved (subbuf, cdu, t, cdda_pos);
 				}
 
@@ -700,6 +666,20 @@ static uae_u32 command_volume (int unitnum, uae_u16 volume_left, uae_u16 volume_
 
 extern void encode_l2 (uae_u8 *p, int address);
 
+/* Sequential data reads let compressed images unpack the following
+ * sectors in the background while the Amiga side processes these. */
+#define CD_READAHEAD 64
+
+static void cdimage_readahead (struct cdunit *cdu, struct cdtoc *t, int first, int next)
+{
+	bool sequential = t == cdu->ra_track && first == cdu->ra_next;
+
+	cdu->ra_track = t;
+	cdu->ra_next = next;
+	if (sequential)
+		zfile_readahead (t->handle, t->offset + (uae_s64)next * t->size, CD_READAHEAD * t->size);
+}
+
 static int command_rawread (int unitnum, uae_u8 *data, int sector, int size, int sectorsize, uae_u32 extra)
 {
 	int ret = 0;
@@ -707,6 +687,7 @@ static int command_rawread (int unitnum, uae_u8 *data, int sector, int size, int
 	if (!cdu)
 		return 0;
 	struct cdtoc *t = findtoc (cdu, &sector);
+	int first = sector;
 
 	if (!t || t->handle == NULL)
 		goto end;
@@ -754,6 +735,7 @@ static int command_rawread (int unitnum, uae_u8 *data, int sector, int size, int
 			zfile_fread (data, sectorsize, size, t->handle);
 			sector += size;
 		}
+		cdimage_readahead (cdu, t, first, sector);
 		cdu->cd_last_pos = sector;
 		ret = sectorsize * size;
 
@@ -782,8 +764,7 @@ static int command_rawread (int unitnum, uae_u8 *data, int sector, int size, int
 				goto end;
 			}
 			for (i = 0; i < size; i++) {
-				zfile_fseek (t->handle, t->offset + sector * t->size, SEEK_SET);
-				zfile_fread (data, t->size, 1, t->handle);
+				cdda_read_audio (cdu, t, data, sector);
 				uae_u8 *p = data + t->size;
 				if (subs) {
 					uae_u8 subdata[SUB_CHANNEL_SIZE];
@@ -817,6 +798,7 @@ static int command_read (int unitnum, uae_u8 *data, int sector, int size)
 		return 0;
 
 	struct cdtoc *t = findtoc (cdu, &sector);
+	int first = sector;
 
 	if (!t || t->handle == NULL)
 		return 0;
@@ -841,6 +823,7 @@ static int command_read (int unitnum, uae_u8 *data, int sector, int size)
 			sector++;
 		}
 	}
+	cdimage_readahead (cdu, t, first, sector);
 	cdu->cd_last_pos = sector;
 	return 1;
 }
@@ -1457,9 +1440,12 @@ static int parsecue (struct cdunit *cdu, struct zfile *zcue, const TCHAR *img)
 								t->enctype = fnametypeid;
 						}
 					} else if (fnametypeid == AUDENC_FLAC && t->handle) {
-						flac_get_size (t);
-						if (t->filesize)
+						uae_s64 size = cdda_stream_size (t->handle);
+						if (size) {
+							t->filesize = size;
 							t->enctype = fnametypeid;
+							uae_sem_init (&t->stream_lock, 0, 1);
+						}
 					}
 				}
 			}
@@ -1621,6 +1607,9 @@ static void unload_image (struct cdunit *cdu)
 
 	for (i = 0; i < sizeof cdu->toc / sizeof (struct cdtoc); i++) {
 		struct cdtoc *t = &cdu->toc[i];
+		cdda_stream_close (t->stream);
+		if (t->enctype == AUDENC_FLAC)
+			uae_sem_destroy (&t->stream_lock);
 		zfile_fclose (t->handle);
 		if (t->handle != t->subhandle)
 			zfile_fclose (t->subhandle);
@@ -1629,6 +1618,7 @@ static void unload_image (struct cdunit *cdu)
 		xfree (t->subdata);
 	}
 	memset (cdu->toc, 0, sizeof cdu->toc);
+	cdu->stream_track = NULL;
 	cdu->tracks = 0;
 	cdu->cdsize = 0;
 }
@@ -1641,6 +1631,7 @@ static int open_device (int unitnum, const TCHAR *ident, int flags)
 
 	if (!cdu->open) {
 		uae_sem_init (&cdu->sub_sem, 0, 1);
+		uae_sem_init (&cdu->stream_sem, 0, 1);
 		parse_image (cdu, ident);
 		cdu->open = true;
 		cdu->enabled = true;
@@ -1675,6 +1666,7 @@ static void close_device (int unitnum)
 		}
 		unload_image (cdu);
 		uae_sem_destroy (&cdu->sub_sem);
+		uae_sem_destroy (&cdu->stream_sem);
 	}
 	blkdev_cd_change (unitnum, currprefs.cdslots[unitnum].name);
 }
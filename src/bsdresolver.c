@@ -0,0 +1,647 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * bsdsocket.library emulation - name lookup cache
+  *
+  * Host, service and protocol lookups are remembered for a while so
+  * programs that resolve the same names over and over don't hit NSS (and
+  * the network) every time. Failed host lookups are cached too, for a
+  * shorter time. Several tasks asking for the same name while a lookup is
+  * in progress share its result. Lookups that may block run on a small
+  * pool of resolver threads.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include "threaddep/thread.h"
+#include "bsdresolver.h"
+
+#include <netdb.h>
+#include <time.h>
+#include <errno.h>
+#include <netinet/in.h>
+
+#define BSDRES_TTL 300		/* seconds a good answer stays valid */
+#define BSDRES_NEGTTL 30	/* seconds a failed lookup stays valid */
+#define BSDRES_MAX 256		/* cached entries */
+#define BSDRES_HASH 64
+#define BSDRES_THREADS 4
+
+#define KEY_HOSTNAME 'n'
+#define KEY_HOSTADDR 'a'
+#define KEY_SERVNAME 's'
+#define KEY_SERVPORT 'p'
+#define KEY_PROTONAME 'r'
+
+static struct hostent *default_hostlookup (const char *name, const void *addr, int len, int type, int *herr);
+
+static uae_sem_t res_lock;
+static int res_init;
+static struct bsdres_entry *res_hash[BSDRES_HASH];
+static struct bsdres_entry *res_lru_first, *res_lru_last;
+static int res_count;
+static int res_ttl = BSDRES_TTL, res_negttl = BSDRES_NEGTTL;
+static BSDRES_HOSTLOOKUP res_hostlookup = default_hostlookup;
+static unsigned int res_hits, res_misses, res_shared;
+
+struct bsdres_job
+{
+    struct bsdres_job *next;
+    void (*fn)(void *);
+    void *arg;
+};
+static struct bsdres_job *job_first, *job_last;
+static uae_sem_t job_lock, job_avail;
+static int job_threads, job_idle;
+
+#ifndef __GLIBC__
+/* the classic lookup functions return static buffers */
+static uae_sem_t nss_lock;
+#endif
+
+/* called from the emulation thread before any lookup thread runs */
+void bsdres_init (void)
+{
+    if (res_init)
+	return;
+    uae_sem_init (&res_lock, 0, 1);
+    uae_sem_init (&job_lock, 0, 1);
+    uae_sem_init (&job_avail, 0, 0);
+#ifndef __GLIBC__
+    uae_sem_init (&nss_lock, 0, 1);
+#endif
+    res_init = 1;
+}
+
+static uae_u64 res_now (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uae_u64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int strvlen (char **v, int *size)
+{
+    int n = 0;
+    if (v) {
+	while (v[n])
+	    *size += strlen (v[n++]) + 1;
+    }
+    *size += (n + 1) * sizeof (char*);
+    return n;
+}
+
+static char *copystr (char **p, const char *s)
+{
+    char *d = *p;
+    if (!s)
+	return NULL;
+    strcpy (d, s);
+    *p += strlen (s) + 1;
+    return d;
+}
+
+static char **copystrv (char ***pv, char **p, char **v, int n)
+{
+    char **d = *pv;
+    int i;
+    for (i = 0; i < n; i++)
+	d[i] = copystr (p, v[i]);
+    d[n] = NULL;
+    *pv += n + 1;
+    return d;
+}
+
+/* the result lives in one allocation and is released with free () */
+struct hostent *bsdres_copyhost (const struct hostent *h)
+{
+    int size = sizeof (struct hostent), naliases, naddrs = 0, i;
+    struct hostent *d;
+    char **pv, *p;
+
+    naliases = strvlen (h->h_aliases, &size);
+    if (h->h_addr_list) {
+	while (h->h_addr_list[naddrs])
+	    naddrs++;
+    }
+    size += (naddrs + 1) * sizeof (char*) + naddrs * h->h_length;
+    if (h->h_name)
+	size += strlen (h->h_name) + 1;
+
+    d = (struct hostent*)malloc (size);
+    if (!d)
+	return NULL;
+    pv = (char**)(d + 1);
+    p = (char*)(pv + naliases + 1 + naddrs + 1);
+    d->h_addrtype = h->h_addrtype;
+    d->h_length = h->h_length;
+    d->h_aliases = copystrv (&pv, &p, h->h_aliases, naliases);
+    d->h_addr_list = pv;
+    for (i = 0; i < naddrs; i++) {
+	d->h_addr_list[i] = p;
+	memcpy (p, h->h_addr_list[i], h->h_length);
+	p += h->h_length;
+    }
+    d->h_addr_list[naddrs] = NULL;
+    d->h_name = copystr (&p, h->h_name);
+    return d;
+}
+
+static struct servent *copyserv (const struct servent *s)
+{
+    int size = sizeof (struct servent), naliases;
+    struct servent *d;
+    char **pv, *p;
+
+    naliases = strvlen (s->s_aliases, &size);
+    size += (s->s_name ? strlen (s->s_name) + 1 : 0) + (s->s_proto ? strlen (s->s_proto) + 1 : 0);
+    d = (struct servent*)malloc (size);
+    if (!d)
+	return NULL;
+    pv = (char**)(d + 1);
+    p = (char*)(pv + naliases + 1);
+    d->s_port = s->s_port;
+    d->s_aliases = copystrv (&pv, &p, s->s_aliases, naliases);
+    d->s_name = copystr (&p, s->s_name);
+    d->s_proto = copystr (&p, s->s_proto);
+    return d;
+}
+
+static struct protoent *copyproto (const struct protoent *pe)
+{
+    int size = sizeof (struct protoent), naliases;
+    struct protoent *d;
+    char **pv, *p;
+
+    naliases = strvlen (pe->p_aliases, &size);
+    size += pe->p_name ? strlen (pe->p_name) + 1 : 0;
+    d = (struct protoent*)malloc (size);
+    if (!d)
+	return NULL;
+    pv = (char**)(d + 1);
+    p = (char*)(pv + naliases + 1);
+    d->p_proto = pe->p_proto;
+    d->p_aliases = copystrv (&pv, &p, pe->p_aliases, naliases);
+    d->p_name = copystr (&p, pe->p_name);
+    return d;
+}
+
+#ifdef __GLIBC__
+
+static struct hostent *default_hostlookup (const char *name, const void *addr, int len, int type, int *herr)
+{
+    struct hostent he, *res = NULL, *out = NULL;
+    size_t bufsize = 1024;
+    char *buf;
+    int r;
+
+    for (;;) {
+	buf = xmalloc (char, bufsize);
+	if (!buf)
+	    break;
+	if (name)
+	    r = gethostbyname_r (name, &he, buf, bufsize, &res, herr);
+	else
+	    r = gethostbyaddr_r (addr, len, type, &he, buf, bufsize, &res, herr);
+	if (r != ERANGE || bufsize >= 65536)
+	    break;
+	xfree (buf);
+	bufsize *= 2;
+    }
+    if (res)
+	out = bsdres_copyhost (res);
+    xfree (buf);
+    return out;
+}
+
+static struct servent *lookupserv (const char *name, int port, const char *proto)
+{
+    struct servent se, *res = NULL, *out = NULL;
+    char buf[1024];
+
+    if (name)
+	getservbyname_r (name, proto, &se, buf, sizeof buf, &res);
+    else
+	getservbyport_r (port, proto, &se, buf, sizeof buf, &res);
+    if (res)
+	out = copyserv (res);
+    return out;
+}
+
+static struct protoent *lookupproto (const char *name)
+{
+    struct protoent pe, *res = NULL, *out = NULL;
+    char buf[1024];
+
+    getprotobyname_r (name, &pe, buf, sizeof buf, &res);
+    if (res)
+	out = copyproto (res);
+    return out;
+}
+
+#else
+
+static struct hostent *default_hostlookup (const char *name, const void *addr, int len, int type, int *herr)
+{
+    struct hostent *h, *out = NULL;
+
+    uae_sem_wait (&nss_lock);
+    h = name ? gethostbyname (name) : gethostbyaddr (addr, len, type);
+    if (h)
+	out = bsdres_copyhost (h);
+    else
+	*herr = h_errno;
+    uae_sem_post (&nss_lock);
+    return out;
+}
+
+static struct servent *lookupserv (const char *name, int port, const char *proto)
+{
+    struct servent *s, *out = NULL;
+
+    uae_sem_wait (&nss_lock);
+    s = name ? getservbyname (name, proto) : getservbyport (port, proto);
+    if (s)
+	out = copyserv (s);
+    uae_sem_post (&nss_lock);
+    return out;
+}
+
+static struct protoent *lookupproto (const char *name)
+{
+    struct protoent *p, *out = NULL;
+
+    uae_sem_wait (&nss_lock);
+    p = getprotobyname (name);
+    if (p)
+	out = copyproto (p);
+    uae_sem_post (&nss_lock);
+    return out;
+}
+
+#endif
+
+static int res_hashkey (const uae_u8 *key, int len)
+{
+    uae_u32 h = 2166136261u;
+    int i;
+    for (i = 0; i < len; i++)
+	h = (h ^ key[i]) * 16777619u;
+    return h % BSDRES_HASH;
+}
+
+static void lru_unlink (struct bsdres_entry *e)
+{
+    if (e->lprev)
+	e->lprev->lnext = e->lnext;
+    else
+	res_lru_first = e->lnext;
+    if (e->lnext)
+	e->lnext->lprev = e->lprev;
+    else
+	res_lru_last = e->lprev;
+    e->lprev = e->lnext = NULL;
+}
+
+static void lru_front (struct bsdres_entry *e)
+{
+    e->lprev = NULL;
+    e->lnext = res_lru_first;
+    if (res_lru_first)
+	res_lru_first->lprev = e;
+    res_lru_first = e;
+    if (!res_lru_last)
+	res_lru_last = e;
+}
+
+static void entry_free (struct bsdres_entry *e)
+{
+    free (e->host);
+    free (e->serv);
+    free (e->proto);
+    if (e->key)
+	uae_sem_destroy (&e->done);
+    xfree (e->key);
+    xfree (e);
+}
+
+/* take e out of the cache, it goes away once the last user releases it */
+static void entry_remove (struct bsdres_entry *e)
+{
+    struct bsdres_entry **ep;
+
+    for (ep = &res_hash[e->hash]; *ep; ep = &(*ep)->hnext) {
+	if (*ep == e) {
+	    *ep = e->hnext;
+	    break;
+	}
+    }
+    lru_unlink (e);
+    res_count--;
+    if (--e->refcnt == 0)
+	entry_free (e);
+}
+
+/* find or create the entry for key, called with res_lock held */
+static struct bsdres_entry *entry_get (const uae_u8 *key, int keylen, int *isnew)
+{
+    int h = res_hashkey (key, keylen);
+    struct bsdres_entry *e;
+
+    *isnew = 0;
+    for (e = res_hash[h]; e; e = e->hnext) {
+	if (e->keylen == keylen && !memcmp (e->key, key, keylen))
+	    break;
+    }
+    if (e && !e->pending && e->expires <= res_now ()) {
+	entry_remove (e);
+	e = NULL;
+    }
+    if (e) {
+	lru_unlink (e);
+	lru_front (e);
+	e->refcnt++;
+	return e;
+    }
+    e = xcalloc (struct bsdres_entry, 1);
+    e->key = xmalloc (uae_u8, keylen);
+    memcpy (e->key, key, keylen);
+    e->keylen = keylen;
+    e->hash = h;
+    uae_sem_init (&e->done, 0, 0);
+    e->pending = 1;
+    e->refcnt = 2; /* cache + caller */
+    e->hnext = res_hash[h];
+    res_hash[h] = e;
+    lru_front (e);
+    res_count++;
+    /* drop the oldest finished entries */
+    while (res_count > BSDRES_MAX) {
+	struct bsdres_entry *old = res_lru_last;
+	while (old && old->pending)
+	    old = old->lprev;
+	if (!old)
+	    break;
+	entry_remove (old);
+    }
+    *isnew = 1;
+    return e;
+}
+
+/* publish the result of a lookup and wake up tasks waiting for it */
+static void entry_done (struct bsdres_entry *e, int negative)
+{
+    uae_sem_wait (&res_lock);
+    e->pending = 0;
+    e->expires = res_now () + (uae_u64)(negative ? res_negttl : res_ttl) * 1000;
+    /* "try again" is not an answer worth remembering */
+    if (negative && e->herr == TRY_AGAIN)
+	e->expires = 0;
+    while (e->waiters > 0) {
+	e->waiters--;
+	uae_sem_post (&e->done);
+    }
+    uae_sem_post (&res_lock);
+}
+
+/* returns the entry for key; isnew is set if the caller has to fill it in */
+static struct bsdres_entry *res_lookup (const uae_u8 *key, int keylen, int cachedonly, int *isnew)
+{
+    struct bsdres_entry *e;
+
+    bsdres_init ();
+    uae_sem_wait (&res_lock);
+    if (cachedonly) {
+	int h = res_hashkey (key, keylen);
+	for (e = res_hash[h]; e; e = e->hnext) {
+	    if (e->keylen == keylen && !memcmp (e->key, key, keylen))
+		break;
+	}
+	if (!e || e->pending || e->expires <= res_now ()) {
+	    uae_sem_post (&res_lock);
+	    return NULL;
+	}
+    }
+    e = entry_get (key, keylen, isnew);
+    if (*isnew) {
+	res_misses++;
+    } else if (e->pending) {
+	/* someone else is already asking, wait for the answer */
+	res_shared++;
+	e->waiters++;
+	uae_sem_post (&res_lock);
+	uae_sem_wait (&e->done);
+	uae_sem_wait (&res_lock);
+    } else {
+	res_hits++;
+    }
+    uae_sem_post (&res_lock);
+    return e;
+}
+
+static int makekey (uae_u8 *key, int max, int type, const void *data, int len)
+{
+    if (len + 1 > max)
+	return -1;
+    key[0] = type;
+    memcpy (key + 1, data, len);
+    return len + 1;
+}
+
+struct bsdres_entry *bsdres_gethostbyname (const char *name, int cachedonly)
+{
+    uae_u8 key[300];
+    int keylen = makekey (key, sizeof key, KEY_HOSTNAME, name, strlen (name));
+    struct bsdres_entry *e;
+    int isnew;
+
+    if (keylen < 0) {
+	/* too long to be a real name, don't bother caching */
+	if (cachedonly)
+	    return NULL;
+	e = xcalloc (struct bsdres_entry, 1);
+	e->refcnt = 1;
+	e->host = res_hostlookup (name, NULL, 0, 0, &e->herr);
+	e->err = e->host ? 0 : errno;
+	return e;
+    }
+    e = res_lookup (key, keylen, cachedonly, &isnew);
+    if (e && isnew) {
+	e->host = res_hostlookup (name, NULL, 0, 0, &e->herr);
+	e->err = e->host ? 0 : errno;
+	if (!e->host && !e->herr)
+	    e->herr = HOST_NOT_FOUND;
+	entry_done (e, e->host == NULL);
+    }
+    return e;
+}
+
+struct bsdres_entry *bsdres_gethostbyaddr (const void *addr, int len, int type, int cachedonly)
+{
+    uae_u8 key[40];
+    int keylen, isnew;
+    struct bsdres_entry *e;
+
+    if (len < 0 || len > 32)
+	len = 32;
+    keylen = makekey (key, sizeof key - 4, KEY_HOSTADDR, addr, len);
+    memcpy (key + keylen, &type, 4);
+    keylen += 4;
+    e = res_lookup (key, keylen, cachedonly, &isnew);
+    if (e && isnew) {
+	e->host = res_hostlookup (NULL, addr, len, type, &e->herr);
+	e->err = e->host ? 0 : errno;
+	if (!e->host && !e->herr)
+	    e->herr = HOST_NOT_FOUND;
+	entry_done (e, e->host == NULL);
+    }
+    return e;
+}
+
+static struct bsdres_entry *res_serv (int type, const char *name, int port, const char *proto)
+{
+    uae_u8 key[256], data[256];
+    int len, keylen, isnew;
+    struct bsdres_entry *e;
+
+    if (name)
+	len = snprintf ((char*)data, sizeof data, "%s/%s", name, proto ? proto : "");
+    else
+	len = snprintf ((char*)data, sizeof data, "%d/%s", port, proto ? proto : "");
+    keylen = makekey (key, sizeof key, type, data, len);
+    if (len >= (int)sizeof data || keylen < 0) {
+	e = xcalloc (struct bsdres_entry, 1);
+	e->refcnt = 1;
+	e->serv = lookupserv (name, port, proto);
+	return e;
+    }
+    e = res_lookup (key, keylen, 0, &isnew);
+    if (isnew) {
+	e->serv = lookupserv (name, port, proto);
+	entry_done (e, e->serv == NULL);
+    }
+    return e;
+}
+
+struct bsdres_entry *bsdres_getservbyname (const char *name, const char *proto)
+{
+    return res_serv (KEY_SERVNAME, name, 0, proto);
+}
+
+struct bsdres_entry *bsdres_getservbyport (int port, const char *proto)
+{
+    return res_serv (KEY_SERVPORT, NULL, port, proto);
+}
+
+struct bsdres_entry *bsdres_getprotobyname (const char *name)
+{
+    uae_u8 key[256];
+    int keylen = makekey (key, sizeof key, KEY_PROTONAME, name, strlen (name));
+    struct bsdres_entry *e;
+    int isnew;
+
+    if (keylen < 0) {
+	e = xcalloc (struct bsdres_entry, 1);
+	e->refcnt = 1;
+	e->proto = lookupproto (name);
+	return e;
+    }
+    e = res_lookup (key, keylen, 0, &isnew);
+    if (isnew) {
+	e->proto = lookupproto (name);
+	entry_done (e, e->proto == NULL);
+    }
+    return e;
+}
+
+void bsdres_release (struct bsdres_entry *e)
+{
+    if (!e)
+	return;
+    if (!e->key) {
+	/* never was in the cache */
+	entry_free (e);
+	return;
+    }
+    uae_sem_wait (&res_lock);
+    if (--e->refcnt == 0)
+	entry_free (e);
+    uae_sem_post (&res_lock);
+}
+
+void bsdres_flush (void)
+{
+    struct bsdres_entry *e, *next;
+
+    if (!res_init)
+	return;
+    uae_sem_wait (&res_lock);
+    write_log ("BSDSOCK: resolver cache %u hits, %u misses, %u shared, %d entries\n",
+	res_hits, res_misses, res_shared, res_count);
+    for (e = res_lru_first; e; e = next) {
+	next = e->lnext;
+	if (!e->pending)
+	    entry_remove (e);
+    }
+    res_hits = res_misses = res_shared = 0;
+    uae_sem_post (&res_lock);
+}
+
+static void *bsdres_thread (void *arg)
+{
+    for (;;) {
+	struct bsdres_job *j;
+
+	uae_sem_wait (&job_lock);
+	job_idle++;
+	uae_sem_post (&job_lock);
+	uae_sem_wait (&job_avail);
+	uae_sem_wait (&job_lock);
+	job_idle--;
+	j = job_first;
+	job_first = j->next;
+	if (!job_first)
+	    job_last = NULL;
+	uae_sem_post (&job_lock);
+	j->fn (j->arg);
+	xfree (j);
+    }
+    return NULL;
+}
+
+void bsdres_async (void (*fn)(void *), void *arg)
+{
+    struct bsdres_job *j = xmalloc (struct bsdres_job, 1);
+
+    bsdres_init ();
+    j->next = NULL;
+    j->fn = fn;
+    j->arg = arg;
+    uae_sem_wait (&job_lock);
+    if (job_last)
+	job_last->next = j;
+    else
+	job_first = j;
+    job_last = j;
+    /* start another thread unless an idle one will take the job */
+    if (job_idle == 0 && job_threads < BSDRES_THREADS) {
+	uae_thread_id tid;
+	/* thread layers disagree on what uae_start_thread returns */
+	uae_start_thread ("bsdsocket resolver", bsdres_thread, NULL, &tid);
+	job_threads++;
+    }
+    uae_sem_post (&job_lock);
+    uae_sem_post (&job_avail);
+}
+
+void bsdres_setbackend (BSDRES_HOSTLOOKUP lookup)
+{
+    res_hostlookup = lookup ? lookup : default_hostlookup;
+}
+
+void bsdres_setttl (int ttl, int negttl)
+{
+    res_ttl = ttl;
+    res_negttl = negttl;
+}
@@ -35,6 +35,7 @@
 #include "threaddep/thread.h"
 #include "native2amiga.h"
 #include "bsdsocket.h"
+#include "bsdresolver.h"
 
 #ifdef BSDSOCKET
 #include <sys/types.h>
@@ -52,6 +53,14 @@
 #include <signal.h>
 #include <arpa/inet.h>
 
+#ifdef __linux__
+#define BSD_REACTOR
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <stdint.h>
+#include <time.h>
+#endif
+
 //#define DEBUG_BSDSOCKET
 #ifdef DEBUG_BSDSOCKET
 #define DEBUG_LOG write_log
@@ -462,7 +471,7 @@ STATIC_INLINE void fd_zero (uae_u32 fdset, uae_u32 nfds)
 
 STATIC_INLINE int bsd_amigaside_FD_ISSET (int n, uae_u32 set)
 {
-    uae_u32 foo = get_long (set + (n / 32));
+    uae_u32 foo = get_long (set + (n / 32) * 4);
     if (foo & (1 << (n % 32)))
 		return 1;
     return 0;
@@ -476,7 +485,7 @@ STATIC_INLINE void bsd_amigaside_FD_ZERO (uae_u32 set)
 
 STATIC_INLINE void bsd_amigaside_FD_SET (int n, uae_u32 set)
 {
-    set = set + (n / 32);
+    set = set + (n / 32) * 4;
     put_long (set, get_long (set) | (1 << (n % 32)));
 }
 
@@ -581,6 +590,31 @@ static void copyHostent (const struct hostent *hostent, SB)
     bsdsocklib_seterrno (sb,0);
 }
 
+/*
+ * Resolve sb->name (action 4) or the address in sb->name (action 7)
+ * through the resolver cache. With cachedonly set nothing is looked up,
+ * 0 is returned if the answer isn't known yet.
+ */
+static int bsdthr_gethost (SB, int cachedonly)
+{
+    struct bsdres_entry *e;
+
+    if (sb->action == 4)
+	e = bsdres_gethostbyname ((char *)get_real_address (sb->name), cachedonly);
+    else
+	e = bsdres_gethostbyaddr (get_real_address (sb->name), sb->a_addrlen, sb->flags, cachedonly);
+    if (!e)
+	return 0;
+    if (e->host) {
+	copyHostent (e->host, sb);
+	bsdsocklib_setherrno (sb, 0);
+    } else
+	bsdsocklib_setherrno (sb, e->herr);
+    bsdsocklib_seterrno (sb, mapErrno (e->err));
+    bsdres_release (e);
+    return 1;
+}
+
 /*
  * Copy a protoent object from native space to Amiga space
  */
@@ -866,6 +900,437 @@ uae_u32 bsdthr_blockingstuff (uae_u32 (*tryfunc)(SB), SB)
     return foo;
 }
 
+#ifdef BSD_REACTOR
+
+/* One reactor thread serves every SocketBase. Blocking calls are tried
+ * non-blocking first; if they would block, the socket is armed in the
+ * reactor's epoll set and the call is retried when it becomes ready.
+ * WaitSelect gets its own epoll set per call, which is itself watched by
+ * the reactor, so the number of descriptors is not limited by FD_SETSIZE.
+ * Completion signals the Amiga task like the old per-base threads did.
+ * Name lookups that miss the resolver cache run on its thread pool. */
+
+#define REACTOR_OP 0
+#define REACTOR_ABORT 1
+#define REACTOR_WS 2
+#define REACTOR_TAG(sb,t) ((uae_u64)(uintptr_t)(sb) | (t))
+
+#define PENDING_NONE 0
+#define PENDING_OP 1
+#define PENDING_WS 2
+#define PENDING_REMOVED -1
+
+struct bsd_wsfd
+{
+    int s;
+    int index;
+    uae_u32 events;
+    uae_u32 revents;
+};
+
+static int reactor_epfd = -1, reactor_evfd = -1;
+static uae_thread_id reactor_tid;
+static uae_sem_t reactor_lock;
+static struct socketbase *reactor_queue;
+static struct socketbase *reactor_wslist;
+
+static uae_u64 reactor_ms (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uae_u64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void reactor_complete (SB, int r, int err)
+{
+    if (sb->pending == PENDING_OP)
+	epoll_ctl (reactor_epfd, EPOLL_CTL_DEL, sb->s, NULL);
+    sb->pending = PENDING_NONE;
+    sb->resultval = r;
+    errno = err;
+    SETERRNO;
+    SETSIGNAL;
+}
+
+static void reactor_try (SB)
+{
+    long flags;
+    int nonblock, r, err;
+
+    if ((flags = fcntl (sb->s, F_GETFL)) == -1)
+	flags = 0;
+    nonblock = (flags & O_NONBLOCK);
+    fcntl (sb->s, F_SETFL, flags | O_NONBLOCK);
+    r = sb->tryfunc (sb);
+    err = errno;
+    fcntl (sb->s, F_SETFL, flags);
+
+    if (r < 0 && !nonblock && (err == EAGAIN || err == EWOULDBLOCK || err == EINPROGRESS)) {
+	struct epoll_event ev;
+	memset (&ev, 0, sizeof ev);
+	ev.events = EPOLLONESHOT | ((sb->action == 3 || sb->action == 6) ? EPOLLIN : EPOLLOUT);
+	ev.data.u64 = REACTOR_TAG (sb, REACTOR_OP);
+	if (epoll_ctl (reactor_epfd, sb->pending == PENDING_OP ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, sb->s, &ev) < 0
+	    && (errno != EEXIST || epoll_ctl (reactor_epfd, EPOLL_CTL_MOD, sb->s, &ev) < 0)) {
+	    reactor_complete (sb, -1, errno);
+	    return;
+	}
+	sb->pending = PENDING_OP;
+	return;
+    }
+    reactor_complete (sb, r, err);
+}
+
+static void reactor_ws_done (SB, int r)
+{
+    struct socketbase **sbp;
+
+    for (sbp = &reactor_wslist; *sbp; sbp = &(*sbp)->nextws) {
+	if (*sbp == sb) {
+	    *sbp = sb->nextws;
+	    break;
+	}
+    }
+    close (sb->wsepfd);
+    sb->wsepfd = -1;
+    sb->pending = PENDING_NONE;
+    if (r <= 0) {
+	int set;
+	for (set = 0; set < 3; set++) {
+	    if (sb->sets [set] != 0)
+		fd_zero (sb->sets [set], sb->nfds);
+	}
+    }
+    if (r >= 0)
+	reactor_complete (sb, r, 0);
+}
+
+/* collect ready descriptors, returns number of set bits or 0 */
+static int reactor_ws_check (SB)
+{
+    struct epoll_event ev[64];
+    int i, n, set, r = 0;
+
+    do {
+	n = epoll_wait (sb->wsepfd, ev, 64, 0);
+	for (i = 0; i < n; i++) {
+	    struct bsd_wsfd *w = &sb->wsfds[ev[i].data.u32];
+	    w->revents |= ev[i].events;
+	}
+    } while (n == 64);
+
+    for (i = 0; i < sb->wscount; i++) {
+	struct bsd_wsfd *w = &sb->wsfds[i];
+	if ((w->events & EPOLLIN) && (w->revents & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+	    r++;
+	if ((w->events & EPOLLOUT) && (w->revents & (EPOLLOUT | EPOLLHUP | EPOLLERR)))
+	    r++;
+	if ((w->events & EPOLLPRI) && (w->revents & EPOLLPRI))
+	    r++;
+    }
+    if (!r)
+	return 0;
+
+    for (set = 0; set < 3; set++) {
+	if (sb->sets [set] != 0)
+	    fd_zero (sb->sets [set], sb->nfds);
+    }
+    for (i = 0; i < sb->wscount; i++) {
+	struct bsd_wsfd *w = &sb->wsfds[i];
+	if ((w->events & EPOLLIN) && (w->revents & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+	    bsd_amigaside_FD_SET (w->index, sb->sets [0]);
+	if ((w->events & EPOLLOUT) && (w->revents & (EPOLLOUT | EPOLLHUP | EPOLLERR)))
+	    bsd_amigaside_FD_SET (w->index, sb->sets [1]);
+	if ((w->events & EPOLLPRI) && (w->revents & EPOLLPRI))
+	    bsd_amigaside_FD_SET (w->index, sb->sets [2]);
+    }
+    return r;
+}
+
+static void reactor_ws_start (SB)
+{
+    struct epoll_event ev;
+    int i, set, r;
+
+    DEBUG_LOG ("WaitSelect: %d 0x%x 0x%x 0x%x 0x%x 0x%x\n", sb->nfds, sb->sets [0], sb->sets [1], sb->sets [2], sb->timeout, sb->sigmp);
+
+    if (sb->wsalloc < sb->nfds) {
+	xfree (sb->wsfds);
+	sb->wsalloc = sb->nfds;
+	sb->wsfds = xmalloc (struct bsd_wsfd, sb->wsalloc);
+    }
+    sb->wscount = 0;
+    sb->wsepfd = epoll_create1 (EPOLL_CLOEXEC);
+    if (sb->wsepfd < 0) {
+	reactor_complete (sb, -1, errno);
+	return;
+    }
+    for (i = 0; i < sb->nfds; i++) {
+	uae_u32 events = 0;
+	for (set = 0; set < 3; set++) {
+	    if (sb->sets [set] != 0 && bsd_amigaside_FD_ISSET (i, sb->sets [set]))
+		events |= set == 0 ? EPOLLIN | EPOLLRDHUP : (set == 1 ? EPOLLOUT : EPOLLPRI);
+	}
+	if (!events)
+	    continue;
+	struct bsd_wsfd *w = &sb->wsfds[sb->wscount];
+	w->s = getsock (sb, i + 1);
+	if (w->s == -1) {
+	    write_log ("BSDSOCK: WaitSelect() called with invalid descriptor %d.\n", i);
+	    continue;
+	}
+	w->index = i;
+	w->events = events;
+	w->revents = 0;
+	memset (&ev, 0, sizeof ev);
+	ev.events = events;
+	ev.data.u32 = sb->wscount;
+	if (epoll_ctl (sb->wsepfd, EPOLL_CTL_ADD, w->s, &ev) < 0) {
+	    write_log ("BSDSOCK: WaitSelect() can't watch descriptor %d, err=%d\n", i, errno);
+	    continue;
+	}
+	sb->wscount++;
+    }
+    sb->pending = PENDING_WS;
+    sb->nextws = reactor_wslist;
+    reactor_wslist = sb;
+
+    r = reactor_ws_check (sb);
+    if (r > 0) {
+	reactor_ws_done (sb, r);
+	return;
+    }
+    sb->deadline = 0;
+    if (sb->timeout) {
+	uae_u32 secs = get_long (sb->timeout);
+	uae_u32 usecs = get_long (sb->timeout + 4);
+	if (secs == 0 && usecs == 0) {
+	    reactor_ws_done (sb, 0);
+	    return;
+	}
+	sb->deadline = reactor_ms () + (uae_u64)secs * 1000 + (usecs + 999) / 1000;
+    }
+    memset (&ev, 0, sizeof ev);
+    ev.events = EPOLLIN;
+    ev.data.u64 = REACTOR_TAG (sb, REACTOR_WS);
+    epoll_ctl (reactor_epfd, EPOLL_CTL_ADD, sb->wsepfd, &ev);
+}
+
+static void reactor_abort (SB)
+{
+    clearsockabort (sb);
+    if (sb->pending == PENDING_OP) {
+	DEBUG_LOG ("select aborted from signal\n");
+	reactor_complete (sb, -1, EINTR);
+    } else if (sb->pending == PENDING_WS) {
+	DEBUG_LOG ("WaitSelect aborted from signal\n");
+	reactor_ws_done (sb, 0);
+    }
+}
+
+static void bsd_gethost_async (void *arg)
+{
+    struct socketbase *sb = (struct socketbase*)arg;
+
+    bsdthr_gethost (sb, 0);
+    SETSIGNAL;
+}
+
+static void reactor_start (SB)
+{
+    switch (sb->action) {
+	case 1:       /* Connect */
+	    sb->tryfunc = bsdthr_Connect_2;
+	    reactor_try (sb);
+	    break;
+	case 2:       /* Send[to] */
+	    sb->tryfunc = bsdthr_Send_2;
+	    reactor_try (sb);
+	    break;
+	case 3:       /* Recv[from] */
+	    sb->tryfunc = bsdthr_Recv_2;
+	    reactor_try (sb);
+	    break;
+	case 6:       /* Accept */
+	    sb->tryfunc = bsdthr_Accept_2;
+	    reactor_try (sb);
+	    break;
+	case 4:       /* Gethostbyname */
+	case 7:       /* Gethostbyaddr */
+	    bsdres_async (bsd_gethost_async, sb);
+	    break;
+	case 5:       /* WaitSelect */
+	    reactor_ws_start (sb);
+	    break;
+    }
+}
+
+/* returns the list of bases that were removed, to be acked by the caller */
+static struct socketbase *reactor_requests (void)
+{
+    struct socketbase *list, *next, *prev = NULL, *removed = NULL;
+
+    uae_sem_wait (&reactor_lock);
+    list = reactor_queue;
+    reactor_queue = NULL;
+    uae_sem_post (&reactor_lock);
+    // queue is LIFO, start from the oldest
+    while (list) {
+	next = list->nextreq;
+	list->nextreq = prev;
+	prev = list;
+	list = next;
+    }
+    for (list = prev; list; list = next) {
+	next = list->nextreq;
+	if (list->action == 0) {
+	    if (list->pending == PENDING_OP)
+		epoll_ctl (reactor_epfd, EPOLL_CTL_DEL, list->s, NULL);
+	    else if (list->pending == PENDING_WS)
+		reactor_ws_done (list, -1);
+	    epoll_ctl (reactor_epfd, EPOLL_CTL_DEL, list->sockabort[0], NULL);
+	    list->pending = PENDING_REMOVED;
+	    list->nextreq = removed;
+	    removed = list;
+	} else {
+	    reactor_start (list);
+	}
+    }
+    return removed;
+}
+
+static int reactor_timeout (void)
+{
+    struct socketbase *sb;
+    uae_u64 now = reactor_ms ();
+    int timeout = -1;
+
+    for (sb = reactor_wslist; sb; sb = sb->nextws) {
+	if (sb->deadline) {
+	    int t = sb->deadline > now ? (int)(sb->deadline - now) : 0;
+	    if (timeout < 0 || t < timeout)
+		timeout = t;
+	}
+    }
+    return timeout;
+}
+
+static void reactor_expire (void)
+{
+    struct socketbase *sb, *next;
+    uae_u64 now = reactor_ms ();
+
+    for (sb = reactor_wslist; sb; sb = next) {
+	next = sb->nextws;
+	if (sb->deadline && sb->deadline <= now)
+	    reactor_ws_done (sb, 0);
+    }
+}
+
+static void *bsd_reactor_thread (void *arg)
+{
+    struct epoll_event ev[64];
+
+    for (;;) {
+	struct socketbase *removed, *sb;
+	uae_u64 v;
+	int i, n;
+
+	n = epoll_wait (reactor_epfd, ev, 64, reactor_timeout ());
+	if (n < 0) {
+	    if (errno != EINTR)
+		write_log ("BSDSOCK: epoll_wait failed, err=%d\n", errno);
+	    n = 0;
+	}
+	if (read (reactor_evfd, &v, sizeof v) < 0)
+	    v = 0;
+	removed = reactor_requests ();
+	for (i = 0; i < n; i++) {
+	    int tag = ev[i].data.u64 & 7;
+	    sb = (struct socketbase*)(uintptr_t)(ev[i].data.u64 & ~(uae_u64)7);
+	    if (!sb || sb->pending == PENDING_REMOVED)
+		continue;
+	    if (tag == REACTOR_ABORT) {
+		reactor_abort (sb);
+	    } else if (tag == REACTOR_OP) {
+		if (sb->pending == PENDING_OP)
+		    reactor_try (sb);
+	    } else if (tag == REACTOR_WS) {
+		if (sb->pending == PENDING_WS) {
+		    int r = reactor_ws_check (sb);
+		    if (r > 0)
+			reactor_ws_done (sb, r);
+		}
+	    }
+	}
+	reactor_expire ();
+	while (removed) {
+	    sb = removed;
+	    removed = sb->nextreq;
+	    sb->pending = PENDING_NONE;
+	    uae_sem_post (&sb->sem);
+	}
+    }
+    return NULL;
+}
+
+static int reactor_init (void)
+{
+    struct epoll_event ev;
+
+    if (reactor_epfd >= 0)
+	return 1;
+    reactor_epfd = epoll_create1 (EPOLL_CLOEXEC);
+    reactor_evfd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (reactor_epfd < 0 || reactor_evfd < 0) {
+	write_log ("BSDSOCK: can't create reactor, err=%d\n", errno);
+	return 0;
+    }
+    memset (&ev, 0, sizeof ev);
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;
+    epoll_ctl (reactor_epfd, EPOLL_CTL_ADD, reactor_evfd, &ev);
+    uae_sem_init (&reactor_lock, 0, 1);
+    uae_start_thread ("bsdsocket", bsd_reactor_thread, NULL, &reactor_tid);
+    return 1;
+}
+
+static int reactor_add (SB)
+{
+    struct epoll_event ev;
+
+    if (!reactor_init ())
+	return 0;
+    sb->pending = PENDING_NONE;
+    sb->wsepfd = -1;
+    sb->wsfds = NULL;
+    sb->wsalloc = 0;
+    memset (&ev, 0, sizeof ev);
+    ev.events = EPOLLIN;
+    ev.data.u64 = REACTOR_TAG (sb, REACTOR_ABORT);
+    return epoll_ctl (reactor_epfd, EPOLL_CTL_ADD, sb->sockabort[0], &ev) == 0;
+}
+
+#endif
+
+/* hand the request set up in sb to whoever executes it */
+static void bsdthr_post (SB)
+{
+#ifdef BSD_REACTOR
+    uae_u64 v = 1;
+
+    uae_sem_wait (&reactor_lock);
+    sb->nextreq = reactor_queue;
+    reactor_queue = sb;
+    uae_sem_post (&reactor_lock);
+    if (write (reactor_evfd, &v, sizeof v) < 0)
+	write_log ("BSDSOCK: reactor wakeup failed, err=%d\n", errno);
+#else
+    uae_sem_post (&sb->sem);
+#endif
+}
+
+#ifndef BSD_REACTOR
 
 static void *bsdlib_threadfunc (void *arg)
 {
@@ -899,17 +1364,12 @@ static void *bsdlib_threadfunc (void *arg)
 		sb->resultval = bsdthr_SendRecvAcceptConnect (bsdthr_Recv_2, sb);
 		break;
 
-	    case 4: {     /* Gethostbyname */
-		struct hostent *tmphostent = gethostbyname ((char *)get_real_address (sb->name));
-
-		if (tmphostent) {
-		    copyHostent (tmphostent, sb);
-		    bsdsocklib_setherrno (sb, 0);
-		} else
-		    SETHERRNO;
-
-		break;
-	    }
+	    case 4:       /* Gethostbyname */
+	    case 7:       /* Gethostbyaddr */
+		/* sets errno and h_errno from the cached lookup */
+		bsdthr_gethost (sb, 0);
+		SETSIGNAL;
+		continue;
 
 	    case 5:       /* WaitSelect */
 		sb->resultval = bsdthr_WaitSelect (sb);
@@ -918,18 +1378,6 @@ static void *bsdlib_threadfunc (void *arg)
 	    case 6:       /* Accept */
 		sb->resultval = bsdthr_SendRecvAcceptConnect (bsdthr_Accept_2, sb);
 		break;
-
-	    case 7: {
-		struct hostent *tmphostent = gethostbyaddr (get_real_address (sb->name), sb->a_addrlen, sb->flags);
-
-		if (tmphostent) {
-		    copyHostent (tmphostent, sb);
-		    bsdsocklib_setherrno (sb, 0);
-		} else
-		    SETHERRNO;
-
-		break;
-	    }
 	}
 	SETERRNO;
 	SETSIGNAL;
@@ -937,6 +1385,8 @@ static void *bsdlib_threadfunc (void *arg)
     return NULL;        /* Just to keep GCC happy.. */
 }
 
+#endif
+
 
 
 
@@ -952,7 +1402,7 @@ void host_connect (TrapContext *context, SB, uae_u32 sd, uae_u32 name, uae_u32 n
     sb->a_addrlen = namelen;
     sb->action    = 1;
 
-    uae_sem_post (&sb->sem);
+    bsdthr_post (sb);
 
     WAITSIGNAL;
 }
@@ -972,7 +1422,7 @@ void host_sendto (TrapContext *context, SB, uae_u32 sd, uae_u32 msg, uae_u32 len
     sb->tolen  = tolen;
     sb->action = 2;
 
-    uae_sem_post (&sb->sem);
+    bsdthr_post (sb);
 
     WAITSIGNAL;
 }
@@ -998,7 +1448,7 @@ void host_recvfrom (TrapContext *context, SB, uae_u32 sd, uae_u32 msg, uae_u32 l
     sb->fromlen= addrlen;
     sb->action = 3;
 
-    uae_sem_post (&sb->sem);
+    bsdthr_post (sb);
 
     WAITSIGNAL;
 }
@@ -1097,7 +1547,11 @@ void host_gethostbynameaddr (TrapContext *context, SB, uae_u32 name, uae_u32 nam
     else
 		sb->action = 7;
 
-    uae_sem_post (&sb->sem);
+    /* answer from the cache without a round trip through a helper thread */
+    if (bsdthr_gethost (sb, 1))
+		return;
+
+    bsdthr_post (sb);
 
     WAITSIGNAL;
 }
@@ -1148,7 +1602,7 @@ void host_WaitSelect (TrapContext *context, SB, uae_u32 nfds, uae_u32 readfds, u
     sb->sigmp    = wssigs;
     sb->action   = 5;
 
-    uae_sem_post (&sb->sem);
+    bsdthr_post (sb);
 
     m68k_dreg (regs, 0) = (((uae_u32)1) << sb->signal) | sb->eintrsigs | wssigs;
     sigs = CallLib (context, get_long (4), -0x13e); // Wait()
@@ -1203,7 +1657,7 @@ void host_accept (TrapContext *context, SB, uae_u32 sd, uae_u32 name, uae_u32 na
     sb->action    = 6;
     sb->len       = sd;
 
-    uae_sem_post (&sb->sem);
+    bsdthr_post (sb);
 
     WAITSIGNAL;
     DEBUG_LOG ("Accept returns %d\n", sb->resultval);
@@ -1283,17 +1737,20 @@ uae_u32 host_listen (SB, uae_u32 sd, uae_u32 backlog)
 
 void host_getprotobyname (TrapContext *context, SB, uae_u32 name)
 {
-    struct protoent *p = getprotobyname ((char *)get_real_address (name));
+    struct bsdres_entry *e = bsdres_getprotobyname ((char *)get_real_address (name));
+    struct protoent *p = e->proto;
 
     DEBUG_LOG ("Getprotobyname(%s)=%lx\n", get_real_address (name), p);
 
     if (p == NULL) {
 		SETERRNO;
+		bsdres_release (e);
 		return;
     }
 
     copyProtoent (context, sb, p);
     BSDTRACE (("OK (%s, %d)\n", p->p_name, p->p_proto));
+    bsdres_release (e);
 }
 
 void host_getprotobynumber (TrapContext *context, SB, uae_u32 number)
@@ -1312,9 +1769,10 @@ void host_getprotobynumber (TrapContext *context, SB, uae_u32 number)
 
 void host_getservbynameport (TrapContext *context, SB, uae_u32 name, uae_u32 proto, uae_u32 type)
 {
-    struct servent *s = (type) ?
-	getservbyport (name, (char *)get_real_address (proto)) :
-	getservbyname ((char *)get_real_address (name), (char *)get_real_address (proto));
+    struct bsdres_entry *e = (type) ?
+	bsdres_getservbyport (name, (char *)get_real_address (proto)) :
+	bsdres_getservbyname ((char *)get_real_address (name), (char *)get_real_address (proto));
+    struct servent *s = e->serv;
     size_t size = 20;
     int numaliases = 0;
     uae_u32 aptr;
@@ -1328,6 +1786,7 @@ void host_getservbynameport (TrapContext *context, SB, uae_u32 name, uae_u32 pro
 
     if (s == NULL) {
 	SETERRNO;
+	bsdres_release (e);
 	return;
     }
 
@@ -1351,6 +1810,7 @@ void host_getservbynameport (TrapContext *context, SB, uae_u32 name, uae_u32 pro
     if (!sb->servent) {
 		write_log ("BSDSOCK: WARNING - getservby%s() ran out of Amiga memory (couldn't allocate %d bytes)\n",type ? "port" : "name", size);
 		bsdsocklib_seterrno (sb, 12); // ENOMEM
+		bsdres_release (e);
 		return;
     }
 
@@ -1372,10 +1832,13 @@ void host_getservbynameport (TrapContext *context, SB, uae_u32 name, uae_u32 pro
 
     BSDTRACE (("OK (%s, %d)\n", s->s_name, (unsigned short)htons (s->s_port)));
     bsdsocklib_seterrno (sb,0);
+    bsdres_release (e);
 }
 
 int host_sbinit (TrapContext *context, SB)
 {
+    bsdres_init ();
+
     if (pipe (sb->sockabort) < 0) {
 		return 0;
     }
@@ -1395,6 +1858,15 @@ int host_sbinit (TrapContext *context, SB)
     sb->hostent = uae_AllocMem (context, 1024, 0);
     sb->hostentsize = 1024;
 
+#ifdef BSD_REACTOR
+    if (!reactor_add (sb)) {
+		write_log ("BSDSOCK: Failed to register with reactor.\n");
+		uae_sem_destroy (&sb->sem);
+		close (sb->sockabort[0]);
+		close (sb->sockabort[1]);
+		return 0;
+    }
+#else
     /* @@@ The thread should be PTHREAD_CREATE_DETACHED */
     if (uae_start_thread ("bsdsocket", bsdlib_threadfunc, (void *)sb, &sb->thread) == BAD_THREAD) {
 		write_log ("BSDSOCK: Failed to create thread.\n");
@@ -1403,6 +1875,7 @@ int host_sbinit (TrapContext *context, SB)
 		close (sb->sockabort[1]);
 		return 0;
     }
+#endif
     return 1;
 }
 
@@ -1410,6 +1883,22 @@ void host_sbcleanup (SB)
 {
     int i;
 
+#ifdef BSD_REACTOR
+    /* take the base out of the reactor before its sockets go away */
+    sb->action = 0;
+    bsdthr_post (sb);
+    uae_sem_wait (&sb->sem);
+    uae_sem_destroy (&sb->sem);
+    xfree (sb->wsfds);
+    sb->wsfds = NULL;
+    close (sb->sockabort[0]);
+    close (sb->sockabort[1]);
+    for (i = 0; i < sb->dtablesize; i++) {
+		if (sb->dtable[i] != -1) {
+		    close(sb->dtable[i]);
+		}
+    }
+#else
     uae_thread_id thread = sb->thread;
     close (sb->sockabort[0]);
     close (sb->sockabort[1]);
@@ -1428,11 +1917,13 @@ void host_sbcleanup (SB)
      * pthreads, it always creates joinable threads - and we can't do anything
      * about that. */
     uae_wait_thread (thread);
+#endif
 }
 
 void host_sbreset (void)
 {
     /* TODO */
+    bsdres_flush ();
 }
 
 uae_u32 host_Inet_NtoA (TrapContext *context, SB, uae_u32 in)
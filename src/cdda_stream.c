@@ -0,0 +1,201 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * FLAC CD audio tracks decoded on demand
+  *
+  * Tracks are not unpacked, they are decoded on the fly into a small ring
+  * that runs ahead of the reader. A read outside of what is buffered
+  * (track change, seek, scan) seeks the decoder, which uses the stream's
+  * SEEKTABLE when it has one. Audio is 16 bit stereo, 4 bytes per sample.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include "zfile.h"
+#include "cdda_stream.h"
+
+#include "FLAC/stream_decoder.h"
+
+struct cdda_stream
+{
+	FLAC__StreamDecoder *flac;
+	struct zfile *zf;
+	uae_s64 size;	// PCM bytes of the whole track
+	uae_u8 *ring;
+	uae_s64 start;	// PCM byte offset of the oldest byte in the ring
+	int head, len;
+	bool eof;
+};
+
+static FLAC__StreamDecoderReadStatus file_read_callback (const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
+{
+	struct cdda_stream *s = (struct cdda_stream*)client_data;
+	if (zfile_ftell (s->zf) >= zfile_size (s->zf))
+		return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+	*bytes = zfile_fread (buffer, 1, *bytes, s->zf);
+	return *bytes ? FLAC__STREAM_DECODER_READ_STATUS_CONTINUE : FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+}
+static FLAC__StreamDecoderSeekStatus file_seek_callback (const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data)
+{
+	struct cdda_stream *s = (struct cdda_stream*)client_data;
+	zfile_fseek (s->zf, absolute_byte_offset, SEEK_SET);
+	return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
+}
+static FLAC__StreamDecoderTellStatus file_tell_callback (const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data)
+{
+	struct cdda_stream *s = (struct cdda_stream*)client_data;
+	*absolute_byte_offset = zfile_ftell (s->zf);
+	return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+}
+static FLAC__StreamDecoderLengthStatus file_len_callback (const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data)
+{
+	struct cdda_stream *s = (struct cdda_stream*)client_data;
+	*stream_length = zfile_size (s->zf);
+	return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+}
+static FLAC__bool file_eof_callback (const FLAC__StreamDecoder *decoder, void *client_data)
+{
+	struct cdda_stream *s = (struct cdda_stream*)client_data;
+	return zfile_ftell (s->zf) >= zfile_size (s->zf);
+}
+static void flac_metadata_callback (const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data)
+{
+	struct cdda_stream *s = (struct cdda_stream*)client_data;
+	if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO)
+		s->size = metadata->data.stream_info.total_samples * (metadata->data.stream_info.bits_per_sample / 8) * metadata->data.stream_info.channels;
+}
+static void flac_error_callback (const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+}
+static FLAC__StreamDecoderWriteStatus flac_write_callback (const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
+{
+	struct cdda_stream *s = (struct cdda_stream*)client_data;
+	unsigned int i;
+
+	for (i = 0; i < frame->header.blocksize; i++) {
+		int pos;
+		if (s->len == CDDA_STREAM_SIZE) {
+			// full, drop the oldest sample
+			s->head = (s->head + 4) % CDDA_STREAM_SIZE;
+			s->start += 4;
+			s->len -= 4;
+		}
+		pos = (s->head + s->len) % CDDA_STREAM_SIZE;
+		*(uae_u16*)(s->ring + pos + 0) = (FLAC__int16)buffer[0][i];
+		*(uae_u16*)(s->ring + pos + 2) = (FLAC__int16)buffer[1][i];
+		s->len += 4;
+	}
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static bool cdda_stream_init (struct cdda_stream *s)
+{
+	s->flac = FLAC__stream_decoder_new ();
+	if (!s->flac)
+		return false;
+	FLAC__stream_decoder_set_md5_checking (s->flac, false);
+	if (FLAC__stream_decoder_init_stream (s->flac,
+		&file_read_callback, &file_seek_callback, &file_tell_callback,
+		&file_len_callback, &file_eof_callback,
+		&flac_write_callback, &flac_metadata_callback, &flac_error_callback, s) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+		FLAC__stream_decoder_delete (s->flac);
+		s->flac = NULL;
+		return false;
+	}
+	FLAC__stream_decoder_process_until_end_of_metadata (s->flac);
+	return true;
+}
+
+/* PCM size of a track, 0 if it isn't FLAC */
+uae_s64 cdda_stream_size (struct zfile *zf)
+{
+	struct cdda_stream s;
+
+	memset (&s, 0, sizeof s);
+	s.zf = zf;
+	if (!cdda_stream_init (&s))
+		return 0;
+	FLAC__stream_decoder_delete (s.flac);
+	return s.size;
+}
+
+struct cdda_stream *cdda_stream_open (struct zfile *zf)
+{
+	struct cdda_stream *s = xcalloc (struct cdda_stream, 1);
+
+	if (!s)
+		return NULL;
+	s->zf = zf;
+	s->ring = xmalloc (uae_u8, CDDA_STREAM_SIZE);
+	if (!s->ring || !cdda_stream_init (s)) {
+		xfree (s->ring);
+		xfree (s);
+		return NULL;
+	}
+	write_log ("FLAC: streaming '%s'\n", zfile_getname (zf));
+	return s;
+}
+
+void cdda_stream_close (struct cdda_stream *s)
+{
+	if (!s)
+		return;
+	FLAC__stream_decoder_delete (s->flac);
+	xfree (s->ring);
+	xfree (s);
+}
+
+static bool cdda_stream_decode (struct cdda_stream *s)
+{
+	if (s->eof)
+		return false;
+	if (!FLAC__stream_decoder_process_single (s->flac)
+		|| FLAC__stream_decoder_get_state (s->flac) == FLAC__STREAM_DECODER_END_OF_STREAM) {
+		s->eof = true;
+		return false;
+	}
+	return true;
+}
+
+/* Copies len bytes of PCM data at pos to dst. Whatever can't be decoded
+ * (damaged or truncated file) is zeroed, returns the bytes decoded. */
+int cdda_stream_read (struct cdda_stream *s, uae_u8 *dst, uae_s64 pos, int len)
+{
+	int got = 0;
+
+	if (pos < s->start || pos > s->start + s->len + CDDA_STREAM_AHEAD) {
+		s->head = s->len = 0;
+		s->start = pos & ~3;
+		s->eof = false;
+		if (!FLAC__stream_decoder_seek_absolute (s->flac, pos / 4)) {
+			write_log ("FLAC: seek to %lld failed\n", pos);
+			FLAC__stream_decoder_flush (s->flac);
+			s->eof = true;
+		}
+	}
+	while (s->start + s->len < pos + len) {
+		if (!cdda_stream_decode (s))
+			break;
+	}
+	// keep the ring topped up so the next buffers are ready
+	while (s->start + s->len < pos + len + CDDA_STREAM_AHEAD / 2 && s->len < CDDA_STREAM_AHEAD) {
+		if (!cdda_stream_decode (s))
+			break;
+	}
+	while (got < len && pos >= s->start && pos < s->start + s->len) {
+		int off = (int)(pos - s->start);
+		int idx = (s->head + off) % CDDA_STREAM_SIZE;
+		int cnt = len - got;
+		if (cnt > s->len - off)
+			cnt = s->len - off;
+		if (cnt > CDDA_STREAM_SIZE - idx)
+			cnt = CDDA_STREAM_SIZE - idx;
+		memcpy (dst + got, s->ring + idx, cnt);
+		got += cnt;
+		pos += cnt;
+	}
+	if (got < len)
+		memset (dst + got, 0, len - got);
+	return got;
+}
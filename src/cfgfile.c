@@ -191,6 +191,7 @@ static const TCHAR *aspects[] = { "none", "vga", "tv", 0 };
 static const TCHAR *vsyncmodes[] = { "false", "true", "autoswitch", 0 };
 static const TCHAR *vsyncmodes2[] = { "normal", "busywait", 0 };
 static const TCHAR *filterapi[] = { "directdraw", "direct3d", 0 };
+static const TCHAR *recordcodec[] = { "raw", "zlib", 0 };
 static const TCHAR *dongles[] =
 {
 	"none",
@@ -722,6 +723,7 @@ void cfgfile_save_options (struct zfile *f, struct uae_prefs *p, int type)
 
 	cfgfile_write (f, "nr_floppies", "%d", p->nr_floppies);
 	cfgfile_write (f, "floppy_speed", "%d", p->floppy_speed);
+	cfgfile_write_bool (f, "floppy_turbo_dma", p->floppy_turbo_dma);
 #ifdef DRIVESOUND
 	cfgfile_write (f, "floppy_volume", "%d", p->dfxclickvolume);
 	cfgfile_dwrite (f, "floppy_channel_mask", "0x%x", p->dfxclickchannelmask);
@@ -760,10 +762,10 @@ void cfgfile_save_options (struct zfile *f, struct uae_prefs *p, int type)
 	cfgfile_write_bool (f, "comp_nf", p->compnf);
 	cfgfile_write_bool (f, "comp_constjump", p->comp_constjump);
 	cfgfile_write_bool (f, "comp_oldsegv", p->comp_oldsegv);
+	cfgfile_write_bool (f, "comp_profile", p->comp_profile);
 
 	cfgfile_write_str (f, "comp_flushmode", flushmode[p->comp_hardflush]);
 	cfgfile_write_bool (f, "compfpu", p->compfpu);
-	cfgfile_write_bool (f, "fpu_strict", p->fpu_strict);
 	cfgfile_write_bool (f, "comp_midopt", p->comp_midopt);
 	cfgfile_write_bool (f, "comp_lowopt", p->comp_lowopt);
 	cfgfile_write_bool (f, "avoid_cmov", p->avoid_cmov);
@@ -928,6 +930,13 @@ void cfgfile_save_options (struct zfile *f, struct uae_prefs *p, int type)
 			p->osd_pos.y >= 20000 ? (p->osd_pos.y - 30000) / 10.0 : (float)p->osd_pos.y, p->osd_pos.y >= 20000 ? "%" : "");
 	}
 	cfgfile_dwrite_bool (f, "show_leds_rtg", !!(p->leds_on_screen & STATUSLINE_RTG));
+	cfgfile_dwrite_bool (f, "show_host_profile", !!(p->leds_on_screen & STATUSLINE_HOSTPROF));
+	if (p->host_profile_file[0])
+		cfgfile_write_str (f, "host_profile_file", p->host_profile_file);
+	if (p->record_file[0]) {
+		cfgfile_write_str (f, "record_file", p->record_file);
+		cfgfile_write_str (f, "record_codec", recordcodec[p->record_codec]);
+	}
 	cfgfile_dwrite (f, "keyboard_leds", "numlock:%s,capslock:%s,scrolllock:%s",
 		kbleds[p->keyboard_leds[0]], kbleds[p->keyboard_leds[1]], kbleds[p->keyboard_leds[2]]);
 	if (p->chipset_mask & CSMASK_AGA)
@@ -1044,6 +1053,12 @@ void cfgfile_save_options (struct zfile *f, struct uae_prefs *p, int type)
 	cfgfile_write (f, "cpu_model", "%d", p->cpu_model);
 	if (p->fpu_model)
 		cfgfile_write (f, "fpu_model", "%d", p->fpu_model);
+	cfgfile_write_bool (f, "fpu_strict", p->fpu_strict);
+	if (p->cpu_trace_file[0]) {
+		cfgfile_write_str (f, "cpu_trace_file", p->cpu_trace_file);
+		cfgfile_write (f, "cpu_trace_registers", "0x%04x", p->cpu_trace_registers);
+		cfgfile_write_bool (f, "cpu_trace_memory", p->cpu_trace_memory);
+	}
 	if (p->mmu_model)
 		cfgfile_write (f, "mmu_model", "%d", p->mmu_model);
 	cfgfile_write_bool (f, "cpu_compatible", p->cpu_compatible);
@@ -1086,6 +1101,7 @@ void cfgfile_save_options (struct zfile *f, struct uae_prefs *p, int type)
 	cfgfile_dwrite (f, "state_replay_rate", "%d", p->statecapturerate);
 	cfgfile_dwrite (f, "state_replay_buffers", "%d", p->statecapturebuffersize);
 	cfgfile_dwrite_bool (f, "state_replay_autoplay", p->inprec_autoplay);
+	cfgfile_dwrite (f, "run_ahead", "%d", p->runahead);
 #endif
 	cfgfile_dwrite_bool (f, "warp", p->turbo_emulation);
 
@@ -1093,6 +1109,8 @@ void cfgfile_save_options (struct zfile *f, struct uae_prefs *p, int type)
 	write_filesys_config (p, f);
 	if (p->filesys_no_uaefsdb)
 		cfgfile_write_bool (f, "filesys_no_fsdb", p->filesys_no_uaefsdb);
+	cfgfile_dwrite (f, "hardfile_queue_depth", "%d", p->hardfile_queue_depth);
+	cfgfile_dwrite (f, "hardfile_cache_size", "%d", p->hardfile_cache_size);
 #endif
 	write_inputdevice_config (p, f);
 }
@@ -1527,7 +1545,10 @@ static int cfgfile_parse_host (struct uae_prefs *p, TCHAR *option, TCHAR *value)
 		|| cfgfile_intval (option, value, "sound_max_buff", &p->sound_maxbsiz, 1)
 		|| cfgfile_intval (option, value, "state_replay_rate", &p->statecapturerate, 1)
 		|| cfgfile_intval (option, value, "state_replay_buffers", &p->statecapturebuffersize, 1)
+		|| cfgfile_intval (option, value, "hardfile_queue_depth", &p->hardfile_queue_depth, 1)
+		|| cfgfile_intval (option, value, "hardfile_cache_size", &p->hardfile_cache_size, 1)
 		|| cfgfile_yesno (option, value, "state_replay_autoplay", &p->inprec_autoplay)
+		|| cfgfile_intval (option, value, "run_ahead", &p->runahead, 1)
 		|| cfgfile_intval (option, value, "sound_frequency", &p->sound_freq, 1)
 		|| cfgfile_intval (option, value, "sound_volume", &p->sound_volume, 1)
 		|| cfgfile_intval (option, value, "sound_volume_cd", &p->sound_volume_cd, 1)
@@ -1688,6 +1709,18 @@ static int cfgfile_parse_host (struct uae_prefs *p, TCHAR *option, TCHAR *value)
 			p->leds_on_screen &= ~STATUSLINE_RTG;
 		return 1;
 	}
+	if (cfgfile_yesno (option, value, "show_host_profile", &vb)) {
+		if (vb)
+			p->leds_on_screen |= STATUSLINE_HOSTPROF;
+		else
+			p->leds_on_screen &= ~STATUSLINE_HOSTPROF;
+		return 1;
+	}
+	if (cfgfile_path (option, value, "host_profile_file", p->host_profile_file, sizeof p->host_profile_file / sizeof (TCHAR)))
+		return 1;
+	if (cfgfile_path (option, value, "record_file", p->record_file, sizeof p->record_file / sizeof (TCHAR))
+		|| cfgfile_strval (option, value, "record_codec", &p->record_codec, recordcodec, 0))
+		return 1;
 
 	if (!_tcscmp (option, "osd_position")) {
 		TCHAR *s = value;
@@ -2281,6 +2314,7 @@ static int cfgfile_parse_hardware (struct uae_prefs *p, const TCHAR *option, TCH
 
 		|| cfgfile_yesno (option, value, "kickshifter", &p->kickshifter)
 		|| cfgfile_yesno (option, value, "ntsc", &p->ntscmode)
+		|| cfgfile_yesno (option, value, "floppy_turbo_dma", &p->floppy_turbo_dma)
 		|| cfgfile_yesno (option, value, "sana2", &p->sana2)
 		|| cfgfile_yesno (option, value, "genlock", &p->genlock)
 		|| cfgfile_yesno (option, value, "cpu_compatible", &p->cpu_compatible)
@@ -2295,23 +2329,29 @@ static int cfgfile_parse_hardware (struct uae_prefs *p, const TCHAR *option, TCH
 		|| cfgfile_yesno (option, value, "comp_nf", &p->compnf)
 		|| cfgfile_yesno (option, value, "comp_constjump", &p->comp_constjump)
 		|| cfgfile_yesno (option, value, "comp_oldsegv", &p->comp_oldsegv)
+		|| cfgfile_yesno (option, value, "comp_profile", &p->comp_profile)
 		|| cfgfile_yesno (option, value, "compforcesettings", &dummybool)
 		|| cfgfile_yesno (option, value, "compfpu", &p->compfpu)
 #endif
-#ifdef FPU
+#ifdef FPUEMU
 		|| cfgfile_yesno (option, value, "fpu_strict", &p->fpu_strict)
 #endif
 #ifdef JIT
 		|| cfgfile_yesno (option, value, "comp_midopt", &p->comp_midopt)
 		|| cfgfile_yesno (option, value, "comp_lowopt", &p->comp_lowopt)
 #endif
+		|| cfgfile_yesno (option, value, "cpu_trace_memory", &p->cpu_trace_memory)
 		|| cfgfile_yesno (option, value, "rtg_nocustom", &p->picasso96_nocustom)
 		|| cfgfile_yesno (option, value, "uaeserial", &p->uaeserial))
 		return 1;
 
+	if (cfgfile_path (option, value, "cpu_trace_file", p->cpu_trace_file, sizeof p->cpu_trace_file / sizeof (TCHAR)))
+		return 1;
+
 	if (cfgfile_intval (option, value, "serial_stopbits", &p->serial_stopbits, 1)
 		|| cfgfile_intval (option, value, "cpu060_revision", &p->cpu060_revision, 1)
 		|| cfgfile_intval (option, value, "fpu_revision", &p->fpu_revision, 1)
+		|| cfgfile_intval (option, value, "cpu_trace_registers", &p->cpu_trace_registers, 1)
 		|| cfgfile_intval (option, value, "cdtvramcard", &p->cs_cdtvcard, 1)
 		|| cfgfile_intval (option, value, "fatgary", &p->cs_fatgaryrev, 1)
 		|| cfgfile_intval (option, value, "ramsey", &p->cs_ramseyrev, 1)
@@ -3995,8 +4035,12 @@ void default_prefs (struct uae_prefs *p, int type)
 	p->comp_hardflush = 0;
 	p->comp_constjump = 1;
 	p->comp_oldsegv = 0;
+	p->comp_profile = 0;
 	p->compfpu = 1;
 	p->fpu_strict = 0;
+	p->cpu_trace_file[0] = 0;
+	p->cpu_trace_registers = 0;
+	p->cpu_trace_memory = 0;
 	p->cachesize = 0;
 	p->avoid_cmov = 0;
 	p->comp_midopt = 0;
@@ -4058,6 +4102,9 @@ void default_prefs (struct uae_prefs *p, int type)
 	p->waiting_blits = 0;
 	p->collision_level = 2;
 	p->leds_on_screen = 0;
+	p->host_profile_file[0] = 0;
+	p->record_file[0] = 0;
+	p->record_codec = 1;
 	p->keyboard_leds_in_use = 0;
 	p->keyboard_leds[0] = p->keyboard_leds[1] = p->keyboard_leds[2] = 0;
 	p->scsi = 0;
@@ -4070,6 +4117,8 @@ void default_prefs (struct uae_prefs *p, int type)
 	p->maprom = 0;
 	p->filesys_no_uaefsdb = 0;
 	p->filesys_custom_uaefsdb = 1;
+	p->hardfile_queue_depth = 1;
+	p->hardfile_cache_size = 0;
 	p->picasso96_nocustom = 1;
 #ifdef ACTION_REPLAY
 	p->cart_internal = 1;
@@ -4110,7 +4159,8 @@ void default_prefs (struct uae_prefs *p, int type)
 	p->gfx_filter_filtermode = 0;
 	p->gfx_filter_scanlineratio = (1 << 4) | 1;
 	p->gfx_filter_keep_aspect = 0;
-	p->gfx_filter_autoscale = AUTOSCALE_STATIC_AUTO;
+	/* nothing scales automatically here, leave centring to gfx_center_* */
+	p->gfx_filter_autoscale = AUTOSCALE_NONE;
 	p->gfx_filteroverlay_overscan = 0;
 #endif
 
@@ -4172,6 +4222,7 @@ void default_prefs (struct uae_prefs *p, int type)
 	p->floppyslots[2].dfxtype = DRV_NONE;
 	p->floppyslots[3].dfxtype = DRV_NONE;
 	p->floppy_speed = 100;
+	p->floppy_turbo_dma = 1;
 	p->floppy_write_length = 0;
 	p->floppy_random_bits_min = 1;
 	p->floppy_random_bits_max = 3;
@@ -4184,6 +4235,7 @@ void default_prefs (struct uae_prefs *p, int type)
 	p->statecapturebuffersize = 100;
 	p->statecapturerate = 5 * 50;
 	p->inprec_autoplay = true;
+	p->runahead = 0;
 #endif
 
 #ifdef UAE_MINI
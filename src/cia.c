@@ -35,6 +35,7 @@
 #include "cdtv.h"
 #endif
 #include "debug.h"
+#include "hostprof.h"
 #ifdef ARCADIA
 #include "arcadia.h"
 #endif
@@ -420,8 +421,10 @@ static void CIA_calctimers (void)
 
 void CIA_handler (void)
 {
+	HOSTPROF_ENTER (HP_CIA);
 	CIA_update ();
 	CIA_calctimers ();
+	HOSTPROF_LEAVE ();
 }
 
 void cia_diskindex (void)
@@ -603,7 +606,7 @@ void CIA_hsync_prehandler (void)
 
 void CIA_hsync_posthandler (bool dotod)
 {
-
+	HOSTPROF_ENTER (HP_CIA);
 	if (ciabtodon && dotod) {
 		ciabtod++;
 		ciabtod &= 0xFFFFFF;
@@ -666,6 +669,7 @@ void CIA_hsync_posthandler (bool dotod)
 				ciaasdr_unread = 0;	/* give up on this key event after unread for a long time */
 		}
 	}
+	HOSTPROF_LEAVE ();
 }
 
 static void calc_led (int old_led)
@@ -2017,4 +2021,62 @@ uae_u8 *restore_keyboard (uae_u8 *src)
 	return src;
 }
 
+const struct runahead_var cia_runahead_vars[] = {
+	RUNAHEAD_VAR (ciaaicr),
+	RUNAHEAD_VAR (ciaaimask),
+	RUNAHEAD_VAR (ciabicr),
+	RUNAHEAD_VAR (ciabimask),
+	RUNAHEAD_VAR (ciaacra),
+	RUNAHEAD_VAR (ciaacrb),
+	RUNAHEAD_VAR (ciabcra),
+	RUNAHEAD_VAR (ciabcrb),
+	RUNAHEAD_VAR (ciaastarta),
+	RUNAHEAD_VAR (ciaastartb),
+	RUNAHEAD_VAR (ciabstarta),
+	RUNAHEAD_VAR (ciabstartb),
+	RUNAHEAD_VAR (ciaaicr_reg),
+	RUNAHEAD_VAR (ciabicr_reg),
+	RUNAHEAD_VAR (ciaata),
+	RUNAHEAD_VAR (ciaatb),
+	RUNAHEAD_VAR (ciabta),
+	RUNAHEAD_VAR (ciabtb),
+	RUNAHEAD_VAR (ciaata_passed),
+	RUNAHEAD_VAR (ciaatb_passed),
+	RUNAHEAD_VAR (ciabta_passed),
+	RUNAHEAD_VAR (ciabtb_passed),
+	RUNAHEAD_VAR (ciaatod),
+	RUNAHEAD_VAR (ciabtod),
+	RUNAHEAD_VAR (ciaatol),
+	RUNAHEAD_VAR (ciabtol),
+	RUNAHEAD_VAR (ciaaalarm),
+	RUNAHEAD_VAR (ciabalarm),
+	RUNAHEAD_VAR (ciaatlatch),
+	RUNAHEAD_VAR (ciabtlatch),
+	RUNAHEAD_VAR (ciabpra),
+	RUNAHEAD_VAR (ciaala),
+	RUNAHEAD_VAR (ciaalb),
+	RUNAHEAD_VAR (ciabla),
+	RUNAHEAD_VAR (ciablb),
+	RUNAHEAD_VAR (ciaatodon),
+	RUNAHEAD_VAR (ciabtodon),
+	RUNAHEAD_VAR (ciaapra),
+	RUNAHEAD_VAR (ciaaprb),
+	RUNAHEAD_VAR (ciaadra),
+	RUNAHEAD_VAR (ciaadrb),
+	RUNAHEAD_VAR (ciaasdr),
+	RUNAHEAD_VAR (ciaasdr_cnt),
+	RUNAHEAD_VAR (ciabprb),
+	RUNAHEAD_VAR (ciabdra),
+	RUNAHEAD_VAR (ciabdrb),
+	RUNAHEAD_VAR (ciabsdr),
+	RUNAHEAD_VAR (ciabsdr_cnt),
+	RUNAHEAD_VAR (div10),
+	RUNAHEAD_VAR (kbstate),
+	RUNAHEAD_VAR (kback),
+	RUNAHEAD_VAR (ciaasdr_unread),
+	RUNAHEAD_VAR (sleepyhead),
+	RUNAHEAD_VAR (serbits),
+	{ NULL, 0 }
+};
+
 #endif /* SAVESTATE */
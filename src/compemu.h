@@ -492,6 +492,8 @@ DECLARE(fcmp_rr(FR d, FR s));
 DECLARE(fflags_into_flags(W2 tmp));
 
 extern int failure;
+extern bool jit_profile;
+extern frame_time_t jit_profile_exec_time;
 #define FAIL(x) do { failure|=x; } while (0)
 
 /* Convenience functions exposed to gencomp */
@@ -583,3 +585,6 @@ void comp_fbcc_opp (uae_u32 opcode);
 void comp_fsave_opp (uae_u32 opcode);
 void comp_frestore_opp (uae_u32 opcode);
 void comp_fpp_opp (uae_u32 opcode, uae_u16 extra);
+uae_u32 *comp_fpp_fallback_counter (uae_u16 opcode, uae_u16 extra);
+void comp_fpp_fallback_dump (void (*out)(const char *, ...));
+void comp_fpp_fallback_reset (void);
@@ -0,0 +1,143 @@
+/*
+ * UAE - The Un*x Amiga Emulator
+ *
+ * JIT profiling: FPU instructions left to the interpreter
+ *
+ * Only counts, translates nothing. With JIT profiling enabled every
+ * interpreter call the compiler emits for an FPU instruction also
+ * increments one of the counters below, so the totals are executions,
+ * not compilations. General operations are counted by their opmode,
+ * everything else by instruction class.
+ */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include "options.h"
+#include "memory.h"
+#include "newcpu.h"
+#include "compemu.h"
+
+#if defined(JIT)
+
+enum {
+	FPP_FB_FMOVE_OUT, FPP_FB_FMOVE_CR, FPP_FB_FMOVEM, FPP_FB_FSCC,
+	FPP_FB_FBCC, FPP_FB_FSAVE, FPP_FB_FRESTORE, FPP_FB_OTHER,
+	FPP_FB_MAX
+};
+static const TCHAR *fpp_fallback_class_name[FPP_FB_MAX] = {
+	"FMOVE FPx,<ea>", "FMOVE(M) control", "FMOVEM", "FScc/FDBcc/FTRAPcc",
+	"FBcc", "FSAVE", "FRESTORE", "other"
+};
+static const TCHAR *fpp_fallback_op_name[0x40] = {
+	"FMOVE", "FINT", "FSINH", "FINTRZ", "FSQRT", NULL, "FLOGNP1", NULL,
+	"FETOXM1", "FTANH", "FATAN", NULL, "FASIN", "FATANH", "FSIN", "FTAN",
+	"FETOX", "FTWOTOX", "FTENTOX", NULL, "FLOGN", "FLOG10", "FLOG2", NULL,
+	"FABS", "FCOSH", "FNEG", NULL, "FACOS", "FCOS", "FGETEXP", "FGETMAN",
+	"FDIV", "FMOD", "FADD", "FMUL", "FSGLDIV", "FREM", "FSCALE", "FSGLMUL",
+	"FSUB", NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+	"FSINCOS", "FSINCOS", "FSINCOS", "FSINCOS", "FSINCOS", "FSINCOS", "FSINCOS", "FSINCOS",
+	"FCMP", NULL, "FTST", NULL, NULL, NULL, NULL, NULL
+};
+
+/* the 68040 single and double rounding forms */
+static const TCHAR *fpp_fallback_name (int op)
+{
+	if (!(op & 0x40))
+		return fpp_fallback_op_name[op];
+	switch (op & ~4) {
+	case 0x40: return "FMOVE";
+	case 0x41: return "FSQRT";
+	case 0x58: return "FABS";
+	case 0x5a: return "FNEG";
+	case 0x60: return "FDIV";
+	case 0x62: return "FADD";
+	case 0x63: return "FMUL";
+	case 0x68: return "FSUB";
+	}
+	return NULL;
+}
+
+/* 0x00-0x7f general operations by opmode, then the classes */
+static uae_u32 fpp_fallback_exec[0x80 + FPP_FB_MAX];
+
+/* counter the generated code increments for this instruction */
+uae_u32 *comp_fpp_fallback_counter (uae_u16 opcode, uae_u16 extra)
+{
+	int cls;
+
+	switch ((opcode >> 6) & 7) {
+	case 0:
+		switch ((extra >> 13) & 7) {
+		case 0:
+		case 2:
+			return &fpp_fallback_exec[extra & 0x7f];
+		case 3:
+			cls = FPP_FB_FMOVE_OUT;
+			break;
+		case 4:
+		case 5:
+			cls = FPP_FB_FMOVE_CR;
+			break;
+		case 6:
+		case 7:
+			cls = FPP_FB_FMOVEM;
+			break;
+		default:
+			cls = FPP_FB_OTHER;
+			break;
+		}
+		break;
+	case 1:
+		cls = FPP_FB_FSCC;
+		break;
+	case 2:
+	case 3:
+		cls = FPP_FB_FBCC;
+		break;
+	case 4:
+		cls = FPP_FB_FSAVE;
+		break;
+	case 5:
+		cls = FPP_FB_FRESTORE;
+		break;
+	default:
+		cls = FPP_FB_OTHER;
+		break;
+	}
+	return &fpp_fallback_exec[0x80 + cls];
+}
+
+void comp_fpp_fallback_dump (void (*out)(const char *, ...))
+{
+	uae_u32 total = 0, arith = 0;
+	int i;
+
+	for (i = 0; i < 0x80; i++)
+		arith += fpp_fallback_exec[i];
+	for (i = 0; i < 0x80 + FPP_FB_MAX; i++)
+		total += fpp_fallback_exec[i];
+	if (!total)
+		return;
+	out ("JIT: %u FPU instructions executed by the interpreter:\n", total);
+	if (arith)
+		out ("JIT:   %-20s %u\n", "arithmetic", arith);
+	for (i = 0; i < FPP_FB_MAX; i++) {
+		if (fpp_fallback_exec[0x80 + i])
+			out ("JIT:   %-20s %u\n", fpp_fallback_class_name[i], fpp_fallback_exec[0x80 + i]);
+	}
+	for (i = 0; i < 0x80; i++) {
+		const TCHAR *name = fpp_fallback_name (i);
+		if (!fpp_fallback_exec[i])
+			continue;
+		out ("JIT:   %02x %-8s%s %u\n", i, name ? name : "?",
+			(i & 0x40) ? (i & 4 ? " (D)" : " (S)") : "    ", fpp_fallback_exec[i]);
+	}
+}
+
+void comp_fpp_fallback_reset (void)
+{
+	memset (fpp_fallback_exec, 0, sizeof fpp_fallback_exec);
+}
+
+#endif
@@ -458,6 +458,11 @@ bool check_prefs_changed_comp (void)
 	currprefs.compfpu = changed_prefs.compfpu;
 	currprefs.fpu_strict = changed_prefs.fpu_strict;
 
+	if (currprefs.comp_profile != changed_prefs.comp_profile) {
+		currprefs.comp_profile = changed_prefs.comp_profile;
+		compemu_profile_enable (currprefs.comp_profile);
+	}
+
 	if (currprefs.cachesize != changed_prefs.cachesize) {
 		if (currprefs.cachesize && !changed_prefs.cachesize) {
 			cachesize_prev = currprefs.cachesize;
@@ -5795,6 +5800,7 @@ void build_comp(void)
 	write_log ("JIT: Supposedly %d compileable opcodes!\n",count);
 
 	/* Initialise state */
+	compemu_profile_enable (currprefs.comp_profile);
 	alloc_cache();
 	create_popalls();
 	reset_lists();
@@ -5903,6 +5909,108 @@ static void catastrophe(void)
 
 int failure;
 
+/* Profiling: how often each opcode is left to the interpreter, how long
+ * the blocks are and where the time goes. Block and fallback counts are
+ * always kept. The timers and the execution counters need jit_profile,
+ * the latter because they add an increment to the generated code. */
+bool jit_profile;
+frame_time_t jit_profile_exec_time;
+static frame_time_t jit_profile_compile_time, jit_profile_compile_max;
+static uae_u32 jit_profile_blocks, jit_profile_insns;
+static uae_u32 jit_profile_blocklen[MAXRUN + 1];
+static uae_u32 jit_fallback_compiled[65536];
+static uae_u32 jit_fallback_exec[65536];
+
+static int jit_profile_cmp (const void *a, const void *b)
+{
+	uae_u16 oa = *(const uae_u16*)a, ob = *(const uae_u16*)b;
+	uae_u64 ka = ((uae_u64)jit_fallback_exec[oa] << 32) | jit_fallback_compiled[oa];
+	uae_u64 kb = ((uae_u64)jit_fallback_exec[ob] << 32) | jit_fallback_compiled[ob];
+
+	return ka < kb ? 1 : (ka > kb ? -1 : 0);
+}
+
+void compemu_profile_reset (void)
+{
+	jit_profile_exec_time = 0;
+	jit_profile_compile_time = jit_profile_compile_max = 0;
+	jit_profile_blocks = jit_profile_insns = 0;
+	memset (jit_profile_blocklen, 0, sizeof jit_profile_blocklen);
+	memset (jit_fallback_compiled, 0, sizeof jit_fallback_compiled);
+	memset (jit_fallback_exec, 0, sizeof jit_fallback_exec);
+	comp_fpp_fallback_reset ();
+}
+
+void compemu_profile_enable (bool enable)
+{
+	if (jit_profile == enable)
+		return;
+	jit_profile = enable;
+	compemu_profile_reset ();
+	/* the execution counters are part of the generated code */
+	if (compiled_code)
+		flush_icache_hard (0, 3);
+	write_log ("JIT: profiling %s\n", enable ? "enabled" : "disabled");
+}
+
+void compemu_profile_dump (int maxlines, void (*out)(const char *, ...))
+{
+	static uae_u16 ops[65536];
+	uae_u32 compiled = 0, exec = 0, fallbacks;
+	int i, n;
+
+	comp_fpp_fallback_dump (out);
+	if (!jit_profile_blocks)
+		return;
+	for (i = 0, n = 0; i < 65536; i++) {
+		compiled += jit_fallback_compiled[i];
+		exec += jit_fallback_exec[i];
+		if (jit_fallback_compiled[i])
+			ops[n++] = i;
+	}
+	fallbacks = n;
+	qsort (ops, n, sizeof (uae_u16), jit_profile_cmp);
+
+	out ("JIT: %u blocks, %u instructions, %u left to the interpreter (%u.%u%%)\n",
+		jit_profile_blocks, jit_profile_insns, compiled,
+		jit_profile_insns ? (uae_u32)((uae_u64)compiled * 100 / jit_profile_insns) : 0,
+		jit_profile_insns ? (uae_u32)((uae_u64)compiled * 1000 / jit_profile_insns % 10) : 0);
+	if (jit_profile) {
+		/* blocks are compiled from inside the translated code */
+		frame_time_t exec_time = jit_profile_exec_time - jit_profile_compile_time;
+		if (exec_time < 0)
+			exec_time = 0;
+		out ("JIT: compile time %u ms (max %u us per block), translated code %u ms, %u interpreter calls\n",
+			(uae_u32)(jit_profile_compile_time * 1000 / syncbase),
+			(uae_u32)(jit_profile_compile_max * 1000000 / syncbase),
+			(uae_u32)(exec_time * 1000 / syncbase), exec);
+	}
+
+	out ("JIT: block length");
+	for (i = 1, n = 1; n <= MAXRUN; i++, n *= 2) {
+		uae_u32 cnt = 0;
+		int j;
+		for (j = n; j < n * 2 && j <= MAXRUN; j++)
+			cnt += jit_profile_blocklen[j];
+		if (cnt)
+			out (" %d-%d:%u", n, n * 2 - 1, cnt);
+	}
+	out ("\n");
+
+	if (maxlines > 0 && fallbacks > (uae_u32)maxlines)
+		fallbacks = maxlines;
+	for (i = 0; i < (int)fallbacks; i++) {
+		uae_u16 opcode = ops[i];
+		struct instr *dp = table68k + opcode;
+		struct mnemolookup *lookup;
+
+		for (lookup = lookuptab; lookup->mnemo != dp->mnemo; lookup++)
+			;
+		out ("JIT: %04x %-8s compiled %6u executed %10u%s\n",
+			opcode, lookup->name, jit_fallback_compiled[opcode], jit_fallback_exec[opcode],
+			compfunctbl[opcode] ? "" : " (no handler)");
+	}
+}
 
 void compile_block(cpu_history* pc_hist, int blocklen, int totcycles)
 {
@@ -5921,7 +6029,13 @@ void compile_block(cpu_history* pc_hist, int blocklen, int totcycles)
 		blockinfo* bi2;
 		int extra_len=0;
 
+		frame_time_t compile_start=jit_profile?read_processor_time():0;
+		HOSTPROF_COUNT (HPC_JITCOMPILES);
+
 		compile_count++;
+		jit_profile_blocks++;
+		jit_profile_insns+=blocklen;
+		jit_profile_blocklen[blocklen]++;
 		if (current_compile_p>=max_compile_start)
 			flush_icache_hard(0, 3);
 
@@ -6074,6 +6188,7 @@ void compile_block(cpu_history* pc_hist, int blocklen, int totcycles)
 							flush(1);
 							was_comp=0;
 						}
+						jit_fallback_compiled[opcode]++;
 						raw_mov_l_ri(REG_PAR1,(uae_u32)opcode);
 						raw_mov_l_ri(REG_PAR2,(uae_u32)&regs);
 #if USE_NORMAL_CALLING_CONVENTION
@@ -6084,6 +6199,11 @@ void compile_block(cpu_history* pc_hist, int blocklen, int totcycles)
 							(uae_u32)pc_hist[i].location);
 						raw_call((uae_u32)cputbl[opcode]);
 						//raw_add_l_mi((uae_u32)&oink,1); // FIXME
+						if (jit_profile) { /* flags are in memory after the call */
+							raw_add_l_mi((uae_u32)&jit_fallback_exec[opcode],1);
+							if ((opcode & 0xfe00) == 0xf200)
+								raw_add_l_mi((uae_u32)comp_fpp_fallback_counter (opcode, cft_map (pc_hist[i].location[1])),1);
+						}
 #if USE_NORMAL_CALLING_CONVENTION
 						raw_inc_sp(8);
 #endif
@@ -6277,6 +6397,13 @@ void compile_block(cpu_history* pc_hist, int blocklen, int totcycles)
 			flush_icache_hard(0, 3);
 
 		do_extra_cycles(totcycles); /* for the compilation time */
+
+		if (jit_profile) {
+			compile_start=read_processor_time()-compile_start;
+			jit_profile_compile_time+=compile_start;
+			if (compile_start>jit_profile_compile_max)
+				jit_profile_compile_max=compile_start;
+		}
 	}
 }
 
@@ -42,7 +42,11 @@
 
 mmu_atc_l1_array atc_l1[2];
 mmu_atc_l1_array *current_atc;
-struct mmu_atc_line atc_l2[2][ATC_L2_SIZE];
+struct mmu_atc_line atc_l2[2][ATC_L2_SETS][ATC_L2_WAYS];
+static uae_u8 atc_l2_victim[2][ATC_L2_SETS];
+struct mmu_atc_stats mmu_atc_stats;
+
+static bool mmu_host_disabled;
 
 #ifdef ATC_STATS
 static unsigned int mmu_atc_hits[ATC_L2_SIZE];
@@ -250,15 +254,18 @@ static void mmu_dump_table(const char * label, uaecptr root_ptr)
 /* {{{ mmu_dump_atc */
 void mmu_dump_atc(void)
 {
-	int i, j;
+	int i, j, k;
 	for (i = 0; i < 2; i++) {
-		for (j = 0; j < ATC_L2_SIZE; j++) {
-			if (atc_l2[i][j].tag == 0x8000)
-				continue;
-			D(bug("ATC[%02d] G=%d TT=%d M=%d WP=%d VD=%d VI=%d tag=%08x --> phys=%08x\n",
-				j, atc_l2[i][j].global, atc_l2[i][j].tt, atc_l2[i][j].modified,
-				atc_l2[i][j].write_protect, atc_l2[i][j].valid_data, atc_l2[i][j].valid_inst,
-				atc_l2[i][j].tag, atc_l2[i][j].phys));
+		for (j = 0; j < ATC_L2_SETS; j++) {
+			for (k = 0; k < ATC_L2_WAYS; k++) {
+				struct mmu_atc_line *l = &atc_l2[i][j][k];
+				if (l->tag == 0x8000)
+					continue;
+				D(bug("ATC[%02d.%d] G=%d TT=%d M=%d WP=%d VD=%d VI=%d tag=%08x --> phys=%08x\n",
+					j, k, l->global, l->tt, l->modified,
+					l->write_protect, l->valid_data, l->valid_inst,
+					l->tag, l->phys));
+			}
 		}
 	}
 }
@@ -281,6 +288,52 @@ void mmu_dump_tables(void)
 
 static uaecptr REGPARAM2 mmu_lookup_pagetable(uaecptr addr, bool super, bool write);
 
+/*
+ * Find the level 2 line of an address. On a miss an empty way or, if the
+ * set is full, the next way in round robin order is returned for refill.
+ */
+static struct mmu_atc_line *mmu_atc_l2_line(uaecptr addr, bool super, bool *hit)
+{
+	int idx = ATC_L2_INDEX(addr);
+	uae_u16 tag = ATC_TAG(addr);
+	struct mmu_atc_line *set = atc_l2[super ? 1 : 0][idx];
+	int i;
+
+	for (i = 0; i < ATC_L2_WAYS; i++) {
+		if (set[i].tag == tag) {
+			*hit = true;
+			return &set[i];
+		}
+	}
+	*hit = false;
+	for (i = 0; i < ATC_L2_WAYS; i++) {
+		if (set[i].tag == 0x8000)
+			return &set[i];
+	}
+	mmu_atc_stats.l2_evict++;
+	i = atc_l2_victim[super ? 1 : 0][idx]++ % ATC_L2_WAYS;
+	return &set[i];
+}
+
+/*
+ * Host address of a physical page for the level 1 fast path. Only plain
+ * ram (and rom for reads) qualifies, everything else needs its handlers.
+ */
+static uae_u8 *mmu_host_page(uaecptr phys, bool write)
+{
+	addrbank *ab;
+
+	if (mmu_host_disabled || currprefs.cpu_cycle_exact)
+		return NULL;
+	phys &= ~0xfff;
+	ab = &get_mem_bank(phys);
+	if (ab->flags != ABFLAG_RAM && (write || ab->flags != ABFLAG_ROM))
+		return NULL;
+	if (!ab->check(phys, 0x1000))
+		return NULL;
+	return ab->xlateaddr(phys);
+}
+
 static ALWAYS_INLINE int mmu_get_fc(bool super, bool data)
 {
 	return (super ? 4 : 0) | (data ? 1 : 2);
@@ -357,6 +410,7 @@ static uaecptr mmu_fill_atc_l2(uaecptr addr, bool super, bool data, bool write,
 		return 0;
 	}
 
+	mmu_atc_stats.table_search++;
 	SAVE_EXCEPTION;
 	TRY(prb) {
 		desc = mmu_lookup_pagetable(addr, super, write);
@@ -392,13 +446,17 @@ fail:
 
 static ALWAYS_INLINE bool mmu_fill_atc_l1(uaecptr addr, bool super, bool data, bool write, struct mmu_atc_line *l1)
 {
-	int idx = ATC_L2_INDEX(addr);
-	int tag = ATC_TAG(addr);
-	struct mmu_atc_line *l = &atc_l2[super ? 1 : 0][idx];
+	struct mmu_atc_line *l;
+	bool hit;
 
-	if (l->tag != tag) {
+	mmu_atc_stats.l1_miss++;
+	l = mmu_atc_l2_line(addr, super, &hit);
+	if (!hit) {
+		mmu_atc_stats.l2_miss++;
 restart:
 		mmu_fill_atc_l2(addr, super, data, write, l);
+	} else {
+		mmu_atc_stats.l2_hit++;
 	}
 	if (!(data ? l->valid_data : l->valid_inst)) {
 		D(bug("MMU: non-resident page (%x,%x,%x)!\n", addr, regs.pc, regs.instruction_pc));
@@ -413,6 +471,7 @@ restart:
 			goto restart;
 	}
 	*l1 = *l;
+	l1->host = mmu_host_page(addr + l1->phys, write);
 #if 0
 	uaecptr phys_addr = addr + l1->phys;
 	if ((phys_addr & 0xfff00000) == 0x00f00000) {
@@ -440,8 +499,9 @@ fail:
 uaecptr REGPARAM2 mmu_translate(uaecptr addr, bool super, bool data, bool write)
 {
 	struct mmu_atc_line *l;
+	bool hit;
 
-	l = &atc_l2[super ? 1 : 0][ATC_L2_INDEX(addr)];
+	l = mmu_atc_l2_line(addr, super, &hit);
 	mmu_fill_atc_l2(addr, super, data, write, l);
 	if (!(data ? l->valid_data : l->valid_inst))
 		THROW(2);
@@ -938,8 +998,9 @@ void REGPARAM2 mmu_op_real(uae_u32 opcode, uae_u16 extra)
 			struct mmu_atc_line *l;
 			uae_u32 desc;
 			bool data = (regs.dfc & 3) != 2;
+			bool hit;
 
-			l = &atc_l2[super ? 1 : 0][ATC_L2_INDEX(addr)];
+			l = mmu_atc_l2_line(addr, super, &hit);
 			desc = mmu_fill_atc_l2(addr, super, data, write, l);
 			if (!(data ? l->valid_data : l->valid_inst))
 				regs.mmusr = MMU_MMUSR_B;
@@ -960,11 +1021,34 @@ void REGPARAM2 mmu_op_real(uae_u32 opcode, uae_u16 extra)
 		op_illg (opcode);
 }
 
+/*
+ * Memory banks were remapped or patched, drop all cached host pointers.
+ * Level 1 lines are cheap to refill from level 2, so simply empty it.
+ */
+void mmu_flush_host_cache(void)
+{
+	struct mmu_atc_line *l;
+	unsigned int i;
+
+	l = atc_l1[0][0][0];
+	for (i = 0; i < sizeof(atc_l1) / sizeof(*l); l++, i++)
+		l->tag = 0x8000;
+}
+
+/* the debugger's memwatch banks must see every access */
+void mmu_enable_host_cache(bool enable)
+{
+	mmu_host_disabled = !enable;
+	mmu_flush_host_cache();
+}
+
 void REGPARAM2 mmu_flush_atc(uaecptr addr, bool super, bool global)
 {
 	struct mmu_atc_line *l;
-	int i, j;
+	uae_u16 tag = ATC_TAG(addr);
+	int i, j, set;
 
+	mmu_atc_stats.flush++;
 	l = atc_l1[super ? 1 : 0][0][0];
 	i = ATC_L1_INDEX(addr);
 	for (j = 0; j < 4; j++) {
@@ -980,14 +1064,18 @@ void REGPARAM2 mmu_flush_atc(uaecptr addr, bool super, bool global)
 			l += ATC_L1_SIZE;
 		}
 	}
-	l = atc_l2[super ? 1 : 0];
-	i = ATC_L2_INDEX(addr);
-	if (global || !l[i].global)
-		l[i].tag = 0x8000;
-	if (regs.mmu_pagesize_8k) {
+	/* level 2 is searched by tag, the other half of an 8K page lives in
+	 * the neighbouring set */
+	i = set = ATC_L2_INDEX(addr);
+	for (;;) {
+		l = atc_l2[super ? 1 : 0][i];
+		for (j = 0; j < ATC_L2_WAYS; j++) {
+			if (l[j].tag == tag && (global || !l[j].global))
+				l[j].tag = 0x8000;
+		}
+		if (!regs.mmu_pagesize_8k || i != set)
+			break;
 		i ^= 1;
-		if (global || !l[i].global)
-			l[i].tag = 0x8000;
 	}
 }
 
@@ -996,13 +1084,14 @@ void REGPARAM2 mmu_flush_atc_all(bool global)
 	struct mmu_atc_line *l;
 	unsigned int i;
 
+	mmu_atc_stats.flush_all++;
 	l = atc_l1[0][0][0];
 	for (i = 0; i < sizeof(atc_l1) / sizeof(*l); l++, i++) {
 		if (global || !l->global)
 			l->tag = 0x8000;
 	}
 
-	l = atc_l2[0];
+	l = atc_l2[0][0];
 	for (i = 0; i < sizeof(atc_l2) / sizeof(*l); l++, i++) {
 		if (global || !l->global)
 			l->tag = 0x8000;
@@ -4,8 +4,12 @@
 
 #include "crc32.h"
 
-static unsigned long crc_table32[256];
+/* crc_table32[0] is the usual byte table, crc_table32[k] advances a
+ * byte k positions further so get_crc32 can fold 8 bytes per step
+ * ("slice-by-8"). ROM scanning calls this from several threads. */
+static uae_u32 crc_table32[8][256];
 static unsigned short crc_table16[256];
+static volatile int crc_table_ready;
 static void make_crc_table (void)
 {
 	unsigned long c;
@@ -18,32 +22,52 @@ static void make_crc_table (void)
 			c = (c >> 1) ^ (c & 1 ? 0xedb88320 : 0);
 			w = (w << 1) ^ ((w & 0x8000) ? 0x1021 : 0);
 		}
-		crc_table32[n] = c;
+		crc_table32[0][n] = c;
 		crc_table16[n] = w;
 	}
+	for (n = 0; n < 256; n++) {
+		for (k = 1; k < 8; k++)
+			crc_table32[k][n] = crc_table32[0][crc_table32[k - 1][n] & 0xff] ^ (crc_table32[k - 1][n] >> 8);
+	}
+	__sync_synchronize ();
+	crc_table_ready = 1;
 }
 uae_u32 get_crc32_val (uae_u8 v, uae_u32 crc)
 {
-	if (!crc_table32[1])
+	if (!crc_table_ready)
 		make_crc_table();
 	crc ^= 0xffffffff;
-	crc = crc_table32[(crc ^ v) & 0xff] ^ (crc >> 8);
+	crc = crc_table32[0][(crc ^ v) & 0xff] ^ (crc >> 8);
 	return crc ^ 0xffffffff;
 }
 uae_u32 get_crc32 (uae_u8 *buf, int len)
 {
 	uae_u32 crc;
-	if (!crc_table32[1])
+	if (!crc_table_ready)
 		make_crc_table();
 	crc = 0xffffffff;
+	while (len > 0 && ((uae_uintptr)buf & 7)) {
+		crc = crc_table32[0][(crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+	while (len >= 8) {
+		/* byte loads keep this endian neutral, compilers merge them */
+		crc ^= buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uae_u32)buf[3] << 24);
+		crc = crc_table32[7][crc & 0xff] ^ crc_table32[6][(crc >> 8) & 0xff]
+			^ crc_table32[5][(crc >> 16) & 0xff] ^ crc_table32[4][crc >> 24]
+			^ crc_table32[3][buf[4]] ^ crc_table32[2][buf[5]]
+			^ crc_table32[1][buf[6]] ^ crc_table32[0][buf[7]];
+		buf += 8;
+		len -= 8;
+	}
 	while (len-- > 0)
-		crc = crc_table32[(crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
+		crc = crc_table32[0][(crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
 	return crc ^ 0xffffffff;
 }
 uae_u16 get_crc16 (uae_u8 *buf, int len)
 {
 	uae_u16 crc;
-	if (!crc_table32[1])
+	if (!crc_table_ready)
 		make_crc_table();
 	crc = 0xffff;
 	while (len-- > 0)
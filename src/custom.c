@@ -42,6 +42,7 @@
 #include "avioutput.h"
 #endif
 #include "debug.h"
+#include "hostprof.h"
 #include "akiko.h"
 #include "cdtv.h"
 #if defined(ENFORCER)
@@ -56,6 +57,7 @@
 #include "sampler.h"
 #include "hrtimer.h"
 #include "sleep.h"
+#include "recorder.h"
 
 #define CUSTOM_DEBUG 0
 #define SPRITE_DEBUG 0
@@ -177,6 +179,8 @@ static int fmode;
 uae_u16 beamcon0, new_beamcon0;
 uae_u16 vtotal = MAXVPOS_PAL, htotal = MAXHPOS_PAL;
 static int maxvpos_stored, maxhpos_stored;
+/* what maxvpos and maxhpos were last computed from */
+static uae_u16 hz_beamcon0, hz_vtotal, hz_htotal;
 static uae_u16 hsstop, hbstrt, hbstop, vsstop, vbstrt, vbstop, hsstrt, vsstrt, hcenter;
 static int ciavsyncmode;
 static int diw_hstrt, diw_hstop;
@@ -455,10 +459,13 @@ static void hsyncdelay (void)
 #endif
 }
 
+static void custom_wput_build (void);
+
 static void update_mirrors (void)
 {
 	aga_mode = (currprefs.chipset_mask & CSMASK_AGA) ? 1 : 0;
 	direct_rgb = aga_mode;
+	custom_wput_build ();
 }
 
 STATIC_INLINE uae_u8 *pfield_xlateptr (uaecptr plpt, int bytecount)
@@ -2793,6 +2800,9 @@ void init_hz_fullinit (bool fullinit)
 		vpos_count = vpos_count_prev = 0;
 	}
 	beamcon0 = new_beamcon0;
+	hz_beamcon0 = beamcon0;
+	hz_vtotal = vtotal;
+	hz_htotal = htotal;
 	isntsc = (beamcon0 & 0x20) ? 0 : 1;
 	islace = (bplcon0 & 4) ? 1 : 0;
 	if (!(currprefs.chipset_mask & CSMASK_ECS_AGNUS))
@@ -4213,59 +4223,59 @@ static uae_u16 COLOR_READ (int num)
 }
 #endif
 
-static void COLOR_WRITE (int hpos, uae_u16 v, int num)
-{
-	v &= 0xFFF;
 #ifdef AGA
-	if (currprefs.chipset_mask & CSMASK_AGA) {
-		int r,g,b;
-		int cr,cg,cb;
-		int colreg;
-		uae_u32 cval;
+static void COLOR_WRITE_AGA (int hpos, uae_u16 v, int num)
+{
+	int r,g,b;
+	int cr,cg,cb;
+	int colreg;
+	uae_u32 cval;
 
-		/* writing is disabled when RDRAM=1 */
-		if (bplcon2 & 0x0100)
-			return;
+	v &= 0xFFF;
+	/* writing is disabled when RDRAM=1 */
+	if (bplcon2 & 0x0100)
+		return;
 
-		colreg = ((bplcon3 >> 13) & 7) * 32 + num;
-		r = (v & 0xF00) >> 8;
-		g = (v & 0xF0) >> 4;
-		b = (v & 0xF) >> 0;
-		cr = current_colors.color_regs_aga[colreg] >> 16;
-		cg = (current_colors.color_regs_aga[colreg] >> 8) & 0xFF;
-		cb = current_colors.color_regs_aga[colreg] & 0xFF;
-
-		if (bplcon3 & 0x200) {
-			cr &= 0xF0; cr |= r;
-			cg &= 0xF0; cg |= g;
-			cb &= 0xF0; cb |= b;
-		} else {
-			cr = r + (r << 4);
-			cg = g + (g << 4);
-			cb = b + (b << 4);
-			color_regs_aga_genlock[colreg] = v >> 15;
-		}
-		cval = (cr << 16) | (cg << 8) | cb;
-		if (cval == current_colors.color_regs_aga[colreg])
-			return;
+	colreg = ((bplcon3 >> 13) & 7) * 32 + num;
+	r = (v & 0xF00) >> 8;
+	g = (v & 0xF0) >> 4;
+	b = (v & 0xF) >> 0;
+	cr = current_colors.color_regs_aga[colreg] >> 16;
+	cg = (current_colors.color_regs_aga[colreg] >> 8) & 0xFF;
+	cb = current_colors.color_regs_aga[colreg] & 0xFF;
 
-		/* Call this with the old table still intact. */
-		record_color_change (hpos, colreg, cval);
-		remembered_color_entry = -1;
-		current_colors.color_regs_aga[colreg] = cval;
-		current_colors.acolors[colreg] = getxcolor (cval);
+	if (bplcon3 & 0x200) {
+		cr &= 0xF0; cr |= r;
+		cg &= 0xF0; cg |= g;
+		cb &= 0xF0; cb |= b;
 	} else {
-#endif
-		if (current_colors.color_regs_ecs[num] == v)
-			return;
-		/* Call this with the old table still intact. */
-		record_color_change (hpos, num, v);
-		remembered_color_entry = -1;
-		current_colors.color_regs_ecs[num] = v;
-		current_colors.acolors[num] = getxcolor (v);
-#ifdef AGA
+		cr = r + (r << 4);
+		cg = g + (g << 4);
+		cb = b + (b << 4);
+		color_regs_aga_genlock[colreg] = v >> 15;
 	}
+	cval = (cr << 16) | (cg << 8) | cb;
+	if (cval == current_colors.color_regs_aga[colreg])
+		return;
+
+	/* Call this with the old table still intact. */
+	record_color_change (hpos, colreg, cval);
+	remembered_color_entry = -1;
+	current_colors.color_regs_aga[colreg] = cval;
+	current_colors.acolors[colreg] = getxcolor (cval);
+}
 #endif
+
+static void COLOR_WRITE_ECS (int hpos, uae_u16 v, int num)
+{
+	v &= 0xFFF;
+	if (current_colors.color_regs_ecs[num] == v)
+		return;
+	/* Call this with the old table still intact. */
+	record_color_change (hpos, num, v);
+	remembered_color_entry = -1;
+	current_colors.color_regs_ecs[num] = v;
+	current_colors.acolors[num] = getxcolor (v);
 }
 
 /* The copper code.  The biggest nightmare in the whole emulator.
@@ -4323,6 +4333,7 @@ static int custom_wput_copper (int hpos, uaecptr addr, uae_u32 value, int noget)
 {
 	int v;
 
+	HOSTPROF_COUNT (HPC_COPPERMOVES);
 #ifdef DEBUGGER
 	value = debug_wputpeekdma (0xdff000 + addr, value);
 #endif
@@ -4332,6 +4343,23 @@ static int custom_wput_copper (int hpos, uaecptr addr, uae_u32 value, int noget)
 	return v;
 }
 
+/* First position after hpos at which a pending WAIT on the current line
+ * can match. Nothing but the comparator happens in the cycles before it,
+ * so update_copper jumps there directly instead of stepping through them
+ * one copper cycle at a time. */
+static int copper_wait_skip (int hpos, int until_hpos)
+{
+	int mask = cop_state.saved_i2 & 0xFE;
+
+	while (hpos < until_hpos) {
+		int next = ((hpos == maxhpos - 3) && (maxhpos & 1)) ? hpos + 1 : hpos + 2;
+		if ((next & mask) >= cop_state.hcmp)
+			break;
+		hpos = next;
+	}
+	return hpos;
+}
+
 static void dump_copper (TCHAR *error, int until_hpos)
 {
 	write_log ("%s: vpos=%d until_hpos=%d\n",
@@ -4365,12 +4393,26 @@ static int customdelay[]= {
 	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
 };
 
+/* Custom register write dispatch, indexed by register offset / 2. Built
+ * for the current chipset by custom_wput_build (). */
+typedef void (*CUSTOM_WFUNC)(int hpos, uae_u16 v, int idx);
+
+#define CUSTOMW_COPDELAY 1 /* copper write takes effect one cycle late */
+
+struct custom_wreg
+{
+	CUSTOM_WFUNC func;
+	uae_u8 idx;
+	uae_u8 flags;
+};
+static struct custom_wreg custom_wregs[256];
+
 static void copper_write (uae_u32 v)
 {
 	custom_wput_copper (current_hpos (), v >> 16, v & 0xffff, 0);
 }
 
-static void update_copper (int until_hpos)
+static void update_copper_1 (int until_hpos)
 {
 	int vp = vpos & (((cop_state.saved_i2 >> 8) & 0x7F) | 0x80);
 	int c_hpos = cop_state.hpos;
@@ -4393,13 +4435,16 @@ static void update_copper (int until_hpos)
 		until_hpos = maxhpos & ~1;
 
 	for (;;) {
-		int old_hpos = c_hpos;
+		int old_hpos;
 		int hp;
 
+		if (cop_state.state == COP_wait && cop_state.movedelay == 0 && vp == cop_state.vcmp)
+			c_hpos = copper_wait_skip (c_hpos, until_hpos);
+
+		old_hpos = c_hpos;
 		if (c_hpos >= until_hpos)
 			break;
 
-
 		/* So we know about the fetch state.  */
 		decide_line (c_hpos);
 		decide_fetch (c_hpos);
@@ -4540,10 +4585,10 @@ static void update_copper (int until_hpos)
 					event2_newevent2 (1, (reg << 16) | data, copper_write);
 #else
 					// FIX: all copper writes happen 1 cycle later than CPU writes
-					if (customdelay[reg / 2]) {
+					if (custom_wregs[reg / 2].flags & CUSTOMW_COPDELAY) {
 						cop_state.moveaddr = reg;
 						cop_state.movedata = data;
-						cop_state.movedelay = customdelay[cop_state.moveaddr / 2];
+						cop_state.movedelay = 1;
 					} else {
 						int hpos2 = old_hpos;
 						custom_wput_copper (hpos2, reg, data, 0);
@@ -4669,6 +4714,13 @@ out:
 	last_copper_hpos = until_hpos;
 }
 
+static void update_copper (int until_hpos)
+{
+	HOSTPROF_ENTER (HP_COPPER);
+	update_copper_1 (until_hpos);
+	HOSTPROF_LEAVE ();
+}
+
 static void compute_spcflag_copper (int hpos)
 {
 	int wasenabled = copper_enabled_thisline;
@@ -5149,10 +5201,15 @@ static void fpscounter (void)
 // vsync functions that are not hardware timing related
 static void vsync_handler_pre (void)
 {
+#ifdef HOSTPROF
+	hostprof_vsync ();
+#endif
 	if (bogusframe > 0)
 		bogusframe--;
 
-	handle_events ();
+	/* host input only between real frames, run-ahead frames repeat it */
+	if (!runahead_frame)
+		handle_events ();
 
 #ifdef PICASSO96
 	picasso_handle_vsync ();
@@ -5170,11 +5227,13 @@ static void vsync_handler_pre (void)
 		return;
 	}
 
-	config_check_vsync ();
+	if (!runahead_frame)
+		config_check_vsync ();
 	if (timehack_alive > 0)
 		timehack_alive--;
 
-	inputdevice_vsync ();
+	if (!runahead_frame)
+		inputdevice_vsync ();
 
 #ifdef FILESYS
 	filesys_vsync ();
@@ -5184,6 +5243,9 @@ static void vsync_handler_pre (void)
 	sampler_vsync ();
 #endif
 
+#ifdef SAVESTATE
+	savestate_runahead_vsync ();
+#endif
 	vsync_handle_redraw (lof_store, lof_changed);
 }
 
@@ -5192,7 +5254,9 @@ static void vsync_handler_post (void)
 {
 	fpscounter ();
 
-	if (!isvsync ()
+	if (runahead_frame != runahead_frames) {
+		/* run-ahead: not shown, no need to wait */
+	} else if (!isvsync ()
 #ifdef AVIOUTPUT
 		&& ((avioutput_framelimiter && avioutput_enabled) || !avioutput_enabled)
 #endif
@@ -5231,8 +5295,10 @@ static void vsync_handler_post (void)
 			show_screen ();
 	}
 
-	gui_handle_events ();
-	handle_events ();
+	if (!runahead_frame) {
+		gui_handle_events ();
+		handle_events ();
+	}
 
 #if CUSTOM_DEBUG > 1
 	if ((intreq & 0x0020) && (intena & 0x0020))
@@ -5645,6 +5711,10 @@ static void hsync_handler_post (bool isvsync)
 	}
 
 	inputdevice_hsync ();
+#ifdef DEBUGGER
+	if (debug_profile)
+		debug_profile_sample ();
+#endif
 
 	last_custom_value1 = 0xffff; // refresh slots should set this to 0xffff
 
@@ -5664,7 +5734,9 @@ static void hsync_handler_post (bool isvsync)
 			lightpen_triggered = 1;
 		}
 		vpos = 0;
+		HOSTPROF_ENTER (HP_VSYNC);
 		vsync_handler_post ();
+		HOSTPROF_LEAVE ();
 		vpos_count = 0;
 	}
 	// DIP Agnus (8361): vblank interrupt is triggered on line 1!
@@ -5833,15 +5905,20 @@ static void hsync_handler_post (bool isvsync)
 static void hsync_handler (void)
 {
 	bool vs = is_vsync ();
+	HOSTPROF_ENTER (HP_HSYNC);
 	hsync_handler_pre (vs);
 	if (vs) {
+		HOSTPROF_ENTER (HP_VSYNC);
 		vsync_handler_pre ();
+		HOSTPROF_LEAVE ();
 		if (savestate_check ()) {
+			HOSTPROF_LEAVE ();
 			uae_reset (0);
 			return;
 		}
 	}
 	hsync_handler_post (vs);
+	HOSTPROF_LEAVE ();
 }
 
 void init_eventtab (void)
@@ -6150,6 +6227,7 @@ int custom_init (void)
 
 	gen_custom_tables ();
 	build_blitfilltable ();
+	custom_wput_build ();
 
 	drawing_init ();
 
@@ -6331,8 +6409,260 @@ uae_u32 REGPARAM2 custom_lget (uaecptr addr)
 #endif
 	return ((uae_u32)custom_wget (addr) << 16) | custom_wget (addr + 2);
 }
+/* Adapters from the register handlers to CUSTOM_WFUNC. */
+#define CUSTOMW(name, call) \
+	static void cw_##name (int hpos, uae_u16 value, int idx) { call; }
+#define CUSTOMW_SYNC(reg) \
+	static void cw_##reg (int hpos, uae_u16 value, int idx) { if (reg != value) { reg = value; varsync (); } }
+
+CUSTOMW (NOP, (void)0)
+CUSTOMW (CLXDAT, CLXDAT ())
+CUSTOMW (DSKPTH, DSKPTH (value))
+CUSTOMW (DSKPTL, DSKPTL (value))
+CUSTOMW (DSKLEN, DSKLEN (value, hpos))
+CUSTOMW (DSKDAT, DSKDAT (value))
+CUSTOMW (VPOSW, VPOSW (value))
+CUSTOMW (VHPOSW, VHPOSW (value))
+CUSTOMW (COPCON, COPCON (value))
+CUSTOMW (SERDAT, SERDAT (value))
+CUSTOMW (SERPER, SERPER (value))
+CUSTOMW (POTGO, POTGO (value))
+CUSTOMW (JOYTEST, JOYTEST (value))
+CUSTOMW (BLTCON0, BLTCON0 (hpos, value))
+CUSTOMW (BLTCON1, BLTCON1 (hpos, value))
+CUSTOMW (BLTAFWM, BLTAFWM (hpos, value))
+CUSTOMW (BLTALWM, BLTALWM (hpos, value))
+CUSTOMW (BLTAPTH, BLTAPTH (hpos, value))
+CUSTOMW (BLTAPTL, BLTAPTL (hpos, value))
+CUSTOMW (BLTBPTH, BLTBPTH (hpos, value))
+CUSTOMW (BLTBPTL, BLTBPTL (hpos, value))
+CUSTOMW (BLTCPTH, BLTCPTH (hpos, value))
+CUSTOMW (BLTCPTL, BLTCPTL (hpos, value))
+CUSTOMW (BLTDPTH, BLTDPTH (hpos, value))
+CUSTOMW (BLTDPTL, BLTDPTL (hpos, value))
+CUSTOMW (BLTSIZE, BLTSIZE (hpos, value))
+CUSTOMW (BLTAMOD, BLTAMOD (hpos, value))
+CUSTOMW (BLTBMOD, BLTBMOD (hpos, value))
+CUSTOMW (BLTCMOD, BLTCMOD (hpos, value))
+CUSTOMW (BLTDMOD, BLTDMOD (hpos, value))
+CUSTOMW (BLTCDAT, BLTCDAT (hpos, value))
+CUSTOMW (BLTBDAT, BLTBDAT (hpos, value))
+CUSTOMW (BLTADAT, BLTADAT (hpos, value))
+CUSTOMW (BLTCON0L, BLTCON0L (hpos, value))
+CUSTOMW (BLTSIZV, BLTSIZV (hpos, value))
+CUSTOMW (BLTSIZH, BLTSIZH (hpos, value))
+CUSTOMW (DSKSYNC, DSKSYNC (hpos, value))
+CUSTOMW (COP1LCH, COP1LCH (value))
+CUSTOMW (COP1LCL, COP1LCL (value))
+CUSTOMW (COP2LCH, COP2LCH (value))
+CUSTOMW (COP2LCL, COP2LCL (value))
+CUSTOMW (COPJMP, COPJMP (idx, 0))
+CUSTOMW (DIWSTRT, DIWSTRT (hpos, value))
+CUSTOMW (DIWSTOP, DIWSTOP (hpos, value))
+CUSTOMW (DDFSTRT, DDFSTRT (hpos, value))
+CUSTOMW (DDFSTOP, DDFSTOP (hpos, value))
+CUSTOMW (DIWHIGH, DIWHIGH (hpos, value))
+CUSTOMW (DMACON, DMACON (hpos, value))
+CUSTOMW (CLXCON, CLXCON (value))
+CUSTOMW (INTENA, INTENA (value))
+CUSTOMW (INTREQ, INTREQ (value))
+CUSTOMW (ADKCON, ADKCON (hpos, value))
+CUSTOMW (AUDxLCH, AUDxLCH (idx, value))
+CUSTOMW (AUDxLCL, AUDxLCL (idx, value))
+CUSTOMW (AUDxLEN, AUDxLEN (idx, value))
+CUSTOMW (AUDxPER, AUDxPER (idx, value))
+CUSTOMW (AUDxVOL, AUDxVOL (idx, value))
+CUSTOMW (AUDxDAT, AUDxDAT (idx, value))
+CUSTOMW (BPLxPTH, BPLxPTH (hpos, value, idx))
+CUSTOMW (BPLxPTL, BPLxPTL (hpos, value, idx))
+CUSTOMW (BPLxDAT, BPLxDAT (hpos, idx, value))
+CUSTOMW (BPLCON0, BPLCON0 (hpos, value))
+CUSTOMW (BPLCON1, BPLCON1 (hpos, value))
+CUSTOMW (BPLCON2, BPLCON2 (hpos, value))
+CUSTOMW (BPL1MOD, BPL1MOD (hpos, value))
+CUSTOMW (BPL2MOD, BPL2MOD (hpos, value))
+CUSTOMW (SPRxPTH, SPRxPTH (hpos, value, idx))
+CUSTOMW (SPRxPTL, SPRxPTL (hpos, value, idx))
+CUSTOMW (SPRxPOS, SPRxPOS (hpos, value, idx))
+CUSTOMW (SPRxCTL, SPRxCTL (hpos, value, idx))
+CUSTOMW (SPRxDATA, SPRxDATA (hpos, value, idx))
+CUSTOMW (SPRxDATB, SPRxDATB (hpos, value, idx))
+CUSTOMW (COLOR_ECS, COLOR_WRITE_ECS (hpos, value, idx))
+CUSTOMW (FNULL, FNULL (value))
+#ifdef ECS_DENISE
+CUSTOMW (BPLCON3, BPLCON3 (hpos, value))
+#endif
+#ifdef AGA
+CUSTOMW (BPLCON4, BPLCON4 (hpos, value))
+CUSTOMW (CLXCON2, CLXCON2 (value))
+CUSTOMW (FMODE, FMODE (hpos, value))
+CUSTOMW (COLOR_AGA, COLOR_WRITE_AGA (hpos, value, idx))
+#endif
+#ifndef CUSTOM_SIMPLE
+CUSTOMW (BEAMCON0, BEAMCON0 (value))
+#ifdef ECS_DENISE
+CUSTOMW_SYNC (htotal)
+CUSTOMW_SYNC (hsstop)
+CUSTOMW_SYNC (hbstrt)
+CUSTOMW_SYNC (hbstop)
+CUSTOMW_SYNC (vtotal)
+CUSTOMW_SYNC (vsstop)
+CUSTOMW_SYNC (hsstrt)
+CUSTOMW_SYNC (vsstrt)
+CUSTOMW_SYNC (hcenter)
+CUSTOMW (vbstrt, if (vbstrt < value || vbstrt > value + 1) { vbstrt = value; varsync (); })
+CUSTOMW (vbstop, if (vbstop < value || vbstop > value + 1) { vbstop = value; varsync (); })
+#endif
+#endif
+
+static void custom_wreg_set (int addr, CUSTOM_WFUNC func, int idx)
+{
+	custom_wregs[addr / 2].func = func;
+	custom_wregs[addr / 2].idx = idx;
+}
+
+/* Registers the current chipset doesn't have are entered as no-ops, the
+ * handlers would ignore the write anyway. Must be called again whenever
+ * currprefs.chipset_mask changes. */
+static void custom_wput_build (void)
+{
+	int ecsagnus = (currprefs.chipset_mask & CSMASK_ECS_AGNUS) != 0;
+	int aga = (currprefs.chipset_mask & CSMASK_AGA) != 0;
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		custom_wregs[i].func = NULL;
+		custom_wregs[i].idx = 0;
+		custom_wregs[i].flags = customdelay[i] ? CUSTOMW_COPDELAY : 0;
+	}
+
+	custom_wreg_set (0x00E, cw_CLXDAT, 0);
+
+	custom_wreg_set (0x020, cw_DSKPTH, 0);
+	custom_wreg_set (0x022, cw_DSKPTL, 0);
+	custom_wreg_set (0x024, cw_DSKLEN, 0);
+	custom_wreg_set (0x026, cw_DSKDAT, 0);
+
+	custom_wreg_set (0x02A, cw_VPOSW, 0);
+	custom_wreg_set (0x02C, cw_VHPOSW, 0);
+	custom_wreg_set (0x02E, cw_COPCON, 0);
+	custom_wreg_set (0x030, cw_SERDAT, 0);
+	custom_wreg_set (0x032, cw_SERPER, 0);
+	custom_wreg_set (0x034, cw_POTGO, 0);
+	custom_wreg_set (0x036, cw_JOYTEST, 0);
+
+	custom_wreg_set (0x040, cw_BLTCON0, 0);
+	custom_wreg_set (0x042, cw_BLTCON1, 0);
+	custom_wreg_set (0x044, cw_BLTAFWM, 0);
+	custom_wreg_set (0x046, cw_BLTALWM, 0);
+	custom_wreg_set (0x048, cw_BLTCPTH, 0);
+	custom_wreg_set (0x04A, cw_BLTCPTL, 0);
+	custom_wreg_set (0x04C, cw_BLTBPTH, 0);
+	custom_wreg_set (0x04E, cw_BLTBPTL, 0);
+	custom_wreg_set (0x050, cw_BLTAPTH, 0);
+	custom_wreg_set (0x052, cw_BLTAPTL, 0);
+	custom_wreg_set (0x054, cw_BLTDPTH, 0);
+	custom_wreg_set (0x056, cw_BLTDPTL, 0);
+	custom_wreg_set (0x058, cw_BLTSIZE, 0);
+	custom_wreg_set (0x05A, ecsagnus ? cw_BLTCON0L : cw_NOP, 0);
+	custom_wreg_set (0x05C, ecsagnus ? cw_BLTSIZV : cw_NOP, 0);
+	custom_wreg_set (0x05E, ecsagnus ? cw_BLTSIZH : cw_NOP, 0);
+	custom_wreg_set (0x060, cw_BLTCMOD, 0);
+	custom_wreg_set (0x062, cw_BLTBMOD, 0);
+	custom_wreg_set (0x064, cw_BLTAMOD, 0);
+	custom_wreg_set (0x066, cw_BLTDMOD, 0);
+	custom_wreg_set (0x070, cw_BLTCDAT, 0);
+	custom_wreg_set (0x072, cw_BLTBDAT, 0);
+	custom_wreg_set (0x074, cw_BLTADAT, 0);
+
+	custom_wreg_set (0x07E, cw_DSKSYNC, 0);
+
+	custom_wreg_set (0x080, cw_COP1LCH, 0);
+	custom_wreg_set (0x082, cw_COP1LCL, 0);
+	custom_wreg_set (0x084, cw_COP2LCH, 0);
+	custom_wreg_set (0x086, cw_COP2LCL, 0);
+	custom_wreg_set (0x088, cw_COPJMP, 1);
+	custom_wreg_set (0x08A, cw_COPJMP, 2);
+
+	custom_wreg_set (0x08E, cw_DIWSTRT, 0);
+	custom_wreg_set (0x090, cw_DIWSTOP, 0);
+	custom_wreg_set (0x092, cw_DDFSTRT, 0);
+	custom_wreg_set (0x094, cw_DDFSTOP, 0);
+
+	custom_wreg_set (0x096, cw_DMACON, 0);
+	custom_wreg_set (0x098, cw_CLXCON, 0);
+	custom_wreg_set (0x09A, cw_INTENA, 0);
+	custom_wreg_set (0x09C, cw_INTREQ, 0);
+	custom_wreg_set (0x09E, cw_ADKCON, 0);
+
+	for (i = 0; i < 4; i++) {
+		int a = 0x0A0 + i * 0x10;
+		custom_wreg_set (a + 0x0, cw_AUDxLCH, i);
+		custom_wreg_set (a + 0x2, cw_AUDxLCL, i);
+		custom_wreg_set (a + 0x4, cw_AUDxLEN, i);
+		custom_wreg_set (a + 0x6, cw_AUDxPER, i);
+		custom_wreg_set (a + 0x8, cw_AUDxVOL, i);
+		custom_wreg_set (a + 0xA, cw_AUDxDAT, i);
+	}
+	for (i = 0; i < 8; i++) {
+		custom_wreg_set (0x0E0 + i * 4, cw_BPLxPTH, i);
+		custom_wreg_set (0x0E2 + i * 4, cw_BPLxPTL, i);
+		custom_wreg_set (0x110 + i * 2, cw_BPLxDAT, i);
+		custom_wreg_set (0x120 + i * 4, cw_SPRxPTH, i);
+		custom_wreg_set (0x122 + i * 4, cw_SPRxPTL, i);
+		custom_wreg_set (0x140 + i * 8, cw_SPRxPOS, i);
+		custom_wreg_set (0x142 + i * 8, cw_SPRxCTL, i);
+		custom_wreg_set (0x144 + i * 8, cw_SPRxDATA, i);
+		custom_wreg_set (0x146 + i * 8, cw_SPRxDATB, i);
+	}
+	for (i = 0; i < 32; i++) {
+#ifdef AGA
+		if (aga) {
+			custom_wreg_set (0x180 + i * 2, cw_COLOR_AGA, i);
+			continue;
+		}
+#endif
+		custom_wreg_set (0x180 + i * 2, cw_COLOR_ECS, i);
+	}
+
+	custom_wreg_set (0x100, cw_BPLCON0, 0);
+	custom_wreg_set (0x102, cw_BPLCON1, 0);
+	custom_wreg_set (0x104, cw_BPLCON2, 0);
+#ifdef ECS_DENISE
+	custom_wreg_set (0x106, cw_BPLCON3, 0);
+#endif
+	custom_wreg_set (0x108, cw_BPL1MOD, 0);
+	custom_wreg_set (0x10A, cw_BPL2MOD, 0);
+#ifdef AGA
+	custom_wreg_set (0x10C, cw_BPLCON4, 0);
+	custom_wreg_set (0x10E, aga ? cw_CLXCON2 : cw_NOP, 0);
+	custom_wreg_set (0x1FC, cw_FMODE, 0);
+#endif
+	custom_wreg_set (0x1E4, cw_DIWHIGH, 0);
+
+#ifndef CUSTOM_SIMPLE
+	custom_wreg_set (0x1DC, cw_BEAMCON0, 0);
+#ifdef ECS_DENISE
+	custom_wreg_set (0x1C0, cw_htotal, 0);
+	custom_wreg_set (0x1C2, cw_hsstop, 0);
+	custom_wreg_set (0x1C4, cw_hbstrt, 0);
+	custom_wreg_set (0x1C6, cw_hbstop, 0);
+	custom_wreg_set (0x1C8, cw_vtotal, 0);
+	custom_wreg_set (0x1CA, cw_vsstop, 0);
+	custom_wreg_set (0x1CC, cw_vbstrt, 0);
+	custom_wreg_set (0x1CE, cw_vbstop, 0);
+	custom_wreg_set (0x1DE, cw_hsstrt, 0);
+	custom_wreg_set (0x1E0, cw_vsstrt, 0);
+	custom_wreg_set (0x1E2, cw_hcenter, 0);
+#endif
+#endif
+	custom_wreg_set (0x1FE, cw_FNULL, 0);
+}
+
 static int REGPARAM2 custom_wput_1 (int hpos, uaecptr addr, uae_u32 value, int noget)
 {
+	const struct custom_wreg *r;
+
 	if (!noget)
 		last_custom_value1 = value;
 	addr &= 0x1FE;
@@ -6343,210 +6673,72 @@ static int REGPARAM2 custom_wput_1 (int hpos, uaecptr addr, uae_u32 value, int n
 	ar_custom[addr+1]=(uae_u8)(value);
 #endif
 #endif
-	switch (addr) {
-	case 0x00E: CLXDAT (); break;
-
-	case 0x020: DSKPTH (value); break;
-	case 0x022: DSKPTL (value); break;
-	case 0x024: DSKLEN (value, hpos); break;
-	case 0x026: DSKDAT (value); break;
-
-	case 0x02A: VPOSW (value); break;
-	case 0x02C: VHPOSW (value); break;
-	case 0x02E: COPCON (value); break;
-	case 0x030: SERDAT (value); break;
-	case 0x032: SERPER (value); break;
-	case 0x034: POTGO (value); break;
-
-	case 0x040: BLTCON0 (hpos, value); break;
-	case 0x042: BLTCON1 (hpos, value); break;
-
-	case 0x044: BLTAFWM (hpos, value); break;
-	case 0x046: BLTALWM (hpos, value); break;
-
-	case 0x050: BLTAPTH (hpos, value); break;
-	case 0x052: BLTAPTL (hpos, value); break;
-	case 0x04C: BLTBPTH (hpos, value); break;
-	case 0x04E: BLTBPTL (hpos, value); break;
-	case 0x048: BLTCPTH (hpos, value); break;
-	case 0x04A: BLTCPTL (hpos, value); break;
-	case 0x054: BLTDPTH (hpos, value); break;
-	case 0x056: BLTDPTL (hpos, value); break;
-
-	case 0x058: BLTSIZE (hpos, value); break;
-
-	case 0x064: BLTAMOD (hpos, value); break;
-	case 0x062: BLTBMOD (hpos, value); break;
-	case 0x060: BLTCMOD (hpos, value); break;
-	case 0x066: BLTDMOD (hpos, value); break;
-
-	case 0x070: BLTCDAT (hpos, value); break;
-	case 0x072: BLTBDAT (hpos, value); break;
-	case 0x074: BLTADAT (hpos, value); break;
-
-	case 0x07E: DSKSYNC (hpos, value); break;
-
-	case 0x080: COP1LCH (value); break;
-	case 0x082: COP1LCL (value); break;
-	case 0x084: COP2LCH (value); break;
-	case 0x086: COP2LCL (value); break;
-
-	case 0x088: COPJMP (1, 0); break;
-	case 0x08A: COPJMP (2, 0); break;
-
-	case 0x08E: DIWSTRT (hpos, value); break;
-	case 0x090: DIWSTOP (hpos, value); break;
-	case 0x092: DDFSTRT (hpos, value); break;
-	case 0x094: DDFSTOP (hpos, value); break;
-
-	case 0x096: DMACON (hpos, value); break;
-	case 0x098: CLXCON (value); break;
-	case 0x09A: INTENA (value); break;
-	case 0x09C: INTREQ (value); break;
-	case 0x09E: ADKCON (hpos, value); break;
-
-	case 0x0A0: AUDxLCH (0, value); break;
-	case 0x0A2: AUDxLCL (0, value); break;
-	case 0x0A4: AUDxLEN (0, value); break;
-	case 0x0A6: AUDxPER (0, value); break;
-	case 0x0A8: AUDxVOL (0, value); break;
-	case 0x0AA: AUDxDAT (0, value); break;
-
-	case 0x0B0: AUDxLCH (1, value); break;
-	case 0x0B2: AUDxLCL (1, value); break;
-	case 0x0B4: AUDxLEN (1, value); break;
-	case 0x0B6: AUDxPER (1, value); break;
-	case 0x0B8: AUDxVOL (1, value); break;
-	case 0x0BA: AUDxDAT (1, value); break;
-
-	case 0x0C0: AUDxLCH (2, value); break;
-	case 0x0C2: AUDxLCL (2, value); break;
-	case 0x0C4: AUDxLEN (2, value); break;
-	case 0x0C6: AUDxPER (2, value); break;
-	case 0x0C8: AUDxVOL (2, value); break;
-	case 0x0CA: AUDxDAT (2, value); break;
-
-	case 0x0D0: AUDxLCH (3, value); break;
-	case 0x0D2: AUDxLCL (3, value); break;
-	case 0x0D4: AUDxLEN (3, value); break;
-	case 0x0D6: AUDxPER (3, value); break;
-	case 0x0D8: AUDxVOL (3, value); break;
-	case 0x0DA: AUDxDAT (3, value); break;
-
-	case 0x0E0: BPLxPTH (hpos, value, 0); break;
-	case 0x0E2: BPLxPTL (hpos, value, 0); break;
-	case 0x0E4: BPLxPTH (hpos, value, 1); break;
-	case 0x0E6: BPLxPTL (hpos, value, 1); break;
-	case 0x0E8: BPLxPTH (hpos, value, 2); break;
-	case 0x0EA: BPLxPTL (hpos, value, 2); break;
-	case 0x0EC: BPLxPTH (hpos, value, 3); break;
-	case 0x0EE: BPLxPTL (hpos, value, 3); break;
-	case 0x0F0: BPLxPTH (hpos, value, 4); break;
-	case 0x0F2: BPLxPTL (hpos, value, 4); break;
-	case 0x0F4: BPLxPTH (hpos, value, 5); break;
-	case 0x0F6: BPLxPTL (hpos, value, 5); break;
-	case 0x0F8: BPLxPTH (hpos, value, 6); break;
-	case 0x0FA: BPLxPTL (hpos, value, 6); break;
-	case 0x0FC: BPLxPTH (hpos, value, 7); break;
-	case 0x0FE: BPLxPTL (hpos, value, 7); break;
-
-	case 0x100: BPLCON0 (hpos, value); break;
-	case 0x102: BPLCON1 (hpos, value); break;
-	case 0x104: BPLCON2 (hpos, value); break;
-#ifdef ECS_DENISE
-	case 0x106: BPLCON3 (hpos, value); break;
-#endif
-
-	case 0x108: BPL1MOD (hpos, value); break;
-	case 0x10A: BPL2MOD (hpos, value); break;
-#ifdef AGA
-	case 0x10E: CLXCON2 (value); break;
+	r = &custom_wregs[addr >> 1];
+	if (r->func) {
+		r->func (hpos, value, r->idx);
+		return 0;
+	}
+	/* writing to read-only register causes read access */
+	if (!noget) {
+#if CUSTOM_DEBUG > 0
+		write_log ("%04X written %08x\n", addr, M68K_GETPC);
 #endif
+		custom_wget_1 (hpos, addr, 1);
+	}
+	return 1;
+}
 
-	case 0x110: BPLxDAT (hpos, 0, value); break;
-	case 0x112: BPLxDAT (hpos, 1, value); break;
-	case 0x114: BPLxDAT (hpos, 2, value); break;
-	case 0x116: BPLxDAT (hpos, 3, value); break;
-	case 0x118: BPLxDAT (hpos, 4, value); break;
-	case 0x11A: BPLxDAT (hpos, 5, value); break;
-	case 0x11C: BPLxDAT (hpos, 6, value); break;
-	case 0x11E: BPLxDAT (hpos, 7, value); break;
-
-	case 0x180: case 0x182: case 0x184: case 0x186: case 0x188: case 0x18A:
-	case 0x18C: case 0x18E: case 0x190: case 0x192: case 0x194: case 0x196:
-	case 0x198: case 0x19A: case 0x19C: case 0x19E: case 0x1A0: case 0x1A2:
-	case 0x1A4: case 0x1A6: case 0x1A8: case 0x1AA: case 0x1AC: case 0x1AE:
-	case 0x1B0: case 0x1B2: case 0x1B4: case 0x1B6: case 0x1B8: case 0x1BA:
-	case 0x1BC: case 0x1BE:
-		COLOR_WRITE (hpos, value & 0xFFF, (addr & 0x3E) / 2);
-		break;
-	case 0x120: case 0x124: case 0x128: case 0x12C:
-	case 0x130: case 0x134: case 0x138: case 0x13C:
-		SPRxPTH (hpos, value, (addr - 0x120) / 4);
-		break;
-	case 0x122: case 0x126: case 0x12A: case 0x12E:
-	case 0x132: case 0x136: case 0x13A: case 0x13E:
-		SPRxPTL (hpos, value, (addr - 0x122) / 4);
-		break;
-	case 0x140: case 0x148: case 0x150: case 0x158:
-	case 0x160: case 0x168: case 0x170: case 0x178:
-		SPRxPOS (hpos, value, (addr - 0x140) / 8);
-		break;
-	case 0x142: case 0x14A: case 0x152: case 0x15A:
-	case 0x162: case 0x16A: case 0x172: case 0x17A:
-		SPRxCTL (hpos, value, (addr - 0x142) / 8);
-		break;
-	case 0x144: case 0x14C: case 0x154: case 0x15C:
-	case 0x164: case 0x16C: case 0x174: case 0x17C:
-		SPRxDATA (hpos, value, (addr - 0x144) / 8);
-		break;
-	case 0x146: case 0x14E: case 0x156: case 0x15E:
-	case 0x166: case 0x16E: case 0x176: case 0x17E:
-		SPRxDATB (hpos, value, (addr - 0x146) / 8);
-		break;
+#define CUSTOMW_BENCH_LOOPS 1000000
 
-	case 0x36: JOYTEST (value); break;
-	case 0x5A: BLTCON0L (hpos, value); break;
-	case 0x5C: BLTSIZV (hpos, value); break;
-	case 0x5E: BLTSIZH (hpos, value); break;
-	case 0x1E4: DIWHIGH (hpos, value); break;
-#ifdef AGA
-	case 0x10C: BPLCON4 (hpos, value); break;
+/* Measure register writes per second through the CPU and the copper
+ * paths. Only registers are written that ignore a write of their
+ * current value. The caller keeps the debugger's memwatch points out
+ * of the copper loop. The bus value and the Action Replay copy of the
+ * registers are put back afterwards, the chipset state is left as it
+ * was. */
+void custom_wput_benchmark (uae_u32 *cpurate, uae_u32 *copperrate)
+{
+	static const uae_u16 regs[] = { 0x108, 0x10A, 0x1FE };
+	uae_u16 vals[3];
+	uae_u16 old_value1 = last_custom_value1;
+#ifdef ACTION_REPLAY
+#ifdef ACTION_REPLAY_COMMON
+	uae_u8 old_ar[3][2];
+#endif
 #endif
+	int hpos = current_hpos ();
+	frame_time_t t;
+	int i;
 
-#ifndef CUSTOM_SIMPLE
-	case 0x1DC: BEAMCON0 (value); break;
-#ifdef ECS_DENISE
-	case 0x1C0: if (htotal != value) { htotal = value; varsync (); } break;
-	case 0x1C2: if (hsstop != value) { hsstop = value; varsync (); } break;
-	case 0x1C4: if (hbstrt != value) { hbstrt = value; varsync (); } break;
-	case 0x1C6: if (hbstop != value) { hbstop = value; varsync (); } break;
-	case 0x1C8: if (vtotal != value) { vtotal = value; varsync (); } break;
-	case 0x1CA: if (vsstop != value) { vsstop = value; varsync (); } break;
-	case 0x1CC: if (vbstrt < value || vbstrt > value + 1) { vbstrt = value; varsync (); } break;
-	case 0x1CE: if (vbstop < value || vbstop > value + 1) { vbstop = value; varsync (); } break;
-	case 0x1DE: if (hsstrt != value) { hsstrt = value; varsync (); } break;
-	case 0x1E0: if (vsstrt != value) { vsstrt = value; varsync (); } break;
-	case 0x1E2: if (hcenter != value) { hcenter = value; varsync (); } break;
+	vals[0] = bpl1mod;
+	vals[1] = bpl2mod;
+	vals[2] = 0;
+#ifdef ACTION_REPLAY
+#ifdef ACTION_REPLAY_COMMON
+	for (i = 0; i < 3; i++)
+		memcpy (old_ar[i], ar_custom + regs[i], 2);
 #endif
 #endif
 
-#ifdef AGA
-	case 0x1FC: FMODE (hpos, value); break;
-#endif
-	case 0x1FE: FNULL (value); break;
+	t = uae_gethrtime ();
+	for (i = 0; i < CUSTOMW_BENCH_LOOPS; i++)
+		custom_wput (0xdff000 + regs[i % 3], vals[i % 3]);
+	t = uae_gethrtime () - t;
+	*cpurate = (uae_u32)(CUSTOMW_BENCH_LOOPS * (double)syncbase / (t ? t : 1));
 
-		/* writing to read-only register causes read access */
-	default:
-		if (!noget) {
-#if CUSTOM_DEBUG > 0
-			write_log ("%04X written %08x\n", addr, M68K_GETPC);
+	t = uae_gethrtime ();
+	for (i = 0; i < CUSTOMW_BENCH_LOOPS; i++)
+		custom_wput_copper (hpos, regs[i % 3], vals[i % 3], 0);
+	t = uae_gethrtime () - t;
+	*copperrate = (uae_u32)(CUSTOMW_BENCH_LOOPS * (double)syncbase / (t ? t : 1));
+
+	last_custom_value1 = old_value1;
+#ifdef ACTION_REPLAY
+#ifdef ACTION_REPLAY_COMMON
+	for (i = 0; i < 3; i++)
+		memcpy (ar_custom + regs[i], old_ar[i], 2);
+#endif
 #endif
-			custom_wget_1 (hpos, addr, 1);
-		}
-		return 1;
-	}
-	return 0;
 }
 
 void REGPARAM2 custom_wput (uaecptr addr, uae_u32 value)
@@ -7200,6 +7392,127 @@ uae_u8 *restore_cycles (uae_u8 *src)
 	return src;
 }
 
+/* Run-ahead saves at the first instruction after vsync. Registers and
+ * beam, copper, sprite and event state are copied as they are, the
+ * line drawing state is started again by restore_custom_runahead_finish. */
+const struct runahead_var custom_runahead_vars[] = {
+	RUNAHEAD_VAR (eventtab),
+	RUNAHEAD_VAR (eventtab2),
+	RUNAHEAD_VAR (currcycle),
+	RUNAHEAD_VAR (nextevent),
+	RUNAHEAD_VAR (is_lastline),
+	RUNAHEAD_VAR (event_cycles),
+	RUNAHEAD_VAR (extra_cycle),
+	RUNAHEAD_VAR (vsync_cycles),
+	RUNAHEAD_VAR (vpos),
+	RUNAHEAD_VAR (vpos_count),
+	RUNAHEAD_VAR (vpos_count_prev),
+	RUNAHEAD_VAR (lof_store),
+	RUNAHEAD_VAR (lof_current),
+	RUNAHEAD_VAR (lof_changed),
+	RUNAHEAD_VAR (lol),
+	RUNAHEAD_VAR (next_lineno),
+	RUNAHEAD_VAR (prev_lineno),
+	RUNAHEAD_VAR (nextline_how),
+	RUNAHEAD_VAR (vpos_lpen),
+	RUNAHEAD_VAR (hpos_lpen),
+	RUNAHEAD_VAR (lightpen_triggered),
+	RUNAHEAD_VAR (intena),
+	RUNAHEAD_VAR (intreq),
+	RUNAHEAD_VAR (intena_internal),
+	RUNAHEAD_VAR (intreq_internal),
+	RUNAHEAD_VAR (irq_nmi),
+	RUNAHEAD_VAR (dmacon),
+	RUNAHEAD_VAR (dmal),
+	RUNAHEAD_VAR (dmal_hpos),
+	RUNAHEAD_VAR (adkcon),
+	RUNAHEAD_VAR (cop1lc),
+	RUNAHEAD_VAR (cop2lc),
+	RUNAHEAD_VAR (copcon),
+	RUNAHEAD_VAR (cop_state),
+	RUNAHEAD_VAR (copper_enabled_thisline),
+	RUNAHEAD_VAR (last_copper_hpos),
+	RUNAHEAD_VAR (copper_access),
+	RUNAHEAD_VAR (fmode),
+	RUNAHEAD_VAR (beamcon0),
+	RUNAHEAD_VAR (new_beamcon0),
+	RUNAHEAD_VAR (vtotal),
+	RUNAHEAD_VAR (htotal),
+	RUNAHEAD_VAR (hsstop),
+	RUNAHEAD_VAR (hbstrt),
+	RUNAHEAD_VAR (hbstop),
+	RUNAHEAD_VAR (vsstop),
+	RUNAHEAD_VAR (vbstrt),
+	RUNAHEAD_VAR (vbstop),
+	RUNAHEAD_VAR (hsstrt),
+	RUNAHEAD_VAR (vsstrt),
+	RUNAHEAD_VAR (hcenter),
+	RUNAHEAD_VAR (diwstrt),
+	RUNAHEAD_VAR (diwstop),
+	RUNAHEAD_VAR (diwhigh),
+	RUNAHEAD_VAR (diwhigh_written),
+	RUNAHEAD_VAR (diw_change),
+	RUNAHEAD_VAR (ddfstrt),
+	RUNAHEAD_VAR (ddfstop),
+	RUNAHEAD_VAR (ddf_change),
+	RUNAHEAD_VAR (badmode),
+	RUNAHEAD_VAR (diwstate),
+	RUNAHEAD_VAR (hdiwstate),
+	RUNAHEAD_VAR (ddfstate),
+	RUNAHEAD_VAR (plf_state),
+	RUNAHEAD_VAR (first_bpl_vpos),
+	RUNAHEAD_VAR (bplcon0),
+	RUNAHEAD_VAR (bplcon1),
+	RUNAHEAD_VAR (bplcon2),
+	RUNAHEAD_VAR (bplcon3),
+	RUNAHEAD_VAR (bplcon4),
+	RUNAHEAD_VAR (bplcon0d),
+	RUNAHEAD_VAR (bplcon0dd),
+	RUNAHEAD_VAR (bplcon0_res),
+	RUNAHEAD_VAR (bplcon0_planes),
+	RUNAHEAD_VAR (bplcon0_planes_limit),
+	RUNAHEAD_VAR (bpl1mod),
+	RUNAHEAD_VAR (bpl2mod),
+	RUNAHEAD_VAR (bplpt),
+	RUNAHEAD_VAR (bplptx),
+	RUNAHEAD_VAR (bplxdat),
+	RUNAHEAD_VAR (current_colors),
+	RUNAHEAD_VAR (clxdat),
+	RUNAHEAD_VAR (clxcon),
+	RUNAHEAD_VAR (clxcon2),
+	RUNAHEAD_VAR (clxcon_bpl_enable),
+	RUNAHEAD_VAR (clxcon_bpl_match),
+	RUNAHEAD_VAR (spr),
+	RUNAHEAD_VAR (sprctl),
+	RUNAHEAD_VAR (sprpos),
+	RUNAHEAD_VAR (sprdata),
+	RUNAHEAD_VAR (sprdatb),
+	RUNAHEAD_VAR (nr_armed),
+	RUNAHEAD_VAR (last_custom_value1),
+	{ NULL, 0 }
+};
+
+void restore_custom_runahead_finish (void)
+{
+	/* the frames run ahead may have switched PAL/NTSC or the
+	 * programmed beam counters, the frame length is not saved */
+	if (hz_beamcon0 != beamcon0 || ((beamcon0 & 0x80) && (hz_vtotal != vtotal || hz_htotal != htotal))) {
+		uae_u16 pending = new_beamcon0;
+		evt hsync = eventtab[ev_hsync].evtime, oldcycles = eventtab[ev_hsync].oldcycles;
+		new_beamcon0 = beamcon0;
+		init_hz ();
+		new_beamcon0 = pending;
+		eventtab[ev_hsync].evtime = hsync;
+		eventtab[ev_hsync].oldcycles = oldcycles;
+		events_schedule ();
+	}
+	reset_decisions ();
+	setup_fmodes (0);
+	calcdiw ();
+	sprres = expand_sprres (bplcon0, bplcon3);
+	sprite_width = GET_SPRITEWIDTH (fmode);
+}
+
 #endif /* SAVESTATE */
 
 void check_prefs_changed_custom (void)
@@ -7229,6 +7542,12 @@ void check_prefs_changed_custom (void)
 	currprefs.cs_mbdmac = changed_prefs.cs_mbdmac;
 	currprefs.cs_df0idhw = changed_prefs.cs_df0idhw;
 	currprefs.cs_slowmemisfast = changed_prefs.cs_slowmemisfast;
+#ifdef SAVESTATE
+	if (currprefs.runahead != changed_prefs.runahead) {
+		savestate_runahead_stop ();
+		currprefs.runahead = changed_prefs.runahead;
+	}
+#endif
 
 	if (currprefs.chipset_mask != changed_prefs.chipset_mask ||
 		currprefs.picasso96_nocustom != changed_prefs.picasso96_nocustom ||
@@ -7241,6 +7560,14 @@ void check_prefs_changed_custom (void)
 			}
 			init_custom ();
 	}
+#ifdef RECORDER
+	if (_tcscmp (currprefs.record_file, changed_prefs.record_file)
+		|| currprefs.record_codec != changed_prefs.record_codec) {
+		_tcscpy (currprefs.record_file, changed_prefs.record_file);
+		currprefs.record_codec = changed_prefs.record_codec;
+		recorder_setup ();
+	}
+#endif
 #ifdef GFXFILTER
 	currprefs.gfx_filter_horiz_zoom = changed_prefs.gfx_filter_horiz_zoom;
 	currprefs.gfx_filter_vert_zoom = changed_prefs.gfx_filter_vert_zoom;
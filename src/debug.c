@@ -35,6 +35,8 @@
 #include "cpummu.h"
 #include "rommgr.h"
 #include "inputrecord.h"
+#include "hostprof.h"
+#include "recorder.h"
 
 int debugger_active;
 static uaecptr skipaddr_start, skipaddr_end;
@@ -120,6 +122,7 @@ static const TCHAR help[] = {
 	"  fs <val> <mask>       Break when (SR & mask) = val\n"                   
 	"  f <addr1> <addr2>     Step forward until <addr1> <= PC <= <addr2>\n"
 	"  e                     Dump contents of all custom registers, ea = AGA colors\n"
+	"  eb                    Benchmark custom register writes\n"
 	"  i [<addr>]            Dump contents of interrupt and trap vectors\n"
 	"  il [<mask>]           Exception breakpoint\n"
 	"  o <0-2|addr> [<lines>]View memory as Copper instructions\n"
@@ -151,6 +154,23 @@ static const TCHAR help[] = {
 	"  dj [<level bitmask>]  Enable joystick/mouse input debugging\n"
 	"  smc [<0-1>]           Enable self-modifying code detector. 1 = enable break.\n"
 	"  dm                    Dump current address space map\n"
+	"  dh                    Show hardfile block cache statistics\n"
+#ifdef RECORDER
+	"  dr                    Show video/audio recorder statistics\n"
+#endif
+	"  U <address>           Show MMU translation of <address>\n"
+	"  U                     Show and reset MMU ATC statistics\n"
+#ifdef JIT
+	"  j [<lines>]           Show JIT block statistics and interpreter fallbacks\n"
+	"  je [<0-1>]            Enable/disable JIT profiling, jr = reset counters\n"
+#endif
+	"  ps [<lines>] [c]      Start sampling profiler, one sample every <lines> scanlines\n"
+	"                        c = also record call stacks (A5 LINK frames)\n"
+	"  p[t] [<n>]            Show top <n> PCs and LoadSeg hunks, pe = stop, pr = reset\n"
+	"  pf <file>             Write call stacks in folded format (flamegraph.pl)\n"
+#ifdef HOSTPROF
+	"  ph [<frames>]         Show host time per emulator subsystem, last <frames> frames\n"
+#endif
 	"  v <vpos> [<hpos>]     Show DMA data (accurate only in cycle-exact mode)\n"
 	"                        v [-1 to -4] = enable visual DMA debugger\n"
 	"  ?<value>              Hex/Bin/Dec converter\n"
@@ -188,6 +208,20 @@ static int debug_out (const TCHAR *format, ...)
 	return 1;
 }
 
+#ifdef JIT
+/* the JIT profile report goes to the debugger console */
+static void jit_profile_out (const TCHAR *format, ...)
+{
+	va_list parms;
+	TCHAR buffer[1000];
+
+	va_start (parms, format);
+	_vsntprintf (buffer, 1000 - 1, format, parms);
+	va_end (parms);
+	console_out (buffer);
+}
+#endif
+
 static void ignore_ws (TCHAR **c)
 {
 	while (**c && _istspace(**c))
@@ -1465,6 +1499,41 @@ static addrbank *debug_mem_area;
 struct memwatch_node mwnodes[MEMWATCH_TOTAL];
 static struct memwatch_node mwhit;
 
+/* One bit per 4K page that has a memwatch point. Accesses to other pages
+ * skip the node list, and banks without watched pages keep their own
+ * handlers (see memwatch_setup). */
+#define MEMWATCH_PAGE_SHIFT 12
+#define MEMWATCH_PAGES (1 << (32 - MEMWATCH_PAGE_SHIFT))
+static uae_u32 *memwatch_pages;
+
+STATIC_INLINE int memwatch_page_hit (uaecptr addr, int size)
+{
+	uae_u32 p1 = addr >> MEMWATCH_PAGE_SHIFT;
+	uae_u32 p2 = (addr + size - 1) >> MEMWATCH_PAGE_SHIFT;
+	return ((memwatch_pages[p1 >> 5] >> (p1 & 31)) & 1) || ((memwatch_pages[p2 >> 5] >> (p2 & 31)) & 1);
+}
+
+/* Instruction breakpoints are looked up through a small hash of the PC,
+ * bpnodes is only scanned when the hash slot is in use. */
+#define BPHASH_SIZE 1024
+#define BPHASH(pc) ((((pc) >> 1) ^ ((pc) >> 11)) & (BPHASH_SIZE - 1))
+static uae_u8 bphash[BPHASH_SIZE];
+static int bpcount;
+
+static void breakpoint_hash_update (void)
+{
+	int i;
+
+	memset (bphash, 0, sizeof bphash);
+	bpcount = 0;
+	for (i = 0; i < BREAKPOINT_TOTAL; i++) {
+		if (!bpnodes[i].enabled)
+			continue;
+		bphash[BPHASH (bpnodes[i].addr)] = 1;
+		bpcount++;
+	}
+}
+
 static uae_u8 *illgdebug, *illghdebug;
 static int illgdebug_break;
 
@@ -1606,6 +1675,7 @@ static void smc_free (void)
 }
 
 static void initialize_memwatch (int mode);
+static void memwatch_setup (void);
 static void smc_detect_init (TCHAR **c)
 {
 	int v, i;
@@ -1626,6 +1696,8 @@ static void smc_detect_init (TCHAR **c)
 	}
 	if (!memwatch_enabled)
 		initialize_memwatch (0);
+	else
+		memwatch_setup ();
 	if (v)
 		smc_mode = 1;
 	console_out_f ("SMCD enabled. Break=%d\n", smc_mode);
@@ -1756,6 +1828,8 @@ void restore_debug_memwatch_finish (void)
 		if (m->size) {
 			if (!memwatch_enabled)
 				initialize_memwatch (0);
+			else
+				memwatch_setup ();
 			return;
 		}
 	}
@@ -1771,6 +1845,8 @@ static int memwatch_func (uaecptr addr, int rwi, int size, uae_u32 *valp)
 	addr = munge24 (addr);
 	if (smc_table && (rwi >= 2))
 		smc_detector (addr, rwi, size, valp);
+	if (!memwatch_page_hit (addr, size))
+		return 1;
 	for (i = 0; i < MEMWATCH_TOTAL; i++) {
 		struct memwatch_node *m = &mwnodes[i];
 		uaecptr addr2 = m->addr;
@@ -2085,6 +2161,73 @@ struct membank_store
 
 static struct membank_store *membank_stores;
 
+/* Route all accesses to a bank through the debugger handlers, or give
+ * it back its own handlers. */
+static void memwatch_hook (struct membank_store *ms, int on)
+{
+	addrbank *a = ms->addr;
+
+	if (!on) {
+		memcpy (a, &ms->store, sizeof (addrbank));
+		return;
+	}
+	a->bget = mmu_enabled ? mmu_bget : debug_bget;
+	a->wget = mmu_enabled ? mmu_wget : debug_wget;
+	a->lget = mmu_enabled ? mmu_lget : debug_lget;
+	a->bput = mmu_enabled ? mmu_bput : debug_bput;
+	a->wput = mmu_enabled ? mmu_wput : debug_wput;
+	a->lput = mmu_enabled ? mmu_lput : debug_lput;
+	a->check = debug_check;
+	a->xlateaddr = debug_xlate;
+	a->wgeti = mmu_enabled ? mmu_wgeti : debug_wgeti;
+	a->lgeti = mmu_enabled ? mmu_lgeti : debug_lgeti;
+}
+
+/* Rebuild the watched page map after memwatch points changed and hook
+ * only the banks that contain a watched page. Illegal access logging
+ * and the SMC detector need to see every access. */
+static void memwatch_setup (void)
+{
+	int i, j, as, all;
+	addrbank *oa;
+
+	if (!memwatch_enabled || !memwatch_pages)
+		return;
+	memset (memwatch_pages, 0, MEMWATCH_PAGES / 8);
+	for (i = 0; i < MEMWATCH_TOTAL; i++) {
+		struct memwatch_node *m = &mwnodes[i];
+		uae_u32 p, last;
+
+		if (m->size <= 0)
+			continue;
+		last = m->addr + m->size - 1;
+		if (last < m->addr)
+			last = 0xffffffff;
+		for (p = m->addr >> MEMWATCH_PAGE_SHIFT; p <= (last >> MEMWATCH_PAGE_SHIFT); p++)
+			memwatch_pages[p >> 5] |= 1 << (p & 31);
+	}
+
+	all = illgdebug != NULL || smc_table != NULL;
+	for (j = 0; membank_stores[j].addr; j++)
+		memwatch_hook (&membank_stores[j], all);
+	if (all)
+		return;
+	as = currprefs.address_space_24 ? 256 : 65536;
+	oa = NULL;
+	for (i = 0; i < as; i++) {
+		/* 16 pages per 64K bank */
+		if (!((memwatch_pages[i >> 1] >> ((i & 1) * 16)) & 0xffff))
+			continue;
+		if (mem_banks[i] == oa)
+			continue;
+		oa = mem_banks[i];
+		for (j = 0; membank_stores[j].addr; j++) {
+			if (membank_stores[j].addr == oa)
+				memwatch_hook (&membank_stores[j], 1);
+		}
+	}
+}
+
 static int deinitialize_memwatch (void)
 {
 	int i, oldmode;
@@ -2101,10 +2244,13 @@ static int deinitialize_memwatch (void)
 	debug_mem_area = NULL;
 	xfree (membank_stores);
 	membank_stores = NULL;
+	xfree (memwatch_pages);
+	memwatch_pages = NULL;
 	memwatch_enabled = 0;
 	mmu_enabled = 0;
 	xfree (illgdebug);
 	illgdebug = 0;
+	mmu_enable_host_cache (true);
 	return oldmode;
 }
 
@@ -2135,23 +2281,16 @@ static void initialize_memwatch (int mode)
 		}
 		memcpy (a1, a2, sizeof (addrbank));
 	}
-	for (i = 0; i < as; i++) {
-		a2 = mem_banks[i];
-		a2->bget = mode ? mmu_bget : debug_bget;
-		a2->wget = mode ? mmu_wget : debug_wget;
-		a2->lget = mode ? mmu_lget : debug_lget;
-		a2->bput = mode ? mmu_bput : debug_bput;
-		a2->wput = mode ? mmu_wput : debug_wput;
-		a2->lput = mode ? mmu_lput : debug_lput;
-		a2->check = debug_check;
-		a2->xlateaddr = debug_xlate;
-		a2->wgeti = mode ? mmu_wgeti : debug_wgeti;
-		a2->lgeti = mode ? mmu_lgeti : debug_lgeti;
-	}
-	if (mode)
+	if (mode) {
 		mmu_enabled = 1;
-	else
+		for (i = 0; membank_stores[i].addr; i++)
+			memwatch_hook (&membank_stores[i], 1);
+	} else {
+		memwatch_pages = xcalloc (uae_u32, MEMWATCH_PAGES / 32);
 		memwatch_enabled = 1;
+		memwatch_setup ();
+	}
+	mmu_enable_host_cache (false);
 }
 
 int debug_bankchange (int mode)
@@ -2271,6 +2410,7 @@ static void memwatch (TCHAR **c)
 				illgdebug_break = 1;
 			console_out_f ("Illegal memory access logging enabled. Break=%d\n", illgdebug_break);
 		}
+		memwatch_setup ();
 		return;
 	}
 	*c = cp;
@@ -2281,6 +2421,7 @@ static void memwatch (TCHAR **c)
 	mwn->size = 0;
 	ignore_ws (c);
 	if (!more_params (c)) {
+		memwatch_setup ();
 		console_out_f ("Memwatch %d removed\n", num);
 		return;
 	}
@@ -2329,6 +2470,7 @@ static void memwatch (TCHAR **c)
 	}
 	if (mwn->frozen && mwn->rwi == 0)
 		mwn->rwi = 3;
+	memwatch_setup ();
 	memwatch_dump (num);
 }
 
@@ -2509,6 +2651,520 @@ static void show_exec_tasks (void)
 	}
 }
 
+/* Safe reads for code that runs outside the debugger (profiler):
+ * only touch RAM or ROM, never I/O registers. */
+static int debug_peek_long (uaecptr addr, uae_u32 *v)
+{
+	addrbank *b = &get_mem_bank (addr);
+
+	if ((addr & 1) || !b->check (addr, 4) || !(b->flags & (ABFLAG_RAM | ABFLAG_ROM)))
+		return 0;
+	*v = get_long (addr);
+	return 1;
+}
+
+static void debug_peek_string (uaecptr addr, int bstr, TCHAR *out, int maxlen)
+{
+	addrbank *b = &get_mem_bank (addr);
+	int i, len = maxlen - 1;
+
+	out[0] = 0;
+	if (!b->check (addr, 1) || !(b->flags & (ABFLAG_RAM | ABFLAG_ROM)))
+		return;
+	if (bstr) {
+		len = get_byte (addr++);
+		if (len > maxlen - 1)
+			len = maxlen - 1;
+	}
+	for (i = 0; i < len; i++) {
+		out[i] = get_byte (addr + i);
+		if (!out[i])
+			break;
+	}
+	out[i] = 0;
+}
+
+/* Seglist of process task and its CLI command name (BSTR) or 0 */
+static uaecptr debug_task_seglist (uaecptr task, uaecptr *command)
+{
+	uae_u32 v, cli, seglist;
+
+	*command = 0;
+	if (!debug_peek_long (task + 8, &v) || (v >> 24) != 13)
+		return 0;
+	if (!debug_peek_long (task + 172, &cli))
+		return 0;
+	if (cli) {
+		if (!debug_peek_long (BPTR2APTR (cli) + 16, command))
+			*command = 0;
+		*command = BPTR2APTR (*command);
+		if (!debug_peek_long (BPTR2APTR (cli) + 60, &seglist))
+			return 0;
+	} else {
+		if (!debug_peek_long (task + 128, &seglist) || !debug_peek_long (BPTR2APTR (seglist) + 12, &seglist))
+			return 0;
+	}
+	return BPTR2APTR (seglist);
+}
+
+/* Sampling profiler.
+ * Every debug_profile scanlines the hsync handler records the PC and,
+ * if enabled, the return addresses found by following the A5 LINK
+ * frame chain. PCs are resolved to LoadSeg hunks of the running
+ * process the first time they are seen. */
+
+#define PROFILE_DEPTH 16
+#define PROFILE_SEGS 512
+#define PROFILE_STACKRANGE 0x10000
+
+struct profile_seg
+{
+	TCHAR name[48];
+	int hunk;
+	uaecptr start, end;
+	uae_u32 samples;
+};
+
+struct profile_pc
+{
+	uaecptr pc;
+	uae_u32 samples;
+	int seg;
+	int used;
+};
+
+struct profile_stack
+{
+	uae_u32 hash;
+	uae_u32 samples;
+	int depth;
+	uaecptr pcs[PROFILE_DEPTH];
+};
+
+int debug_profile;
+static int profile_countdown, profile_stacks;
+static uae_u32 profile_samples, profile_lost;
+static struct profile_seg profile_segs[PROFILE_SEGS];
+static int profile_segcnt;
+static struct profile_pc *profile_pcs;
+static int profile_pcsize, profile_pcused;
+static struct profile_stack *profile_stk;
+static int profile_stksize, profile_stkused;
+
+#define PROFILE_HASH(v) ((uae_u32)(v) * 2654435761u)
+
+static int profile_findseg (uaecptr pc)
+{
+	int i;
+
+	for (i = 0; i < profile_segcnt; i++) {
+		if (pc >= profile_segs[i].start && pc < profile_segs[i].end)
+			return i;
+	}
+	return -1;
+}
+
+static int profile_addseg (const TCHAR *name, int hunk, uaecptr start, uaecptr end)
+{
+	struct profile_seg *s;
+
+	if (profile_segcnt >= PROFILE_SEGS)
+		return -1;
+	s = &profile_segs[profile_segcnt];
+	snprintf (s->name, sizeof s->name, "%s", name);
+	s->hunk = hunk;
+	s->start = start;
+	s->end = end;
+	s->samples = 0;
+	return profile_segcnt++;
+}
+
+/* find the hunk of the running process that contains pc */
+static int profile_resolve (uaecptr pc)
+{
+	uae_u32 execbase, task, seglist, size, name;
+	uaecptr command;
+	TCHAR tname[48];
+	int seg, hunk;
+
+	seg = profile_findseg (pc);
+	if (seg >= 0)
+		return seg;
+	if (pc >= 0xf80000 && pc < 0x1000000)
+		return profile_addseg ("ROM", -1, 0xf80000, 0x1000000);
+	if (!debug_peek_long (4, &execbase) || !debug_peek_long (execbase + 276, &task) || !task)
+		return -1;
+	seglist = debug_task_seglist (task, &command);
+	for (hunk = 0; seglist && hunk < 1000; hunk++) {
+		if (!debug_peek_long (seglist - 4, &size))
+			break;
+		if (pc >= seglist + 4 && pc < seglist + size - 4) {
+			if (command)
+				debug_peek_string (command, 1, tname, sizeof tname / sizeof (TCHAR));
+			else
+				tname[0] = 0;
+			if (!tname[0] && debug_peek_long (task + 10, &name))
+				debug_peek_string (name, 0, tname, sizeof tname / sizeof (TCHAR));
+			return profile_addseg (tname[0] ? tname : "?", hunk, seglist + 4, seglist + size - 4);
+		}
+		if (!debug_peek_long (seglist, &seglist))
+			break;
+		seglist = BPTR2APTR (seglist);
+	}
+	return -1;
+}
+
+static void *profile_grow (int *size, int entsize)
+{
+	int newsize = *size ? *size * 2 : 4096;
+	void *t = xcalloc (uae_u8, newsize * entsize);
+
+	if (!t)
+		return NULL;
+	*size = newsize;
+	return t;
+}
+
+static struct profile_pc *profile_getpc (uaecptr pc)
+{
+	struct profile_pc *p;
+	uae_u32 i;
+
+	if (profile_pcused * 2 >= profile_pcsize) {
+		struct profile_pc *old = profile_pcs;
+		int j, oldsize = profile_pcsize;
+		struct profile_pc *t = (struct profile_pc*)profile_grow (&profile_pcsize, sizeof (struct profile_pc));
+		if (!t)
+			return NULL;
+		for (j = 0; j < oldsize; j++) {
+			if (!old[j].used)
+				continue;
+			i = PROFILE_HASH (old[j].pc);
+			while (t[i & (profile_pcsize - 1)].used)
+				i++;
+			t[i & (profile_pcsize - 1)] = old[j];
+		}
+		xfree (old);
+		profile_pcs = t;
+	}
+	i = PROFILE_HASH (pc);
+	for (;;) {
+		p = &profile_pcs[i & (profile_pcsize - 1)];
+		if (!p->used)
+			break;
+		if (p->pc == pc)
+			return p;
+		i++;
+	}
+	p->used = 1;
+	p->pc = pc;
+	p->samples = 0;
+	p->seg = profile_resolve (pc);
+	profile_pcused++;
+	return p;
+}
+
+static void profile_addstack (const uaecptr *pcs, int depth)
+{
+	struct profile_stack *s;
+	uae_u32 hash = depth, i;
+	int j;
+
+	for (j = 0; j < depth; j++)
+		hash = PROFILE_HASH (hash ^ pcs[j]);
+	if (profile_stkused * 2 >= profile_stksize) {
+		struct profile_stack *old = profile_stk;
+		int oldsize = profile_stksize;
+		struct profile_stack *t = (struct profile_stack*)profile_grow (&profile_stksize, sizeof (struct profile_stack));
+		if (!t) {
+			profile_lost++;
+			return;
+		}
+		for (j = 0; j < oldsize; j++) {
+			if (!old[j].samples)
+				continue;
+			i = old[j].hash;
+			while (t[i & (profile_stksize - 1)].samples)
+				i++;
+			t[i & (profile_stksize - 1)] = old[j];
+		}
+		xfree (old);
+		profile_stk = t;
+	}
+	for (i = hash;; i++) {
+		s = &profile_stk[i & (profile_stksize - 1)];
+		if (!s->samples)
+			break;
+		if (s->hash == hash && s->depth == depth && !memcmp (s->pcs, pcs, depth * sizeof (uaecptr))) {
+			s->samples++;
+			return;
+		}
+	}
+	s->hash = hash;
+	s->depth = depth;
+	memcpy (s->pcs, pcs, depth * sizeof (uaecptr));
+	s->samples = 1;
+	profile_stkused++;
+}
+
+/* called from the hsync handler */
+void debug_profile_sample (void)
+{
+	uaecptr pcs[PROFILE_DEPTH];
+	struct profile_pc *p;
+	int depth = 1;
+
+	if (--profile_countdown > 0)
+		return;
+	profile_countdown = debug_profile;
+	pcs[0] = munge24 (m68k_getpc ());
+	p = profile_getpc (pcs[0]);
+	if (!p) {
+		profile_lost++;
+		return;
+	}
+	p->samples++;
+	if (p->seg >= 0)
+		profile_segs[p->seg].samples++;
+	profile_samples++;
+	if (!profile_stacks)
+		return;
+	{
+		uae_u32 sp = m68k_areg (regs, 7), fp = m68k_areg (regs, 5), next, ret;
+		while (depth < PROFILE_DEPTH && fp >= sp && fp < sp + PROFILE_STACKRANGE) {
+			if (!debug_peek_long (fp, &next) || !debug_peek_long (fp + 4, &ret))
+				break;
+			pcs[depth++] = ret;
+			/* make sure return addresses get resolved while their process runs */
+			profile_getpc (ret);
+			if (next <= fp)
+				break;
+			fp = next;
+		}
+	}
+	profile_addstack (pcs, depth);
+}
+
+static void profile_reset (void)
+{
+	xfree (profile_pcs);
+	xfree (profile_stk);
+	profile_pcs = NULL;
+	profile_stk = NULL;
+	profile_pcsize = profile_pcused = 0;
+	profile_stksize = profile_stkused = 0;
+	profile_segcnt = 0;
+	profile_samples = profile_lost = 0;
+}
+
+static void profile_start (int lines, int stacks)
+{
+	profile_reset ();
+	profile_stacks = stacks;
+	profile_countdown = lines;
+	debug_profile = lines;
+	console_out_f ("Profiler started, sampling every %d line%s%s\n", lines, lines > 1 ? "s" : "",
+		stacks ? ", with call stacks" : "");
+}
+
+/* out must have room for a segment name and 20 more characters */
+static void profile_pcname (uaecptr pc, TCHAR *out)
+{
+	int seg = profile_findseg (pc);
+
+	if (seg < 0)
+		_stprintf (out, "%08X", pc);
+	else if (profile_segs[seg].hunk < 0)
+		_stprintf (out, "%s+%X", profile_segs[seg].name, pc - profile_segs[seg].start);
+	else
+		_stprintf (out, "%s:%d+%X", profile_segs[seg].name, profile_segs[seg].hunk, pc - profile_segs[seg].start);
+}
+
+static int profile_pccmp (const void *a, const void *b)
+{
+	uae_u32 sa = (*(const struct profile_pc**)a)->samples, sb = (*(const struct profile_pc**)b)->samples;
+	return sa < sb ? 1 : (sa > sb ? -1 : 0);
+}
+
+static int profile_segcmp (const void *a, const void *b)
+{
+	uae_u32 sa = (*(const struct profile_seg**)a)->samples, sb = (*(const struct profile_seg**)b)->samples;
+	return sa < sb ? 1 : (sa > sb ? -1 : 0);
+}
+
+static void profile_report (int top)
+{
+	struct profile_pc **pcs;
+	struct profile_seg *segs[PROFILE_SEGS];
+	TCHAR name[80];
+	uae_u32 other = profile_samples;
+	int i, n = 0;
+
+	console_out_f ("Profiler %s, %u samples", debug_profile ? "running" : "stopped", profile_samples);
+	if (profile_lost)
+		console_out_f (", %u lost", profile_lost);
+	console_out ("\n");
+	if (!profile_samples)
+		return;
+	pcs = xmalloc (struct profile_pc*, profile_pcused);
+	if (!pcs)
+		return;
+	for (i = 0; i < profile_pcsize; i++) {
+		if (profile_pcs[i].samples)
+			pcs[n++] = &profile_pcs[i];
+	}
+	qsort (pcs, n, sizeof (struct profile_pc*), profile_pccmp);
+	console_out (" Samples      %  PC\n");
+	for (i = 0; i < n && i < top; i++) {
+		profile_pcname (pcs[i]->pc, name);
+		console_out_f ("%8u %5.1f%%  %08X %s\n", pcs[i]->samples,
+			pcs[i]->samples * 100.0 / profile_samples, pcs[i]->pc, name);
+	}
+	xfree (pcs);
+
+	for (i = 0; i < profile_segcnt; i++) {
+		segs[i] = &profile_segs[i];
+		other -= segs[i]->samples;
+	}
+	qsort (segs, profile_segcnt, sizeof (struct profile_seg*), profile_segcmp);
+	console_out (" Samples      %  Segment\n");
+	for (i = 0; i < profile_segcnt && i < top && segs[i]->samples; i++) {
+		console_out_f ("%8u %5.1f%%  %08X-%08X %s", segs[i]->samples, segs[i]->samples * 100.0 / profile_samples,
+			segs[i]->start, segs[i]->end - 1, segs[i]->name);
+		if (segs[i]->hunk >= 0)
+			console_out_f (" hunk %d", segs[i]->hunk);
+		console_out ("\n");
+	}
+	if (other)
+		console_out_f ("%8u %5.1f%%  (no segment)\n", other, other * 100.0 / profile_samples);
+}
+
+/* one line per distinct stack, root first: "a;b;c <samples>" as used by flamegraph.pl */
+static void profile_folded (const TCHAR *file)
+{
+	TCHAR name[80];
+	FILE *f;
+	int i, j, lines = 0;
+
+	if (!profile_stkused) {
+		console_out ("No call stacks recorded, start the profiler with 'ps c'\n");
+		return;
+	}
+	f = _tfopen (file, "w");
+	if (!f) {
+		console_out_f ("Couldn't open file '%s'\n", file);
+		return;
+	}
+	for (i = 0; i < profile_stksize; i++) {
+		struct profile_stack *s = &profile_stk[i];
+		if (!s->samples)
+			continue;
+		for (j = s->depth - 1; j >= 0; j--) {
+			TCHAR *p;
+			profile_pcname (s->pcs[j], name);
+			for (p = name; *p; p++) {
+				if (*p == ';' || *p == ' ')
+					*p = '_';
+			}
+			fprintf (f, "%s%s", name, j ? ";" : "");
+		}
+		fprintf (f, " %u\n", s->samples);
+		lines++;
+	}
+	fclose (f);
+	console_out_f ("%d stacks written to '%s'\n", lines, file);
+}
+
+#ifdef HOSTPROF
+/* averages of the host instrumentation frame ring */
+static void hostprof_show (int num)
+{
+	uae_u64 time[HP_MAX] = { 0 }, count[HPC_MAX] = { 0 }, total = 0;
+	int i, n;
+
+	if (num > hostprof_frames ())
+		num = hostprof_frames ();
+	if (num <= 0) {
+		console_out ("No frames recorded\n");
+		return;
+	}
+	for (n = 0; n < num; n++) {
+		const struct hostprof_frame *f = hostprof_getframe (n);
+		total += f->total;
+		for (i = 0; i < HP_MAX; i++)
+			time[i] += f->time[i];
+		for (i = 0; i < HPC_MAX; i++)
+			count[i] += f->count[i];
+	}
+	console_out_f ("Last %d frames, %llu us per frame\n", num, (unsigned long long)(total / num));
+	for (i = 0; i < HP_MAX; i++) {
+		console_out_f ("  %-12s %8llu us %5.1f%%\n", hostprof_names[i], (unsigned long long)(time[i] / num),
+			total ? time[i] * 100.0 / total : 0.0);
+	}
+	for (i = 0; i < HPC_MAX; i++)
+		console_out_f ("  %-12s %8llu per frame\n", hostprof_counternames[i], (unsigned long long)(count[i] / num));
+}
+
+#endif
+
+#ifdef RECORDER
+static void recorder_show (void)
+{
+	struct recorder_stats st;
+
+	if (!recorder_active) {
+		console_out ("Recorder not running (record_file)\n");
+		return;
+	}
+	recorder_getstats (&st);
+	console_out_f ("Video frames %u, repeated %u, dropped %u\n", st.frames, st.repeats, st.frames_dropped);
+	console_out_f ("Audio blocks %u, dropped %u\n", st.audio_blocks, st.audio_dropped);
+	console_out_f ("Queue depth %d, max %d\n", st.queue_depth, st.queue_max);
+	console_out_f ("%llu bytes captured, %llu written\n", (unsigned long long)st.bytes_in, (unsigned long long)st.bytes_out);
+}
+#endif
+
+static void profile_cmd (TCHAR **c)
+{
+	TCHAR cmd = _totlower (**c);
+
+	if (cmd)
+		(*c)++;
+	if (cmd == 's') {
+		int lines = 1, stacks = 0;
+		while (more_params (c)) {
+			if (_totlower (**c) == 'c') {
+				stacks = 1;
+				(*c)++;
+			} else {
+				lines = readint (c);
+			}
+		}
+		profile_start (lines > 0 ? lines : 1, stacks);
+	} else if (cmd == 'e') {
+		debug_profile = 0;
+		console_out_f ("Profiler stopped, %u samples\n", profile_samples);
+	} else if (cmd == 'r') {
+		profile_reset ();
+		console_out ("Profiler counters reset\n");
+	} else if (cmd == 'f') {
+		TCHAR name[MAX_DPATH];
+		if (!more_params (c) || !next_string (c, name, MAX_DPATH, 0)) {
+			console_out ("pf <file>\n");
+			return;
+		}
+		profile_folded (name);
+	} else if (cmd == 't') {
+		profile_report (more_params (c) ? readint (c) : 20);
+#ifdef HOSTPROF
+	} else if (cmd == 'h') {
+		hostprof_show (more_params (c) ? readint (c) : 50);
+#endif
+	} else {
+		profile_report (20);
+	}
+}
+
 static uaecptr get_base (const uae_char *name)
 {
 	uaecptr v = get_long (4);
@@ -2687,6 +3343,7 @@ int instruction_breakpoint (TCHAR **c)
 		} else if (nc == 'D' && (*c)[1] == 0) {
 			for (i = 0; i < BREAKPOINT_TOTAL; i++)
 				bpnodes[i].enabled = 0;
+			breakpoint_hash_update ();
 			console_out ("All breakpoints removed\n");
 			return 0;
 		} else if (nc == 'L') {
@@ -2713,6 +3370,7 @@ int instruction_breakpoint (TCHAR **c)
 				bpn = &bpnodes[i];
 				if (bpn->enabled && bpn->addr == skipaddr_start) {
 					bpn->enabled = 0;
+					breakpoint_hash_update ();
 					console_out ("Breakpoint removed\n");
 					skipaddr_start = 0xffffffff;
 					skipaddr_doskip = 0;
@@ -2725,6 +3383,7 @@ int instruction_breakpoint (TCHAR **c)
 					continue;
 				bpn->addr = skipaddr_start;
 				bpn->enabled = 1;
+				breakpoint_hash_update ();
 				console_out ("Breakpoint added\n");
 				skipaddr_start = 0xffffffff;
 				skipaddr_doskip = 0;
@@ -3258,7 +3917,19 @@ static bool debug_line (TCHAR *input)
 			}
 			break;
 		}
-		case 'e': dump_custom_regs (tolower(*inptr) == 'a'); break;
+		case 'e':
+			if (*inptr == 'b') {
+				uae_u32 cpurate, copperrate;
+				int old_memwatch = memwatch_enabled;
+				/* the copper passes its writes to memwatch */
+				memwatch_enabled = 0;
+				custom_wput_benchmark (&cpurate, &copperrate);
+				memwatch_enabled = old_memwatch;
+				console_out_f ("Custom register writes/s: CPU %u, copper %u\n", cpurate, copperrate);
+			} else {
+				dump_custom_regs (tolower(*inptr) == 'a');
+			}
+			break;
 		case 'r':
 			{
 				if (more_params(&inptr))
@@ -3267,6 +3938,7 @@ static bool debug_line (TCHAR *input)
 					m68k_dumpstate (stdout, &nextpc);
 			}
 			break;
+		case 'p': profile_cmd (&inptr); break;
 		case 'D': deepcheatsearch (&inptr); break;
 		case 'C': cheatsearch (&inptr); break;
 		case 'W': writeintomem (&inptr); break;
@@ -3286,6 +3958,7 @@ static bool debug_line (TCHAR *input)
 						smc_detect_init (&inptr);
 					else
 						smc_free ();
+					memwatch_setup ();
 				}
 			} else {
 				searchmem (&inptr);
@@ -3304,6 +3977,14 @@ static bool debug_line (TCHAR *input)
 					console_out_f ("Input logging level %d\n", inputdevice_logging);
 				} else if (*inptr == 'm') {
 					memory_map_dump_2 (0);
+#ifdef FILESYS
+				} else if (*inptr == 'h') {
+					hardfile_cache_stats ();
+#endif
+#ifdef RECORDER
+				} else if (*inptr == 'r') {
+					recorder_show ();
+#endif
 				} else if (*inptr == 't') {
 					next_char (&inptr);
 					debugtest_set (&inptr);
@@ -3529,7 +4210,18 @@ static bool debug_line (TCHAR *input)
 				return true;
 			break;
 		case 'U':
-			if (currprefs.cpu_model && more_params (&inptr)) {
+			if (currprefs.mmu_model && !more_params (&inptr)) {
+				struct mmu_atc_stats *st = &mmu_atc_stats;
+				uae_u32 l2 = st->l2_hit + st->l2_miss;
+				console_out_f ("ATC L1 misses %u, L2 hits %u misses %u (%u.%u%%) evictions %u\n",
+					st->l1_miss, st->l2_hit, st->l2_miss,
+					l2 ? (uae_u32)((uae_u64)st->l2_miss * 100 / l2) : 0,
+					l2 ? (uae_u32)((uae_u64)st->l2_miss * 1000 / l2 % 10) : 0,
+					st->l2_evict);
+				console_out_f ("Table searches %u, PFLUSH %u, PFLUSHA %u\n",
+					st->table_search, st->flush, st->flush_all);
+				memset (st, 0, sizeof (struct mmu_atc_stats));
+			} else if (currprefs.cpu_model && more_params (&inptr)) {
 				int i;
 				uaecptr addrl = readhex (&inptr);
 				uaecptr addrp;
@@ -3555,6 +4247,26 @@ static bool debug_line (TCHAR *input)
 				console_out_f ("\n");
 			}
 			break;
+#ifdef JIT
+		case 'j':
+			if (*inptr == 'r') {
+				compemu_profile_reset ();
+				console_out ("JIT profile counters reset\n");
+			} else if (*inptr == 'e') {
+				bool enable;
+				next_char (&inptr);
+				if (more_params (&inptr))
+					enable = readint (&inptr) != 0;
+				else
+					enable = !currprefs.comp_profile;
+				currprefs.comp_profile = changed_prefs.comp_profile = enable;
+				compemu_profile_enable (enable);
+				console_out_f ("JIT profiling %s\n", enable ? "enabled" : "disabled");
+			} else {
+				compemu_profile_dump (more_params (&inptr) ? readint (&inptr) : 20, jit_profile_out);
+			}
+			break;
+#endif
 		case 'h':
 		case '?':
 			if (more_params (&inptr))
@@ -3647,13 +4359,15 @@ void debug (void)
 			pc = munge24 (m68k_getpc ());
 			opcode = (currprefs.cpu_compatible || currprefs.cpu_cycle_exact) ? regs.ir : get_word (pc);
 
-			for (i = 0; i < BREAKPOINT_TOTAL; i++) {
-				if (!bpnodes[i].enabled)
-					continue;
-				if (bpnodes[i].addr == pc) {
-					bp = 1;
-					console_out_f ("Breakpoint at %08X\n", pc);
-					break;
+			if (bphash[BPHASH (pc)]) {
+				for (i = 0; i < BREAKPOINT_TOTAL; i++) {
+					if (!bpnodes[i].enabled)
+						continue;
+					if (bpnodes[i].addr == pc) {
+						bp = 1;
+						console_out_f ("Breakpoint at %08X\n", pc);
+						break;
+					}
 				}
 			}
 
@@ -3666,18 +4380,9 @@ void debug (void)
 					int process = get_byte (activetask + 8) == 13 ? 1 : 0;
 					char *name = (char*)get_real_address (get_long (activetask + 10));
 					if (process) {
-						uaecptr cli = BPTR2APTR(get_long (activetask + 172));
-						uaecptr seglist = 0;
-
-						uae_char *command = NULL;
-						if (cli) {
-							if (processname)
-								command = (char*)get_real_address (BPTR2APTR(get_long (cli + 16)));
-							seglist = BPTR2APTR(get_long (cli + 60));
-						} else {
-							seglist = BPTR2APTR(get_long (activetask + 128));
-							seglist = BPTR2APTR(get_long (seglist + 12));
-						}
+						uaecptr cmd;
+						uaecptr seglist = debug_task_seglist (activetask, &cmd);
+						uae_char *command = cmd ? (char*)get_real_address (cmd) : NULL;
 						if (activetask == processptr || (processname && (!strcasecmp (name, processname) || (command && command[0] && !strncasecmp (command + 1, processname, command[0]) && processname[command[0]] == 0)))) {
 							while (seglist) {
 								uae_u32 size = get_long (seglist - 4) - 4;
@@ -3756,10 +4461,8 @@ void debug (void)
 		) {
 			savestate_capture (1);
 	}
-	for (i = 0; i < BREAKPOINT_TOTAL; i++) {
-		if (bpnodes[i].enabled)
-			do_skip = 1;
-	}
+	if (bpcount)
+		do_skip = 1;
 	if (sr_bpmask || sr_bpvalue)
 		do_skip = 1;
 	if (do_skip) {
@@ -33,6 +33,7 @@ int disk_debug_track = -1;
 #include "savestate.h"
 #include "cia.h"
 #include "debug.h"
+#include "hostprof.h"
 #ifdef FDI2RAW
 #include "fdi2raw.h"
 #endif
@@ -48,6 +49,7 @@ int disk_debug_track = -1;
 #include "crc32.h"
 #include "inputdevice.h"
 #include "amax.h"
+#include "threaddep/thread.h"
 #ifdef RETROPLATFORM
 #include "rp.h"
 #endif
@@ -146,6 +148,51 @@ typedef struct {
 #define DRIVE_ID_525SD 0x55555555 /* 40 track 5.25 drive , kickstart does not recognize this */
 
 typedef enum { ADF_NONE = -1, ADF_NORMAL, ADF_EXT1, ADF_EXT2, ADF_FDI, ADF_IPF, ADF_CATWEASEL, ADF_PCDOS } drive_filetype;
+
+/* Encoded MFM tracks of the inserted image. Sector based and raw images
+ * are encoded by a background thread from a copy of the image taken at
+ * insert time, IPF and FDI tracks are kept after they were first loaded.
+ * Stepping to a cached track only swaps bigmfmbuf. */
+
+#define TRACKCACHE_IMAGE_MAX (4 * 1024 * 1024)
+#define TRACKCACHE_LAZY_MAX (8 * 1024 * 1024) /* IPF/FDI bytes per drive */
+
+enum { TC_EMPTY, TC_BUSY, TC_STALE, TC_READY };
+
+struct trackcache_entry {
+	uae_u16 *mfm;
+	uae_u16 *timing;
+	unsigned int words;
+	unsigned int tracklen;
+	int skipoffset;
+	unsigned int indexoffset;
+	volatile int state;
+	bool dirty; /* written to, image copy is out of date */
+	bool lazy;
+	uae_u32 lastuse;
+};
+
+struct trackcache {
+	struct trackcache_entry t[MAX_TRACKS];
+	uae_u8 *image;
+	int imagesize;
+	int fwlen;
+	uae_sem_t lock;
+	uae_thread_id tid;
+	volatile int thread; /* 1 = running, 2 = asked to stop, 0 = done */
+	uae_u32 usecnt;
+	int lazybytes;
+	int hits, misses, encoded;
+};
+
+/* what a track is encoded into, drv->trackbuf or a cache slot */
+struct trackout {
+	uae_u16 *mfm;
+	unsigned int tracklen;
+	int skipoffset;
+	const uae_u8 *image;
+	int imagesize;
+};
 typedef struct {
 	struct zfile *diskfile;
 	struct zfile *writediskfile;
@@ -158,8 +205,10 @@ typedef struct {
 	int motordelay; /* dskrdy needs some clock cycles before it changes after switching off motor */
 	bool state;
 	bool wrprot;
-	uae_u16 bigmfmbuf[0x4000 * DDHDMULT];
+	uae_u16 *bigmfmbuf; /* trackbuf or a track cache slot */
+	uae_u16 trackbuf[0x4000 * DDHDMULT];
 	uae_u16 tracktiming[0x4000 * DDHDMULT];
+	struct trackcache *cache;
 	int multi_revolution;
 	int skipoffset;
 	unsigned int mfmpos;
@@ -563,8 +612,14 @@ static void drive_settype_id (drive *drv)
 #endif
 }
 
+static void drive_mfmbuf_own (drive *drv, bool keep);
+static void trackcache_init (drive *drv);
+static void trackcache_free (drive *drv);
+
 static void drive_image_free (drive *drv)
 {
+	drive_mfmbuf_own (drv, true);
+	trackcache_free (drv);
 	switch (drv->filetype)
 	{
 	case ADF_IPF:
@@ -734,6 +789,7 @@ static void track_reset (drive *drv)
 	drv->buffered_side = -1;
 	drv->skipoffset = -1;
 	drv->tracktiming[0] = 0;
+	drive_mfmbuf_own (drv, false);
 	memset (drv->bigmfmbuf, 0xaa, FLOPPY_WRITE_LEN * 2 * drv->ddhd);
 	updatemfmpos (drv);
 }
@@ -1138,6 +1194,7 @@ static int drive_insert (drive * drv, struct uae_prefs *p, int dnum, const TCHAR
 	}
 	openwritefile (drv, 0);
 	drive_settype_id (drv); /* Set DD or HD drive */
+	trackcache_init (drv);
 	drive_fill_bigbuf (drv, 1);
 	drv->mfmpos = uaerand ();
 	drv->mfmpos |= (uaerand () << 16);
@@ -1309,6 +1366,28 @@ static void read_floppy_data (struct zfile *diskfile, trackid *tid, int offset,
 	zfile_fread (dst, 1, len, diskfile);
 }
 
+/* read from the image copy when encoding for the track cache */
+static void read_track_data (drive *drv, struct trackout *to, trackid *tid, int offset, uae_u8 *dst, int len)
+{
+	int pos = tid->offs + offset;
+
+	if (!to->image) {
+		read_floppy_data (drv->diskfile, tid, offset, dst, len);
+		return;
+	}
+	if (len <= 0)
+		return;
+	if (pos < 0 || pos >= to->imagesize) {
+		memset (dst, 0, len);
+		return;
+	}
+	if (pos + len > to->imagesize) {
+		memset (dst + to->imagesize - pos, 0, pos + len - to->imagesize);
+		len = to->imagesize - pos;
+	}
+	memcpy (dst, to->image + pos, len);
+}
+
 /* Megalomania does not like zero MFM words... */
 static void mfmcode (uae_u16 * mfm, unsigned int words)
 {
@@ -1353,18 +1432,17 @@ static uae_u16 *mfmcoder (uae_u8 *src, uae_u16 *dest, int len)
 	return dest;
 }
 
-static void decode_pcdos (drive *drv)
+static void decode_pcdos (drive *drv, unsigned int tr, struct trackout *to)
 {
 	unsigned int i;
 	int len;
-	unsigned int tr = drv->cyl * 2 + side;
 	uae_u16 *dstmfmbuf, *mfm2;
 	uae_u8 secbuf[1000];
 	uae_u16 crc16;
 	trackid *ti = drv->trackdata + tr;
 	int tracklen = 12500;
 
-	mfm2 = drv->bigmfmbuf;
+	mfm2 = to->mfm;
 	*mfm2++ = 0x9254;
 	memset (secbuf, 0x4e, 40);
 	memset (secbuf + 40, 0x00, 12);
@@ -1384,8 +1462,8 @@ static void decode_pcdos (drive *drv)
 		secbuf[13] = 0xa1;
 		secbuf[14] = 0xa1;
 		secbuf[15] = 0xfe;
-		secbuf[16] = drv->cyl;
-		secbuf[17] = side;
+		secbuf[16] = tr / 2;
+		secbuf[17] = tr & 1;
 		secbuf[18] = 1 + i;
 		secbuf[19] = 2; // 128 << 2 = 512
 		crc16 = get_crc16(secbuf + 12, 3 + 1 + 4);
@@ -1397,7 +1475,7 @@ static void decode_pcdos (drive *drv)
 		secbuf[57] = 0xa1;
 		secbuf[58] = 0xa1;
 		secbuf[59] = 0xfb;
-		read_floppy_data (drv->diskfile, ti, i * 512, &secbuf[60], 512);
+		read_track_data (drv, to, ti, i * 512, &secbuf[60], 512);
 		crc16 = get_crc16 (secbuf + 56, 3 + 1 + 512);
 		secbuf[60 + 512] = crc16 >> 8;
 		secbuf[61 + 512] = crc16 & 0xff;
@@ -1412,28 +1490,27 @@ static void decode_pcdos (drive *drv)
 		mfm2[57] = 0x4489;
 		mfm2[58] = 0x4489;
 	}
-	while (dstmfmbuf - drv->bigmfmbuf < tracklen / 2)
+	while (dstmfmbuf - to->mfm < tracklen / 2)
 		*dstmfmbuf++ = 0x9254;
-	drv->skipoffset = 0;
-	drv->tracklen = (dstmfmbuf - drv->bigmfmbuf) * 16;
+	to->skipoffset = 0;
+	to->tracklen = (dstmfmbuf - to->mfm) * 16;
 	if (disk_debug_logging > 0)
 		write_log ("pcdos read track %d\n", tr);
 }
 
-static void decode_amigados (drive *drv)
+static void decode_amigados (drive *drv, unsigned int tr, struct trackout *to)
 {
 	/* Normal AmigaDOS format track */
-	unsigned int tr = drv->cyl * 2 + side;
 	unsigned int sec;
 	int dstmfmoffset = 0;
-	uae_u16 *dstmfmbuf = drv->bigmfmbuf;
+	uae_u16 *dstmfmbuf = to->mfm;
 	int len = drv->num_secs * 544 + FLOPPY_GAP_LEN;
 
 	trackid *ti = drv->trackdata + tr;
 	memset (dstmfmbuf, 0xaa, len * 2);
 	dstmfmoffset += FLOPPY_GAP_LEN;
-	drv->skipoffset = (FLOPPY_GAP_LEN * 8) / 3 * 2;
-	drv->tracklen = len * 2 * 8;
+	to->skipoffset = (FLOPPY_GAP_LEN * 8) / 3 * 2;
+	to->tracklen = len * 2 * 8;
 
 	for (sec = 0; sec < drv->num_secs; sec++) {
 		uae_u8 secbuf[544];
@@ -1452,7 +1529,7 @@ static void decode_amigados (drive *drv)
 		for (i = 8; i < 24; i++)
 			secbuf[i] = 0;
 
-		read_floppy_data (drv->diskfile, ti, sec * 512, &secbuf[32], 512);
+		read_track_data (drv, to, ti, sec * 512, &secbuf[32], 512);
 
 		mfmbuf[0] = mfmbuf[1] = 0xaaaa;
 		mfmbuf[2] = mfmbuf[3] = 0x4489;
@@ -1524,20 +1601,19 @@ static void decode_amigados (drive *drv)
 *
 */
 
-static void decode_diskspare (drive *drv)
+static void decode_diskspare (drive *drv, unsigned int tr, struct trackout *to)
 {
-	int tr = drv->cyl * 2 + side;
 	int sec;
 	int dstmfmoffset = 0;
 	int size = 512 + 8;
-	uae_u16 *dstmfmbuf = drv->bigmfmbuf;
+	uae_u16 *dstmfmbuf = to->mfm;
 	int len = drv->num_secs * size + FLOPPY_GAP_LEN;
 
 	trackid *ti = drv->trackdata + tr;
 	memset (dstmfmbuf, 0xaa, len * 2);
 	dstmfmoffset += FLOPPY_GAP_LEN;
-	drv->skipoffset = (FLOPPY_GAP_LEN * 8) / 3 * 2;
-	drv->tracklen = len * 2 * 8;
+	to->skipoffset = (FLOPPY_GAP_LEN * 8) / 3 * 2;
+	to->tracklen = len * 2 * 8;
 
 	for (sec = 0; sec < drv->num_secs; sec++) {
 		uae_u8 secbuf[512 + 8];
@@ -1551,7 +1627,7 @@ static void decode_diskspare (drive *drv)
 		secbuf[2] = 0;
 		secbuf[3] = 0;
 
-		read_floppy_data (drv->diskfile, ti, sec * 512, &secbuf[4], 512);
+		read_track_data (drv, to, ti, sec * 512, &secbuf[4], 512);
 
 		mfmbuf[0] = 0xaaaa;
 		mfmbuf[1] = 0x4489;
@@ -1600,10 +1676,327 @@ static void decode_diskspare (drive *drv)
 		write_log ("diskspare read track %d\n", tr);
 }
 
+static void decode_raw (drive *drv, unsigned int tr, struct trackout *to)
+{
+	trackid *ti = drv->trackdata + tr;
+	unsigned int i;
+	int base_offset = ti->type == TRACK_RAW ? 0 : 1;
+
+	to->tracklen = ti->bitlen + 16 * base_offset;
+	to->skipoffset = -1;
+	to->mfm[0] = ti->sync;
+	read_track_data (drv, to, ti, 0, (uae_u8*)(to->mfm + base_offset), (ti->bitlen + 7) / 8);
+	for (i = base_offset; i < (to->tracklen + 15) / 16; i++) {
+		uae_u16 *mfm = to->mfm + i;
+		uae_u8 *data = (uae_u8 *) mfm;
+		*mfm = 256 * *data + *(data + 1);
+	}
+	if (disk_debug_logging > 1)
+		write_log ("rawtrack %d image offset=%x\n", tr, ti->offs);
+}
+
+/* encode a sector based or raw track, returns 0 if it has no data */
+static int decode_track (drive *drv, unsigned int tr, struct trackout *to)
+{
+	trackid *ti = drv->trackdata + tr;
+
+	to->tracklen = 0;
+	to->skipoffset = -1;
+	if (ti->type == TRACK_PCDOS)
+		decode_pcdos (drv, tr, to);
+	else if (ti->type == TRACK_AMIGADOS)
+		decode_amigados (drv, tr, to);
+	else if (ti->type == TRACK_DISKSPARE)
+		decode_diskspare (drv, tr, to);
+	else if (ti->type != TRACK_NONE)
+		decode_raw (drv, tr, to);
+	return to->tracklen > 0;
+}
+
+/* make bigmfmbuf private before anything is written into it */
+static void drive_mfmbuf_own (drive *drv, bool keep)
+{
+	if (drv->bigmfmbuf == drv->trackbuf)
+		return;
+	if (keep && drv->bigmfmbuf)
+		memcpy (drv->trackbuf, drv->bigmfmbuf, ((drv->tracklen + 15) / 16) * 2);
+	drv->bigmfmbuf = drv->trackbuf;
+}
+
+static struct trackcache_entry *trackcache_alloc (struct trackcache *tc, struct trackcache_entry *e, unsigned int tracklen, bool timing)
+{
+	unsigned int words = (tracklen + 15) / 16 + 8;
+
+	if (e->words < words || (timing && !e->timing)) {
+		xfree (e->mfm);
+		xfree (e->timing);
+		e->mfm = xcalloc (uae_u16, words);
+		e->timing = timing ? xcalloc (uae_u16, words) : NULL;
+		e->words = words;
+	}
+	return e->mfm ? e : NULL;
+}
+
+static void *trackcache_thread (void *v)
+{
+	drive *drv = (drive*)v;
+	struct trackcache *tc = drv->cache;
+	/* the track length isn't known before it is encoded */
+	uae_u16 *scratch = xcalloc (uae_u16, 0x4000 * DDHDMULT);
+	unsigned int tr;
+
+	for (tr = 0; scratch && tr < drv->num_tracks && tr < MAX_TRACKS && tc->thread == 1; tr++) {
+		struct trackcache_entry *e = &tc->t[tr];
+		struct trackout to;
+
+		uae_sem_wait (&tc->lock);
+		if (e->state != TC_EMPTY || e->dirty) {
+			uae_sem_post (&tc->lock);
+			continue;
+		}
+		e->state = TC_BUSY;
+		uae_sem_post (&tc->lock);
+
+		memset (&to, 0, sizeof to);
+		to.mfm = scratch;
+		to.image = tc->image;
+		to.imagesize = tc->imagesize;
+		if (decode_track (drv, tr, &to) && trackcache_alloc (tc, e, to.tracklen, false)) {
+			memcpy (e->mfm, to.mfm, ((to.tracklen + 15) / 16) * 2);
+			e->tracklen = to.tracklen;
+			e->skipoffset = to.skipoffset;
+			e->indexoffset = 0;
+		} else {
+			e->tracklen = 0;
+		}
+
+		uae_sem_wait (&tc->lock);
+		if (e->state == TC_BUSY && e->tracklen) {
+			e->state = TC_READY;
+			tc->encoded++;
+		} else {
+			e->state = TC_EMPTY;
+		}
+		uae_sem_post (&tc->lock);
+	}
+	xfree (scratch);
+	tc->thread = 0;
+	return NULL;
+}
+
+static void trackcache_start (drive *drv)
+{
+	struct trackcache *tc = drv->cache;
+
+	if (!tc->image)
+		return;
+	tc->thread = 1;
+	uae_start_thread ("floppy track cache", trackcache_thread, drv, &tc->tid);
+}
+
+static void trackcache_stop (struct trackcache *tc)
+{
+	if (tc->thread) {
+		tc->thread = 2;
+		uae_wait_thread (tc->tid);
+		tc->thread = 0;
+	}
+}
+
+static void trackcache_free (drive *drv)
+{
+	struct trackcache *tc = drv->cache;
+	int i;
+
+	if (!tc)
+		return;
+	trackcache_stop (tc);
+	drive_mfmbuf_own (drv, true);
+	if (disk_debug_logging > 0)
+		write_log ("DF%d: track cache %d hits, %d misses, %d encoded in background\n",
+			(int)(drv - floppy), tc->hits, tc->misses, tc->encoded);
+	for (i = 0; i < MAX_TRACKS; i++) {
+		xfree (tc->t[i].mfm);
+		xfree (tc->t[i].timing);
+	}
+	xfree (tc->image);
+	uae_sem_destroy (&tc->lock);
+	xfree (tc);
+	drv->cache = NULL;
+}
+
+/* called on insert, starts encoding all tracks of sector and raw images */
+static void trackcache_init (drive *drv)
+{
+	struct trackcache *tc;
+	bool background = false;
+
+	trackcache_free (drv);
+	if (drv->filetype == ADF_CATWEASEL || drv->filetype == ADF_NONE || !drv->diskfile)
+		return;
+	tc = xcalloc (struct trackcache, 1);
+	if (!tc)
+		return;
+	uae_sem_init (&tc->lock, 0, 1);
+	tc->fwlen = FLOPPY_WRITE_LEN;
+	drv->cache = tc;
+
+	if (drv->filetype == ADF_NORMAL || drv->filetype == ADF_EXT1 || drv->filetype == ADF_EXT2 || drv->filetype == ADF_PCDOS) {
+		uae_s64 size = zfile_size (drv->diskfile);
+		if (size > 0 && size <= TRACKCACHE_IMAGE_MAX) {
+			tc->image = xmalloc (uae_u8, size);
+			if (tc->image) {
+				zfile_fseek (drv->diskfile, 0, SEEK_SET);
+				tc->imagesize = zfile_fread (tc->image, 1, size, drv->diskfile);
+				background = tc->imagesize == size;
+			}
+		}
+	}
+	if (background)
+		trackcache_start (drv);
+}
+
+/* writes make the cached encoding and the image copy stale */
+static void trackcache_invalidate (drive *drv, unsigned int tr)
+{
+	struct trackcache *tc = drv->cache;
+	struct trackcache_entry *e;
+
+	if (!tc || tr >= MAX_TRACKS)
+		return;
+	e = &tc->t[tr];
+	uae_sem_wait (&tc->lock);
+	if (e->mfm == drv->bigmfmbuf)
+		drive_mfmbuf_own (drv, true);
+	if (e->state == TC_BUSY)
+		e->state = TC_STALE;
+	else if (e->state == TC_READY)
+		e->state = TC_EMPTY;
+	if (e->lazy) {
+		tc->lazybytes -= e->words * 2;
+		e->lazy = false;
+	}
+	e->dirty = true;
+	uae_sem_post (&tc->lock);
+}
+
+/* drop least recently used IPF/FDI tracks until size fits */
+static void trackcache_trim (drive *drv, int size)
+{
+	struct trackcache *tc = drv->cache;
+
+	while (tc->lazybytes + size > TRACKCACHE_LAZY_MAX) {
+		struct trackcache_entry *old = NULL;
+		int i;
+		for (i = 0; i < MAX_TRACKS; i++) {
+			struct trackcache_entry *e = &tc->t[i];
+			if (e->lazy && e->state == TC_READY && e->mfm != drv->bigmfmbuf && (!old || e->lastuse < old->lastuse))
+				old = e;
+		}
+		if (!old)
+			break;
+		tc->lazybytes -= old->words * 2;
+		xfree (old->mfm);
+		xfree (old->timing);
+		old->mfm = old->timing = NULL;
+		old->words = 0;
+		old->lazy = false;
+		old->state = TC_EMPTY;
+	}
+}
+
+/* remember the track just loaded into trackbuf */
+static void trackcache_put (drive *drv, unsigned int tr)
+{
+	struct trackcache *tc = drv->cache;
+	struct trackcache_entry *e;
+	bool lazy = drv->filetype == ADF_IPF || drv->filetype == ADF_FDI;
+	bool timing = drv->tracktiming[0] != 0;
+
+	if (!tc || tr >= MAX_TRACKS || drv->tracklen == 0)
+		return;
+	/* weak bits differ from one revolution to the next */
+	if (drv->multi_revolution)
+		return;
+	e = &tc->t[tr];
+	uae_sem_wait (&tc->lock);
+	if (e->state == TC_EMPTY) {
+		if (lazy)
+			trackcache_trim (drv, ((drv->tracklen + 15) / 16 + 8) * (timing ? 4 : 2));
+		if (trackcache_alloc (tc, e, drv->tracklen, timing)) {
+			unsigned int words = (drv->tracklen + 15) / 16;
+			memcpy (e->mfm, drv->bigmfmbuf, words * 2);
+			if (timing)
+				memcpy (e->timing, drv->tracktiming, words * 2);
+			else if (e->timing)
+				e->timing[0] = 0;
+			e->tracklen = drv->tracklen;
+			e->skipoffset = drv->skipoffset;
+			e->indexoffset = drv->indexoffset;
+			e->lastuse = ++tc->usecnt;
+			if (lazy && !e->lazy) {
+				tc->lazybytes += e->words * (timing ? 4 : 2);
+				e->lazy = true;
+			}
+			e->state = TC_READY;
+		}
+	}
+	uae_sem_post (&tc->lock);
+}
+
+/* switch bigmfmbuf to a cached track, returns 0 if it isn't cached yet */
+static int trackcache_get (drive *drv, unsigned int tr)
+{
+	struct trackcache *tc = drv->cache;
+	struct trackcache_entry *e;
+
+	if (!tc || tr >= MAX_TRACKS)
+		return 0;
+	if (tc->fwlen != FLOPPY_WRITE_LEN) {
+		/* gap length changed (PAL/NTSC switch), start over */
+		int i;
+		trackcache_stop (tc);
+		drive_mfmbuf_own (drv, true);
+		for (i = 0; i < MAX_TRACKS; i++) {
+			struct trackcache_entry *e = &tc->t[i];
+			if (e->lazy) {
+				xfree (e->mfm);
+				xfree (e->timing);
+				e->mfm = e->timing = NULL;
+				e->words = 0;
+				e->lazy = false;
+			}
+			e->state = TC_EMPTY;
+		}
+		tc->lazybytes = 0;
+		tc->fwlen = FLOPPY_WRITE_LEN;
+		trackcache_start (drv);
+		return 0;
+	}
+	e = &tc->t[tr];
+	uae_sem_wait (&tc->lock);
+	if (e->state != TC_READY) {
+		uae_sem_post (&tc->lock);
+		tc->misses++;
+		return 0;
+	}
+	e->lastuse = ++tc->usecnt;
+	uae_sem_post (&tc->lock);
+	drv->bigmfmbuf = e->mfm;
+	drv->tracklen = e->tracklen;
+	drv->skipoffset = e->skipoffset;
+	drv->indexoffset = e->indexoffset;
+	if (e->timing && e->timing[0])
+		memcpy (drv->tracktiming, e->timing, ((e->tracklen + 15) / 16) * 2);
+	else
+		drv->tracktiming[0] = 0;
+	tc->hits++;
+	return 1;
+}
+
 static void drive_fill_bigbuf (drive * drv, int force)
 {
 	unsigned int tr = drv->cyl * 2 + side;
-	trackid *ti = drv->trackdata + tr;
 
 	if ((!drv->diskfile && !drv->catweasel) || tr >= drv->num_tracks) {
 		track_reset (drv);
@@ -1626,6 +2019,7 @@ static void drive_fill_bigbuf (drive * drv, int force)
 	if (drv->writediskfile && drv->writetrackdata[tr].bitlen > 0) {
 		unsigned int i;
 		trackid *wti = &drv->writetrackdata[tr];
+		drive_mfmbuf_own (drv, false);
 		drv->tracklen = wti->bitlen;
 		drv->revolutions = wti->revolutions;
 		read_floppy_data (drv->writediskfile, wti, 0, (uae_u8*)drv->bigmfmbuf, (wti->bitlen + 7) / 8);
@@ -1638,6 +2032,7 @@ static void drive_fill_bigbuf (drive * drv, int force)
 		    write_log ("track %d, length %d read from \"saveimage\"\n", tr, drv->tracklen);
 	} else if (drv->filetype == ADF_CATWEASEL) {
 #ifdef CATWEASEL
+		drive_mfmbuf_own (drv, false);
 		drv->tracklen = 0;
 		if (!catweasel_disk_changed (drv->catweasel)) {
 			drv->tracklen = catweasel_fillmfm (drv->catweasel, drv->bigmfmbuf, side, drv->ddhd, 0);
@@ -1648,51 +2043,42 @@ static void drive_fill_bigbuf (drive * drv, int force)
 			return;
 		}
 #endif
+	} else if (trackcache_get (drv, tr)) {
+
+		;
+
 	} else if (drv->filetype == ADF_IPF) {
 
 #ifdef CAPS
+		drive_mfmbuf_own (drv, false);
 		caps_loadtrack (drv->bigmfmbuf, drv->tracktiming, drv - floppy, tr, &drv->tracklen, &drv->multi_revolution, &drv->skipoffset);
+		trackcache_put (drv, tr);
 #endif
 
 	} else if (drv->filetype == ADF_FDI) {
 
 #ifdef FDI2RAW
+		drive_mfmbuf_own (drv, false);
 		fdi2raw_loadtrack (drv->fdi, drv->bigmfmbuf, drv->tracktiming, tr, &drv->tracklen, &drv->indexoffset, &drv->multi_revolution, 1);
+		trackcache_put (drv, tr);
 #endif
 
-	} else if (ti->type == TRACK_PCDOS) {
-
-		decode_pcdos (drv);
-
-	} else if (ti->type == TRACK_AMIGADOS) {
-
-		decode_amigados (drv);
-
-	} else if (ti->type == TRACK_DISKSPARE) {
-
-		decode_diskspare (drv);
+	} else if (drv->trackdata[tr].type != TRACK_NONE) {
+		struct trackout to;
 
-	} else if (ti->type == TRACK_NONE) {
-
-		;
-
-	} else {
-		unsigned int i;
-		int base_offset = ti->type == TRACK_RAW ? 0 : 1;
-		drv->tracklen = ti->bitlen + 16 * base_offset;
-		drv->bigmfmbuf[0] = ti->sync;
-		read_floppy_data (drv->diskfile, ti, 0, (uae_u8*)(drv->bigmfmbuf + base_offset), (ti->bitlen + 7) / 8);
-		for (i = base_offset; i < (drv->tracklen + 15) / 16; i++) {
-			uae_u16 *mfm = drv->bigmfmbuf + i;
-			uae_u8 *data = (uae_u8 *) mfm;
-			*mfm = 256 * *data + *(data + 1);
+		drive_mfmbuf_own (drv, false);
+		memset (&to, 0, sizeof to);
+		to.mfm = drv->bigmfmbuf;
+		if (decode_track (drv, tr, &to)) {
+			drv->tracklen = to.tracklen;
+			drv->skipoffset = to.skipoffset;
+			trackcache_put (drv, tr);
 		}
-		if (disk_debug_logging > 1)
-			write_log ("rawtrack %d image offset=%x\n", tr, ti->offs);
 	}
 	drv->buffered_side = side;
 	drv->buffered_cyl = drv->cyl;
 	if (drv->tracklen == 0) {
+		drive_mfmbuf_own (drv, false);
 		drv->tracklen = FLOPPY_WRITE_LEN * drv->ddhd * 2 * 8;
 		memset (drv->bigmfmbuf, 0, FLOPPY_WRITE_LEN * 2 * drv->ddhd);
 	}
@@ -1992,11 +2378,16 @@ static void drive_write_data (drive * drv)
 	int tr = drv->cyl * 2 + side;
 	static int warned;
 
+#ifdef SAVESTATE
+	savestate_runahead_commit ();
+#endif
+
 	if (drive_writeprotected (drv) || drv->trackdata[tr].type == TRACK_NONE) {
 		/* read original track back because we didn't really write anything */
 		drv->buffered_side = 2;
 		return;
 	}
+	trackcache_invalidate (drv, tr);
 	if (drv->writediskfile) {
 		drive_write_ext2 (drv->bigmfmbuf, drv->writediskfile, &drv->writetrackdata[tr],
 			longwritemode ? dsklength2 * 8 : drv->tracklen);
@@ -2377,6 +2768,7 @@ static void DISK_check_change (void)
 
 	if (currprefs.floppy_speed != changed_prefs.floppy_speed)
 		currprefs.floppy_speed = changed_prefs.floppy_speed;
+	currprefs.floppy_turbo_dma = changed_prefs.floppy_turbo_dma;
 	for (i = 0; i < MAX_FLOPPY_DRIVES; i++) {
 		drive *drv = floppy + i;
 		if (currprefs.floppyslots[i].dfxtype != changed_prefs.floppyslots[i].dfxtype) {
@@ -2613,6 +3005,8 @@ STATIC_INLINE uae_u32 getonebit (uae_u16 * mfmbuf, unsigned int mfmpos)
 	return (buf[0] & (1 << (15 - (mfmpos & 15)))) ? 1 : 0;
 }
 
+static int turbodma_fast, turbodma_slow;
+
 void dumpdisk (void)
 {
 	int i, j, k;
@@ -2639,6 +3033,7 @@ void dumpdisk (void)
 	}
 	write_log ("side %d dma %d off %d word %04X pt %08X len %04X bytr %04X adk %04X sync %04X\n",
 		side, dskdmaen, bitoffset, word, dskpt, dsklen, dskbytr_val, adkcon, dsksync);
+	write_log ("turbo DMA reads: %d copied whole, %d word by word\n", turbodma_fast, turbodma_slow);
 }
 
 static void disk_dmafinished (void)
@@ -2666,18 +3061,20 @@ static void fetchnextrevolution (drive *drv)
 	{
 	case ADF_IPF:
 #ifdef CAPS
+		drive_mfmbuf_own (drv, false);
 		caps_loadrevolution (drv->bigmfmbuf, drv - floppy, drv->cyl * 2 + side, &drv->tracklen);
 #endif
 		break;
 	case ADF_FDI:
 #ifdef FDI2RAW
+		drive_mfmbuf_own (drv, false);
 		fdi2raw_loadrevolution (drv->fdi, drv->bigmfmbuf, drv->tracktiming, drv->cyl * 2 + side, &drv->tracklen, 1);
 #endif
 		break;
 	}
 }
 
-void DISK_handler (uae_u32 data)
+static void DISK_handler_1 (uae_u32 data)
 {
 	int flag = data & 255;
 	int disk_sync_cycle = data >> 8;
@@ -2703,6 +3100,13 @@ void DISK_handler (uae_u32 data)
 	}
 }
 
+void DISK_handler (uae_u32 data)
+{
+	HOSTPROF_ENTER (HP_DISK);
+	DISK_handler_1 (data);
+	HOSTPROF_LEAVE ();
+}
+
 static void disk_doupdate_write (drive * drv, int floppybits)
 {
 	int dr;
@@ -2741,6 +3145,7 @@ static void disk_doupdate_write (drive * drv, int floppybits)
 				for (dr = 0; dr < MAX_FLOPPY_DRIVES ; dr++) {
 					drive *drv2 = &floppy[dr];
 					if (drives[dr]) {
+						drive_mfmbuf_own (drv2, true);
 						drv2->bigmfmbuf[drv2->mfmpos >> 4] = w;
 						drv2->bigmfmbuf[(drv2->mfmpos >> 4) + 1] = 0x5555;
 						drv2->writtento = 1;
@@ -3054,7 +3459,7 @@ static void DISK_start (void)
 
 static int linecounter;
 
-void DISK_hsync (void)
+static void DISK_hsync_1 (void)
 {
 	unsigned int dr;
 
@@ -3074,6 +3479,13 @@ void DISK_hsync (void)
 	DISK_update (maxhpos);
 }
 
+void DISK_hsync (void)
+{
+	HOSTPROF_ENTER (HP_DISK);
+	DISK_hsync_1 ();
+	HOSTPROF_LEAVE ();
+}
+
 void DISK_update (unsigned int tohpos)
 {
 	unsigned int dr;
@@ -3135,6 +3547,82 @@ void DISK_update (unsigned int tohpos)
 	disk_doupdate_predict (disk_hpos);
 }
 
+/* Standard trackdisk style turbo read: DSKSYNC 0x4489 with WORDSYNC and a
+ * track that has no timing data. Copies the track following the first
+ * sync word straight to chip RAM. Returns 0 if the word by word path is
+ * needed. */
+static int disk_turbo_read (drive *drv, unsigned int pos)
+{
+	unsigned int words = drv->tracklen / 16;
+	unsigned int w, i;
+	int len = dsklength;
+	uae_u8 *dst;
+
+	if (!currprefs.floppy_turbo_dma || len <= 0)
+		return 0;
+	if (!(adkcon & 0x400) || dsksync != 0x4489)
+		return 0;
+	if (drv->tracktiming[0] || drv->multi_revolution || (drv->tracklen & 15) || words == 0)
+		return 0;
+	if (!valid_address (dskpt, len * 2))
+		return 0;
+	/* memory watch points or other hooks on chip RAM? */
+	if ((&get_mem_bank (dskpt) != &chipmem_bank && &get_mem_bank (dskpt) != &chipmem_bank_ce2)
+		|| &get_mem_bank (dskpt + len * 2 - 1) != &get_mem_bank (dskpt))
+		return 0;
+
+	w = pos >> 4;
+	for (i = 0; i < words; i++) {
+		if (++w >= words)
+			w = 0;
+		if (drv->bigmfmbuf[w] == dsksync)
+			break;
+	}
+	if (i >= words)
+		return 0;
+	/* must skip first disk sync marker */
+	if (++w >= words)
+		w = 0;
+
+	dst = get_real_address (dskpt);
+#ifdef SAVESTATE
+	memory_snapshot_chipblock (dskpt, len * 2, 0, 1);
+#endif
+	while (len > 0) {
+		unsigned int n = words - w;
+		const uae_u16 *src = drv->bigmfmbuf + w;
+		if (n > (unsigned int)len)
+			n = len;
+		for (i = 0; i < n; i++)
+			do_put_mem_word ((uae_u16*)(dst + i * 2), src[i]);
+		dst += n * 2;
+		len -= n;
+		w = 0;
+	}
+	dskpt += dsklength * 2;
+	dsklength = -1;
+	INTREQ (0x8000 | 0x1000);
+	turbodma_fast++;
+	if (disk_debug_logging > 1)
+		write_log ("turbo DMA read track %d, %d words\n", drv->cyl * 2 + side, dsklength2);
+	return 1;
+}
+
+/* can the turbo path read this drive's current track? */
+static bool disk_turbo_track (drive *drv)
+{
+	unsigned int tr = drv->cyl * 2 + side;
+
+	if (drv->filetype == ADF_NORMAL)
+		return true;
+	/* AmigaDOS tracks of extended ADFs, unless there's a raw track in the save image */
+	if (!currprefs.floppy_turbo_dma || drv->filetype != ADF_EXT2 || tr >= drv->num_tracks)
+		return false;
+	if (drv->writediskfile && drv->writetrackdata[tr].bitlen > 0)
+		return false;
+	return drv->trackdata[tr].type == TRACK_AMIGADOS;
+}
+
 void DSKLEN (uae_u16 v, unsigned int hpos)
 {
 	unsigned int dr, prev = dsklen;
@@ -3187,6 +3675,10 @@ void DSKLEN (uae_u16 v, unsigned int hpos)
 			return;
 		}
 		dskdmaen = 3;
+#ifdef SAVESTATE
+		/* written tracks go to the image file, no run-ahead roll back */
+		savestate_runahead_commit ();
+#endif
 		DISK_start ();
 	}
 
@@ -3243,7 +3735,7 @@ void DSKLEN (uae_u16 v, unsigned int hpos)
 		drive *drv = &floppy[dr];
 		if (selected & (1 << dr))
 			continue;
-		if (drv->filetype != ADF_NORMAL)
+		if (!disk_turbo_track (drv))
 			break;
 	}
 	if (dr < MAX_FLOPPY_DRIVES) /* no turbo mode if any selected drive has non-standard ADF */
@@ -3265,8 +3757,13 @@ void DSKLEN (uae_u16 v, unsigned int hpos)
 			pos = drv->mfmpos & ~15;
 			drive_fill_bigbuf (drv, 0);
 
-			if (dskdmaen == 2) { /* TURBO read */
+			if (dskdmaen == 2 && disk_turbo_read (drv, pos)) {
+
+				done = 1;
+
+			} else if (dskdmaen == 2) { /* TURBO read */
 
+				turbodma_slow++;
 				if (adkcon & 0x400) {
 					for (i = 0; i < drv->tracklen; i += 16) {
 						pos += 16;
@@ -3292,6 +3789,7 @@ void DSKLEN (uae_u16 v, unsigned int hpos)
 
 			} else if (dskdmaen == 3) { /* TURBO write */
 
+				drive_mfmbuf_own (drv, true);
 				for (i = 0; i < dsklength; i++) {
 					uae_u16 w = chipmem_wget_indirect (dskpt + i * 2);
 					drv->bigmfmbuf[pos >> 4] = w;
@@ -3437,6 +3935,7 @@ void DISK_init (void)
 
 	for (dr = 0; dr < MAX_FLOPPY_DRIVES; dr++) {
 		drive *drv = &floppy[dr];
+		drv->bigmfmbuf = drv->trackbuf;
 		/* reset all drive types to 3.5 DD */
 		drive_settype_id (drv);
 		if (!drive_insert (drv, &currprefs, dr, currprefs.floppyslots[dr].df, false))
@@ -3689,6 +4188,7 @@ uae_u8 *restore_disk2 (int num,uae_u8 *src)
 		drv->indexoffset = restore_u32 ();
 		drv->buffered_cyl = drv->cyl;
 		drv->buffered_side = side;
+		drive_mfmbuf_own (drv, false);
 		for (j = 0; j < (drv->tracklen + 15) / 16; j++) {
 			drv->bigmfmbuf[j] = restore_u16 ();
 			if (m & 2)
@@ -3804,6 +4304,112 @@ uae_u8 *save_floppy (int *len, uae_u8 *dstptr)
 	return dstbak;
 }
 
+/* Run-ahead: controller state and drive mechanics. The track buffers
+ * are not saved, the track under the head is loaded again if it moved. */
+const struct runahead_var disk_runahead_vars[] = {
+	RUNAHEAD_VAR (side),
+	RUNAHEAD_VAR (direction),
+	RUNAHEAD_VAR (selected),
+	RUNAHEAD_VAR (disabled),
+	RUNAHEAD_VAR (dskdmaen),
+	RUNAHEAD_VAR (dsklength),
+	RUNAHEAD_VAR (dsklength2),
+	RUNAHEAD_VAR (dsklen),
+	RUNAHEAD_VAR (dskbytr_val),
+	RUNAHEAD_VAR (dskpt),
+	RUNAHEAD_VAR (fifo_filled),
+	RUNAHEAD_VAR (fifo),
+	RUNAHEAD_VAR (fifo_inuse),
+	RUNAHEAD_VAR (dma_enable),
+	RUNAHEAD_VAR (bitoffset),
+	RUNAHEAD_VAR (syncoffset),
+	RUNAHEAD_VAR (word),
+	RUNAHEAD_VAR (dsksync),
+	RUNAHEAD_VAR (dsksync_cycles),
+	RUNAHEAD_VAR (disk_hpos),
+	RUNAHEAD_VAR (disk_jitter),
+	RUNAHEAD_VAR (indexdecay),
+	RUNAHEAD_VAR (prev_data),
+	RUNAHEAD_VAR (prev_step),
+	{ NULL, 0 }
+};
+
+struct drive_runahead {
+	struct zfile *diskfile;
+	unsigned int cyl, mfmpos;
+	bool motoroff, state, dskchange, dskready;
+	int motordelay;
+	int dskchange_time, dskready_up_time, dskready_down_time;
+	int steplimit;
+	frame_time_t steplimitcycle;
+	int indexhack, drive_id_scnt, idbit;
+	int floppybitcounter;
+};
+
+int disk_runahead_size (void)
+{
+	return MAX_FLOPPY_DRIVES * sizeof (struct drive_runahead);
+}
+
+uae_u8 *save_disk_runahead (uae_u8 *dst)
+{
+	struct drive_runahead *ra = (struct drive_runahead*)dst;
+	int i;
+
+	for (i = 0; i < MAX_FLOPPY_DRIVES; i++, ra++) {
+		drive *drv = &floppy[i];
+		ra->diskfile = drv->diskfile;
+		ra->cyl = drv->cyl;
+		ra->mfmpos = drv->mfmpos;
+		ra->motoroff = drv->motoroff;
+		ra->state = drv->state;
+		ra->dskchange = drv->dskchange;
+		ra->dskready = drv->dskready;
+		ra->motordelay = drv->motordelay;
+		ra->dskchange_time = drv->dskchange_time;
+		ra->dskready_up_time = drv->dskready_up_time;
+		ra->dskready_down_time = drv->dskready_down_time;
+		ra->steplimit = drv->steplimit;
+		ra->steplimitcycle = drv->steplimitcycle;
+		ra->indexhack = drv->indexhack;
+		ra->drive_id_scnt = drv->drive_id_scnt;
+		ra->idbit = drv->idbit;
+		ra->floppybitcounter = drv->floppybitcounter;
+	}
+	return (uae_u8*)ra;
+}
+
+uae_u8 *restore_disk_runahead (uae_u8 *src)
+{
+	struct drive_runahead *ra = (struct drive_runahead*)src;
+	int i;
+
+	for (i = 0; i < MAX_FLOPPY_DRIVES; i++, ra++) {
+		drive *drv = &floppy[i];
+		/* inserted or ejected meanwhile: keep the new disk */
+		if (ra->diskfile != drv->diskfile)
+			continue;
+		drv->cyl = ra->cyl;
+		drv->motoroff = ra->motoroff;
+		drv->state = ra->state;
+		drv->dskchange = ra->dskchange;
+		drv->dskready = ra->dskready;
+		drv->motordelay = ra->motordelay;
+		drv->dskchange_time = ra->dskchange_time;
+		drv->dskready_up_time = ra->dskready_up_time;
+		drv->dskready_down_time = ra->dskready_down_time;
+		drv->steplimit = ra->steplimit;
+		drv->steplimitcycle = ra->steplimitcycle;
+		drv->indexhack = ra->indexhack;
+		drv->drive_id_scnt = ra->drive_id_scnt;
+		drv->idbit = ra->idbit;
+		drv->floppybitcounter = ra->floppybitcounter;
+		drive_fill_bigbuf (drv, 0);
+		drv->mfmpos = drv->tracklen ? ra->mfmpos % drv->tracklen : 0;
+	}
+	return (uae_u8*)ra;
+}
+
 #endif /* SAVESTATE */
 
 #define MAX_DISKENTRIES 4
@@ -49,6 +49,8 @@
 #include "statusline.h"
 #include "inputdevice.h"
 #include "debug.h"
+#include "hostprof.h"
+#include "recorder.h"
 
 extern int sprite_buffer_res;
 int lores_factor, lores_shift;
@@ -1982,7 +1984,7 @@ enum double_how {
 	dh_emerg
 };
 
-static void pfield_draw_line (int lineno, int gfx_ypos, int follow_ypos)
+static void pfield_draw_line_1 (int lineno, int gfx_ypos, int follow_ypos)
 {
 	static int warned = 0;
 	int border = 0;
@@ -2172,6 +2174,14 @@ static void pfield_draw_line (int lineno, int gfx_ypos, int follow_ypos)
 	}
 }
 
+static void pfield_draw_line (int lineno, int gfx_ypos, int follow_ypos)
+{
+	HOSTPROF_ENTER (HP_DRAW);
+	HOSTPROF_COUNT (HPC_LINES);
+	pfield_draw_line_1 (lineno, gfx_ypos, follow_ypos);
+	HOSTPROF_LEAVE ();
+}
+
 static void center_image (void)
 {
 	int prev_x_adjust = visible_left_border;
@@ -2406,7 +2416,7 @@ static void draw_status_line (int line, int statusy)
 	int bpp, y;
 	uae_u8 *buf;
 
-	if (!(currprefs.leds_on_screen & STATUSLINE_CHIPSET) || (currprefs.leds_on_screen & STATUSLINE_TARGET))
+	if (!(currprefs.leds_on_screen & (STATUSLINE_CHIPSET | STATUSLINE_HOSTPROF)) || (currprefs.leds_on_screen & STATUSLINE_TARGET))
 		return;
 	bpp = gfxvidinfo.pixbytes;
 	y = line - (gfxvidinfo.height - TD_TOTAL_HEIGHT);
@@ -2414,7 +2424,12 @@ static void draw_status_line (int line, int statusy)
 	if (xlinebuffer == 0)
 		xlinebuffer = row_map[line];
 	buf = xlinebuffer;
-	draw_status_line_single (buf, bpp, statusy, gfxvidinfo.width, xredcolors, xgreencolors, xbluecolors, NULL);
+	if (currprefs.leds_on_screen & STATUSLINE_CHIPSET)
+		draw_status_line_single (buf, bpp, statusy, gfxvidinfo.width, xredcolors, xgreencolors, xbluecolors, NULL);
+#ifdef HOSTPROF
+	if (currprefs.leds_on_screen & STATUSLINE_HOSTPROF)
+		draw_status_line_hostprof (buf, bpp, statusy, gfxvidinfo.width, xredcolors, xgreencolors, xbluecolors, NULL);
+#endif
 }
 
 static void draw_debug_status_line (int line)
@@ -2562,6 +2577,12 @@ void finish_drawing_frame (void)
 		do_flush_line (where2);
 	}
 
+#ifdef RECORDER
+	/* before the status line goes on top */
+	if (recorder_active)
+		recorder_frame (gfxvidinfo.bufmem, gfxvidinfo.rowbytes, gfxvidinfo.width, gfxvidinfo.height, gfxvidinfo.pixbytes);
+#endif
+
 	if (currprefs.leds_on_screen) {
 		int slx, sly;
 		statusline_getpos (&slx, &sly, gfxvidinfo.width, gfxvidinfo.height);
@@ -2655,6 +2676,11 @@ void vsync_handle_redraw (int long_frame, int lof_changed)
 
 		if (framecnt == 0)
 			finish_drawing_frame ();
+#ifdef RECORDER
+		/* record what is shown, not the frames run again after run-ahead */
+		if (runahead_frame == runahead_frames)
+			recorder_vsync ();
+#endif
 		if (interlace_seen > 0) {
 			interlace_seen = -1;
 		} else if (interlace_seen == -1) {
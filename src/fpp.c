@@ -107,6 +107,10 @@ static double *fp_nan    = (double *)dhex_nan;
 double fp_1e8 = 1.0e8;
 float  fp_1e0 = 1, fp_1e1 = 10, fp_1e2 = 100, fp_1e4 = 10000;
 
+/* FMOVECR constant rom, converted once instead of on every FMOVECR */
+static fptype fp_cr_rom[0x40];
+static uae_u64 fp_cr_valid;
+
 #define FFLAG_Z	    0x4000
 #define FFLAG_N	    0x0100
 #define FFLAG_NAN   0x0400
@@ -1047,6 +1051,74 @@ static void fround (int reg)
 	regs.fp[reg] = (float)regs.fp[reg];
 }
 
+/*
+ * fpu_strict selects the accurate engine: results are rounded to the
+ * FPCR precision (FSGLDIV and FSGLMUL always to single, FSINCOS both
+ * registers) and libm functions with full precision near zero are used.
+ * Both engines still compute in host double precision, so extended
+ * precision results are not reproduced. The fast engine keeps host
+ * precision and the cheaper formulas.
+ */
+static void fround_fpcr (int reg)
+{
+	switch ((regs.fpcr >> 6) & 3)
+	{
+	case 1:
+		regs.fp[reg] = (float)regs.fp[reg];
+		break;
+#if USE_LONG_DOUBLE
+	case 2:
+		regs.fp[reg] = (double)regs.fp[reg];
+		break;
+#endif
+	}
+}
+
+/* single precision mantissa, the exponent keeps the extended range */
+static void fround_sgl (int reg)
+{
+	int expon;
+	fptype m = frexp (regs.fp[reg], &expon);
+
+	regs.fp[reg] = ldexp ((float)m, expon);
+}
+
+static void init_fp_cr_rom (void)
+{
+	static const int valid[] = {
+		0x00, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x30, 0x31, 0x32, 0x33, 0x34,
+		0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f, -1
+	};
+	int i;
+
+	if (fp_cr_valid)
+		return;
+	fp_cr_rom[0x00] = *fp_pi;
+	fp_cr_rom[0x0b] = *fp_l10_2;
+	fp_cr_rom[0x0c] = *fp_exp_1;
+	fp_cr_rom[0x0d] = *fp_l2_e;
+	fp_cr_rom[0x0e] = *fp_l10_e;
+	fp_cr_rom[0x0f] = 0.0;
+	fp_cr_rom[0x30] = *fp_ln_2;
+	fp_cr_rom[0x31] = *fp_ln_10;
+	fp_cr_rom[0x32] = (fptype)fp_1e0;
+	fp_cr_rom[0x33] = (fptype)fp_1e1;
+	fp_cr_rom[0x34] = (fptype)fp_1e2;
+	fp_cr_rom[0x35] = (fptype)fp_1e4;
+	fp_cr_rom[0x36] = (fptype)fp_1e8;
+	fp_cr_rom[0x37] = *fp_1e16;
+	fp_cr_rom[0x38] = *fp_1e32;
+	fp_cr_rom[0x39] = *fp_1e64;
+	fp_cr_rom[0x3a] = *fp_1e128;
+	fp_cr_rom[0x3b] = *fp_1e256;
+	fp_cr_rom[0x3c] = *fp_1e512;
+	fp_cr_rom[0x3d] = *fp_1e1024;
+	fp_cr_rom[0x3e] = *fp_1e2048;
+	fp_cr_rom[0x3f] = *fp_1e4096;
+	for (i = 0; valid[i] >= 0; i++)
+		fp_cr_valid |= (uae_u64)1 << valid[i];
+}
+
 void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 {
 	int reg;
@@ -1321,78 +1393,13 @@ void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 		case 2: /* Extremely common */
 			reg = (extra >> 7) & 7;
 			if ((extra & 0xfc00) == 0x5c00) {
-				switch (extra & 0x7f) {
-		case 0x00:
-			regs.fp[reg] = *fp_pi;
-			break;
-		case 0x0b:
-			regs.fp[reg] = *fp_l10_2;
-			break;
-		case 0x0c:
-			regs.fp[reg] = *fp_exp_1;
-			break;
-		case 0x0d:
-			regs.fp[reg] = *fp_l2_e;
-			break;
-		case 0x0e:
-			regs.fp[reg] = *fp_l10_e;
-			break;
-		case 0x0f:
-			regs.fp[reg] = 0.0;
-			break;
-		case 0x30:
-			regs.fp[reg] = *fp_ln_2;
-			break;
-		case 0x31:
-			regs.fp[reg] = *fp_ln_10;
-			break;
-		case 0x32:
-			regs.fp[reg] = (fptype)fp_1e0;
-			break;
-		case 0x33:
-			regs.fp[reg] = (fptype)fp_1e1;
-			break;
-		case 0x34:
-			regs.fp[reg] = (fptype)fp_1e2;
-			break;
-		case 0x35:
-			regs.fp[reg] = (fptype)fp_1e4;
-			break;
-		case 0x36:
-			regs.fp[reg] = (fptype)fp_1e8;
-			break;
-		case 0x37:
-			regs.fp[reg] = *fp_1e16;
-			break;
-		case 0x38:
-			regs.fp[reg] = *fp_1e32;
-			break;
-		case 0x39:
-			regs.fp[reg] = *fp_1e64;
-			break;
-		case 0x3a:
-			regs.fp[reg] = *fp_1e128;
-			break;
-		case 0x3b:
-			regs.fp[reg] = *fp_1e256;
-			break;
-		case 0x3c:
-			regs.fp[reg] = *fp_1e512;
-			break;
-		case 0x3d:
-			regs.fp[reg] = *fp_1e1024;
-			break;
-		case 0x3e:
-			regs.fp[reg] = *fp_1e2048;
-			break;
-		case 0x3f:
-			regs.fp[reg] = *fp_1e4096;
-			break;
-		default:
-			m68k_setpc (m68k_getpc () - 4);
-			op_illg (opcode);
-			return;
+				int off = extra & 0x7f;
+				if (off >= 0x40 || !(fp_cr_valid & ((uae_u64)1 << off))) {
+					m68k_setpc (m68k_getpc () - 4);
+					op_illg (opcode);
+					return;
 				}
+				regs.fp[reg] = fp_cr_rom[off];
 				MAKE_FPSR (regs.fp[reg]);
 				return;
 			}
@@ -1428,7 +1435,10 @@ void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 #else /* no X86_MSVC */
 			switch ((regs.fpcr >> 4) & 3) {
 		case 0: /* to nearest */
-			regs.fp[reg] = floor (src + 0.5);
+			if (currprefs.fpu_strict)
+				regs.fp[reg] = rint (src);
+			else
+				regs.fp[reg] = floor (src + 0.5);
 			break;
 		case 1: /* to zero */
 			if (src >= 0.0)
@@ -1451,7 +1461,10 @@ void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 			regs.fp[reg] = sinh (src);
 			break;
 		case 0x03: /* FINTRZ */
-			regs.fp[reg] = fp_round_to_zero(src);
+			if (currprefs.fpu_strict)
+				regs.fp[reg] = trunc (src);
+			else
+				regs.fp[reg] = fp_round_to_zero(src);
 			break;
 		case 0x04: /* FSQRT */
 		case 0x41:
@@ -1461,10 +1474,16 @@ void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 				fround (reg);
 			break;
 		case 0x06: /* FLOGNP1 */
-			regs.fp[reg] = log (src + 1.0);
+			if (currprefs.fpu_strict)
+				regs.fp[reg] = log1p (src);
+			else
+				regs.fp[reg] = log (src + 1.0);
 			break;
 		case 0x08: /* FETOXM1 */
-			regs.fp[reg] = exp (src) - 1.0;
+			if (currprefs.fpu_strict)
+				regs.fp[reg] = expm1 (src);
+			else
+				regs.fp[reg] = exp (src) - 1.0;
 			break;
 		case 0x09: /* FTANH */
 			regs.fp[reg] = tanh (src);
@@ -1477,7 +1496,10 @@ void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 			break;
 		case 0x0d: /* FATANH */
 #if 1	/* The BeBox doesn't have atanh, and it isn't in the HPUX libm either */
-			regs.fp[reg] = 0.5 * log ((1 + src) / (1 - src));
+			if (currprefs.fpu_strict)
+				regs.fp[reg] = 0.5 * log1p (2 * src / (1 - src));
+			else
+				regs.fp[reg] = 0.5 * log ((1 + src) / (1 - src));
 #else
 			regs.fp[reg] = atanh (src);
 #endif
@@ -1492,7 +1514,10 @@ void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 			regs.fp[reg] = exp (src);
 			break;
 		case 0x11: /* FTWOTOX */
-			regs.fp[reg] = pow (2.0, src);
+			if (currprefs.fpu_strict)
+				regs.fp[reg] = exp2 (src);
+			else
+				regs.fp[reg] = pow (2.0, src);
 			break;
 		case 0x12: /* FTENTOX */
 			regs.fp[reg] = pow (10.0, src);
@@ -1504,7 +1529,10 @@ void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 			regs.fp[reg] = log10 (src);
 			break;
 		case 0x16: /* FLOG2 */
-			regs.fp[reg] = *fp_l2_e * log (src);
+			if (currprefs.fpu_strict)
+				regs.fp[reg] = log2 (src);
+			else
+				regs.fp[reg] = *fp_l2_e * log (src);
 			break;
 		case 0x18: /* FABS */
 		case 0x58:
@@ -1558,7 +1586,9 @@ void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 				fround (reg);
 			break;
 		case 0x21: /* FMOD */
-			{
+			if (currprefs.fpu_strict) {
+				regs.fp[reg] = fmod (regs.fp[reg], src);
+			} else {
 				fptype quot = fp_round_to_zero(regs.fp[reg] / src);
 				regs.fp[reg] = regs.fp[reg] - quot * src;
 			}
@@ -1579,9 +1609,13 @@ void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 			break;
 		case 0x24: /* FSGLDIV */
 			regs.fp[reg] /= src;
+			if (currprefs.fpu_strict)
+				fround_sgl (reg);
 			break;
 		case 0x25: /* FREM */
-			{
+			if (currprefs.fpu_strict) {
+				regs.fp[reg] = remainder (regs.fp[reg], src);
+			} else {
 				fptype quot = fp_round_to_nearest(regs.fp[reg] / src);
 				regs.fp[reg] = regs.fp[reg] - quot * src;
 			}
@@ -1597,6 +1631,8 @@ void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 			break;
 		case 0x27: /* FSGLMUL */
 			regs.fp[reg] *= src;
+			if (currprefs.fpu_strict)
+				fround_sgl (reg);
 			break;
 		case 0x28: /* FSUB */
 		case 0x68:
@@ -1615,6 +1651,9 @@ void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 		case 0x37:
 			regs.fp[extra & 7] = cos (src);
 			regs.fp[reg] = sin (src);
+			/* the sine is rounded below with the other results */
+			if (currprefs.fpu_strict)
+				fround_fpcr (extra & 7);
 			break;
 		case 0x38: /* FCMP */
 			{
@@ -1632,6 +1671,8 @@ void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 			op_illg (opcode);
 			return;
 			}
+			if (currprefs.fpu_strict && !(extra & 0x40) && (extra & 0x7f) != 0x24 && (extra & 0x7f) != 0x27)
+				fround_fpcr (reg);
 			MAKE_FPSR (regs.fp[reg]);
 			return;
 	}
@@ -1641,6 +1682,7 @@ void fpuop_arithmetic (uae_u32 opcode, uae_u16 extra)
 
 void fpu_reset (void)
 {
+	init_fp_cr_rom ();
 	regs.fpcr = regs.fpsr = regs.fpiar = 0;
 	regs.fp_result = 1;
 	fpux_restore (NULL);
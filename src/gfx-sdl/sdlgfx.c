@@ -69,6 +69,7 @@ unsigned int shading_enabled = 0;
 #include "inputdevice.h"
 #include "hotkeys.h"
 #include "sdlgfx.h"
+#include "gfxfilter.h"
 
 /* Uncomment for debugging output */
 //#define DEBUG
@@ -327,6 +328,10 @@ static int init_colors (void)
 	blue_shift  = maskShift (display->format->Bmask);
 
 	alloc_colors64k (red_bits, green_bits, blue_bits, red_shift, green_shift, blue_shift, 0, 0, 0, 0);
+#ifdef GFXFILTER
+	S2X_configure (red_bits, green_bits, blue_bits, red_shift, green_shift, blue_shift);
+	S2X_refresh ();
+#endif
     } else {
 	alloc_colors256 (get_color);
 	SDL_SetColors (screen, arSDLColors, 0, 256);
@@ -814,6 +819,62 @@ static void sdl_flush_screen_flip (struct vidbuf_description *gfxinfo, int first
     idletime += sleep_time;
 }
 
+#ifdef GFXFILTER
+
+/**
+ ** Buffer methods with a software filter: the Amiga screen is drawn into
+ ** the filter's buffer and scaled into the display once per frame.
+ **/
+
+static void sdl_filter_flush_block (struct vidbuf_description *gfxinfo, int first_line, int last_line)
+{
+    S2X_invalidate (first_line, last_line);
+}
+
+static void sdl_filter_flush_screen (struct vidbuf_description *gfxinfo, int first_line, int last_line)
+{
+    int first, last, done;
+
+    if (SDL_MUSTLOCK (display) && SDL_LockSurface (display))
+		return;
+    done = S2X_render (display->pixels, display->pitch, &first, &last);
+    if (SDL_MUSTLOCK (display))
+		SDL_UnlockSurface (display);
+    if (display != screen)
+		sdl_flush_screen_flip (gfxinfo, first_line, last_line);
+    else if (done)
+		SDL_UpdateRect (display, 0, first, current_width, last - first + 1);
+}
+
+static int sdl_filter_init (void)
+{
+    int mult = S2X_getmult ();
+    int depth = display->format->BitsPerPixel;
+    int pitch;
+
+    S2X_init (current_width, current_height, current_width / mult, current_height / mult, depth, depth);
+    if (!usedfilter) {
+		write_log ("SDLGFX: no %d bit software filter, filter disabled\n", depth);
+		return 0;
+    }
+    /* hardware surfaces are only touched by S2X_render, under lock */
+    if (gfxvidinfo.emergmem) {
+		free (gfxvidinfo.emergmem);
+		gfxvidinfo.emergmem = 0;
+    }
+    gfxvidinfo.bufmem        = S2X_getbuffer (&pitch);
+    gfxvidinfo.rowbytes      = pitch;
+    gfxvidinfo.width         = current_width / mult;
+    gfxvidinfo.height        = current_height / mult;
+    gfxvidinfo.lockscr       = sdl_lock_nolock;
+    gfxvidinfo.unlockscr     = sdl_unlock_nolock;
+    gfxvidinfo.flush_block   = sdl_filter_flush_block;
+    gfxvidinfo.flush_screen  = sdl_filter_flush_screen;
+    return 1;
+}
+
+#endif /* GFXFILTER */
+
 static void sdl_flush_clear_screen (struct vidbuf_description *gfxinfo)
 {
     DEBUG_LOG ("Function: flush_clear_screen\n");
@@ -1145,6 +1206,10 @@ static int graphics_subinit (void)
 	    gfxvidinfo.linemem		= 0;
 	    gfxvidinfo.pixbytes		= display->format->BytesPerPixel;
 	    gfxvidinfo.rowbytes		= display->pitch;
+#ifdef GFXFILTER
+	    if (currprefs.gfx_filter > 0)
+			sdl_filter_init ();
+#endif
 
 
 	    SDL_SetColors (display, arSDLColors, 0, 256);
@@ -1244,6 +1309,9 @@ static void graphics_subshutdown (void)
     }
     display = screen = 0;
     mousehack = 0;
+#ifdef GFXFILTER
+    S2X_free ();
+#endif
 
     if (gfxvidinfo.emergmem) {
 	free (gfxvidinfo.emergmem);
@@ -1534,7 +1602,9 @@ int check_prefs_changed_gfx (void)
 		&& changed_prefs.gfx_xcenter		== currprefs.gfx_xcenter
 		&& changed_prefs.gfx_ycenter		== currprefs.gfx_ycenter
 		&& changed_prefs.gfx_afullscreen	== currprefs.gfx_afullscreen
-		&& changed_prefs.gfx_pfullscreen	== currprefs.gfx_pfullscreen) {
+		&& changed_prefs.gfx_pfullscreen	== currprefs.gfx_pfullscreen
+		&& changed_prefs.gfx_filter		== currprefs.gfx_filter
+		&& changed_prefs.gfx_filter_filtermode	== currprefs.gfx_filter_filtermode) {
 		return 0;
     }
 
@@ -1555,6 +1625,8 @@ int check_prefs_changed_gfx (void)
 	currprefs.gfx_ycenter			= changed_prefs.gfx_ycenter;
 	currprefs.gfx_afullscreen		= changed_prefs.gfx_afullscreen;
 	currprefs.gfx_pfullscreen		= changed_prefs.gfx_pfullscreen;
+	currprefs.gfx_filter			= changed_prefs.gfx_filter;
+	currprefs.gfx_filter_filtermode	= changed_prefs.gfx_filter_filtermode;
 
 #ifdef PICASSO96
 	if (!screen_is_picasso)
@@ -1836,6 +1908,13 @@ void gfx_set_picasso_state (int on)
 		// Set height, width for Amiga gfx
 		current_width  = gfxvidinfo.width;
 		current_height = gfxvidinfo.height;
+#ifdef GFXFILTER
+		/* gfxvidinfo has the size of the filter's source buffer */
+		if (currprefs.gfx_filter > 0) {
+			current_width  *= S2X_getmult ();
+			current_height *= S2X_getmult ();
+		}
+#endif
 		graphics_subinit ();
 	}
 
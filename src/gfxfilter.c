@@ -0,0 +1,880 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Software display filters
+  *
+  * The Amiga display is drawn into a buffer at 1/mult of the window size
+  * and scaled into the window once per frame. Only bands of S2X_BAND
+  * source lines that drawing.c flushed since the last frame are scaled
+  * again, and the dirty bands are shared out to a small thread pool with
+  * the calling thread taking part. Scale2x, Scale3x and the PAL blur have
+  * SSE2 kernels; everything has a plain C version for other hosts.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#ifdef GFXFILTER
+
+#include "options.h"
+#include "gfxfilter.h"
+#include "threaddep/thread.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define S2X_BAND 16
+#define S2X_MAXTHREADS 8
+
+struct uae_filter uaefilters[] =
+{
+	{ UAE_FILTER_NULL, 0, 1, "Null filter", "null", UAE_FILTER_MODE_16_16 | UAE_FILTER_MODE_32_32 },
+	{ UAE_FILTER_SCALE2X, 0, 2, "Scale2X", "scale2x", UAE_FILTER_MODE_16_16 | UAE_FILTER_MODE_32_32 },
+	{ UAE_FILTER_HQ2X, 0, 2, "hq2x", "hq2x", UAE_FILTER_MODE_16_16 | UAE_FILTER_MODE_32_32 },
+	{ UAE_FILTER_HQ3X, 0, 3, "hq3x", "hq3x", UAE_FILTER_MODE_16_16 | UAE_FILTER_MODE_32_32 },
+	{ UAE_FILTER_HQ4X, 0, 4, "hq4x", "hq4x", UAE_FILTER_MODE_16_16 | UAE_FILTER_MODE_32_32 },
+	{ UAE_FILTER_PAL, 0, 1, "PAL", "pal", UAE_FILTER_MODE_16_16 | UAE_FILTER_MODE_32_32 },
+	{ 0 }
+};
+
+/* pixel layout, from S2X_configure */
+static int red_bits = 8, green_bits = 8, blue_bits = 8;
+static int red_shift = 16, green_shift = 8, blue_shift = 0;
+static uae_u32 mask_rb = 0xff00ff, mask_g = 0x00ff00, mask_low = 0x010101;
+
+static int s2x_type, s2x_mult, s2x_depth;
+static int dst_width, dst_height, amiga_width, amiga_height;
+static uae_u8 *amiga_buf;
+static int amiga_pitch;
+static uae_u8 *band_dirty;
+static int band_count;
+
+static uae_u8 *s2x_dst;
+static int s2x_dstpitch;
+static int *s2x_jobs;
+static volatile int s2x_njobs, s2x_next;
+static uae_sem_t s2x_go, s2x_done;
+static volatile int s2x_quit;
+static int s2x_threads;
+
+/* blends, weights add up to 4 */
+STATIC_INLINE uae_u32 blend2 (uae_u32 a, int wa, uae_u32 b, int wb)
+{
+	uae_u64 rb = (uae_u64)(a & mask_rb) * wa + (uae_u64)(b & mask_rb) * wb;
+	uae_u64 g = (uae_u64)(a & mask_g) * wa + (uae_u64)(b & mask_g) * wb;
+	return (uae_u32)(((rb >> 2) & mask_rb) | ((g >> 2) & mask_g));
+}
+
+STATIC_INLINE uae_u32 blend3 (uae_u32 a, int wa, uae_u32 b, int wb, uae_u32 c, int wc)
+{
+	uae_u64 rb = (uae_u64)(a & mask_rb) * wa + (uae_u64)(b & mask_rb) * wb + (uae_u64)(c & mask_rb) * wc;
+	uae_u64 g = (uae_u64)(a & mask_g) * wa + (uae_u64)(b & mask_g) * wb + (uae_u64)(c & mask_g) * wc;
+	return (uae_u32)(((rb >> 2) & mask_rb) | ((g >> 2) & mask_g));
+}
+
+STATIC_INLINE int clampline (int y, int height)
+{
+	return y < 0 ? 0 : (y >= height ? height - 1 : y);
+}
+
+/*
+ * Scale2x
+ */
+
+#define SCALE2X_PIXEL(T, B, D, E, F, H, d0, d1) \
+	if (B != H && D != F) { \
+		(d0)[0] = D == B ? D : E; \
+		(d0)[1] = B == F ? F : E; \
+		(d1)[0] = D == H ? D : E; \
+		(d1)[1] = H == F ? F : E; \
+	} else { \
+		(d0)[0] = (d0)[1] = (d1)[0] = (d1)[1] = E; \
+	}
+
+#define SCALE2X_LINE(T, from, to) \
+	for (x = from; x < to; x++) { \
+		T B = b[x], E = e[x], H = h[x]; \
+		T D = e[x > 0 ? x - 1 : 0], F = e[x < width - 1 ? x + 1 : x]; \
+		SCALE2X_PIXEL (T, B, D, E, F, H, d0 + 2 * x, d1 + 2 * x) \
+	}
+
+#ifdef __SSE2__
+STATIC_INLINE __m128i sel (__m128i m, __m128i a, __m128i b)
+{
+	return _mm_or_si128 (_mm_and_si128 (m, a), _mm_andnot_si128 (m, b));
+}
+#define LOADU(p) _mm_loadu_si128 ((const __m128i*)(p))
+#define STOREU(p, v) _mm_storeu_si128 ((__m128i*)(p), v)
+#endif
+
+void scale2x_32 (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int height)
+{
+	int y;
+
+	for (y = y0; y < y1; y++) {
+		const uae_u32 *b = (const uae_u32*)(src + clampline (y - 1, height) * srcpitch);
+		const uae_u32 *e = (const uae_u32*)(src + y * srcpitch);
+		const uae_u32 *h = (const uae_u32*)(src + clampline (y + 1, height) * srcpitch);
+		uae_u32 *d0 = (uae_u32*)(dst + 2 * y * dstpitch);
+		uae_u32 *d1 = (uae_u32*)(dst + (2 * y + 1) * dstpitch);
+		int x = 1;
+
+		SCALE2X_LINE (uae_u32, 0, 1);
+#ifdef __SSE2__
+		for (; x + 4 < width; x += 4) {
+			__m128i vb = LOADU (b + x), ve = LOADU (e + x), vh = LOADU (h + x);
+			__m128i vd = LOADU (e + x - 1), vf = LOADU (e + x + 1);
+			__m128i m = _mm_andnot_si128 (_mm_or_si128 (_mm_cmpeq_epi32 (vb, vh), _mm_cmpeq_epi32 (vd, vf)), _mm_set1_epi32 (-1));
+			__m128i e0 = sel (_mm_and_si128 (m, _mm_cmpeq_epi32 (vd, vb)), vd, ve);
+			__m128i e1 = sel (_mm_and_si128 (m, _mm_cmpeq_epi32 (vb, vf)), vf, ve);
+			__m128i e2 = sel (_mm_and_si128 (m, _mm_cmpeq_epi32 (vd, vh)), vd, ve);
+			__m128i e3 = sel (_mm_and_si128 (m, _mm_cmpeq_epi32 (vh, vf)), vf, ve);
+			STOREU (d0 + 2 * x, _mm_unpacklo_epi32 (e0, e1));
+			STOREU (d0 + 2 * x + 4, _mm_unpackhi_epi32 (e0, e1));
+			STOREU (d1 + 2 * x, _mm_unpacklo_epi32 (e2, e3));
+			STOREU (d1 + 2 * x + 4, _mm_unpackhi_epi32 (e2, e3));
+		}
+#endif
+		SCALE2X_LINE (uae_u32, x, width);
+	}
+}
+
+void scale2x_16 (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int height)
+{
+	int y;
+
+	for (y = y0; y < y1; y++) {
+		const uae_u16 *b = (const uae_u16*)(src + clampline (y - 1, height) * srcpitch);
+		const uae_u16 *e = (const uae_u16*)(src + y * srcpitch);
+		const uae_u16 *h = (const uae_u16*)(src + clampline (y + 1, height) * srcpitch);
+		uae_u16 *d0 = (uae_u16*)(dst + 2 * y * dstpitch);
+		uae_u16 *d1 = (uae_u16*)(dst + (2 * y + 1) * dstpitch);
+		int x = 1;
+
+		SCALE2X_LINE (uae_u16, 0, 1);
+#ifdef __SSE2__
+		for (; x + 8 < width; x += 8) {
+			__m128i vb = LOADU (b + x), ve = LOADU (e + x), vh = LOADU (h + x);
+			__m128i vd = LOADU (e + x - 1), vf = LOADU (e + x + 1);
+			__m128i m = _mm_andnot_si128 (_mm_or_si128 (_mm_cmpeq_epi16 (vb, vh), _mm_cmpeq_epi16 (vd, vf)), _mm_set1_epi32 (-1));
+			__m128i e0 = sel (_mm_and_si128 (m, _mm_cmpeq_epi16 (vd, vb)), vd, ve);
+			__m128i e1 = sel (_mm_and_si128 (m, _mm_cmpeq_epi16 (vb, vf)), vf, ve);
+			__m128i e2 = sel (_mm_and_si128 (m, _mm_cmpeq_epi16 (vd, vh)), vd, ve);
+			__m128i e3 = sel (_mm_and_si128 (m, _mm_cmpeq_epi16 (vh, vf)), vf, ve);
+			STOREU (d0 + 2 * x, _mm_unpacklo_epi16 (e0, e1));
+			STOREU (d0 + 2 * x + 8, _mm_unpackhi_epi16 (e0, e1));
+			STOREU (d1 + 2 * x, _mm_unpacklo_epi16 (e2, e3));
+			STOREU (d1 + 2 * x + 8, _mm_unpackhi_epi16 (e2, e3));
+		}
+#endif
+		SCALE2X_LINE (uae_u16, x, width);
+	}
+}
+
+/*
+ * Scale3x
+ */
+
+#define SCALE3X_LINE(T, from, to) \
+	for (x = from; x < to; x++) { \
+		int xl = x > 0 ? x - 1 : 0, xr = x < width - 1 ? x + 1 : x; \
+		T A = b[xl], B = b[x], C = b[xr]; \
+		T D = e[xl], E = e[x], F = e[xr]; \
+		T G = h[xl], H = h[x], I = h[xr]; \
+		T *p0 = d0 + 3 * x, *p1 = d1 + 3 * x, *p2 = d2 + 3 * x; \
+		if (B != H && D != F) { \
+			p0[0] = D == B ? D : E; \
+			p0[1] = (D == B && E != C) || (B == F && E != A) ? B : E; \
+			p0[2] = B == F ? F : E; \
+			p1[0] = (D == B && E != G) || (D == H && E != A) ? D : E; \
+			p1[1] = E; \
+			p1[2] = (B == F && E != I) || (H == F && E != C) ? F : E; \
+			p2[0] = D == H ? D : E; \
+			p2[1] = (D == H && E != I) || (H == F && E != G) ? H : E; \
+			p2[2] = H == F ? F : E; \
+		} else { \
+			p0[0] = p0[1] = p0[2] = E; \
+			p1[0] = p1[1] = p1[2] = E; \
+			p2[0] = p2[1] = p2[2] = E; \
+		} \
+	}
+
+#ifdef __SSE2__
+/* The nine outputs are selected in vector registers, there is no cheap
+ * 3-way interleave in SSE2 so they are spread out through a small buffer. */
+#define SCALE3X_SSE2(T, N, CMPEQ) \
+	for (; x + N < width; x += N) { \
+		__m128i va = LOADU (b + x - 1), vb = LOADU (b + x), vc = LOADU (b + x + 1); \
+		__m128i vd = LOADU (e + x - 1), ve = LOADU (e + x), vf = LOADU (e + x + 1); \
+		__m128i vg = LOADU (h + x - 1), vh = LOADU (h + x), vi = LOADU (h + x + 1); \
+		__m128i ones = _mm_set1_epi32 (-1); \
+		__m128i m = _mm_andnot_si128 (_mm_or_si128 (CMPEQ (vb, vh), CMPEQ (vd, vf)), ones); \
+		__m128i db = _mm_and_si128 (m, CMPEQ (vd, vb)), bf = _mm_and_si128 (m, CMPEQ (vb, vf)); \
+		__m128i dh = _mm_and_si128 (m, CMPEQ (vd, vh)), hf = _mm_and_si128 (m, CMPEQ (vh, vf)); \
+		__m128i nea = _mm_andnot_si128 (CMPEQ (ve, va), ones), nec = _mm_andnot_si128 (CMPEQ (ve, vc), ones); \
+		__m128i neg = _mm_andnot_si128 (CMPEQ (ve, vg), ones), nei = _mm_andnot_si128 (CMPEQ (ve, vi), ones); \
+		T out[9][N]; \
+		int i; \
+		STOREU (out[0], sel (db, vd, ve)); \
+		STOREU (out[1], sel (_mm_or_si128 (_mm_and_si128 (db, nec), _mm_and_si128 (bf, nea)), vb, ve)); \
+		STOREU (out[2], sel (bf, vf, ve)); \
+		STOREU (out[3], sel (_mm_or_si128 (_mm_and_si128 (db, neg), _mm_and_si128 (dh, nea)), vd, ve)); \
+		STOREU (out[4], ve); \
+		STOREU (out[5], sel (_mm_or_si128 (_mm_and_si128 (bf, nei), _mm_and_si128 (hf, nec)), vf, ve)); \
+		STOREU (out[6], sel (dh, vd, ve)); \
+		STOREU (out[7], sel (_mm_or_si128 (_mm_and_si128 (dh, nei), _mm_and_si128 (hf, neg)), vh, ve)); \
+		STOREU (out[8], sel (hf, vf, ve)); \
+		for (i = 0; i < N; i++) { \
+			T *p0 = d0 + 3 * (x + i), *p1 = d1 + 3 * (x + i), *p2 = d2 + 3 * (x + i); \
+			p0[0] = out[0][i]; p0[1] = out[1][i]; p0[2] = out[2][i]; \
+			p1[0] = out[3][i]; p1[1] = out[4][i]; p1[2] = out[5][i]; \
+			p2[0] = out[6][i]; p2[1] = out[7][i]; p2[2] = out[8][i]; \
+		} \
+	}
+#endif
+
+void scale3x_32 (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int height)
+{
+	int y;
+
+	for (y = y0; y < y1; y++) {
+		const uae_u32 *b = (const uae_u32*)(src + clampline (y - 1, height) * srcpitch);
+		const uae_u32 *e = (const uae_u32*)(src + y * srcpitch);
+		const uae_u32 *h = (const uae_u32*)(src + clampline (y + 1, height) * srcpitch);
+		uae_u32 *d0 = (uae_u32*)(dst + 3 * y * dstpitch);
+		uae_u32 *d1 = (uae_u32*)(dst + (3 * y + 1) * dstpitch);
+		uae_u32 *d2 = (uae_u32*)(dst + (3 * y + 2) * dstpitch);
+		int x = 1;
+
+		SCALE3X_LINE (uae_u32, 0, 1);
+#ifdef __SSE2__
+		SCALE3X_SSE2 (uae_u32, 4, _mm_cmpeq_epi32);
+#endif
+		SCALE3X_LINE (uae_u32, x, width);
+	}
+}
+
+void scale3x_16 (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int height)
+{
+	int y;
+
+	for (y = y0; y < y1; y++) {
+		const uae_u16 *b = (const uae_u16*)(src + clampline (y - 1, height) * srcpitch);
+		const uae_u16 *e = (const uae_u16*)(src + y * srcpitch);
+		const uae_u16 *h = (const uae_u16*)(src + clampline (y + 1, height) * srcpitch);
+		uae_u16 *d0 = (uae_u16*)(dst + 3 * y * dstpitch);
+		uae_u16 *d1 = (uae_u16*)(dst + (3 * y + 1) * dstpitch);
+		uae_u16 *d2 = (uae_u16*)(dst + (3 * y + 2) * dstpitch);
+		int x = 1;
+
+		SCALE3X_LINE (uae_u16, 0, 1);
+#ifdef __SSE2__
+		SCALE3X_SSE2 (uae_u16, 8, _mm_cmpeq_epi16);
+#endif
+		SCALE3X_LINE (uae_u16, x, width);
+	}
+}
+
+/*
+ * hq2x/3x/4x
+ *
+ * Not the original 256 case tables: neighbours are compared in YUV with
+ * the hq2x thresholds, and each corner of the output block is smoothed
+ * when an edge runs across it (the two side neighbours match each other
+ * but not the centre pixel), or blended towards a differing diagonal.
+ * Output pixels on the border of the block next to such an edge get a
+ * lighter blend, the rest is the centre pixel.
+ *
+ * Every comparison a block needs is between a pixel and its right
+ * neighbour or one of the three below it, so each line is converted to
+ * YUV once and compared with the next line once, into four bits per
+ * pixel. Blocks then only look up bits, most have none set and are a
+ * plain fill.
+ */
+
+#define HQ_R 1		/* right */
+#define HQ_D 2		/* below */
+#define HQ_DR 4		/* below right */
+#define HQ_DL 8		/* below left */
+
+/* corner flags: edge across the corner, diagonal differs */
+#define HQ_EDGE(c) (1 << (c))
+#define HQ_DIAG(c) (16 << (c))
+
+STATIC_INLINE uae_u32 rgb2yuv (uae_u32 p)
+{
+	int r = ((p >> red_shift) & ((1 << red_bits) - 1)) << (8 - red_bits);
+	int g = ((p >> green_shift) & ((1 << green_bits) - 1)) << (8 - green_bits);
+	int b = ((p >> blue_shift) & ((1 << blue_bits) - 1)) << (8 - blue_bits);
+	int y = (r + g + b) >> 2;
+	int u = 128 + ((r - b) >> 2);
+	int v = 128 + ((-r + 2 * g - b) >> 3);
+	return (y << 16) | (u << 8) | v;
+}
+
+STATIC_INLINE int yuvdiff (uae_u32 a, uae_u32 b)
+{
+	return a != b && (abs ((int)(a >> 16) - (int)(b >> 16)) > 48
+		|| abs ((int)((a >> 8) & 0xff) - (int)((b >> 8) & 0xff)) > 7
+		|| abs ((int)(a & 0xff) - (int)(b & 0xff)) > 6);
+}
+
+static void hq_yuv_line (const uae_u8 *src, uae_u32 *yuv, int width, int bpp)
+{
+	int x;
+
+	for (x = 0; x < width; x++)
+		yuv[x] = rgb2yuv (bpp == 4 ? ((const uae_u32*)src)[x] : ((const uae_u16*)src)[x]);
+}
+
+#define HQ_DIFF_PIXEL(x) \
+	m[x] = yuvdiff (a[x], a[x < width - 1 ? x + 1 : x]) * HQ_R \
+		| yuvdiff (a[x], b[x]) * HQ_D \
+		| yuvdiff (a[x], b[x < width - 1 ? x + 1 : x]) * HQ_DR \
+		| yuvdiff (a[x], b[x > 0 ? x - 1 : 0]) * HQ_DL;
+
+#ifdef __SSE2__
+/* all ones in the lanes that differ */
+STATIC_INLINE __m128i hq_differ_sse2 (__m128i a, __m128i b, __m128i thr)
+{
+	__m128i d = _mm_or_si128 (_mm_subs_epu8 (a, b), _mm_subs_epu8 (b, a));
+	return _mm_xor_si128 (_mm_cmpeq_epi32 (_mm_subs_epu8 (d, thr), _mm_setzero_si128 ()), _mm_set1_epi32 (-1));
+}
+#endif
+
+/* line a against itself and line b below it, neighbours clamped at the
+ * edges like everywhere else */
+static void hq_diff_line (const uae_u32 *a, const uae_u32 *b, uae_u8 *m, int width)
+{
+	int x = 0;
+
+	HQ_DIFF_PIXEL (0);
+	x = 1;
+#ifdef __SSE2__
+	{
+		const __m128i thr = _mm_set1_epi32 ((48 << 16) | (7 << 8) | 6);
+		for (; x + 5 <= width; x += 4) {
+			__m128i e = _mm_loadu_si128 ((const __m128i*)(a + x));
+			__m128i bits = _mm_and_si128 (hq_differ_sse2 (e, _mm_loadu_si128 ((const __m128i*)(a + x + 1)), thr), _mm_set1_epi32 (HQ_R));
+			bits = _mm_or_si128 (bits, _mm_and_si128 (hq_differ_sse2 (e, _mm_loadu_si128 ((const __m128i*)(b + x)), thr), _mm_set1_epi32 (HQ_D)));
+			bits = _mm_or_si128 (bits, _mm_and_si128 (hq_differ_sse2 (e, _mm_loadu_si128 ((const __m128i*)(b + x + 1)), thr), _mm_set1_epi32 (HQ_DR)));
+			bits = _mm_or_si128 (bits, _mm_and_si128 (hq_differ_sse2 (e, _mm_loadu_si128 ((const __m128i*)(b + x - 1)), thr), _mm_set1_epi32 (HQ_DL)));
+			bits = _mm_packs_epi32 (bits, bits);
+			bits = _mm_packus_epi16 (bits, bits);
+			*(uae_u32*)(m + x) = _mm_cvtsi128_si32 (bits);
+		}
+	}
+#endif
+	for (; x < width; x++)
+		HQ_DIFF_PIXEL (x);
+}
+
+/* corner flags of pixel x from the bits of the line above (up) and of
+ * its own line (cur), see HQ_R */
+STATIC_INLINE int hq_flags (const uae_u8 *up, const uae_u8 *cur, int x, int width)
+{
+	int first = x == 0, last = x == width - 1;
+	int eb = up[x] & HQ_D, eh = cur[x] & HQ_D;
+	int ed = first ? 0 : cur[x - 1] & HQ_R;
+	int ef = cur[x] & HQ_R;
+	int ea = first ? eb : up[x - 1] & HQ_DR;
+	int ec = last ? eb : up[x + 1] & HQ_DL;
+	int eg = cur[x] & HQ_DL, ei = cur[x] & HQ_DR;
+	int db = up[x] & HQ_DL, fb = up[x] & HQ_DR;
+	int dh = first ? eh : cur[x - 1] & HQ_DR;
+	int fh = last ? eh : cur[x + 1] & HQ_DL;
+	int f = 0;
+
+	if (ed && !db)
+		f |= HQ_EDGE (0);
+	if (ef && !fb)
+		f |= HQ_EDGE (1);
+	if (ed && !dh)
+		f |= HQ_EDGE (2);
+	if (ef && !fh)
+		f |= HQ_EDGE (3);
+	if (ea)
+		f |= HQ_DIAG (0);
+	if (ec)
+		f |= HQ_DIAG (1);
+	if (eg)
+		f |= HQ_DIAG (2);
+	if (ei)
+		f |= HQ_DIAG (3);
+	return f;
+}
+
+/* n[] is the 3x3 neighbourhood (A B C / D E F / G H I) */
+STATIC_INLINE void hq_block (const uae_u32 *n, int flags, uae_u32 *out, int mult)
+{
+	/* corners in order top-left, top-right, bottom-left, bottom-right:
+	 * horizontal side, vertical side and diagonal neighbour */
+	static const int side_h[4] = { 3, 5, 3, 5 }, side_v[4] = { 1, 1, 7, 7 }, diag[4] = { 0, 2, 6, 8 };
+	uae_u32 e = n[4];
+	int c, i;
+
+	for (i = 0; i < mult * mult; i++)
+		out[i] = e;
+	for (c = 0; c < 4; c++) {
+		int ox = c & 1 ? mult - 1 : 0, oy = c & 2 ? mult - 1 : 0;
+		int ix = c & 1 ? mult - 2 : 1, iy = c & 2 ? mult - 2 : 1;
+		if (flags & HQ_EDGE (c)) {
+			out[oy * mult + ox] = blend3 (e, 2, n[side_h[c]], 1, n[side_v[c]], 1);
+			if (mult > 2) {
+				out[iy * mult + ox] = blend2 (e, 3, n[side_h[c]], 1);
+				out[oy * mult + ix] = blend2 (e, 3, n[side_v[c]], 1);
+			}
+		} else if (flags & HQ_DIAG (c)) {
+			out[oy * mult + ox] = blend2 (e, 3, n[diag[c]], 1);
+		}
+	}
+}
+
+#define HQ_PUT(T) \
+	for (j = 0; j < mult; j++) { \
+		T *d = (T*)(dst + (y * mult + j) * dstpitch) + x * mult; \
+		for (i = 0; i < mult; i++) \
+			d[i] = flags ? out[j * mult + i] : e; \
+	}
+
+STATIC_INLINE void hq_line (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y, int height, int mult, int bpp, const uae_u8 *up, const uae_u8 *cur)
+{
+	const uae_u8 *rows[3];
+	uae_u32 out[16];
+	int x, i, j, k;
+
+	rows[0] = src + clampline (y - 1, height) * srcpitch;
+	rows[1] = src + y * srcpitch;
+	rows[2] = src + clampline (y + 1, height) * srcpitch;
+	for (x = 0; x < width; x++) {
+		int flags = hq_flags (up, cur, x, width);
+		uae_u32 e = bpp == 4 ? ((const uae_u32*)rows[1])[x] : ((const uae_u16*)rows[1])[x];
+		if (flags) {
+			int xs[3] = { x > 0 ? x - 1 : 0, x, x < width - 1 ? x + 1 : x };
+			uae_u32 n[9];
+			for (k = 0; k < 3; k++) {
+				for (i = 0; i < 3; i++)
+					n[k * 3 + i] = bpp == 4 ? ((const uae_u32*)rows[k])[xs[i]] : ((const uae_u16*)rows[k])[xs[i]];
+			}
+			hq_block (n, flags, out, mult);
+		}
+		if (bpp == 4) {
+			HQ_PUT (uae_u32);
+		} else {
+			HQ_PUT (uae_u16);
+		}
+	}
+}
+
+/* Lines y0 to y1 - 1. The YUV and comparison bits of a line are made
+ * once and used by the line itself and the one below it. */
+#define HQ_LINES(m, bpp) \
+	for (y = y0; y < y1; y++) { \
+		uae_u32 *t32; \
+		uae_u8 *t8; \
+		hq_yuv_line (src + clampline (y + 1, height) * srcpitch, ynext, width, bpp); \
+		hq_diff_line (ycur, ynext, cur, width); \
+		hq_line (src, srcpitch, dst, dstpitch, width, y, height, m, bpp, up, cur); \
+		t32 = ycur; ycur = ynext; ynext = t32; \
+		t8 = up; up = cur; cur = t8; \
+	}
+
+static void hq_render (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int height, int mult, int bpp)
+{
+	uae_u32 *yuv = xmalloc (uae_u32, 2 * width);
+	uae_u8 *bits = xmalloc (uae_u8, 2 * width);
+	uae_u32 *ycur = yuv, *ynext = yuv + width;
+	uae_u8 *up = bits, *cur = bits + width;
+	int y;
+
+	/* the line above the first one, against the first one */
+	hq_yuv_line (src + clampline (y0 - 1, height) * srcpitch, ynext, width, bpp);
+	hq_yuv_line (src + y0 * srcpitch, ycur, width, bpp);
+	hq_diff_line (ynext, ycur, up, width);
+	if (bpp == 4) {
+		switch (mult)
+		{
+		case 2: HQ_LINES (2, 4); break;
+		case 3: HQ_LINES (3, 4); break;
+		default: HQ_LINES (4, 4); break;
+		}
+	} else {
+		switch (mult)
+		{
+		case 2: HQ_LINES (2, 2); break;
+		case 3: HQ_LINES (3, 2); break;
+		default: HQ_LINES (4, 2); break;
+		}
+	}
+	xfree (yuv);
+	xfree (bits);
+}
+
+void hq_32 (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int height, int mult)
+{
+	hq_render (src, srcpitch, dst, dstpitch, width, y0, y1, height, mult, 4);
+}
+
+void hq_16 (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int height, int mult)
+{
+	hq_render (src, srcpitch, dst, dstpitch, width, y0, y1, height, mult, 2);
+}
+
+/*
+ * PAL: 1-2-1 horizontal blur, the colour bleed of a composite signal.
+ * Averages round up, like the SSE2 pavgb.
+ */
+
+STATIC_INLINE uae_u32 avg_up (uae_u32 a, uae_u32 b, uae_u32 lowbits)
+{
+	return (a | b) - (((a ^ b) & ~lowbits) >> 1);
+}
+
+void PAL_init (void)
+{
+}
+
+void PAL_1x1_32 (uae_u32 *src, int pitchs, uae_u32 *trg, int pitcht, int width, int height)
+{
+	int x, y;
+
+	for (y = 0; y < height; y++) {
+		const uae_u32 *s = (const uae_u32*)((uae_u8*)src + y * pitchs);
+		uae_u32 *d = (uae_u32*)((uae_u8*)trg + y * pitcht);
+
+		x = 0;
+		if (width > 1)
+			d[x++] = avg_up (avg_up (s[0], s[1], 0x01010101), s[0], 0x01010101);
+#ifdef __SSE2__
+		for (; x + 4 < width; x += 4) {
+			__m128i l = LOADU (s + x - 1), c = LOADU (s + x), r = LOADU (s + x + 1);
+			STOREU (d + x, _mm_avg_epu8 (_mm_avg_epu8 (l, r), c));
+		}
+#endif
+		for (; x < width; x++) {
+			uae_u32 l = s[x > 0 ? x - 1 : 0], r = s[x < width - 1 ? x + 1 : x];
+			d[x] = avg_up (avg_up (l, r, 0x01010101), s[x], 0x01010101);
+		}
+	}
+}
+
+void PAL_1x1_16 (uae_u16 *src, int pitchs, uae_u16 *trg, int pitcht, int width, int height)
+{
+	uae_u32 low = mask_low;
+	int x, y;
+
+	for (y = 0; y < height; y++) {
+		const uae_u16 *s = (const uae_u16*)((uae_u8*)src + y * pitchs);
+		uae_u16 *d = (uae_u16*)((uae_u8*)trg + y * pitcht);
+
+		x = 0;
+		if (width > 1)
+			d[x++] = avg_up (avg_up (s[0], s[1], low), s[0], low);
+#ifdef __SSE2__
+		{
+			__m128i hi = _mm_set1_epi16 ((short)~low);
+			for (; x + 8 < width; x += 8) {
+				__m128i l = LOADU (s + x - 1), c = LOADU (s + x), r = LOADU (s + x + 1);
+				__m128i a = _mm_sub_epi16 (_mm_or_si128 (l, r), _mm_srli_epi16 (_mm_and_si128 (_mm_xor_si128 (l, r), hi), 1));
+				a = _mm_sub_epi16 (_mm_or_si128 (a, c), _mm_srli_epi16 (_mm_and_si128 (_mm_xor_si128 (a, c), hi), 1));
+				STOREU (d + x, a);
+			}
+		}
+#endif
+		for (; x < width; x++) {
+			uae_u32 l = s[x > 0 ? x - 1 : 0], r = s[x < width - 1 ? x + 1 : x];
+			d[x] = avg_up (avg_up (l, r, low), s[x], low);
+		}
+	}
+}
+
+/*
+ * Nearest neighbour
+ */
+
+static void null_scale (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int mult, int bpp)
+{
+	int x, y, i;
+
+	for (y = y0; y < y1; y++) {
+		const uae_u8 *s = src + y * srcpitch;
+		uae_u8 *d = dst + y * mult * dstpitch;
+		if (mult == 1) {
+			memcpy (d, s, width * bpp);
+			continue;
+		}
+		if (bpp == 4) {
+			for (x = 0; x < width; x++) {
+				for (i = 0; i < mult; i++)
+					((uae_u32*)d)[x * mult + i] = ((const uae_u32*)s)[x];
+			}
+		} else {
+			for (x = 0; x < width; x++) {
+				for (i = 0; i < mult; i++)
+					((uae_u16*)d)[x * mult + i] = ((const uae_u16*)s)[x];
+			}
+		}
+		for (i = 1; i < mult; i++)
+			memcpy (d + i * dstpitch, d, width * mult * bpp);
+	}
+}
+
+/*
+ * Band scheduling
+ */
+
+static void s2x_band (int band)
+{
+	int y0 = band * S2X_BAND;
+	int y1 = y0 + S2X_BAND > amiga_height ? amiga_height : y0 + S2X_BAND;
+	int bpp = s2x_depth / 8;
+
+	switch (s2x_type)
+	{
+	case UAE_FILTER_SCALE2X:
+		if (s2x_mult == 3) {
+			if (bpp == 4)
+				scale3x_32 (amiga_buf, amiga_pitch, s2x_dst, s2x_dstpitch, amiga_width, y0, y1, amiga_height);
+			else
+				scale3x_16 (amiga_buf, amiga_pitch, s2x_dst, s2x_dstpitch, amiga_width, y0, y1, amiga_height);
+		} else {
+			if (bpp == 4)
+				scale2x_32 (amiga_buf, amiga_pitch, s2x_dst, s2x_dstpitch, amiga_width, y0, y1, amiga_height);
+			else
+				scale2x_16 (amiga_buf, amiga_pitch, s2x_dst, s2x_dstpitch, amiga_width, y0, y1, amiga_height);
+		}
+		break;
+	case UAE_FILTER_HQ2X:
+	case UAE_FILTER_HQ3X:
+	case UAE_FILTER_HQ4X:
+		if (bpp == 4)
+			hq_32 (amiga_buf, amiga_pitch, s2x_dst, s2x_dstpitch, amiga_width, y0, y1, amiga_height, s2x_mult);
+		else
+			hq_16 (amiga_buf, amiga_pitch, s2x_dst, s2x_dstpitch, amiga_width, y0, y1, amiga_height, s2x_mult);
+		break;
+	case UAE_FILTER_PAL:
+		if (bpp == 4)
+			PAL_1x1_32 ((uae_u32*)(amiga_buf + y0 * amiga_pitch), amiga_pitch,
+				(uae_u32*)(s2x_dst + y0 * s2x_dstpitch), s2x_dstpitch, amiga_width, y1 - y0);
+		else
+			PAL_1x1_16 ((uae_u16*)(amiga_buf + y0 * amiga_pitch), amiga_pitch,
+				(uae_u16*)(s2x_dst + y0 * s2x_dstpitch), s2x_dstpitch, amiga_width, y1 - y0);
+		break;
+	default:
+		null_scale (amiga_buf, amiga_pitch, s2x_dst, s2x_dstpitch, amiga_width, y0, y1, s2x_mult, bpp);
+		break;
+	}
+}
+
+static void s2x_work (void)
+{
+	int i;
+
+	while ((i = __sync_fetch_and_add (&s2x_next, 1)) < s2x_njobs)
+		s2x_band (s2x_jobs[i]);
+}
+
+static void *s2x_thread (void *v)
+{
+	for (;;) {
+		uae_sem_wait (&s2x_go);
+		if (s2x_quit)
+			break;
+		s2x_work ();
+		uae_sem_post (&s2x_done);
+	}
+	uae_sem_post (&s2x_done);
+	return NULL;
+}
+
+static void s2x_startthreads (void)
+{
+	int i, n = 1;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	n = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+	/* the emulation thread renders bands too */
+	n--;
+	if (n > S2X_MAXTHREADS)
+		n = S2X_MAXTHREADS;
+	if (n <= 0)
+		return;
+	uae_sem_init (&s2x_go, 0, 0);
+	uae_sem_init (&s2x_done, 0, 0);
+	s2x_quit = 0;
+	for (i = 0; i < n; i++) {
+		uae_thread_id tid;
+		uae_start_thread ("s2x", s2x_thread, NULL, &tid);
+	}
+	s2x_threads = n;
+}
+
+static void s2x_stopthreads (void)
+{
+	int i;
+
+	if (!s2x_threads)
+		return;
+	s2x_quit = 1;
+	for (i = 0; i < s2x_threads; i++)
+		uae_sem_post (&s2x_go);
+	for (i = 0; i < s2x_threads; i++)
+		uae_sem_wait (&s2x_done);
+	uae_sem_destroy (&s2x_go);
+	uae_sem_destroy (&s2x_done);
+	s2x_threads = 0;
+}
+
+/* Scale the changed bands into dst. Returns the number of bands
+ * rendered, first and last are the destination lines touched. */
+int S2X_render (uae_u8 *dst, int dstpitch, int *first, int *last)
+{
+	int i, helpers, outmult;
+
+	if (!amiga_buf)
+		return 0;
+	s2x_njobs = 0;
+	for (i = 0; i < band_count; i++) {
+		if (band_dirty[i]) {
+			s2x_jobs[s2x_njobs++] = i;
+			band_dirty[i] = 0;
+		}
+	}
+	if (!s2x_njobs)
+		return 0;
+	outmult = s2x_type == UAE_FILTER_PAL ? 1 : s2x_mult;
+	*first = s2x_jobs[0] * S2X_BAND * outmult;
+	*last = (s2x_jobs[s2x_njobs - 1] + 1) * S2X_BAND * outmult - 1;
+	if (*last >= amiga_height * outmult)
+		*last = amiga_height * outmult - 1;
+
+	s2x_dst = dst;
+	s2x_dstpitch = dstpitch;
+	s2x_next = 0;
+	helpers = s2x_njobs - 1 < s2x_threads ? s2x_njobs - 1 : s2x_threads;
+	__sync_synchronize ();
+	for (i = 0; i < helpers; i++)
+		uae_sem_post (&s2x_go);
+	s2x_work ();
+	for (i = 0; i < helpers; i++)
+		uae_sem_wait (&s2x_done);
+	return s2x_njobs;
+}
+
+void S2X_invalidate (int first, int last)
+{
+	int i;
+
+	if (!band_dirty)
+		return;
+	/* neighbouring lines are part of the filter input */
+	first = clampline (first - 1, amiga_height);
+	last = clampline (last + 1, amiga_height);
+	for (i = first / S2X_BAND; i <= last / S2X_BAND; i++)
+		band_dirty[i] = 1;
+}
+
+void S2X_refresh (void)
+{
+	if (band_dirty)
+		memset (band_dirty, 1, band_count);
+}
+
+static struct uae_filter *s2x_findfilter (int type)
+{
+	int i;
+
+	for (i = 0; uaefilters[i].name; i++) {
+		if (uaefilters[i].type == type)
+			return &uaefilters[i];
+	}
+	return NULL;
+}
+
+/* Display to Amiga size ratio for the configured filter */
+int S2X_getmult (void)
+{
+	struct uae_filter *uf = s2x_findfilter (currprefs.gfx_filter);
+	int mult;
+
+	if (!uf)
+		return 1;
+	switch (uf->type)
+	{
+	case UAE_FILTER_NULL:
+		mult = currprefs.gfx_filter_filtermode + 1;
+		return mult > 4 ? 4 : mult;
+	case UAE_FILTER_SCALE2X:
+		return currprefs.gfx_filter_filtermode >= 2 ? 3 : 2;
+	default:
+		return uf->intmul;
+	}
+}
+
+uae_u8 *S2X_getbuffer (int *pitch)
+{
+	*pitch = amiga_pitch;
+	return amiga_buf;
+}
+
+void S2X_configure (int rb, int gb, int bb, int rs, int gs, int bs)
+{
+	red_bits = rb;
+	green_bits = gb;
+	blue_bits = bb;
+	red_shift = rs;
+	green_shift = gs;
+	blue_shift = bs;
+	mask_rb = (((1 << rb) - 1) << rs) | (((1 << bb) - 1) << bs);
+	mask_g = ((1 << gb) - 1) << gs;
+	mask_low = (1 << rs) | (1 << gs) | (1 << bs);
+}
+
+void S2X_free (void)
+{
+	s2x_stopthreads ();
+	xfree (amiga_buf);
+	xfree (band_dirty);
+	xfree (s2x_jobs);
+	amiga_buf = NULL;
+	band_dirty = NULL;
+	s2x_jobs = NULL;
+	usedfilter = NULL;
+}
+
+/* dw/dh display size, aw/ah Amiga buffer size, ad/dd depths in bits.
+ * The filter works within one pixel format, so ad must equal dd. */
+void S2X_init (int dw, int dh, int aw, int ah, int ad, int dd)
+{
+	S2X_free ();
+	usedfilter = s2x_findfilter (currprefs.gfx_filter);
+	if (!usedfilter || ad != dd || (ad != 16 && ad != 32)) {
+		usedfilter = NULL;
+		return;
+	}
+	s2x_type = usedfilter->type;
+	s2x_mult = S2X_getmult ();
+	s2x_depth = ad;
+	dst_width = dw;
+	dst_height = dh;
+	amiga_width = aw;
+	amiga_height = ah;
+	amiga_pitch = (aw * (ad / 8) + 15) & ~15;
+	amiga_buf = xcalloc (uae_u8, amiga_pitch * ah);
+	band_count = (ah + S2X_BAND - 1) / S2X_BAND;
+	band_dirty = xcalloc (uae_u8, band_count);
+	s2x_jobs = xmalloc (int, band_count);
+	S2X_refresh ();
+	s2x_startthreads ();
+	write_log ("S2X: %s %dx%d -> %dx%d (%dx), %d bit, %d threads\n", usedfilter->name,
+		aw, ah, dw, dh, s2x_mult, ad, s2x_threads + 1);
+}
+
+void S2X_reset (void)
+{
+	S2X_init (dst_width, dst_height, amiga_width, amiga_height, s2x_depth, s2x_depth);
+}
+
+#endif /* GFXFILTER */
@@ -13,6 +13,7 @@
 #include "rtgmodes.h"
 #include "xwin.h"
 #include "gfxfilter.h"
+#include "recorder.h"
 
 #include "uae_endian.h"
 
@@ -343,6 +344,9 @@ void alloc_colors64k (int rw, int gw, int bw, int rs, int gs, int bs, int aw, in
 	int i, j;
 
 	video_calc_gammatable();
+#ifdef RECORDER
+	recorder_setformat (rw, gw, bw, rs, gs, bs);
+#endif
 	j = 256;
 	for (i = 0; i < 4096; i++) {
 		int r = ((i >> 8) << 4) | (i >> 8);
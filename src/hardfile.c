@@ -65,6 +65,15 @@
 #define ASYNC_REQUEST_TEMP 1
 #define ASYNC_REQUEST_CHANGEINT 10
 
+#define MAX_QUEUE_DEPTH 16
+
+/* block transfer currently being processed by a worker thread */
+struct hardfileinflight {
+	uaecptr request;
+	uae_u64 offset, len;
+	int write;
+};
+
 struct hardfileprivdata {
 	volatile uaecptr d_request[MAX_ASYNC_REQUESTS];
 	volatile int d_request_type[MAX_ASYNC_REQUESTS];
@@ -76,6 +85,20 @@ struct hardfileprivdata {
 	int changenum;
 	uaecptr changeint;
 	uae_thread_id tid;
+
+	/* With queue depth > 1 the unit thread only dispatches: reads and
+	 * writes go to a pool of workers and complete out of order, any
+	 * other command waits until the pool is idle. */
+	int queue_depth;
+	int workers;
+	smp_comm_pipe work;
+	uae_sem_t work_lock;
+	uae_sem_t worker_sem;
+	uae_sem_t inflight_lock;
+	uae_sem_t inflight_done;
+	volatile int inflight_waiting;
+	int inflight_cnt;
+	struct hardfileinflight inflight[MAX_QUEUE_DEPTH];
 };
 
 #define VHD_DYNAMIC 3
@@ -371,6 +394,479 @@ static uae_u32 vhd_checksum (uae_u8 *p, int offset)
 	return ~sum;
 }
 
+/* Host side block cache. Image data is kept in 64K extents, indexed by
+ * their offset in the image file and replaced least recently used first.
+ * Writes go to the cache and reach the file when the extent is evicted
+ * or on an explicit flush (CMD_UPDATE, SYNCHRONIZE CACHE, close). A read
+ * that continues where the previous one ended hands the next extent to a
+ * helper thread, which loads it while the Amiga side is busy with the
+ * data it got. Everything, including VHD bitmaps and the BAT updates,
+ * goes through it, so it stays coherent with the file.
+ *
+ * The lock only covers the cache structures and copying from and to the
+ * extents. An extent being loaded or written back is marked busy and the
+ * lock is dropped for the file access, anyone who needs that extent
+ * waits for it, everyone else carries on. */
+
+#define HDF_CACHE_EXTENT 65536
+#define HDF_CACHE_HASH 256
+#define HDF_CACHE_EMPTY ((uae_u64)-1)
+
+struct hdf_cache_extent {
+	uae_u64 offset;
+	uae_u8 *data;
+	int valid;
+	bool dirty;
+	bool busy;
+	bool readahead;
+	uae_u32 lru;
+	int next;
+};
+
+struct hdf_blockcache {
+	uae_sem_t lock;
+	/* file access without direct_io goes through one stdio stream */
+	uae_sem_t io_lock;
+	uae_sem_t busy_done;
+	int busy_waiting;
+	int count;
+	struct hdf_cache_extent *ext;
+	int hash[HDF_CACHE_HASH];
+	uae_u32 tick;
+	uae_u64 last_end;
+	int sequential;
+	uae_u32 hits, misses, writebacks;
+	uae_u32 readahead, readahead_hits;
+	/* read-ahead request, HDF_CACHE_EMPTY when there is none */
+	uae_u64 ra_offset;
+	uae_sem_t ra_wake, ra_done;
+	volatile int ra_state;
+};
+
+STATIC_INLINE int hdf_cache_hash (uae_u64 offset)
+{
+	return (int)((offset / HDF_CACHE_EXTENT) % HDF_CACHE_HASH);
+}
+
+static void *hdf_cache_thread (void *v);
+
+static void hdf_cache_init (struct hardfiledata *hfd)
+{
+	struct hdf_blockcache *bc;
+	uae_thread_id tid;
+	int i;
+
+	if (currprefs.hardfile_cache_size <= 0 || hfd->drive_empty)
+		return;
+	bc = xcalloc (struct hdf_blockcache, 1);
+	bc->count = currprefs.hardfile_cache_size * (1024 * 1024 / HDF_CACHE_EXTENT);
+	bc->ext = xcalloc (struct hdf_cache_extent, bc->count);
+	for (i = 0; i < bc->count; i++) {
+		bc->ext[i].offset = HDF_CACHE_EMPTY;
+		bc->ext[i].next = -1;
+	}
+	for (i = 0; i < HDF_CACHE_HASH; i++)
+		bc->hash[i] = -1;
+	uae_sem_init (&bc->lock, 0, 1);
+	uae_sem_init (&bc->io_lock, 0, 1);
+	uae_sem_init (&bc->busy_done, 0, 0);
+	uae_sem_init (&bc->ra_wake, 0, 0);
+	uae_sem_init (&bc->ra_done, 0, 0);
+	bc->ra_offset = HDF_CACHE_EMPTY;
+	hfd->bcache = bc;
+	/* set before the thread runs, hdf_cache_free may clear it first */
+	bc->ra_state = 1;
+	uae_start_thread ("hardfile cache", hdf_cache_thread, hfd, &tid);
+}
+
+/* called without the cache lock */
+static int hdf_cache_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len, bool write)
+{
+	struct hdf_blockcache *bc = hfd->bcache;
+	int v;
+
+	if (!hfd->direct_io)
+		uae_sem_wait (&bc->io_lock);
+	if (write)
+		v = hdf_write_target (hfd, buffer, offset, len);
+	else
+		v = hdf_read_target (hfd, buffer, offset, len);
+	if (!hfd->direct_io)
+		uae_sem_post (&bc->io_lock);
+	return v;
+}
+
+/* Wait until some busy extent is done, the caller has to look again */
+static void hdf_cache_wait (struct hdf_blockcache *bc)
+{
+	bc->busy_waiting++;
+	uae_sem_post (&bc->lock);
+	uae_sem_wait (&bc->busy_done);
+	uae_sem_wait (&bc->lock);
+}
+
+static void hdf_cache_unbusy (struct hdf_blockcache *bc, struct hdf_cache_extent *e)
+{
+	e->busy = false;
+	while (bc->busy_waiting > 0) {
+		bc->busy_waiting--;
+		uae_sem_post (&bc->busy_done);
+	}
+}
+
+/* A failed write back leaves the extent dirty, it is tried again on the
+ * next eviction or flush. Drops the lock meanwhile, the caller has to
+ * look the extent up again afterwards. */
+static int hdf_cache_writeback (struct hardfiledata *hfd, struct hdf_cache_extent *e)
+{
+	struct hdf_blockcache *bc = hfd->bcache;
+	int ok;
+
+	if (!e->dirty)
+		return 1;
+	bc->writebacks++;
+	e->busy = true;
+	uae_sem_post (&bc->lock);
+	ok = hdf_cache_target (hfd, e->data, e->offset + hfd->virtual_size, e->valid, true) == e->valid;
+	uae_sem_wait (&bc->lock);
+	hdf_cache_unbusy (bc, e);
+	if (!ok) {
+		write_log ("HDF cache: write back failed at %llx\n", e->offset);
+		return 0;
+	}
+	e->dirty = false;
+	return 1;
+}
+
+static void hdf_cache_unlink (struct hdf_blockcache *bc, int idx)
+{
+	struct hdf_cache_extent *e = &bc->ext[idx];
+	int *pp = &bc->hash[hdf_cache_hash (e->offset)];
+
+	while (*pp >= 0) {
+		if (*pp == idx) {
+			*pp = e->next;
+			break;
+		}
+		pp = &bc->ext[*pp].next;
+	}
+	e->offset = HDF_CACHE_EMPTY;
+	e->next = -1;
+}
+
+static struct hdf_cache_extent *hdf_cache_find (struct hdf_blockcache *bc, uae_u64 offset)
+{
+	int idx = bc->hash[hdf_cache_hash (offset)];
+
+	while (idx >= 0) {
+		struct hdf_cache_extent *e = &bc->ext[idx];
+		if (e->offset == offset)
+			return e;
+		idx = e->next;
+	}
+	return NULL;
+}
+
+/* Returns the extent at offset, reading it from the file unless the
+ * caller is about to overwrite all of it. */
+static struct hdf_cache_extent *hdf_cache_get (struct hardfiledata *hfd, uae_u64 offset, bool load, bool readahead)
+{
+	struct hdf_blockcache *bc = hfd->bcache;
+	struct hdf_cache_extent *e;
+	uae_u64 limit = (hfd->physsize - hfd->virtual_size) & ~511;
+	int i, victim, len, ok, tries = 0;
+
+	for (;;) {
+		e = hdf_cache_find (bc, offset);
+		if (e && e->busy) {
+			hdf_cache_wait (bc);
+			continue;
+		}
+		if (e) {
+			if (!readahead) {
+				bc->hits++;
+				if (e->readahead) {
+					bc->readahead_hits++;
+					e->readahead = false;
+				}
+				e->lru = ++bc->tick;
+			}
+			return e;
+		}
+		if (offset >= limit)
+			return NULL;
+		victim = -1;
+		for (i = 0; i < bc->count; i++) {
+			if (bc->ext[i].busy)
+				continue;
+			if (bc->ext[i].offset == HDF_CACHE_EMPTY) {
+				victim = i;
+				break;
+			}
+			if (victim < 0 || bc->ext[i].lru < bc->ext[victim].lru)
+				victim = i;
+		}
+		if (victim < 0) {
+			hdf_cache_wait (bc);
+			continue;
+		}
+		e = &bc->ext[victim];
+		if (e->offset == HDF_CACHE_EMPTY)
+			break;
+		if (!e->dirty) {
+			hdf_cache_unlink (bc, victim);
+			break;
+		}
+		/* keep unwritten data, try the next oldest */
+		if (!hdf_cache_writeback (hfd, e)) {
+			if (++tries > 4)
+				return NULL;
+			e->lru = ++bc->tick;
+		}
+	}
+	if (!e->data)
+		e->data = xmalloc (uae_u8, HDF_CACHE_EXTENT);
+	len = offset + HDF_CACHE_EXTENT > limit ? (int)(limit - offset) : HDF_CACHE_EXTENT;
+	e->offset = offset;
+	e->valid = len;
+	e->dirty = false;
+	e->readahead = readahead;
+	e->lru = readahead ? bc->tick : ++bc->tick;
+	e->next = bc->hash[hdf_cache_hash (offset)];
+	bc->hash[hdf_cache_hash (offset)] = victim;
+	if (load) {
+		e->busy = true;
+		uae_sem_post (&bc->lock);
+		ok = hdf_cache_target (hfd, e->data, offset + hfd->virtual_size, len, false) == len;
+		uae_sem_wait (&bc->lock);
+		hdf_cache_unbusy (bc, e);
+		if (!ok) {
+			hdf_cache_unlink (bc, victim);
+			return NULL;
+		}
+	}
+	if (readahead)
+		bc->readahead++;
+	else
+		bc->misses++;
+	return e;
+}
+
+static int hdf_cache_read (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len)
+{
+	struct hdf_blockcache *bc = hfd->bcache;
+	uae_u8 *p = (uae_u8*)buffer;
+	uae_u64 start, next;
+	int got = 0;
+
+	if (!bc)
+		return hdf_read_target (hfd, buffer, offset, len);
+	if (offset < hfd->virtual_size)
+		return hdf_cache_target (hfd, buffer, offset, len, false);
+	offset -= hfd->virtual_size;
+	start = offset;
+	uae_sem_wait (&bc->lock);
+	while (len > 0) {
+		uae_u64 base = offset & ~(uae_u64)(HDF_CACHE_EXTENT - 1);
+		int eoffset = (int)(offset - base);
+		int elen = HDF_CACHE_EXTENT - eoffset;
+		struct hdf_cache_extent *e = hdf_cache_get (hfd, base, true, false);
+
+		if (!e || eoffset >= e->valid)
+			break;
+		if (elen > len)
+			elen = len;
+		if (elen > e->valid - eoffset)
+			elen = e->valid - eoffset;
+		memcpy (p, e->data + eoffset, elen);
+		got += elen;
+		offset += elen;
+		p += elen;
+		len -= elen;
+	}
+	/* sequential reader: have the following extent loaded meanwhile */
+	if (start == bc->last_end)
+		bc->sequential++;
+	else
+		bc->sequential = 0;
+	bc->last_end = offset;
+	next = (offset + HDF_CACHE_EXTENT - 1) & ~(uae_u64)(HDF_CACHE_EXTENT - 1);
+	if (bc->sequential >= 2 && bc->count > 2 && bc->ra_state > 0
+		&& bc->ra_offset == HDF_CACHE_EMPTY && !hdf_cache_find (bc, next)) {
+		bc->ra_offset = next;
+		uae_sem_post (&bc->ra_wake);
+	}
+	uae_sem_post (&bc->lock);
+	return got;
+}
+
+/* Load the extent at bc->ra_offset. The file is read without the cache
+ * lock, a reader that wants the extent meanwhile waits for it. */
+static void hdf_cache_prefetch (struct hardfiledata *hfd)
+{
+	struct hdf_blockcache *bc = hfd->bcache;
+
+	uae_sem_wait (&bc->lock);
+	if (!hdf_cache_find (bc, bc->ra_offset))
+		hdf_cache_get (hfd, bc->ra_offset, true, true);
+	bc->ra_offset = HDF_CACHE_EMPTY;
+	uae_sem_post (&bc->lock);
+}
+
+static void *hdf_cache_thread (void *v)
+{
+	struct hardfiledata *hfd = (struct hardfiledata*)v;
+	struct hdf_blockcache *bc = hfd->bcache;
+
+	for (;;) {
+		uae_sem_wait (&bc->ra_wake);
+		if (bc->ra_state < 0)
+			break;
+		hdf_cache_prefetch (hfd);
+	}
+	bc->ra_state = 0;
+	uae_sem_post (&bc->ra_done);
+	return NULL;
+}
+
+static int hdf_cache_write (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len)
+{
+	struct hdf_blockcache *bc = hfd->bcache;
+	uae_u8 *p = (uae_u8*)buffer;
+	int got = 0;
+
+	if (!bc)
+		return hdf_write_target (hfd, buffer, offset, len);
+	if (offset < hfd->virtual_size)
+		return hdf_cache_target (hfd, buffer, offset, len, true);
+	if (hfd->readonly || hfd->dangerous)
+		return 0;
+	offset -= hfd->virtual_size;
+	uae_sem_wait (&bc->lock);
+	while (len > 0) {
+		uae_u64 base = offset & ~(uae_u64)(HDF_CACHE_EXTENT - 1);
+		int eoffset = (int)(offset - base);
+		int elen = HDF_CACHE_EXTENT - eoffset;
+		struct hdf_cache_extent *e;
+
+		if (elen > len)
+			elen = len;
+		e = hdf_cache_get (hfd, base, eoffset != 0 || elen != HDF_CACHE_EXTENT, false);
+		if (!e || eoffset >= e->valid)
+			break;
+		if (elen > e->valid - eoffset)
+			elen = e->valid - eoffset;
+		memcpy (e->data + eoffset, p, elen);
+		e->dirty = true;
+		got += elen;
+		offset += elen;
+		p += elen;
+		len -= elen;
+	}
+	uae_sem_post (&bc->lock);
+	return got;
+}
+
+/* returns 0 if some data could not be written */
+int hdf_cache_flush (struct hardfiledata *hfd)
+{
+	struct hdf_blockcache *bc = hfd->bcache;
+	int i, ok = 1;
+
+	if (!bc)
+		return 1;
+	uae_sem_wait (&bc->lock);
+	for (i = 0; i < bc->count; i++) {
+		struct hdf_cache_extent *e = &bc->ext[i];
+		while (e->busy)
+			hdf_cache_wait (bc);
+		if (e->offset != HDF_CACHE_EMPTY && !hdf_cache_writeback (hfd, e))
+			ok = 0;
+	}
+	uae_sem_post (&bc->lock);
+	return ok;
+}
+
+/* The image changes size: an extent that ended at the old end of the
+ * file holds fewer bytes than it could now, write it back and forget it. */
+static int hdf_cache_resize (struct hardfiledata *hfd, uae_u64 newsize)
+{
+	struct hdf_blockcache *bc = hfd->bcache;
+	int i, ok;
+
+	if (!bc)
+		return hdf_resize_target (hfd, newsize);
+	uae_sem_wait (&bc->io_lock);
+	ok = hdf_resize_target (hfd, newsize);
+	uae_sem_post (&bc->io_lock);
+	if (!ok)
+		return 0;
+	uae_sem_wait (&bc->lock);
+	for (i = 0; i < bc->count; i++) {
+		struct hdf_cache_extent *e = &bc->ext[i];
+		while (e->busy)
+			hdf_cache_wait (bc);
+		if (e->offset == HDF_CACHE_EMPTY || e->valid == HDF_CACHE_EXTENT)
+			continue;
+		if (e->dirty) {
+			/* look at it again, the lock was dropped */
+			if (hdf_cache_writeback (hfd, e))
+				i--;
+			continue;
+		}
+		hdf_cache_unlink (bc, i);
+	}
+	uae_sem_post (&bc->lock);
+	return 1;
+}
+
+static void hdf_cache_log (struct hardfiledata *hfd)
+{
+	struct hdf_blockcache *bc = hfd->bcache;
+
+	write_log ("HDF cache %s: %d extents, hits %u misses %u, read-ahead %u (%u used), write-backs %u\n",
+		hfd->device_name, bc->count, bc->hits, bc->misses,
+		bc->readahead, bc->readahead_hits, bc->writebacks);
+}
+
+static void hdf_cache_free (struct hardfiledata *hfd)
+{
+	struct hdf_blockcache *bc = hfd->bcache;
+	int i;
+
+	if (!bc)
+		return;
+	if (bc->ra_state > 0) {
+		bc->ra_state = -1;
+		uae_sem_post (&bc->ra_wake);
+		uae_sem_wait (&bc->ra_done);
+	}
+	if (!hdf_cache_flush (hfd))
+		write_log ("HDF cache %s: data lost on close\n", hfd->device_name);
+	hdf_cache_log (hfd);
+	for (i = 0; i < bc->count; i++)
+		xfree (bc->ext[i].data);
+	xfree (bc->ext);
+	uae_sem_destroy (&bc->lock);
+	uae_sem_destroy (&bc->io_lock);
+	uae_sem_destroy (&bc->busy_done);
+	uae_sem_destroy (&bc->ra_wake);
+	uae_sem_destroy (&bc->ra_done);
+	xfree (bc);
+	hfd->bcache = NULL;
+}
+
+void hardfile_cache_stats (void)
+{
+	int i;
+
+	for (i = 0; i < MAX_FILESYSTEM_UNITS; i++) {
+		struct hardfiledata *hfd = get_hardfile_data (i);
+		if (hfd && hfd->bcache)
+			hdf_cache_log (hfd);
+	}
+}
+
 int hdf_open (struct hardfiledata *hfd, const TCHAR *pname)
 {
 	uae_u8 tmp[512], tmp2[512];
@@ -430,9 +926,11 @@ int hdf_open (struct hardfiledata *hfd, const TCHAR *pname)
 	write_log ("HDF is VHD %s image, virtual size=%dK\n",
 		hfd->vhd_type == 2 ? "fixed" : "dynamic",
 		hfd->virtsize / 1024);
+	hdf_cache_init (hfd);
 	return 1;
 nonvhd:
 	hfd->vhd_type = 0;
+	hdf_cache_init (hfd);
 	return 1;
 end:
 	hdf_close_target (hfd);
@@ -441,6 +939,7 @@ end:
 
 void hdf_close (struct hardfiledata *hfd)
 {
+	hdf_cache_free (hfd);
 	hdf_close_target (hfd);
 	hfd->vhd_type = 0;
 	xfree (hfd->vhd_header);
@@ -484,7 +983,7 @@ static uae_u64 vhd_read (struct hardfiledata *hfd, void *v, uae_u64 offset, uae_
 			if (hfd->vhd_sectormapblock != sectormapblock) {
 				// read sector bitmap
 				//write_log ("BM %08x\n", sectormapblock);
-				if (hdf_read_target (hfd, hfd->vhd_sectormap, sectormapblock, 512) != 512) {
+				if (hdf_cache_read (hfd, hfd->vhd_sectormap, sectormapblock, 512) != 512) {
 					write_log ("vhd_read: bitmap read error\n");
 					return read;
 				}
@@ -495,7 +994,7 @@ static uae_u64 vhd_read (struct hardfiledata *hfd, void *v, uae_u64 offset, uae_
 				// read data block
 				uae_u64 block = sectoroffset * (uae_u64)512 + hfd->vhd_bitmapsize + bitmapoffsetbits * 512;
 				//write_log ("DB %08x\n", block);
-				if (hdf_read_target (hfd, dataptr, block, 512) != 512) {
+				if (hdf_cache_read (hfd, dataptr, block, 512) != 512) {
 					write_log ("vhd_read: data read error\n");
 					return read;
 				}
@@ -520,13 +1019,13 @@ static int vhd_write_enlarge (struct hardfiledata *hfd, uae_u32 bamoffset)
 
 	len = hfd->vhd_blocksize + hfd->vhd_bitmapsize + 512;
 	buf = xcalloc (uae_u8, len);
-	if (!hdf_resize_target (hfd, hfd->physsize + len - 512)) {
+	if (!hdf_cache_resize (hfd, hfd->physsize + len - 512)) {
 		write_log ("vhd_enlarge: failure\n");
 		return 0;
 	}
 	// add footer (same as 512 byte header)
 	memcpy (buf + len - 512, hfd->vhd_header, 512);
-	v = hdf_write_target (hfd, buf, hfd->vhd_footerblock, len);
+	v = hdf_cache_write (hfd, buf, hfd->vhd_footerblock, len);
 	xfree (buf);
 	if (v != len) {
 		write_log ("vhd_enlarge: footer write error\n");
@@ -540,7 +1039,7 @@ static int vhd_write_enlarge (struct hardfiledata *hfd, uae_u32 bamoffset)
 	p[2] = block >>  8;
 	p[3] = block >>  0;
 	// write to disk
-	if (hdf_write_target (hfd, hfd->vhd_header + hfd->vhd_bamoffset, hfd->vhd_bamoffset, hfd->vhd_bamsize) != hfd->vhd_bamsize) {
+	if (hdf_cache_write (hfd, hfd->vhd_header + hfd->vhd_bamoffset, hfd->vhd_bamoffset, hfd->vhd_bamsize) != hfd->vhd_bamsize) {
 		write_log ("vhd_enlarge: bam write error\n");
 		return 0;
 	}
@@ -575,14 +1074,14 @@ static uae_u64 vhd_write (struct hardfiledata *hfd, void *v, uae_u64 offset, uae
 			uae_u64 sectormapblock = sectoroffset * (uae_u64)512 + (bitmapoffsetbytes & ~511);
 			if (hfd->vhd_sectormapblock != sectormapblock) {
 				// read sector bitmap
-				if (hdf_read_target (hfd, hfd->vhd_sectormap, sectormapblock, 512) != 512) {
+				if (hdf_cache_read (hfd, hfd->vhd_sectormap, sectormapblock, 512) != 512) {
 					write_log ("vhd_write: bitmap read error\n");
 					return written;
 				}
 				hfd->vhd_sectormapblock = sectormapblock;
 			}
 			// write data
-			if (hdf_write_target (hfd, dataptr, sectoroffset * (uae_u64)512 + hfd->vhd_bitmapsize + bitmapoffsetbits * 512, 512) != 512) {
+			if (hdf_cache_write (hfd, dataptr, sectoroffset * (uae_u64)512 + hfd->vhd_bitmapsize + bitmapoffsetbits * 512, 512) != 512) {
 				write_log ("vhd_write: data write error\n");
 				return written;
 			}
@@ -590,7 +1089,7 @@ static uae_u64 vhd_write (struct hardfiledata *hfd, void *v, uae_u64 offset, uae
 			if (!(hfd->vhd_sectormap[bitmapoffsetbytes & 511] & (1 << (7 - (bitmapoffsetbits & 7))))) {
 				// no, we need to mark it allocated and write the modified bitmap back to the disk
 				hfd->vhd_sectormap[bitmapoffsetbytes & 511] |= (1 << (7 - (bitmapoffsetbits & 7)));
-				if (hdf_write_target (hfd, hfd->vhd_sectormap, sectormapblock, 512) != 512) {
+				if (hdf_cache_write (hfd, hfd->vhd_sectormap, sectormapblock, 512) != 512) {
 					write_log ("vhd_write: bam write error\n");
 					return written;
 				}
@@ -745,9 +1244,9 @@ static int hdf_read2 (struct hardfiledata *hfd, void *buffer, uae_u64 offset, in
 	if (hfd->vhd_type == VHD_DYNAMIC)
 		return vhd_read (hfd, buffer, offset, len);
 	else if (hfd->vhd_type == VHD_FIXED)
-		return hdf_read_target (hfd, buffer, offset + 512, len);
+		return hdf_cache_read (hfd, buffer, offset + 512, len);
 	else
-		return hdf_read_target (hfd, buffer, offset, len);
+		return hdf_cache_read (hfd, buffer, offset, len);
 }
 
 static void adide_decode (void *v, int len)
@@ -912,9 +1411,9 @@ static int hdf_write2 (struct hardfiledata *hfd, void *buffer, uae_u64 offset, i
 	if (hfd->vhd_type == VHD_DYNAMIC)
 		return vhd_write (hfd, buffer, offset, len);
 	else if (hfd->vhd_type == VHD_FIXED)
-		return hdf_write_target (hfd, buffer, offset + 512, len);
+		return hdf_cache_write (hfd, buffer, offset + 512, len);
 	else
-		return hdf_write_target (hfd, buffer, offset, len);
+		return hdf_cache_write (hfd, buffer, offset, len);
 }
 
 int hdf_write (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len)
@@ -1229,6 +1728,8 @@ int scsi_emulate (struct hardfiledata *hfd, struct hd_hardfiledata *hdhfd, uae_u
 		if (nodisk (hfd))
 			goto nodisk;
 		scsi_len = 0;
+		if (!hdf_cache_flush (hfd))
+			goto writefail;
 		break;
 	case 0xa8: /* READ (12) */
 		if (nodisk (hfd))
@@ -1275,6 +1776,13 @@ nodisk:
 		s[12] = 0x3A; /* MEDIUM NOT PRESENT */
 		ls = 12;
 		break;
+writefail:
+		status = 2; /* CHECK CONDITION */
+		s[0] = 0x70;
+		s[2] = 3; /* MEDIUM ERROR */
+		s[12] = 0x0c; /* WRITE ERROR */
+		ls = 12;
+		break;
 
 	default:
 err:
@@ -1472,9 +1980,12 @@ static void abort_async (struct hardfileprivdata *hfpd, uaecptr request, int err
 }
 
 static void *hardfile_thread (void *devs);
+static void *hardfile_worker (void *devs);
 static int start_thread (TrapContext *context, int unit)
 {
 	struct hardfileprivdata *hfpd = &hardfpd[unit];
+	struct hardfiledata *hfd = get_hardfile_data (unit);
+	int i;
 
 	if (hfpd->thread_running)
 		return 1;
@@ -1482,6 +1993,27 @@ static int start_thread (TrapContext *context, int unit)
 	hfpd->base = m68k_areg (regs, 6);
 	init_comm_pipe (&hfpd->requests, 100, 1);
 	uae_sem_init (&hfpd->sync_sem, 0, 0);
+
+	hfpd->queue_depth = currprefs.hardfile_queue_depth;
+	if (hfpd->queue_depth > MAX_QUEUE_DEPTH)
+		hfpd->queue_depth = MAX_QUEUE_DEPTH;
+	/* dynamic VHDs update their block map on write, keep them serial */
+	if (hfpd->queue_depth > 1 && hfd && hfd->vhd_type != VHD_DYNAMIC && hdf_direct_target (hfd, 1)) {
+		init_comm_pipe (&hfpd->work, MAX_ASYNC_REQUESTS + 1, 1);
+		uae_sem_init (&hfpd->work_lock, 0, 1);
+		uae_sem_init (&hfpd->worker_sem, 0, 0);
+		uae_sem_init (&hfpd->inflight_lock, 0, 1);
+		uae_sem_init (&hfpd->inflight_done, 0, 0);
+		for (i = 0; i < hfpd->queue_depth; i++) {
+			uae_thread_id tid;
+			uae_start_thread ("hardfile worker", hardfile_worker, hfpd, &tid);
+			uae_sem_wait (&hfpd->worker_sem);
+		}
+		write_log ("uaehf.device:%d %d parallel requests\n", unit, hfpd->workers);
+	} else {
+		hfpd->queue_depth = 1;
+	}
+
 	uae_start_thread ("hardfile", hardfile_thread, hfpd, &hfpd->tid);
 	uae_sem_wait (&hfpd->sync_sem);
 	return hfpd->thread_running;
@@ -1730,8 +2262,12 @@ no_disk:
 		actual = hfd->drive_empty ? 1 :0;
 		break;
 
-		/* Some commands that just do nothing and return zero */
 	case CMD_UPDATE:
+		if (!hdf_cache_flush (hfd))
+			error = IOERR_NotSpecified;
+		break;
+
+		/* Some commands that just do nothing and return zero */
 	case CMD_CLEAR:
 	case CMD_MOTOR:
 	case CMD_SEEK:
@@ -1854,22 +2390,194 @@ static uae_u32 REGPARAM2 hardfile_beginio (TrapContext *context)
 	}
 }
 
+/* Returns the byte range touched by a request that may run in parallel
+ * with other block transfers, zero for everything else. */
+static int hardfile_io_range (struct hardfiledata *hfd, uaecptr request, uae_u64 *offset, uae_u64 *len, int *write)
+{
+	uae_u32 cmd = get_word (request + 28);
+	uae_u8 cdb[12];
+	uaecptr acmd, scsi_cmd;
+	int i;
+
+	switch (cmd)
+	{
+	case CMD_READ:
+	case CMD_WRITE:
+		*offset = get_long (request + 44);
+		*len = get_long (request + 36);
+		*write = cmd == CMD_WRITE;
+		return 1;
+	case TD_READ64:
+	case NSCMD_TD_READ64:
+	case TD_WRITE64:
+	case NSCMD_TD_WRITE64:
+		*offset = get_long (request + 44) | ((uae_u64)get_long (request + 32) << 32);
+		*len = get_long (request + 36);
+		*write = cmd == TD_WRITE64 || cmd == NSCMD_TD_WRITE64;
+		return 1;
+	case HD_SCSICMD:
+		if (hfd->nrcyls != 0)
+			return 0;
+		acmd = get_long (request + 40);
+		scsi_cmd = get_long (acmd + 12);
+		for (i = 0; i < 10; i++)
+			cdb[i] = get_byte (scsi_cmd + i);
+		switch (cdb[0])
+		{
+		case 0x08: /* READ (6) */
+		case 0x0a: /* WRITE (6) */
+			*offset = ((cdb[1] & 31) << 16) | (cdb[2] << 8) | cdb[3];
+			*len = cdb[4] ? cdb[4] : 256;
+			break;
+		case 0x28: /* READ (10) */
+		case 0x2a: /* WRITE (10) */
+			*offset = gl (cdb + 2);
+			*len = (cdb[7] << 8) | cdb[8];
+			break;
+		default:
+			return 0;
+		}
+		*offset *= hfd->blocksize;
+		*len *= hfd->blocksize;
+		*write = cdb[0] == 0x0a || cdb[0] == 0x2a;
+		return 1;
+	}
+	return 0;
+}
+
+/* Wait until the request can't race with anything in flight (or, with
+ * request == 0, until the pool is idle) and then claim a slot for it. */
+static void queue_inflight (struct hardfileprivdata *hfpd, uaecptr request, uae_u64 offset, uae_u64 len, int write)
+{
+	for (;;) {
+		int i, busy = 0;
+
+		uae_sem_wait (&hfpd->inflight_lock);
+		if (!request) {
+			busy = hfpd->inflight_cnt > 0;
+		} else if (hfpd->inflight_cnt >= hfpd->queue_depth) {
+			busy = 1;
+		} else {
+			for (i = 0; i < hfpd->inflight_cnt; i++) {
+				struct hardfileinflight *hi = &hfpd->inflight[i];
+				if ((write || hi->write) && offset < hi->offset + hi->len && hi->offset < offset + len) {
+					busy = 1;
+					break;
+				}
+			}
+		}
+		if (!busy) {
+			if (request) {
+				struct hardfileinflight *hi = &hfpd->inflight[hfpd->inflight_cnt++];
+				hi->request = request;
+				hi->offset = offset;
+				hi->len = len;
+				hi->write = write;
+			}
+			uae_sem_post (&hfpd->inflight_lock);
+			return;
+		}
+		hfpd->inflight_waiting = 1;
+		uae_sem_post (&hfpd->inflight_lock);
+		uae_sem_wait (&hfpd->inflight_done);
+	}
+}
+
+static void release_inflight (struct hardfileprivdata *hfpd, uaecptr request)
+{
+	int i;
+
+	uae_sem_wait (&hfpd->inflight_lock);
+	for (i = 0; i < hfpd->inflight_cnt; i++) {
+		if (hfpd->inflight[i].request == request) {
+			hfpd->inflight[i] = hfpd->inflight[--hfpd->inflight_cnt];
+			break;
+		}
+	}
+	if (hfpd->inflight_waiting) {
+		hfpd->inflight_waiting = 0;
+		uae_sem_post (&hfpd->inflight_done);
+	}
+	uae_sem_post (&hfpd->inflight_lock);
+}
+
+static void *hardfile_worker (void *devs)
+{
+	struct hardfileprivdata *hfpd = (struct hardfileprivdata*)devs;
+	struct hardfiledata *hfd = get_hardfile_data (hfpd - &hardfpd[0]);
+
+	uae_set_thread_priority (2);
+	hfpd->workers++;
+	uae_sem_post (&hfpd->worker_sem);
+	for (;;) {
+		uaecptr request;
+
+		uae_sem_wait (&hfpd->work_lock);
+		request = (uaecptr)read_comm_pipe_u32_blocking (&hfpd->work);
+		uae_sem_post (&hfpd->work_lock);
+		if (!request)
+			break;
+		/* the transfer itself runs without change_sem held */
+		hardfile_do_io (hfd, hfpd, request);
+		uae_sem_wait (&change_sem);
+		put_byte (request + 30, get_byte (request + 30) & ~1);
+		release_async_request (hfpd, request);
+		uae_ReplyMsg (request);
+		uae_sem_post (&change_sem);
+		release_inflight (hfpd, request);
+	}
+	uae_sem_post (&hfpd->worker_sem);
+	return 0;
+}
+
+static void stop_workers (struct hardfileprivdata *hfpd)
+{
+	int i;
+
+	queue_inflight (hfpd, 0, 0, 0, 0);
+	for (i = 0; i < hfpd->workers; i++)
+		write_comm_pipe_u32 (&hfpd->work, 0, 1);
+	for (i = 0; i < hfpd->workers; i++)
+		uae_sem_wait (&hfpd->worker_sem);
+	hfpd->workers = 0;
+	hdf_direct_target (get_hardfile_data (hfpd - &hardfpd[0]), 0);
+	destroy_comm_pipe (&hfpd->work);
+	uae_sem_destroy (&hfpd->work_lock);
+	uae_sem_destroy (&hfpd->worker_sem);
+	uae_sem_destroy (&hfpd->inflight_lock);
+	uae_sem_destroy (&hfpd->inflight_done);
+}
+
 static void *hardfile_thread (void *devs)
 {
 	struct hardfileprivdata *hfpd = (struct hardfileprivdata*)devs;
+	struct hardfiledata *hfd = get_hardfile_data (hfpd - &hardfpd[0]);
 
 	uae_set_thread_priority (2);
 	hfpd->thread_running = 1;
 	uae_sem_post (&hfpd->sync_sem);
 	for (;;) {
 		uaecptr request = (uaecptr)read_comm_pipe_u32_blocking (&hfpd->requests);
+		if (hfpd->workers) {
+			uae_u64 offset, len;
+			int write;
+			if (request && hardfile_io_range (hfd, request, &offset, &len, &write)) {
+				queue_inflight (hfpd, request, offset, len, write);
+				write_comm_pipe_u32 (&hfpd->work, request, 1);
+				continue;
+			}
+			if (request)
+				queue_inflight (hfpd, 0, 0, 0, 0);
+			else
+				stop_workers (hfpd);
+		}
 		uae_sem_wait (&change_sem);
 		if (!request) {
 			hfpd->thread_running = 0;
 			uae_sem_post (&hfpd->sync_sem);
 			uae_sem_post (&change_sem);
 			return 0;
-		} else if (hardfile_do_io (get_hardfile_data (hfpd - &hardfpd[0]), hfpd, request) == 0) {
+		} else if (hardfile_do_io (hfd, hfpd, request) == 0) {
 			put_byte (request + 30, get_byte (request + 30) & ~1);
 			release_async_request (hfpd, request);
 			uae_ReplyMsg (request);
@@ -340,6 +340,7 @@ void hdf_close_target (struct hardfiledata *hfd)
 	hfd->cache_valid = 0;
 	hfd->drive_empty = 0;
 	hfd->dangerous = 0;
+	hfd->direct_io = 0;
 }
 
 int hdf_dup_target (struct hardfiledata *dhfd, const struct hardfiledata *shfd)
@@ -471,6 +472,84 @@ static int hdf_read_2 (struct hardfiledata *hfd, void *buffer, uae_u64 offset, i
 	return 0;
 }
 
+/* Positioned I/O straight to the file descriptor, bypassing the stdio
+ * stream and the shared read cache. Keeps no state in hfd, so several
+ * hardfile worker threads can use it on the same unit at once. */
+static int hdf_read_direct (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len)
+{
+	int fd = fileno (hfd->handle->h);
+	uae_u8 *p = (uae_u8*)buffer;
+	int got = 0;
+
+	if (offset + len > hfd->physsize - hfd->virtual_size) {
+		write_log ("hdf_read_direct: out of bounds, offset=0x%llx len=%d\n", offset, len);
+		return 0;
+	}
+	offset += hfd->offset;
+	while (len > 0) {
+		ssize_t ret = pread (fd, p, len, offset);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		got += ret;
+		offset += ret;
+		p += ret;
+		len -= ret;
+	}
+	return got;
+}
+
+static int hdf_write_direct (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len)
+{
+	int fd = fileno (hfd->handle->h);
+	uae_u8 *p = (uae_u8*)buffer;
+	uae_u64 start;
+	int got = 0;
+
+	if (hfd->readonly || hfd->dangerous)
+		return 0;
+	if (offset + len > hfd->physsize - hfd->virtual_size) {
+		write_log ("hdf_write_direct: out of bounds, offset=0x%llx len=%d\n", offset, len);
+		return 0;
+	}
+	start = offset;
+	offset += hfd->offset;
+	while (len > 0) {
+		ssize_t ret = pwrite (fd, p, len, offset);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		got += ret;
+		offset += ret;
+		p += ret;
+		len -= ret;
+	}
+	if (start == 0 && got >= 512) {
+		uae_u8 tmp[512];
+		if (pread (fd, tmp, sizeof tmp, hfd->offset) != sizeof tmp || memcmp (buffer, tmp, sizeof tmp) != 0)
+			gui_message ("Harddrive\n%s\nblock zero write failed!", hfd->device_name);
+	}
+	return got;
+}
+
+/* Switch a unit to (or back from) positioned I/O. Only plain files and
+ * devices opened through stdio can do it, zfile backed images can't. */
+int hdf_direct_target (struct hardfiledata *hfd, int enable)
+{
+	if (!enable) {
+		hfd->direct_io = 0;
+		return 0;
+	}
+	if (hfd->handle_valid != HDF_HANDLE_LINUX || hfd->handle->h == INVALID_HANDLE_VALUE)
+		return 0;
+	fflush (hfd->handle->h);
+	hfd->cache_valid = 0;
+	hfd->direct_io = 1;
+	return 1;
+}
+
 int hdf_read_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len)
 {
     int got = 0;
@@ -486,6 +565,8 @@ int hdf_read_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int
 		return len2;
 	}
 	offset -= hfd->virtual_size;
+	if (hfd->direct_io)
+		return hdf_read_direct (hfd, buffer, offset, len);
 	while (len > 0) {
 		unsigned int maxlen;
 		size_t ret;
@@ -557,6 +638,8 @@ int hdf_write_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, in
 	if (offset < hfd->virtual_size)
 		return len;
 	offset -= hfd->virtual_size;
+	if (hfd->direct_io)
+		return hdf_write_direct (hfd, buffer, offset, len);
 	while (len > 0) {
 		int maxlen = len > CACHE_SIZE ? CACHE_SIZE : len;
 		int ret = hdf_write_2 (hfd, p, offset, maxlen);
@@ -0,0 +1,147 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Host side instrumentation of the emulation hot paths
+  *
+  * Sections bracketed by HOSTPROF_ENTER/HOSTPROF_LEAVE accumulate host
+  * clock ticks (TSC on x86) and HOSTPROF_COUNT bumps event counters.
+  * Once per frame the totals are converted to microseconds and stored
+  * in a ring of the last HOSTPROF_FRAMES frames, which the debugger
+  * ('ph'), the status line and the exit dump read.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#ifdef HOSTPROF
+
+#include "options.h"
+#include "hostprof.h"
+
+const TCHAR *hostprof_names[HP_MAX] = {
+	"cpu", "hsync", "vsync", "blitter", "copper", "draw", "audio", "disk", "cia", "snapshot"
+};
+const TCHAR *hostprof_counternames[HPC_MAX] = {
+	"blits", "coppermoves", "lines", "events", "jitcompiles"
+};
+
+uae_u64 hostprof_time[HP_MAX], hostprof_last;
+uae_u32 hostprof_count[HPC_MAX];
+int hostprof_stack[HOSTPROF_DEPTH], hostprof_sp;
+
+static struct hostprof_frame frames[HOSTPROF_FRAMES];
+static int frame_next, frame_total;
+static uae_u32 frame_counter;
+static uae_u64 frame_ns;
+
+static uae_u64 hostprof_ns (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Close the current frame record. The clock ticks of the frame are
+ * scaled by the wall time of the frame, so the TSC needs no calibration. */
+void hostprof_vsync (void)
+{
+	struct hostprof_frame *f = &frames[frame_next];
+	uae_u64 now = hostprof_clock (), ns = hostprof_ns (), ticks = 0;
+	int i;
+
+	hostprof_time[hostprof_stack[hostprof_sp & (HOSTPROF_DEPTH - 1)]] += now - hostprof_last;
+	hostprof_last = now;
+	for (i = 0; i < HP_MAX; i++)
+		ticks += hostprof_time[i];
+	if (frame_ns && ticks) {
+		uae_u64 total = ns - frame_ns;
+		f->frame = frame_counter;
+		f->total = (uae_u32)(total / 1000);
+		for (i = 0; i < HP_MAX; i++)
+			f->time[i] = (uae_u32)(hostprof_time[i] * total / ticks / 1000);
+		memcpy (f->count, hostprof_count, sizeof f->count);
+		frame_next = (frame_next + 1) % HOSTPROF_FRAMES;
+		if (frame_total < HOSTPROF_FRAMES)
+			frame_total++;
+	}
+	frame_counter++;
+	frame_ns = ns;
+	memset (hostprof_time, 0, sizeof hostprof_time);
+	memset (hostprof_count, 0, sizeof hostprof_count);
+}
+
+int hostprof_frames (void)
+{
+	return frame_total;
+}
+
+/* back = 0 is the last complete frame */
+const struct hostprof_frame *hostprof_getframe (int back)
+{
+	if (back >= frame_total)
+		return NULL;
+	return &frames[(frame_next - 1 - back + HOSTPROF_FRAMES) % HOSTPROF_FRAMES];
+}
+
+static void write_csv (FILE *f)
+{
+	int i, n;
+
+	fprintf (f, "frame,total_us");
+	for (i = 0; i < HP_MAX; i++)
+		fprintf (f, ",%s_us", hostprof_names[i]);
+	for (i = 0; i < HPC_MAX; i++)
+		fprintf (f, ",%s", hostprof_counternames[i]);
+	fprintf (f, "\n");
+	for (n = frame_total - 1; n >= 0; n--) {
+		const struct hostprof_frame *fr = hostprof_getframe (n);
+		fprintf (f, "%u,%u", fr->frame, fr->total);
+		for (i = 0; i < HP_MAX; i++)
+			fprintf (f, ",%u", fr->time[i]);
+		for (i = 0; i < HPC_MAX; i++)
+			fprintf (f, ",%u", fr->count[i]);
+		fprintf (f, "\n");
+	}
+}
+
+static void write_json (FILE *f)
+{
+	int i, n;
+
+	fprintf (f, "[\n");
+	for (n = frame_total - 1; n >= 0; n--) {
+		const struct hostprof_frame *fr = hostprof_getframe (n);
+		fprintf (f, "  { \"frame\": %u, \"total_us\": %u", fr->frame, fr->total);
+		for (i = 0; i < HP_MAX; i++)
+			fprintf (f, ", \"%s_us\": %u", hostprof_names[i], fr->time[i]);
+		for (i = 0; i < HPC_MAX; i++)
+			fprintf (f, ", \"%s\": %u", hostprof_counternames[i], fr->count[i]);
+		fprintf (f, " }%s\n", n ? "," : "");
+	}
+	fprintf (f, "]\n");
+}
+
+/* Write the frame ring to host_profile_file, JSON if the name ends in
+ * .json, CSV otherwise. */
+void hostprof_exit (void)
+{
+	const TCHAR *name = currprefs.host_profile_file;
+	int len = _tcslen (name);
+	FILE *f;
+
+	if (!len || !frame_total)
+		return;
+	f = _tfopen (name, "w");
+	if (!f) {
+		write_log ("hostprof: can't create '%s'\n", name);
+		return;
+	}
+	if (len > 5 && !_tcsicmp (name + len - 5, ".json"))
+		write_json (f);
+	else
+		write_csv (f);
+	fclose (f);
+	write_log ("hostprof: %d frames written to '%s'\n", frame_total, name);
+}
+
+#endif /* HOSTPROF */
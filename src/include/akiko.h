@@ -13,3 +13,26 @@ extern void akiko_mute (int);
 extern uae_u8 *extendedkickmemory;
 
 extern void rethink_akiko (void);
+
+/* Akiko chunky to planar conversion: 32 8-bit chunky pixels in, 8
+ * bitplane longwords out. Each group of 8 pixels is an 8x8 bit matrix
+ * transpose, done with the 64-bit delta swap method. */
+STATIC_INLINE void akiko_c2p_convert (const uae_u32 *src, uae_u32 *dst)
+{
+	int g, j;
+
+	for (j = 0; j < 8; j++)
+		dst[j] = 0;
+	for (g = 0; g < 4; g++) {
+		uae_u64 x = ((uae_u64)src[6 - 2 * g] << 32) | src[7 - 2 * g];
+		uae_u64 t;
+		t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+		x ^= t ^ (t << 7);
+		t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+		x ^= t ^ (t << 14);
+		t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+		x ^= t ^ (t << 28);
+		for (j = 0; j < 8; j++)
+			dst[j] |= (uae_u32)((x >> (8 * j)) & 0xff) << (8 * g);
+	}
+}
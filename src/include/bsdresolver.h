@@ -0,0 +1,56 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * bsdsocket.library emulation - name lookup cache
+  */
+
+#ifndef UAE_BSDRESOLVER_H
+#define UAE_BSDRESOLVER_H
+
+struct hostent;
+struct servent;
+struct protoent;
+
+/* A cached answer. Exactly one of host/serv/proto is set on success,
+ * herr and err hold h_errno and errno of a failed host lookup. Entries
+ * are reference counted and must be handed back with bsdres_release ().
+ * Needs threaddep/thread.h. */
+struct bsdres_entry
+{
+    struct hostent *host;
+    struct servent *serv;
+    struct protoent *proto;
+    int herr;
+    int err;
+    /* private */
+    struct bsdres_entry *hnext, *lprev, *lnext;
+    int refcnt;
+    int pending;
+    int waiters;
+    uae_sem_t done;	/* posted once per waiter when pending clears */
+    int hash;
+    uae_u64 expires;
+    int keylen;
+    uae_u8 *key;
+};
+
+/* backend used for host lookups, returns a bsdres_copyhost () copy */
+typedef struct hostent *(*BSDRES_HOSTLOOKUP)(const char *name, const void *addr, int len, int type, int *herr);
+
+extern void bsdres_init (void);
+extern struct bsdres_entry *bsdres_gethostbyname (const char *name, int cachedonly);
+extern struct bsdres_entry *bsdres_gethostbyaddr (const void *addr, int len, int type, int cachedonly);
+extern struct bsdres_entry *bsdres_getservbyname (const char *name, const char *proto);
+extern struct bsdres_entry *bsdres_getservbyport (int port, const char *proto);
+extern struct bsdres_entry *bsdres_getprotobyname (const char *name);
+extern void bsdres_release (struct bsdres_entry *e);
+extern void bsdres_flush (void);
+
+/* run fn (arg) on one of the resolver threads */
+extern void bsdres_async (void (*fn)(void *), void *arg);
+
+extern struct hostent *bsdres_copyhost (const struct hostent *h);
+extern void bsdres_setbackend (BSDRES_HOSTLOOKUP lookup);
+extern void bsdres_setttl (int ttl, int negttl);
+
+#endif /* UAE_BSDRESOLVER_H */
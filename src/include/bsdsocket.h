@@ -85,6 +85,15 @@ struct socketbase {
     uae_u32 sets [3];
     uae_u32 timeout;
     uae_u32 sigmp;
+    /* shared reactor (Linux) */
+    struct socketbase *nextreq;	/* reactor request queue */
+    struct socketbase *nextws;	/* WaitSelects with pending timeout */
+    uae_u32 (*tryfunc)(struct socketbase *);	/* blocking call being retried */
+    int pending;		/* call parked in the reactor */
+    int wsepfd;			/* epoll set of the current WaitSelect */
+    struct bsd_wsfd *wsfds;
+    int wscount, wsalloc;
+    uae_u64 deadline;		/* WaitSelect timeout, monotonic ms */
 #endif
 };
 
@@ -0,0 +1,25 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * FLAC CD audio tracks decoded on demand
+  */
+
+#ifndef UAE_CDDA_STREAM_H
+#define UAE_CDDA_STREAM_H
+
+struct zfile;
+struct cdda_stream;
+
+/* Decoded audio kept around the read position of a track.
+ * Large enough for a few seconds ahead plus the biggest FLAC frame. */
+#define CDDA_STREAM_SIZE (1024 * 1024)
+#define CDDA_STREAM_AHEAD (CDDA_STREAM_SIZE / 2)
+
+/* None of these lock, the caller serializes all use of a stream and
+ * of the file it decodes. */
+extern uae_s64 cdda_stream_size (struct zfile *zf);
+extern struct cdda_stream *cdda_stream_open (struct zfile *zf);
+extern void cdda_stream_close (struct cdda_stream *s);
+extern int cdda_stream_read (struct cdda_stream *s, uae_u8 *dst, uae_s64 pos, int len);
+
+#endif /* UAE_CDDA_STREAM_H */
@@ -202,6 +202,9 @@ struct mmu_atc_line {
 	unsigned hw : 1;
 	unsigned bus_fault : 1;
 	uaecptr phys;
+	/* level 1 only: host address of the physical page, NULL if the
+	 * page must go through the memory bank handlers */
+	uae_u8 *host;
 };
 
 /*
@@ -233,12 +236,32 @@ typedef struct mmu_atc_line mmu_atc_l1_array[2][2][ATC_L1_SIZE];
 extern mmu_atc_l1_array atc_l1[2];
 extern mmu_atc_l1_array *current_atc;
 
-#define ATC_L2_SIZE_LOG		12
-#define ATC_L2_SIZE			(1 << ATC_L2_SIZE_LOG)
-
-#define ATC_L2_INDEX(addr)	((((addr) >> 12) ^ ((addr) >> (32 - ATC_L2_SIZE_LOG))) % ATC_L2_SIZE)
-
-extern struct mmu_atc_line atc_l2[2][ATC_L2_SIZE];
+/*
+ * second level atc cache
+ * set associative, indexed by [super][set][way]. The set index hashes the
+ * upper address bits in, so the 14 bit tag still identifies the page.
+ */
+#define ATC_L2_WAYS_LOG		2
+#define ATC_L2_WAYS			(1 << ATC_L2_WAYS_LOG)
+#define ATC_L2_SETS_LOG		11
+#define ATC_L2_SETS			(1 << ATC_L2_SETS_LOG)
+#define ATC_L2_SIZE			(ATC_L2_SETS * ATC_L2_WAYS)
+
+#define ATC_L2_INDEX(addr)	((((addr) >> 12) ^ ((addr) >> (32 - ATC_L2_SETS_LOG))) % ATC_L2_SETS)
+
+extern struct mmu_atc_line atc_l2[2][ATC_L2_SETS][ATC_L2_WAYS];
+
+/* translation statistics, level 1 hits are not counted */
+struct mmu_atc_stats {
+	uae_u32 l1_miss;
+	uae_u32 l2_hit;
+	uae_u32 l2_miss;
+	uae_u32 l2_evict;
+	uae_u32 table_search;
+	uae_u32 flush;
+	uae_u32 flush_all;
+};
+extern struct mmu_atc_stats mmu_atc_stats;
 
 /*
  * lookup address in the level 1 atc cache,
@@ -346,8 +369,11 @@ static ALWAYS_INLINE uae_u32 mmu_get_long(uaecptr addr, bool data, int size)
 {
 	struct mmu_atc_line *cl;
 
-	if (likely(mmu_lookup(addr, data, false, &cl)))
+	if (likely(mmu_lookup(addr, data, false, &cl))) {
+		if (likely(cl->host != NULL))
+			return do_get_mem_long((uae_u32*)(cl->host + (addr & 0xfff)));
 		return phys_get_long(mmu_get_real_address(addr, cl));
+	}
 	return mmu_get_long_slow(addr, regs.s != 0, data, size, cl);
 }
 
@@ -355,8 +381,11 @@ static ALWAYS_INLINE uae_u16 mmu_get_word(uaecptr addr, bool data, int size)
 {
 	struct mmu_atc_line *cl;
 
-	if (likely(mmu_lookup(addr, data, false, &cl)))
+	if (likely(mmu_lookup(addr, data, false, &cl))) {
+		if (likely(cl->host != NULL))
+			return do_get_mem_word((uae_u16*)(cl->host + (addr & 0xfff)));
 		return phys_get_word(mmu_get_real_address(addr, cl));
+	}
 	return mmu_get_word_slow(addr, regs.s != 0, data, size, cl);
 }
 
@@ -364,8 +393,11 @@ static ALWAYS_INLINE uae_u8 mmu_get_byte(uaecptr addr, bool data, int size)
 {
 	struct mmu_atc_line *cl;
 
-	if (likely(mmu_lookup(addr, data, false, &cl)))
+	if (likely(mmu_lookup(addr, data, false, &cl))) {
+		if (likely(cl->host != NULL))
+			return *(cl->host + (addr & 0xfff));
 		return phys_get_byte(mmu_get_real_address(addr, cl));
+	}
 	return mmu_get_byte_slow(addr, regs.s != 0, data, size, cl);
 }
 
@@ -374,9 +406,12 @@ static ALWAYS_INLINE void mmu_put_long(uaecptr addr, uae_u32 val, bool data, int
 {
 	struct mmu_atc_line *cl;
 
-	if (likely(mmu_lookup(addr, data, true, &cl)))
-		phys_put_long(mmu_get_real_address(addr, cl), val);
-	else
+	if (likely(mmu_lookup(addr, data, true, &cl))) {
+		if (likely(cl->host != NULL))
+			do_put_mem_long((uae_u32*)(cl->host + (addr & 0xfff)), val);
+		else
+			phys_put_long(mmu_get_real_address(addr, cl), val);
+	} else
 		mmu_put_long_slow(addr, val, regs.s != 0, data, size, cl);
 }
 
@@ -384,9 +419,12 @@ static ALWAYS_INLINE void mmu_put_word(uaecptr addr, uae_u16 val, bool data, int
 {
 	struct mmu_atc_line *cl;
 
-	if (likely(mmu_lookup(addr, data, true, &cl)))
-		phys_put_word(mmu_get_real_address(addr, cl), val);
-	else
+	if (likely(mmu_lookup(addr, data, true, &cl))) {
+		if (likely(cl->host != NULL))
+			do_put_mem_word((uae_u16*)(cl->host + (addr & 0xfff)), val);
+		else
+			phys_put_word(mmu_get_real_address(addr, cl), val);
+	} else
 		mmu_put_word_slow(addr, val, regs.s != 0, data, size, cl);
 }
 
@@ -394,9 +432,12 @@ static ALWAYS_INLINE void mmu_put_byte(uaecptr addr, uae_u8 val, bool data, int
 {
 	struct mmu_atc_line *cl;
 
-	if (likely(mmu_lookup(addr, data, true, &cl)))
-		phys_put_byte(mmu_get_real_address(addr, cl), val);
-	else
+	if (likely(mmu_lookup(addr, data, true, &cl))) {
+		if (likely(cl->host != NULL))
+			*(cl->host + (addr & 0xfff)) = val;
+		else
+			phys_put_byte(mmu_get_real_address(addr, cl), val);
+	} else
 		mmu_put_byte_slow(addr, val, regs.s != 0, data, size, cl);
 }
 
@@ -404,8 +445,11 @@ static ALWAYS_INLINE uae_u32 mmu_get_user_long(uaecptr addr, bool super, bool da
 {
 	struct mmu_atc_line *cl;
 
-	if (likely(mmu_user_lookup(addr, super, data, false, &cl)))
+	if (likely(mmu_user_lookup(addr, super, data, false, &cl))) {
+		if (likely(cl->host != NULL))
+			return do_get_mem_long((uae_u32*)(cl->host + (addr & 0xfff)));
 		return phys_get_long(mmu_get_real_address(addr, cl));
+	}
 	return mmu_get_long_slow(addr, super, data, size, cl);
 }
 
@@ -413,8 +457,11 @@ static ALWAYS_INLINE uae_u16 mmu_get_user_word(uaecptr addr, bool super, bool da
 {
 	struct mmu_atc_line *cl;
 
-	if (likely(mmu_user_lookup(addr, super, data, false, &cl)))
+	if (likely(mmu_user_lookup(addr, super, data, false, &cl))) {
+		if (likely(cl->host != NULL))
+			return do_get_mem_word((uae_u16*)(cl->host + (addr & 0xfff)));
 		return phys_get_word(mmu_get_real_address(addr, cl));
+	}
 	return mmu_get_word_slow(addr, super, data, size, cl);
 }
 
@@ -422,8 +469,11 @@ static ALWAYS_INLINE uae_u8 mmu_get_user_byte(uaecptr addr, bool super, bool dat
 {
 	struct mmu_atc_line *cl;
 
-	if (likely(mmu_user_lookup(addr, super, data, false, &cl)))
+	if (likely(mmu_user_lookup(addr, super, data, false, &cl))) {
+		if (likely(cl->host != NULL))
+			return *(cl->host + (addr & 0xfff));
 		return phys_get_byte(mmu_get_real_address(addr, cl));
+	}
 	return mmu_get_byte_slow(addr, super, data, size, cl);
 }
 
@@ -431,9 +481,12 @@ static ALWAYS_INLINE void mmu_put_user_long(uaecptr addr, uae_u32 val, bool supe
 {
 	struct mmu_atc_line *cl;
 
-	if (likely(mmu_user_lookup(addr, super, data, true, &cl)))
-		phys_put_long(mmu_get_real_address(addr, cl), val);
-	else
+	if (likely(mmu_user_lookup(addr, super, data, true, &cl))) {
+		if (likely(cl->host != NULL))
+			do_put_mem_long((uae_u32*)(cl->host + (addr & 0xfff)), val);
+		else
+			phys_put_long(mmu_get_real_address(addr, cl), val);
+	} else
 		mmu_put_long_slow(addr, val, super, data, size, cl);
 }
 
@@ -441,9 +494,12 @@ static ALWAYS_INLINE void mmu_put_user_word(uaecptr addr, uae_u16 val, bool supe
 {
 	struct mmu_atc_line *cl;
 
-	if (likely(mmu_user_lookup(addr, super, data, true, &cl)))
-		phys_put_word(mmu_get_real_address(addr, cl), val);
-	else
+	if (likely(mmu_user_lookup(addr, super, data, true, &cl))) {
+		if (likely(cl->host != NULL))
+			do_put_mem_word((uae_u16*)(cl->host + (addr & 0xfff)), val);
+		else
+			phys_put_word(mmu_get_real_address(addr, cl), val);
+	} else
 		mmu_put_word_slow(addr, val, super, data, size, cl);
 }
 
@@ -451,9 +507,12 @@ static ALWAYS_INLINE void mmu_put_user_byte(uaecptr addr, uae_u8 val, bool super
 {
 	struct mmu_atc_line *cl;
 
-	if (likely(mmu_user_lookup(addr, super, data, true, &cl)))
-		phys_put_byte(mmu_get_real_address(addr, cl), val);
-	else
+	if (likely(mmu_user_lookup(addr, super, data, true, &cl))) {
+		if (likely(cl->host != NULL))
+			*(cl->host + (addr & 0xfff)) = val;
+		else
+			phys_put_byte(mmu_get_real_address(addr, cl), val);
+	} else
 		mmu_put_byte_slow(addr, val, super, data, size, cl);
 }
 
@@ -23,6 +23,7 @@ extern void custom_prepare (void);
 extern void custom_reset (int hardreset);
 extern int intlev (void);
 extern void dumpcustom (void);
+extern void custom_wput_benchmark (uae_u32 *cpurate, uae_u32 *copperrate);
 
 extern void do_disk (void);
 extern void do_copper (void);
@@ -41,6 +41,8 @@ extern int instruction_breakpoint (TCHAR **c);
 extern int debug_bankchange (int);
 extern void log_dma_record (void);
 extern void debug_parser (const TCHAR *cmd, TCHAR *out, uae_u32 outsize);
+extern int debug_profile;
+extern void debug_profile_sample (void);
 
 #define BREAKPOINT_TOTAL 20
 struct breakpoint_node {
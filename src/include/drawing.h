@@ -279,6 +279,7 @@ extern int thisframe_first_drawn_line, thisframe_last_drawn_line;
 #define IHF_QUIT_PROGRAM 1
 #define IHF_PICASSO 2
 #define IHF_SOUNDADJUST 3
+#define IHF_RUNAHEAD 4
 
 extern int inhibit_frame;
 
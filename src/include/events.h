@@ -16,6 +16,7 @@
 
 #include "machdep/rpt.h"
 #include "hrtimer.h"
+#include "hostprof.h"
 
 /* Every Amiga hardware clock cycle takes this many "virtual" cycles.  This
  * used to be hardcoded as 1, but using higher values allows us to time some
@@ -34,6 +34,7 @@ STATIC_INLINE void do_cycles_slow (unsigned long cycles_to_add)
 
 		for (i = 0; i < ev_max; i++) {
 			if (eventtab[i].active && eventtab[i].evtime == currcycle) {
+				HOSTPROF_COUNT (HPC_EVENTS);
 				(*eventtab[i].handler)();
 			}
 		}
@@ -54,6 +55,7 @@ STATIC_INLINE void do_cycles_fast (void)
 
 		for (i = 0; i < ev_max; i++) {
 			if (eventtab[i].active && eventtab[i].evtime == currcycle) {
+				HOSTPROF_COUNT (HPC_EVENTS);
 				(*eventtab[i].handler) ();
 			}
 		}
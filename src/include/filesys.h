@@ -51,6 +51,8 @@ struct hardfiledata {
 
     int drive_empty;
     TCHAR *emptyname;
+    int direct_io;
+    struct hdf_blockcache *bcache;
 };
 
 #define HFD_FLAGS_REALDRIVE 1
@@ -123,4 +125,7 @@ extern void hdf_close_target (struct hardfiledata *hfd);
 extern int hdf_read_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len);
 extern int hdf_write_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len);
 extern int hdf_resize_target (struct hardfiledata *hfd, uae_u64 newsize);
+extern int hdf_direct_target (struct hardfiledata *hfd, int enable);
+extern int hdf_cache_flush (struct hardfiledata *hfd);
+extern void hardfile_cache_stats (void);
 extern void getchsgeometry (uae_u64 size, int *pcyl, int *phead, int *psectorspertrack);
@@ -66,10 +66,110 @@ STATIC_INLINE void from_double (double src, uae_u32 * wrd1, uae_u32 * wrd2)
 #endif
 }
 
+/*
+ * Extended precision conversions working directly on the bit patterns,
+ * no frexp/ldexp. Infinities, NaNs and denormals are kept, mantissas are
+ * rounded to nearest even when narrowing to double.
+ */
+STATIC_INLINE double to_exten (uae_u32 wrd1, uae_u32 wrd2, uae_u32 wrd3)
+{
+    union {
+	double d;
+	uae_u64 u;
+    } val;
+    uae_u64 sign = (uae_u64)(wrd1 & 0x80000000) << 32;
+    uae_u64 mant = ((uae_u64)wrd2 << 32) | wrd3;
+    int expon = (wrd1 >> 16) & 0x7fff;
+    uae_u32 rest;
+
+    if (expon == 0x7fff) {
+	/* the explicit integer bit does not matter for infinity or NaN */
+	mant <<= 1;
+	val.u = sign | 0x7ff0000000000000ULL | (mant >> 12);
+	if (mant)
+	    val.u |= 0x0008000000000000ULL;
+	return val.d;
+    }
+    if (mant == 0) {
+	val.u = sign;
+	return val.d;
+    }
+    /* denormals and unnormals */
+    while (!(mant & 0x8000000000000000ULL)) {
+	mant <<= 1;
+	expon--;
+    }
+    expon += 1023 - 16383;
+    if (expon <= 0) {
+	int shift = 1 - expon;
+	if (shift > 63) {
+	    val.u = sign;
+	    return val.d;
+	}
+	mant = (mant >> shift) | ((mant & ((1ULL << shift) - 1)) != 0);
+	expon = 0;
+    }
+    rest = (uae_u32)mant & 0x7ff;
+    mant >>= 11;
+    if (rest > 0x400 || (rest == 0x400 && (mant & 1)))
+	mant++;
+    if (mant >> 53) {
+	mant >>= 1;
+	expon++;
+    } else if (expon == 0 && (mant >> 52)) {
+	expon = 1;
+    }
+    if (expon >= 0x7ff) {
+	val.u = sign | 0x7ff0000000000000ULL;
+	return val.d;
+    }
+    val.u = sign | ((uae_u64)expon << 52) | (mant & 0x000fffffffffffffULL);
+    return val.d;
+}
+
+STATIC_INLINE void from_exten (double src, uae_u32 * wrd1, uae_u32 * wrd2, uae_u32 * wrd3)
+{
+    union {
+	double d;
+	uae_u64 u;
+    } val;
+    uae_u32 sign;
+    uae_u64 mant;
+    int expon;
+
+    val.d = src;
+    sign = (uae_u32)(val.u >> 32) & 0x80000000;
+    expon = (int)(val.u >> 52) & 0x7ff;
+    mant = val.u & 0x000fffffffffffffULL;
+    if (expon == 0x7ff) {
+	*wrd1 = sign | 0x7fff0000;
+	mant <<= 11;
+    } else {
+	if (expon == 0) {
+	    if (mant == 0) {
+		*wrd1 = sign;
+		*wrd2 = *wrd3 = 0;
+		return;
+	    }
+	    expon = 1;
+	    while (!(mant & 0x0010000000000000ULL)) {
+		mant <<= 1;
+		expon--;
+	    }
+	}
+	mant = (mant | 0x0010000000000000ULL) << 11;
+	*wrd1 = sign | ((expon + 16383 - 1023) << 16);
+    }
+    *wrd2 = (uae_u32)(mant >> 32);
+    *wrd3 = (uae_u32)mant;
+}
+
 #define HAVE_from_double
 #define HAVE_to_double
 #define HAVE_from_single
 #define HAVE_to_single
+#define HAVE_to_exten
+#define HAVE_from_exten
 
 /* Get the rest of the conversion functions defined.  */
 #include "fpp-unknown.h"
@@ -1,50 +1,36 @@
 
 #ifdef GFXFILTER
 
-typedef unsigned char u8;
-typedef unsigned short u16;
-typedef unsigned long u32;
+/* Software scalers (gfxfilter.c)
+ *
+ * The Amiga screen is drawn at 1/mult of the display size into a buffer
+ * owned by the filter (S2X_getbuffer). S2X_render scales the lines that
+ * changed since the last frame into the display, split into bands that
+ * are processed by a pool of threads.
+ */
 
 extern void S2X_refresh (void);
-extern void S2X_render (void);
+extern int S2X_render (uae_u8 *dst, int dstpitch, int *first, int *last);
 extern void S2X_init (int dw, int dh, int aw, int ah, int ad, int dd);
 extern void S2X_reset (void);
 extern void S2X_free (void);
 extern int S2X_getmult (void);
+extern uae_u8 *S2X_getbuffer (int *pitch);
+extern void S2X_invalidate (int first, int last);
+extern void S2X_configure (int rb, int gb, int bb, int rs, int gs, int bs);
 
 extern void PAL_init (void);
 extern void PAL_1x1_32 (uae_u32 *src, int pitchs, uae_u32 *trg, int pitcht, int width, int height);
 extern void PAL_1x1_16 (uae_u16 *src, int pitchs, uae_u16 *trg, int pitcht, int width, int height);
 
-typedef unsigned char uint8;
-typedef unsigned short uint16;
-typedef unsigned long uint32;
-#ifndef __cplusplus
-typedef int bool;
-#endif
-
-	extern void S2X_configure (int rb, int gb, int bb, int rs, int gs, int bs);
-	extern int Init_2xSaI (int rb, int gb, int bb, int rs, int gs, int bs);
-	extern void Super2xSaI_16 (const uint8 *srcPtr, uint32 srcPitch, uint8 *dstPtr, uint32 dstPitch, int width, int height);
-	extern void Super2xSaI_32 (const uint8 *srcPtr, uint32 srcPitch, uint8 *dstPtr, uint32 dstPitch, int width, int height);
-	extern void SuperEagle_16 (const uint8 *srcPtr, uint32 srcPitch, uint8 *dstPtr, uint32 dstPitch, int width, int height);
-	extern void SuperEagle_32 (const uint8 *srcPtr, uint32 srcPitch, uint8 *dstPtr, uint32 dstPitch, int width, int height);
-	extern void _2xSaI_16 (const uint8 *srcPtr, uint32 srcPitch, uint8 *dstPtr, uint32 dstPitch, int width, int height);
-	extern void _2xSaI_32 (const uint8 *srcPtr, uint32 srcPitch, uint8 *dstPtr, uint32 dstPitch, int width, int height);
-	extern void AdMame2x (u8 *srcPtr, u32 srcPitch, /* u8 deltaPtr, */
-		      u8 *dstPtr, u32 dstPitch, int width, int height);
-	extern void AdMame2x32 (u8 *srcPtr, u32 srcPitch, /* u8 deltaPtr, */
-		      u8 *dstPtr, u32 dstPitch, int width, int height);
-
-	extern void hq_init (int rb, int gb, int bb, int rs, int gs, int bs);
-
-	extern void _cdecl hq2x_16 (unsigned char*, unsigned char*, DWORD, DWORD, DWORD);
-	extern void _cdecl hq2x_32 (unsigned char*, unsigned char*, DWORD, DWORD, DWORD);
-	extern void _cdecl hq3x_16 (unsigned char*, unsigned char*, DWORD, DWORD, DWORD);
-	extern void _cdecl hq3x_32 (unsigned char*, unsigned char*, DWORD, DWORD, DWORD);
-	extern void _cdecl hq4x_16 (unsigned char*, unsigned char*, DWORD, DWORD, DWORD);
-	extern void _cdecl hq4x_32 (unsigned char*, unsigned char*, DWORD, DWORD, DWORD);
-}
+/* Single band kernels, pitches in bytes. Scale2x/3x are the AdvanceMAME
+ * edge rules, hq is an hq2x style YUV edge interpolation for 2x to 4x. */
+extern void scale2x_32 (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int height);
+extern void scale2x_16 (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int height);
+extern void scale3x_32 (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int height);
+extern void scale3x_16 (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int height);
+extern void hq_32 (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int height, int mult);
+extern void hq_16 (const uae_u8 *src, int srcpitch, uae_u8 *dst, int dstpitch, int width, int y0, int y1, int height, int mult);
 
 #define UAE_FILTER_NULL 1
 #define UAE_FILTER_SCALE2X 2
@@ -0,0 +1,105 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Host side instrumentation of the emulation hot paths
+  *
+  * Only built with --enable-hostprof (HOSTPROF), otherwise the
+  * macros below compile to nothing.
+  */
+
+#ifndef UAE_HOSTPROF_H
+#define UAE_HOSTPROF_H
+
+/* Timed sections. Time is exclusive: a section entered from another
+ * one stops the outer clock. Whatever runs outside any section is
+ * charged to HP_CPU, which is mostly m68k_run_* (and JIT code). */
+enum {
+	HP_CPU,
+	HP_HSYNC,
+	HP_VSYNC,
+	HP_BLITTER,
+	HP_COPPER,
+	HP_DRAW,
+	HP_AUDIO,
+	HP_DISK,
+	HP_CIA,
+	HP_SNAPSHOT,
+	HP_MAX
+};
+
+/* per frame event counters */
+enum {
+	HPC_BLITS,
+	HPC_COPPERMOVES,
+	HPC_LINES,
+	HPC_EVENTS,
+	HPC_JITCOMPILES,
+	HPC_MAX
+};
+
+#ifdef HOSTPROF
+
+#include <time.h>
+
+#define HOSTPROF_DEPTH 16 /* power of two */
+#define HOSTPROF_FRAMES 512
+
+struct hostprof_frame
+{
+	uae_u32 frame;
+	uae_u32 total;		/* microseconds */
+	uae_u32 time[HP_MAX];	/* microseconds */
+	uae_u32 count[HPC_MAX];
+};
+
+extern const TCHAR *hostprof_names[HP_MAX], *hostprof_counternames[HPC_MAX];
+extern uae_u64 hostprof_time[HP_MAX], hostprof_last;
+extern uae_u32 hostprof_count[HPC_MAX];
+extern int hostprof_stack[HOSTPROF_DEPTH], hostprof_sp;
+
+STATIC_INLINE uae_u64 hostprof_clock (void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return __builtin_ia32_rdtsc ();
+#else
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+STATIC_INLINE void hostprof_enter (int section)
+{
+	uae_u64 now = hostprof_clock ();
+
+	hostprof_time[hostprof_stack[hostprof_sp & (HOSTPROF_DEPTH - 1)]] += now - hostprof_last;
+	hostprof_last = now;
+	hostprof_stack[++hostprof_sp & (HOSTPROF_DEPTH - 1)] = section;
+}
+
+STATIC_INLINE void hostprof_leave (void)
+{
+	uae_u64 now = hostprof_clock ();
+
+	hostprof_time[hostprof_stack[hostprof_sp-- & (HOSTPROF_DEPTH - 1)]] += now - hostprof_last;
+	hostprof_last = now;
+}
+
+extern void hostprof_vsync (void);
+extern const struct hostprof_frame *hostprof_getframe (int back);
+extern int hostprof_frames (void);
+extern void hostprof_exit (void);
+
+#define HOSTPROF_ENTER(s) hostprof_enter (s)
+#define HOSTPROF_LEAVE() hostprof_leave ()
+#define HOSTPROF_COUNT(c) (hostprof_count[c]++)
+
+#else
+
+#define HOSTPROF_ENTER(s)
+#define HOSTPROF_LEAVE()
+#define HOSTPROF_COUNT(c)
+
+#endif
+
+#endif /* UAE_HOSTPROF_H */
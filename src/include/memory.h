@@ -177,6 +177,15 @@ extern void map_overlay (int chip);
 extern void memory_hardreset (void);
 extern void free_fastmemory (void);
 
+#ifdef SAVESTATE
+extern int memory_snapshot_start (void);
+extern void memory_snapshot_stop (void);
+extern int memory_snapshot_active (void);
+extern int memory_snapshot_save (void);
+extern int memory_snapshot_restore (void);
+extern void memory_snapshot_chipblock (uaecptr addr, int width, int step, int rows);
+#endif
+
 #define longget(addr) (call_mem_get_func(get_mem_bank(addr).lget, addr))
 #define wordget(addr) (call_mem_get_func(get_mem_bank(addr).wget, addr))
 #define byteget(addr) (call_mem_get_func(get_mem_bank(addr).bget, addr))
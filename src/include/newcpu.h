@@ -448,12 +448,17 @@ extern cpuop_func *cpufunctbl[65536] ASM_SYM_FOR_FUNC ("cpufunctbl");
 #ifdef JIT
 extern void flush_icache (uaecptr, int);
 extern void compemu_reset (void);
+extern void compemu_profile_dump (int maxlines, void (*out)(const char *, ...));
+extern void compemu_profile_reset (void);
+extern void compemu_profile_enable (bool enable);
 //extern bool check_prefs_changed_comp (void);
 #else
 #define flush_icache(uaecptr, int) do {} while (0)
 #endif
 extern void flush_dcache (uaecptr, int);
 extern void flush_mmu (uaecptr, int);
+extern void mmu_flush_host_cache (void);
+extern void mmu_enable_host_cache (bool);
 
 extern int movec_illg (int regno);
 extern uae_u32 val_move2c (int regno);
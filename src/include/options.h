@@ -228,11 +228,11 @@ struct uae_prefs {
 	bool compfpu;
 	bool comp_midopt;
 	bool comp_lowopt;
-	bool fpu_strict;
 
 	bool comp_hardflush;
 	bool comp_constjump;
 	bool comp_oldsegv;
+	bool comp_profile;
 
 	int optcount[10];
 #endif
@@ -298,6 +298,9 @@ struct uae_prefs {
 	int collision_level;
 	int leds_on_screen;
 	struct wh osd_pos;
+	TCHAR host_profile_file[MAX_DPATH];
+	TCHAR record_file[MAX_DPATH];
+	int record_codec;
 	int keyboard_leds[3];
 	bool keyboard_leds_in_use;
 	int scsi;
@@ -311,6 +314,7 @@ struct uae_prefs {
 	int cpu_frequency;
 	bool blitter_cycle_exact;
 	int floppy_speed;
+	bool floppy_turbo_dma;
 	int floppy_write_length;
 	int floppy_random_bits_min;
 	int floppy_random_bits_max;
@@ -386,6 +390,10 @@ struct uae_prefs {
 	int mmu_model;
 	int cpu060_revision;
 	int fpu_model;
+	bool fpu_strict;
+	TCHAR cpu_trace_file[MAX_DPATH];
+	int cpu_trace_registers;
+	bool cpu_trace_memory;
 	int fpu_revision;
 	bool cpu_compatible;
 	bool address_space_24;
@@ -412,6 +420,8 @@ struct uae_prefs {
 	bool kickshifter;
 	bool filesys_no_uaefsdb;
 	bool filesys_custom_uaefsdb;
+	int hardfile_queue_depth;
+	int hardfile_cache_size;
 	bool mmkeyboard;
 	int uae_hide;
 	bool clipboard_sharing;
@@ -507,6 +517,7 @@ struct uae_prefs {
 #ifdef SAVESTATE
 	bool statecapture;
 	int statecapturerate, statecapturebuffersize;
+	int runahead;
 #endif
 
 	/* input */
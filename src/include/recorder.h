@@ -0,0 +1,75 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Video and audio recorder
+  */
+
+#ifndef UAE_RECORDER_H
+#define UAE_RECORDER_H
+
+/* A recording is a struct recorder_header followed by packets, each a
+ * struct recorder_packet and size bytes of payload, all in host byte
+ * order. Video payload is width * height * pixbytes of tightly packed
+ * pixels, audio payload is signed 16 bit samples, interleaved.
+ * Use the readrecord tool to convert a recording. */
+#define RECORDER_MAGIC 0x52454155 /* "UAER" on little endian hosts */
+#define RECORDER_VERSION 1
+
+enum {
+	RECP_VIDEO,	/* stamp = frame number */
+	RECP_REPEAT,	/* previous video frame shown again, no payload */
+	RECP_AUDIO	/* stamp = sample frames recorded before this block */
+};
+
+/* packet flags */
+#define RECF_ZLIB 1	/* payload is zlib compressed to size bytes */
+#define RECF_DELTA 2	/* video: XOR with the previous video frame */
+
+struct recorder_header
+{
+	uae_u32 magic;
+	uae_u16 version;
+	uae_u16 hdrsize;
+	uae_u32 fps_milli;	/* display rate * 1000 */
+	uae_u32 audio_freq;
+	uae_u16 audio_channels;
+	uae_u16 pad;
+};
+
+struct recorder_packet
+{
+	uae_u32 size;		/* payload bytes following in the file */
+	uae_u32 rawsize;	/* payload bytes once decompressed */
+	uae_u32 stamp;
+	uae_u8 type;
+	uae_u8 flags;
+	uae_u8 pixbytes;
+	uae_u8 pad;
+	uae_u16 width, height;
+	uae_u8 bits[3];		/* red, green and blue bits */
+	uae_u8 shift[3];	/* red, green and blue shift */
+	uae_u16 pad2;
+};
+
+struct recorder_stats
+{
+	uae_u32 frames;		/* video frames queued, including repeats */
+	uae_u32 repeats;
+	uae_u32 frames_dropped;
+	uae_u32 audio_blocks;
+	uae_u32 audio_dropped;
+	int queue_depth, queue_max;
+	uae_u64 bytes_in, bytes_out;
+};
+
+extern int recorder_active;
+
+extern void recorder_setup (void);
+extern void recorder_stop (void);
+extern void recorder_setformat (int rw, int gw, int bw, int rs, int gs, int bs);
+extern void recorder_frame (const uae_u8 *buf, int pitch, int width, int height, int pixbytes);
+extern void recorder_vsync (void);
+extern void recorder_audio (const uae_u8 *buf, int bytes);
+extern void recorder_getstats (struct recorder_stats *st);
+
+#endif /* UAE_RECORDER_H */
@@ -73,6 +73,7 @@ extern struct romlist *getromlistbyromdata (const struct romdata *rd);
 extern void romlist_add (const TCHAR *path, struct romdata *rd);
 extern TCHAR *romlist_get (const struct romdata *rd);
 extern void romlist_clear (void);
+extern int romscan_paths (const TCHAR **paths, int num, const TCHAR *indexfile);
 extern struct zfile *read_rom (struct romdata **rd);
 extern struct zfile *read_rom_name (const TCHAR *filename);
 
@@ -232,6 +232,36 @@ STATIC_INLINE bool isrestore (void)
 
 extern void savestate_quick (int slot, int save);
 
+/* Run-ahead keeps the machine state in memory and restores it into the
+ * same running emulation, so each module lists the variables it wants
+ * copied as they are. Tables end with a NULL entry. */
+struct runahead_var
+{
+	void *ptr;
+	int size;
+};
+#define RUNAHEAD_VAR(x) { &(x), sizeof (x) }
+
+extern const struct runahead_var cpu_runahead_vars[];
+extern const struct runahead_var custom_runahead_vars[];
+extern const struct runahead_var blitter_runahead_vars[];
+extern const struct runahead_var audio_runahead_vars[];
+extern const struct runahead_var cia_runahead_vars[];
+extern const struct runahead_var disk_runahead_vars[];
+extern const struct runahead_var keybuf_runahead_vars[];
+extern const struct runahead_var inputstate_runahead_vars[];
+
+extern int disk_runahead_size (void);
+extern uae_u8 *save_disk_runahead (uae_u8 *dst);
+extern uae_u8 *restore_disk_runahead (uae_u8 *src);
+extern void restore_custom_runahead_finish (void);
+
+extern int runahead_frame, runahead_frames;
+extern void savestate_runahead_vsync (void);
+extern void savestate_runahead (void);
+extern void savestate_runahead_commit (void);
+extern void savestate_runahead_stop (void);
+
 extern void savestate_capture (int);
 extern void savestate_free (void);
 extern void savestate_init (void);
@@ -244,5 +274,7 @@ extern void savestate_capture_request (void);
 #else
 
 #define savestate_state 0
+#define runahead_frame 0
+#define runahead_frames 0
 
 #endif
@@ -0,0 +1,36 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Page tracked RAM snapshots
+  */
+
+#ifndef UAE_SNAPSHOT_H
+#define UAE_SNAPSHOT_H
+
+#define SNAPSHOT_PAGE_SHIFT 12
+#define SNAPSHOT_PAGE_SIZE (1 << SNAPSHOT_PAGE_SHIFT)
+
+/* A copy of a block of RAM that is kept up to date page by page.
+ * Whoever writes to mem marks the page, saving and restoring then
+ * only copy the pages marked since the last save or restore. */
+struct snapshot_ram
+{
+	uae_u8 *mem;		/* live memory */
+	uae_u8 *copy;		/* mem as it was at the last save */
+	uae_u8 *dirty;		/* one byte per page, padded to 8 */
+	uae_u32 size;
+	uae_u32 pages;
+};
+
+STATIC_INLINE void snapshot_ram_mark (struct snapshot_ram *r, uae_u32 offset)
+{
+	if (offset < r->size)
+		r->dirty[offset >> SNAPSHOT_PAGE_SHIFT] = 1;
+}
+
+extern int snapshot_ram_init (struct snapshot_ram *r, uae_u8 *mem, uae_u32 size);
+extern void snapshot_ram_free (struct snapshot_ram *r);
+extern int snapshot_ram_save (struct snapshot_ram *r);
+extern int snapshot_ram_restore (struct snapshot_ram *r);
+
+#endif /* UAE_SNAPSHOT_H */
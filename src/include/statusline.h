@@ -21,7 +21,9 @@ static int td_pos = (TD_RIGHT|TD_BOTTOM);
 
 #define STATUSLINE_CHIPSET 1
 #define STATUSLINE_RTG 2
+#define STATUSLINE_HOSTPROF 4
 #define STATUSLINE_TARGET 0x80
 
 extern void draw_status_line_single (uae_u8 *buf, int bpp, int y, int totalwidth, uae_u32 *rc, uae_u32 *gc, uae_u32 *bc, uae_u32 *alpha);
 extern void statusline_getpos (int *x, int *y, int width, int height);
+extern void draw_status_line_hostprof (uae_u8 *buf, int bpp, int y, int totalwidth, uae_u32 *rc, uae_u32 *gc, uae_u32 *bc, uae_u32 *alpha);
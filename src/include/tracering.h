@@ -0,0 +1,67 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * CPU execution trace ring
+  */
+
+#ifndef UAE_TRACERING_H
+#define UAE_TRACERING_H
+
+/* Trace files are gzip compressed: a struct tracering_header followed
+ * by struct tracering_rec records, both in host byte order. */
+#define TRACERING_MAGIC 0x54454155 /* "UAET" on little endian hosts */
+#define TRACERING_VERSION 1
+
+enum {
+	TR_INSN,	/* pc, opcode, cycles; value = cycle count high bits */
+	TR_REG,		/* register size (D0-D7, A0-A7) changed to value */
+	TR_READ,	/* data read: pc = address, size = 1, 2 or 4 */
+	TR_WRITE,	/* data write: pc = address, size = 1, 2 or 4 */
+	TR_DROP		/* value records were lost, the writer fell behind */
+};
+
+struct tracering_header
+{
+	uae_u32 magic;
+	uae_u16 version;
+	uae_u16 recsize;
+	uae_u32 regmask;
+	uae_u32 flags;
+};
+
+struct tracering_rec
+{
+	uae_u32 pc;
+	uae_u32 cycles;
+	uae_u32 value;
+	uae_u16 opcode;
+	uae_u8 type;
+	uae_u8 size;
+};
+
+#define TRACERING_MEMORY 1 /* header flags: memory accesses are recorded */
+
+extern int tracering_active, tracering_memory;
+extern uae_u32 tracering_regmask;
+extern struct tracering_rec *tracering_ptr, *tracering_end;
+
+extern void tracering_nextblock (void);
+extern void tracering_regdelta (void);
+extern void tracering_setup (void);
+extern void tracering_stop (void);
+
+STATIC_INLINE void tracering_add (int type, int size, uae_u16 opcode, uae_u32 pc, uae_u32 value, uae_u32 cycles)
+{
+	struct tracering_rec *r = tracering_ptr;
+
+	r->pc = pc;
+	r->cycles = cycles;
+	r->value = value;
+	r->opcode = opcode;
+	r->type = type;
+	r->size = size;
+	if (++tracering_ptr == tracering_end)
+		tracering_nextblock ();
+}
+
+#endif /* UAE_TRACERING_H */
@@ -1,3 +1,5 @@
+struct s2devstruct;
+
 struct netdriverdata
 {
     TCHAR *name;
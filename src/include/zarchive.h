@@ -2,6 +2,7 @@
 typedef uae_s64 (*ZFILEREAD)(void*, uae_u64, uae_u64, struct zfile*);
 typedef uae_s64 (*ZFILEWRITE)(void*, uae_u64, uae_u64, struct zfile*);
 typedef uae_s64 (*ZFILESEEK)(struct zfile*, uae_s64, int);
+typedef void (*ZFILECLOSE)(struct zfile*);
 
 struct zfile {
     TCHAR *name;
@@ -26,6 +27,7 @@ struct zfile {
     ZFILEREAD zfileread;
     ZFILEWRITE zfilewrite;
     ZFILESEEK zfileseek;
+    ZFILECLOSE zfileclose;
     void *userdata;
     int useparent;
 };
@@ -53,6 +53,7 @@ extern int zfile_getc (struct zfile *z);
 extern int zfile_putc (int c, struct zfile *z);
 extern int zfile_ferror (struct zfile *z);
 extern uae_u8 *zfile_getdata (struct zfile *z, uae_s64 offset, int len);
+extern void zfile_readahead (struct zfile *z, uae_s64 offset, uae_s64 len);
 extern void zfile_exit (void);
 extern int execute_command (TCHAR *);
 extern int zfile_iscompressed (struct zfile *z);
@@ -5932,4 +5932,21 @@ void clear_inputstate (void)
 		vertclear[i] = 1;
 	}
 }
+
+const struct runahead_var inputstate_runahead_vars[] = {
+	RUNAHEAD_VAR (joydir),
+	RUNAHEAD_VAR (joybutton),
+	RUNAHEAD_VAR (otop),
+	RUNAHEAD_VAR (obot),
+	RUNAHEAD_VAR (oleft),
+	RUNAHEAD_VAR (oright),
+	RUNAHEAD_VAR (cd32_shifter),
+	RUNAHEAD_VAR (pot_cap),
+	RUNAHEAD_VAR (joydirpot),
+	RUNAHEAD_VAR (mouse_delta),
+	RUNAHEAD_VAR (mouse_deltanoreset),
+	RUNAHEAD_VAR (mouse_frame_x),
+	RUNAHEAD_VAR (mouse_frame_y),
+	{ NULL, 0 }
+};
 #endif
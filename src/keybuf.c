@@ -83,3 +83,12 @@ void keybuf_init (void)
 	kpb_first = kpb_last = 0;
 	inputdevice_updateconfig (&currprefs);
 }
+
+#ifdef SAVESTATE
+/* Keys read during run-ahead frames are read again by the real frame.
+ * Only the read position goes back, keys typed since stay queued. */
+const struct runahead_var keybuf_runahead_vars[] = {
+	RUNAHEAD_VAR (kpb_last),
+	{ NULL, 0 }
+};
+#endif
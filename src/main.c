@@ -24,6 +24,8 @@
 #include "newcpu.h"
 #include "disk.h"
 #include "debug.h"
+#include "hostprof.h"
+#include "recorder.h"
 #include "xwin.h"
 #include "inputdevice.h"
 #include "keybuf.h"
@@ -393,6 +395,13 @@ void fixup_prefs (struct uae_prefs *p)
 		p->collision_level = 1;
 		err = 1;
 	}
+#ifdef SAVESTATE
+	if (p->runahead < 0 || p->runahead > 4) {
+		write_log ("Invalid run_ahead value, must be within 0..4.  Using 0.\n");
+		p->runahead = 0;
+		err = 1;
+	}
+#endif
 	if (p->parallel_postscript_emulation)
 		p->parallel_postscript_detection = 1;
 	if (p->cs_compatible == 1) {
@@ -755,6 +764,9 @@ void do_start_program (void)
 	inputdevice_updateconfig (&currprefs);
 	if (quit_program >= 0)
 		quit_program = 2;
+#ifdef RECORDER
+	recorder_setup ();
+#endif
 	m68k_go (1);
 }
 
@@ -762,12 +774,21 @@ void do_leave_program (void)
 {
 #ifdef SAMPLER
 	sampler_free ();
+#endif
+#ifdef RECORDER
+	recorder_stop ();
 #endif
 	graphics_leave ();
 	inputdevice_close ();
 	DISK_free ();
 	close_sound ();
 	dump_counts ();
+#ifdef JIT
+	compemu_profile_dump (50, write_log);
+#endif
+#ifdef HOSTPROF
+	hostprof_exit ();
+#endif
 #ifdef SERIAL_PORT
 	serial_exit ();
 #endif
@@ -32,6 +32,7 @@
 #include "a2091.h"
 #include "gayle.h"
 #include "debug.h"
+#include "snapshot.h"
 
 extern uae_u8 *natmem_offset, *natmem_offset_end;
 
@@ -2454,11 +2455,185 @@ void map_overlay (int chip)
 		m68k_setpc (m68k_getpc ());
 }
 
+#ifdef SAVESTATE
+
+/* Write tracking for run-ahead snapshots (snapshot.c). While a snapshot
+ * is kept, the put functions of the RAM banks and the chip RAM DMA
+ * pointers are replaced by ones that also mark the page written to. */
+
+enum { SNAP_CHIP, SNAP_BOGO, SNAP_FAST, SNAP_BANKS };
+
+struct snapshot_bank
+{
+	addrbank *bank;
+	mem_put_func lput, wput, bput;
+	struct snapshot_ram ram;
+};
+
+static struct snapshot_bank snapbanks[SNAP_BANKS];
+static void (REGPARAM3 *snap_lput_indirect)(uaecptr, uae_u32) REGPARAM;
+static void (REGPARAM3 *snap_wput_indirect)(uaecptr, uae_u32) REGPARAM;
+static void (REGPARAM3 *snap_bput_indirect)(uaecptr, uae_u32) REGPARAM;
+static int snapshot_active;
+
+#define SNAPSHOT_PUT(name, n, put, size) \
+static void REGPARAM2 name (uaecptr addr, uae_u32 v) \
+{ \
+	struct snapshot_bank *sb = &snapbanks[n]; \
+	uae_u32 offset = sb->bank->xlateaddr (addr) - sb->ram.mem; \
+	call_mem_put_func (sb->put, addr, v); \
+	snapshot_ram_mark (&sb->ram, offset); \
+	snapshot_ram_mark (&sb->ram, offset + size - 1); \
+}
+
+SNAPSHOT_PUT (snap_chip_lput, SNAP_CHIP, lput, 4)
+SNAPSHOT_PUT (snap_chip_wput, SNAP_CHIP, wput, 2)
+SNAPSHOT_PUT (snap_chip_bput, SNAP_CHIP, bput, 1)
+SNAPSHOT_PUT (snap_bogo_lput, SNAP_BOGO, lput, 4)
+SNAPSHOT_PUT (snap_bogo_wput, SNAP_BOGO, wput, 2)
+SNAPSHOT_PUT (snap_bogo_bput, SNAP_BOGO, bput, 1)
+SNAPSHOT_PUT (snap_fast_lput, SNAP_FAST, lput, 4)
+SNAPSHOT_PUT (snap_fast_wput, SNAP_FAST, wput, 2)
+SNAPSHOT_PUT (snap_fast_bput, SNAP_FAST, bput, 1)
+
+/* blitter, disk and copper DMA */
+static void REGPARAM2 snap_chip_lput_indirect (uaecptr addr, uae_u32 v)
+{
+	snap_lput_indirect (addr, v);
+	snapshot_ram_mark (&snapbanks[SNAP_CHIP].ram, addr & chipmem_full_mask);
+	snapshot_ram_mark (&snapbanks[SNAP_CHIP].ram, (addr + 3) & chipmem_full_mask);
+}
+static void REGPARAM2 snap_chip_wput_indirect (uaecptr addr, uae_u32 v)
+{
+	snap_wput_indirect (addr, v);
+	snapshot_ram_mark (&snapbanks[SNAP_CHIP].ram, addr & chipmem_full_mask);
+}
+static void REGPARAM2 snap_chip_bput_indirect (uaecptr addr, uae_u32 v)
+{
+	snap_bput_indirect (addr, v);
+	snapshot_ram_mark (&snapbanks[SNAP_CHIP].ram, addr & chipmem_full_mask);
+}
+
+static const mem_put_func snapputs[SNAP_BANKS][3] = {
+	{ snap_chip_lput, snap_chip_wput, snap_chip_bput },
+	{ snap_bogo_lput, snap_bogo_wput, snap_bogo_bput },
+	{ snap_fast_lput, snap_fast_wput, snap_fast_bput }
+};
+
+/* Take a full copy of chip, slow and Zorro II fast RAM and start
+ * tracking writes. Other memory (Zorro III, motherboard RAM, RTG) is
+ * not tracked, the caller has to refuse such configurations. */
+int memory_snapshot_start (void)
+{
+	int i;
+
+	memory_snapshot_stop ();
+	snapbanks[SNAP_CHIP].bank = &chipmem_bank;
+	snapbanks[SNAP_BOGO].bank = &bogomem_bank;
+	snapbanks[SNAP_FAST].bank = &fastmem_bank;
+	for (i = 0; i < SNAP_BANKS; i++) {
+		struct snapshot_bank *sb = &snapbanks[i];
+		uae_u32 size = i == SNAP_CHIP ? allocated_chipmem : i == SNAP_BOGO ? allocated_bogomem : allocated_fastmem;
+		if (!size || !sb->bank->baseaddr)
+			continue;
+		if (!snapshot_ram_init (&sb->ram, sb->bank->baseaddr, size)) {
+			memory_snapshot_stop ();
+			return 0;
+		}
+		sb->lput = sb->bank->lput;
+		sb->wput = sb->bank->wput;
+		sb->bput = sb->bank->bput;
+		sb->bank->lput = snapputs[i][0];
+		sb->bank->wput = snapputs[i][1];
+		sb->bank->bput = snapputs[i][2];
+	}
+	snap_lput_indirect = chipmem_lput_indirect;
+	snap_wput_indirect = chipmem_wput_indirect;
+	snap_bput_indirect = chipmem_bput_indirect;
+	chipmem_lput_indirect = snap_chip_lput_indirect;
+	chipmem_wput_indirect = snap_chip_wput_indirect;
+	chipmem_bput_indirect = snap_chip_bput_indirect;
+	snapshot_active = 1;
+	return 1;
+}
+
+void memory_snapshot_stop (void)
+{
+	int i;
+
+	if (!snapshot_active)
+		return;
+	for (i = 0; i < SNAP_BANKS; i++) {
+		struct snapshot_bank *sb = &snapbanks[i];
+		if (!sb->ram.mem)
+			continue;
+		sb->bank->lput = sb->lput;
+		sb->bank->wput = sb->wput;
+		sb->bank->bput = sb->bput;
+		snapshot_ram_free (&sb->ram);
+	}
+	chipmem_lput_indirect = snap_lput_indirect;
+	chipmem_wput_indirect = snap_wput_indirect;
+	chipmem_bput_indirect = snap_bput_indirect;
+	snapshot_active = 0;
+}
+
+int memory_snapshot_active (void)
+{
+	return snapshot_active;
+}
+
+/* For DMA that writes chip RAM directly instead of through the put
+ * functions: rows of width bytes, step bytes apart. */
+void memory_snapshot_chipblock (uaecptr addr, int width, int step, int rows)
+{
+	struct snapshot_ram *r = &snapbanks[SNAP_CHIP].ram;
+
+	if (!snapshot_active || !r->mem || width <= 0)
+		return;
+	while (rows-- > 0) {
+		uae_u32 offset;
+		for (offset = 0; offset < (uae_u32)width; offset += SNAPSHOT_PAGE_SIZE)
+			snapshot_ram_mark (r, (addr + offset) & chipmem_full_mask);
+		snapshot_ram_mark (r, (addr + width - 1) & chipmem_full_mask);
+		addr += step;
+	}
+}
+
+/* Both return the number of pages copied */
+int memory_snapshot_save (void)
+{
+	int i, pages = 0;
+
+	for (i = 0; i < SNAP_BANKS; i++) {
+		if (snapbanks[i].ram.mem)
+			pages += snapshot_ram_save (&snapbanks[i].ram);
+	}
+	return pages;
+}
+
+int memory_snapshot_restore (void)
+{
+	int i, pages = 0;
+
+	for (i = 0; i < SNAP_BANKS; i++) {
+		if (snapbanks[i].ram.mem)
+			pages += snapshot_ram_restore (&snapbanks[i].ram);
+	}
+	return pages;
+}
+
+#endif /* SAVESTATE */
+
 void memory_reset (void)
 {
 	int bnk, bnk_end;
 	int gayle;
 
+#ifdef SAVESTATE
+	/* memory may move, run-ahead takes a new copy when it needs one */
+	memory_snapshot_stop ();
+#endif
 	be_cnt = 0;
 	currprefs.chipmem_size = changed_prefs.chipmem_size;
 	currprefs.bogomem_size = changed_prefs.bogomem_size;
@@ -2842,6 +3017,9 @@ void map_banks (addrbank *bank, int start, int size, int realsize)
 #ifdef JIT
 	flush_icache (0, 3); /* Sure don't want to keep any old mappings around! */
 #endif
+#ifdef MMU
+	mmu_flush_host_cache ();
+#endif
 #ifdef NATMEM_OFFSET
 	delete_shmmaps (start << 16, size << 16);
 #endif
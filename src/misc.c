@@ -31,6 +31,7 @@
 #include "fsdb.h"
 #include "debug.h"
 #include "sleep.h"
+#include "rommgr.h"
 
 #define TRUE 1
 #define FALSE 0
@@ -40,6 +41,7 @@ static int logging_started;
 #define LOG_NORMAL "puae_log.txt"
 
 void fetch_path(TCHAR *name, TCHAR *out, int size);
+void fetch_datapath(TCHAR *out, int size);
 void fetch_configurationpath(TCHAR *out, int size);
 
 void serialuartbreak(int v);
@@ -705,20 +707,24 @@ int scan_roms (int show)
 {
         TCHAR path[MAX_DPATH];
         static int recursive;
-        int id, i, ret, keys, cnt;
-        TCHAR *paths[MAX_ROM_PATHS];
+        int i, ret, cnt;
+        const TCHAR *paths[MAX_ROM_PATHS];
 
         if (recursive)
                 return 0;
         recursive++;
 
-//FIXME:
         cnt = 0;
-        ret = 0;
-        for (i = 0; i < MAX_ROM_PATHS; i++)
-                paths[i] = NULL;
+        for (i = 0; i < MAX_PATHS && cnt < MAX_ROM_PATHS; i++) {
+                if (currprefs.path_rom.path[i][0])
+                        paths[cnt++] = currprefs.path_rom.path[i];
+        }
+        fetch_datapath (path, sizeof (path) / sizeof (TCHAR));
+        _tcscat (path, "puae_romindex.txt");
+        ret = romscan_paths (paths, cnt, path);
+        if (show)
+                write_log ("%d ROMs found\n", ret);
 
-end:
         recursive--;
         return ret;
 }
@@ -34,6 +34,7 @@
 #include "cia.h"
 #include "inputrecord.h"
 #include "sleep.h"
+#include "tracering.h"
 
 #define f_out fprintf
 #define console_out printf
@@ -632,6 +633,40 @@ static void do_cycles_ce_post (unsigned long cycles, uae_u32 v)
 	do_cycles_ce (cycles);
 }
 
+static uae_u32 tracering_x_get_long (uaecptr o)
+{
+	uae_u32 v = x2_get_long (o);
+	tracering_add (TR_READ, 4, 0, o, v, (uae_u32)(get_cycles () / CYCLE_UNIT));
+	return v;
+}
+static uae_u32 tracering_x_get_word (uaecptr o)
+{
+	uae_u32 v = x2_get_word (o);
+	tracering_add (TR_READ, 2, 0, o, v, (uae_u32)(get_cycles () / CYCLE_UNIT));
+	return v;
+}
+static uae_u32 tracering_x_get_byte (uaecptr o)
+{
+	uae_u32 v = x2_get_byte (o);
+	tracering_add (TR_READ, 1, 0, o, v, (uae_u32)(get_cycles () / CYCLE_UNIT));
+	return v;
+}
+static void tracering_x_put_long (uaecptr o, uae_u32 v)
+{
+	tracering_add (TR_WRITE, 4, 0, o, v, (uae_u32)(get_cycles () / CYCLE_UNIT));
+	x2_put_long (o, v);
+}
+static void tracering_x_put_word (uaecptr o, uae_u32 v)
+{
+	tracering_add (TR_WRITE, 2, 0, o, v, (uae_u32)(get_cycles () / CYCLE_UNIT));
+	x2_put_word (o, v);
+}
+static void tracering_x_put_byte (uaecptr o, uae_u32 v)
+{
+	tracering_add (TR_WRITE, 1, 0, o, v, (uae_u32)(get_cycles () / CYCLE_UNIT));
+	x2_put_byte (o, v);
+}
+
 // indirect memory access functions
 static void set_x_funcs (void)
 {
@@ -810,6 +845,13 @@ static void set_x_funcs (void)
 			x_do_cycles_pre = cputracefunc2_x_do_cycles_pre;
 			x_do_cycles_post = cputracefunc2_x_do_cycles_post;
 		}
+	} else if (tracering_active && tracering_memory) {
+		x_put_long = tracering_x_put_long;
+		x_put_word = tracering_x_put_word;
+		x_put_byte = tracering_x_put_byte;
+		x_get_long = tracering_x_get_long;
+		x_get_word = tracering_x_get_word;
+		x_get_byte = tracering_x_get_byte;
 	}
 }
 
@@ -912,6 +954,12 @@ static void set_cpu_caches (void)
 
 STATIC_INLINE void count_instr (unsigned int opcode)
 {
+	if (tracering_active) {
+		uae_u64 c = get_cycles () / CYCLE_UNIT;
+		if (tracering_regmask)
+			tracering_regdelta ();
+		tracering_add (TR_INSN, 0, opcode, m68k_getpc (), (uae_u32)(c >> 32), (uae_u32)c);
+	}
 }
 
 static unsigned long REGPARAM2 op_illg_1 (uae_u32 opcode)
@@ -1143,6 +1191,19 @@ void check_prefs_changed_cpu (void)
 	if (currprefs.cpu_idle != changed_prefs.cpu_idle) {
 		currprefs.cpu_idle = changed_prefs.cpu_idle;
 	}
+	/* fast/accurate FPU engine can be switched on the fly */
+	if (currprefs.fpu_strict != changed_prefs.fpu_strict) {
+		currprefs.fpu_strict = changed_prefs.fpu_strict;
+	}
+	if (_tcscmp (currprefs.cpu_trace_file, changed_prefs.cpu_trace_file)
+		|| currprefs.cpu_trace_registers != changed_prefs.cpu_trace_registers
+		|| currprefs.cpu_trace_memory != changed_prefs.cpu_trace_memory) {
+		_tcscpy (currprefs.cpu_trace_file, changed_prefs.cpu_trace_file);
+		currprefs.cpu_trace_registers = changed_prefs.cpu_trace_registers;
+		currprefs.cpu_trace_memory = changed_prefs.cpu_trace_memory;
+		tracering_setup ();
+		set_x_funcs ();
+	}
 	if (changed)
 		set_special (SPCFLAG_BRK);
 
@@ -3498,6 +3559,8 @@ static void m68k_run_1_ce (void)
 	for (;;) {
 		uae_u16 opcode = r->ir;
 
+		count_instr (opcode);
+
 #if DEBUG_CD32CDTVIO
 		out_cd32io (m68k_getpc ());
 #endif
@@ -3624,7 +3687,13 @@ typedef void compiled_handler (void);
 static void m68k_run_jit (void)
 {
 	for (;;) {
-		((compiled_handler*)(pushall_call_handler))();
+		if (jit_profile) {
+			frame_time_t start = read_processor_time ();
+			((compiled_handler*)(pushall_call_handler))();
+			jit_profile_exec_time += read_processor_time () - start;
+		} else {
+			((compiled_handler*)(pushall_call_handler))();
+		}
 		/* Whenever we return from that, we should check spcflags */
 		if (uae_int_requested) {
 			INTREQ_f (0x8008);
@@ -3792,6 +3861,8 @@ static void m68k_run_2ce (void)
 		r->instruction_pc = m68k_getpc ();
 		uae_u16 opcode = x_prefetch (0);
 
+		count_instr (opcode);
+
 		if (cpu_tracer) {
 			memcpy (&cputrace.regs, &r->regs, 16 * sizeof (uae_u32));
 			cputrace.opcode = opcode;
@@ -3920,6 +3991,7 @@ static void m68k_run_mmu (void)
 {
 	for (;;) {
 		uae_u16 opcode = get_iword (0);
+		count_instr (opcode);
 		do_cycles (cpu_cycles);
 		mmu_backup_regs = regs;
 		cpu_cycles = (*cpufunctbl[opcode])(opcode);
@@ -4075,6 +4147,7 @@ void m68k_go (int may_quit)
 			regs.spcflags |= of & (SPCFLAG_BRK | SPCFLAG_MODE_CHANGE);
 		}
 #endif
+		tracering_setup ();
 		set_x_funcs ();
 		if (startup)
 			custom_prepare ();
@@ -4092,7 +4165,11 @@ void m68k_go (int may_quit)
 				currprefs.cpu_compatible ? m68k_run_2p : m68k_run_2;
 		}
 		run_func ();
+#ifdef SAVESTATE
+		savestate_runahead ();
+#endif
 	}
+	tracering_stop ();
 	in_m68k_go--;
 }
 
@@ -4968,6 +5045,18 @@ uae_u8 *save_cpu (int *len, uae_u8 *dstptr)
 	return dstbak;
 }
 
+/* Registers, prefetch and caches for run-ahead, plus the cycles still
+ * owed by the last instruction. */
+const struct runahead_var cpu_runahead_vars[] = {
+	RUNAHEAD_VAR (regs),
+	RUNAHEAD_VAR (cpu_cycles),
+	RUNAHEAD_VAR (caches020),
+	RUNAHEAD_VAR (icaches030),
+	RUNAHEAD_VAR (dcaches030),
+	RUNAHEAD_VAR (caches040),
+	{ NULL, 0 }
+};
+
 #ifdef MMU
 uae_u8 *save_mmu (int *len, uae_u8 *dstptr)
 {
@@ -0,0 +1,201 @@
+/*
+ * readrecord
+ *
+ * Convert recordings written by record_file to raw RGB24 video and a
+ * WAV file, which ffmpeg and friends can read.
+ */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include "recorder.h"
+
+#include <zlib.h>
+
+void write_log (const char *s,...)
+{
+    fprintf (stderr, "%s", s);
+}
+
+static uae_u8 *frame, *rgb, *payload, *unpacked;
+static int framesize, payloadsize, unpackedsize;
+static int width, height;
+static unsigned long video_frames, video_skipped;
+static unsigned long long audio_samples;
+
+static int grow (uae_u8 **p, int *size, int need)
+{
+    if (*size >= need)
+	return 1;
+    free (*p);
+    *p = malloc (need);
+    *size = *p ? need : 0;
+    return *p != NULL;
+}
+
+static void wav_header (FILE *f, const struct recorder_header *h, uae_u32 datasize)
+{
+    uae_u32 tl;
+    uae_u16 tw;
+
+    fseek (f, 0, SEEK_SET);
+    fwrite ("RIFF", 1, 4, f);
+    tl = datasize + 36;
+    fwrite (&tl, 4, 1, f);
+    fwrite ("WAVEfmt ", 1, 8, f);
+    tl = 16;
+    fwrite (&tl, 4, 1, f);
+    tw = 1;
+    fwrite (&tw, 2, 1, f);
+    tw = h->audio_channels;
+    fwrite (&tw, 2, 1, f);
+    tl = h->audio_freq;
+    fwrite (&tl, 4, 1, f);
+    tl = h->audio_freq * h->audio_channels * 2;
+    fwrite (&tl, 4, 1, f);
+    tw = h->audio_channels * 2;
+    fwrite (&tw, 2, 1, f);
+    tw = 16;
+    fwrite (&tw, 2, 1, f);
+    fwrite ("data", 1, 4, f);
+    tl = datasize;
+    fwrite (&tl, 4, 1, f);
+}
+
+/* frame (pixbytes per pixel, tightly packed) to RGB24 */
+static void convert (const struct recorder_packet *p)
+{
+    int i, c, n = p->width * p->height;
+
+    for (i = 0; i < n; i++) {
+	uae_u32 v = p->pixbytes == 4 ? ((uae_u32*)frame)[i] : ((uae_u16*)frame)[i];
+	for (c = 0; c < 3; c++) {
+	    uae_u32 max = (1 << p->bits[c]) - 1;
+	    rgb[i * 3 + c] = ((v >> p->shift[c]) & max) * 255 / max;
+	}
+    }
+}
+
+static void write_frames (FILE *f, uae_u32 count)
+{
+    while (count-- > 0) {
+	if (f)
+	    fwrite (rgb, 3, width * height, f);
+	video_frames++;
+    }
+}
+
+int main (int argc, char **argv)
+{
+    struct recorder_header h;
+    struct recorder_packet p;
+    FILE *f, *vf = NULL, *af = NULL;
+    uae_u32 nextframe = 0;
+    const uae_u8 *data;
+    char name[1024];
+
+    if (argc != 2 && argc != 3) {
+	fprintf (stderr, "Usage: readrecord <recording> [<output prefix>]\n");
+	fprintf (stderr, "Writes <prefix>.rgb (raw RGB24 frames) and <prefix>.wav\n");
+	return 1;
+    }
+    f = fopen (argv[1], "rb");
+    if (!f) {
+	perror (argv[1]);
+	return 1;
+    }
+    if (fread (&h, sizeof h, 1, f) != 1 || h.magic != RECORDER_MAGIC) {
+	fprintf (stderr, "%s is not a recording\n", argv[1]);
+	fclose (f);
+	return 1;
+    }
+    if (h.version != RECORDER_VERSION || h.hdrsize != sizeof h) {
+	fprintf (stderr, "%s: unsupported recording version %d\n", argv[1], h.version);
+	fclose (f);
+	return 1;
+    }
+    if (argc == 3) {
+	sprintf (name, "%.1000s.rgb", argv[2]);
+	vf = fopen (name, "wb");
+	sprintf (name, "%.1000s.wav", argv[2]);
+	af = fopen (name, "wb");
+	if (!vf || !af) {
+	    perror (name);
+	    return 1;
+	}
+	wav_header (af, &h, 0);
+    }
+
+    while (fread (&p, sizeof p, 1, f) == 1) {
+	if (!grow (&payload, &payloadsize, p.size) || (p.size && fread (payload, p.size, 1, f) != 1)) {
+	    fprintf (stderr, "%s: file is truncated\n", argv[1]);
+	    break;
+	}
+	data = payload;
+	if (p.flags & RECF_ZLIB) {
+	    uLongf len = p.rawsize;
+	    if (!grow (&unpacked, &unpackedsize, p.rawsize) || uncompress (unpacked, &len, payload, p.size) != Z_OK) {
+		fprintf (stderr, "%s: bad packet at frame %u\n", argv[1], nextframe);
+		continue;
+	    }
+	    data = unpacked;
+	}
+
+	if (p.type == RECP_AUDIO) {
+	    uae_u64 pos = audio_samples;
+	    /* blocks dropped while recording become silence */
+	    for (; pos < p.stamp; pos++) {
+		static const uae_s16 zero[8];
+		if (af)
+		    fwrite (zero, 2, h.audio_channels, af);
+	    }
+	    if (af)
+		fwrite (data, 1, p.rawsize, af);
+	    audio_samples = pos + p.rawsize / (2 * h.audio_channels);
+	} else if (p.type == RECP_VIDEO) {
+	    int i;
+	    if (p.flags & RECF_DELTA) {
+		if (framesize < (int)p.rawsize)
+		    continue;
+		for (i = 0; i < (int)p.rawsize; i++)
+		    frame[i] ^= data[i];
+	    } else {
+		if (!grow (&frame, &framesize, p.rawsize))
+		    break;
+		memcpy (frame, data, p.rawsize);
+	    }
+	    if (!rgb) {
+		width = p.width;
+		height = p.height;
+		rgb = calloc (width * height, 3);
+	    }
+	    if (p.stamp > nextframe)
+		write_frames (vf, p.stamp - nextframe);
+	    if (p.width == width && p.height == height) {
+		convert (&p);
+	    } else {
+		/* raw video has one size, keep the first */
+		video_skipped++;
+	    }
+	    write_frames (vf, 1);
+	    nextframe = p.stamp + 1;
+	} else if (p.type == RECP_REPEAT && rgb) {
+	    write_frames (vf, p.stamp + 1 - nextframe);
+	    nextframe = p.stamp + 1;
+	}
+    }
+    fclose (f);
+
+    printf ("%lu frames %dx%d at %.3f Hz, %llu samples %d Hz %d channels\n",
+	video_frames, width, height, h.fps_milli / 1000.0, audio_samples, h.audio_freq, h.audio_channels);
+    if (video_skipped)
+	printf ("%lu frames with a different size replaced by the previous frame\n", video_skipped);
+    if (vf) {
+	fclose (vf);
+	wav_header (af, &h, (uae_u32)(audio_samples * 2 * h.audio_channels));
+	fclose (af);
+	printf ("ffmpeg -f rawvideo -pixel_format rgb24 -video_size %dx%d -framerate %.3f -i %s.rgb -i %s.wav ...\n",
+	    width, height, h.fps_milli / 1000.0, argv[2], argv[2]);
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * readtrace
+ *
+ * Decode CPU trace files written by cpu_trace_file
+ */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include "tracering.h"
+
+#include <zlib.h>
+#include <stdarg.h>
+
+void write_log (const char *format,...)
+{
+    va_list parms;
+
+    va_start (parms, format);
+    vfprintf (stderr, format, parms);
+    va_end (parms);
+}
+
+static const char *regname (int r)
+{
+    static const char *names[] = {
+	"D0", "D1", "D2", "D3", "D4", "D5", "D6", "D7",
+	"A0", "A1", "A2", "A3", "A4", "A5", "A6", "A7"
+    };
+    return r < 16 ? names[r] : "??";
+}
+
+static void printrec (const struct tracering_rec *r)
+{
+    static const char sizes[] = "?BW?L";
+
+    switch (r->type) {
+    case TR_INSN:
+	printf ("%08X %04X  @%llu\n", r->pc, r->opcode,
+	    ((unsigned long long)r->value << 32) | r->cycles);
+	break;
+    case TR_REG:
+	printf ("              %s=%08X\n", regname (r->size), r->value);
+	break;
+    case TR_READ:
+    case TR_WRITE:
+	printf ("              %c %08X.%c=%0*X  @%u\n",
+	    r->type == TR_READ ? 'R' : 'W', r->pc,
+	    sizes[r->size <= 4 ? r->size : 0], r->size * 2, r->value, r->cycles);
+	break;
+    case TR_DROP:
+	printf ("*** %u records dropped\n", r->value);
+	break;
+    default:
+	printf ("*** unknown record type %d\n", r->type);
+	break;
+    }
+}
+
+int main (int argc, char **argv)
+{
+    struct tracering_header h;
+    struct tracering_rec recs[1024];
+    unsigned long long total = 0;
+    gzFile f;
+    int n;
+
+    if (argc != 2) {
+	fprintf (stderr, "Usage: readtrace <tracefile>\n");
+	return 1;
+    }
+    f = gzopen (argv[1], "rb");
+    if (!f) {
+	perror (argv[1]);
+	return 1;
+    }
+    if (gzread (f, &h, sizeof h) != sizeof h || h.magic != TRACERING_MAGIC) {
+	fprintf (stderr, "%s is not a CPU trace file\n", argv[1]);
+	gzclose (f);
+	return 1;
+    }
+    if (h.version != TRACERING_VERSION || h.recsize != sizeof (struct tracering_rec)) {
+	fprintf (stderr, "%s: unsupported trace version %d\n", argv[1], h.version);
+	gzclose (f);
+	return 1;
+    }
+    printf ("registers %04X%s\n", h.regmask, (h.flags & TRACERING_MEMORY) ? ", memory accesses" : "");
+    while ((n = gzread (f, recs, sizeof recs)) > 0) {
+	int i;
+	n /= sizeof (struct tracering_rec);
+	for (i = 0; i < n; i++)
+	    printrec (&recs[i]);
+	total += n;
+    }
+    /* a trace of a crashed session ends with a partial block */
+    if (n < 0)
+	fprintf (stderr, "%s: file is truncated\n", argv[1]);
+    gzclose (f);
+    fprintf (stderr, "%llu records\n", total);
+    return 0;
+}
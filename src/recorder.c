@@ -0,0 +1,509 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Video and audio recorder
+  *
+  * The emulation thread copies each finished frame (recorder_frame) and
+  * each sound buffer (recorder_audio) into a reference counted buffer
+  * from a small pool and queues it. That copy is all the recording work
+  * the emulation does: an encoder thread takes the buffers off the queue
+  * and hands them to the configured writer, and frames that weren't
+  * drawn (frame skip) are queued as repeats of the last one without any
+  * copy at all. The queue has one producer and one consumer and needs no
+  * lock. When the encoder falls behind there is no buffer or queue slot
+  * left, so the frame or sound block is dropped and counted instead of
+  * stalling the emulation.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#ifdef RECORDER
+
+#include "options.h"
+#include "custom.h"
+#include "audio.h"
+#include "threaddep/thread.h"
+#include "recorder.h"
+
+#include <zlib.h>
+
+/* triple buffering plus the previous frame the encoder keeps for delta
+ * coding; the last queued frame stays referenced for repeats */
+#define REC_FRAMES 4
+#define REC_AUDIOBUFS 16
+#define REC_QUEUE 32
+
+struct rec_buf
+{
+	volatile int refs;
+	int alloc, len;
+	int width, height, pixbytes;
+	uae_u8 bits[3], shift[3];
+	uae_u8 *data;
+};
+
+struct rec_entry
+{
+	struct rec_buf *b;
+	int type;
+	uae_u32 stamp;
+};
+
+/* Writers get the packet header with type, stamp and video geometry
+ * filled in and fill in size, rawsize and flags themselves. prev is the
+ * previous video frame if it has the same geometry, for delta coding. */
+struct recorder_writer
+{
+	const TCHAR *name;
+	void *(*open) (const TCHAR *name, const struct recorder_header *h);
+	int (*write) (void *handle, struct recorder_packet *p, const uae_u8 *data, int len, const uae_u8 *prev);
+	void (*close) (void *handle);
+};
+
+int recorder_active;
+
+static struct rec_buf frames[REC_FRAMES], audiobufs[REC_AUDIOBUFS];
+static struct rec_entry queue[REC_QUEUE];
+static volatile unsigned int q_head, q_tail;
+static struct rec_buf *rec_pending, *rec_last, *enc_prev;
+static int rec_lost; /* what is on screen didn't make it into the recording */
+static uae_u32 rec_frameno;
+static uae_u64 rec_samples;
+static int rec_channels;
+static uae_sem_t rec_avail;
+static uae_thread_id rec_tid;
+static volatile int rec_quit;
+static struct recorder_stats stats;
+static const struct recorder_writer *writer;
+static void *writer_handle;
+static TCHAR rec_file[MAX_DPATH];
+static int rec_codec, rec_writeerror;
+static uae_u8 fmt_bits[3] = { 8, 8, 8 }, fmt_shift[3] = { 16, 8, 0 };
+
+/*
+ * Writers
+ */
+
+static FILE *rec_fopen (const TCHAR *name, const struct recorder_header *h)
+{
+	FILE *f = _tfopen (name, "wb");
+
+	if (f && fwrite (h, sizeof *h, 1, f) != 1) {
+		fclose (f);
+		f = NULL;
+	}
+	return f;
+}
+
+static int rec_fwrite (FILE *f, const struct recorder_packet *p, const uae_u8 *data)
+{
+	if (fwrite (p, sizeof *p, 1, f) != 1 || (p->size && fwrite (data, p->size, 1, f) != 1)) {
+		if (!rec_writeerror)
+			write_log ("Recorder: write to '%s' failed\n", rec_file);
+		rec_writeerror = 1;
+		return 0;
+	}
+	return sizeof *p + p->size;
+}
+
+static void *raw_open (const TCHAR *name, const struct recorder_header *h)
+{
+	return rec_fopen (name, h);
+}
+
+static int raw_write (void *handle, struct recorder_packet *p, const uae_u8 *data, int len, const uae_u8 *prev)
+{
+	p->size = p->rawsize = len;
+	return rec_fwrite ((FILE*)handle, p, data);
+}
+
+static void raw_close (void *handle)
+{
+	fclose ((FILE*)handle);
+}
+
+/* Fast deflate of each packet. Consecutive frames mostly differ in a
+ * few places, XORed with the previous frame they are mostly zeroes. */
+struct zwriter
+{
+	FILE *f;
+	uae_u8 *delta, *out;
+	int deltasize;
+	uLong outsize;
+};
+
+static void *zlib_open (const TCHAR *name, const struct recorder_header *h)
+{
+	struct zwriter *z;
+	FILE *f = rec_fopen (name, h);
+
+	if (!f)
+		return NULL;
+	z = xcalloc (struct zwriter, 1);
+	z->f = f;
+	return z;
+}
+
+static int zlib_write (void *handle, struct recorder_packet *p, const uae_u8 *data, int len, const uae_u8 *prev)
+{
+	struct zwriter *z = (struct zwriter*)handle;
+	uLong bound = compressBound (len), outlen;
+	int i;
+
+	p->rawsize = p->size = len;
+	if (!len)
+		return rec_fwrite (z->f, p, data);
+	if (prev) {
+		if (z->deltasize < len) {
+			xfree (z->delta);
+			z->delta = xmalloc (uae_u8, len);
+			z->deltasize = len;
+		}
+		for (i = 0; i + 4 <= len; i += 4)
+			*(uae_u32*)(z->delta + i) = *(const uae_u32*)(data + i) ^ *(const uae_u32*)(prev + i);
+		for (; i < len; i++)
+			z->delta[i] = data[i] ^ prev[i];
+		data = z->delta;
+		p->flags |= RECF_DELTA;
+	}
+	if (z->outsize < bound) {
+		xfree (z->out);
+		z->out = xmalloc (uae_u8, bound);
+		z->outsize = bound;
+	}
+	outlen = z->outsize;
+	if (compress2 (z->out, &outlen, data, len, 1) == Z_OK && outlen < (uLong)len) {
+		p->flags |= RECF_ZLIB;
+		p->size = outlen;
+		data = z->out;
+	}
+	return rec_fwrite (z->f, p, data);
+}
+
+static void zlib_close (void *handle)
+{
+	struct zwriter *z = (struct zwriter*)handle;
+
+	fclose (z->f);
+	xfree (z->delta);
+	xfree (z->out);
+	xfree (z);
+}
+
+/* indexed by record_codec */
+static const struct recorder_writer writers[] = {
+	{ "raw", raw_open, raw_write, raw_close },
+	{ "zlib", zlib_open, zlib_write, zlib_close },
+};
+
+/*
+ * Buffers and queue
+ */
+
+STATIC_INLINE void rec_ref (struct rec_buf *b)
+{
+	__sync_fetch_and_add (&b->refs, 1);
+}
+
+STATIC_INLINE void rec_unref (struct rec_buf *b)
+{
+	__sync_fetch_and_sub (&b->refs, 1);
+}
+
+/* Only the emulation thread takes buffers, the encoder only drops its
+ * references, so a buffer seen unreferenced here stays free. */
+static struct rec_buf *rec_getbuf (struct rec_buf *pool, int num, int size)
+{
+	int i;
+
+	for (i = 0; i < num; i++) {
+		struct rec_buf *b = &pool[i];
+		if (b->refs)
+			continue;
+		if (b->alloc < size) {
+			xfree (b->data);
+			b->data = xmalloc (uae_u8, size);
+			if (!b->data) {
+				b->alloc = 0;
+				return NULL;
+			}
+			b->alloc = size;
+		}
+		b->refs = 1;
+		b->len = size;
+		return b;
+	}
+	return NULL;
+}
+
+/* Queue b, the queue entry takes over the caller's reference. */
+static int rec_push (struct rec_buf *b, int type, uae_u32 stamp)
+{
+	struct rec_entry *e;
+	int depth;
+
+	if (q_head - q_tail >= REC_QUEUE)
+		return 0;
+	e = &queue[q_head % REC_QUEUE];
+	e->b = b;
+	e->type = type;
+	e->stamp = stamp;
+	__sync_synchronize ();
+	q_head++;
+	uae_sem_post (&rec_avail);
+	depth = q_head - q_tail;
+	if (depth > stats.queue_max)
+		stats.queue_max = depth;
+	return 1;
+}
+
+static void rec_encode (struct rec_entry *e)
+{
+	struct rec_buf *b = e->b;
+	struct recorder_packet p;
+	const uae_u8 *prev = NULL;
+	int n;
+
+	memset (&p, 0, sizeof p);
+	p.type = e->type;
+	p.stamp = e->stamp;
+	if (e->type == RECP_VIDEO) {
+		p.width = b->width;
+		p.height = b->height;
+		p.pixbytes = b->pixbytes;
+		memcpy (p.bits, b->bits, 3);
+		memcpy (p.shift, b->shift, 3);
+		if (enc_prev && enc_prev->len == b->len && enc_prev->width == b->width
+			&& enc_prev->pixbytes == b->pixbytes && !memcmp (enc_prev->shift, b->shift, 3))
+			prev = enc_prev->data;
+	}
+	n = writer->write (writer_handle, &p, b ? b->data : NULL, b ? b->len : 0, prev);
+	stats.bytes_out += n;
+	if (e->type == RECP_VIDEO) {
+		/* keep it as the reference for the next frame */
+		if (enc_prev)
+			rec_unref (enc_prev);
+		enc_prev = b;
+	} else if (b) {
+		rec_unref (b);
+	}
+}
+
+static void *rec_thread (void *arg)
+{
+	for (;;) {
+		uae_sem_wait (&rec_avail);
+		if (q_tail == q_head) {
+			if (rec_quit)
+				break;
+			continue;
+		}
+		__sync_synchronize ();
+		rec_encode (&queue[q_tail % REC_QUEUE]);
+		__sync_synchronize ();
+		q_tail++;
+	}
+	if (enc_prev)
+		rec_unref (enc_prev);
+	enc_prev = NULL;
+	return NULL;
+}
+
+/*
+ * Emulation side
+ */
+
+/* Pixel layout of the frames passed to recorder_frame */
+void recorder_setformat (int rw, int gw, int bw, int rs, int gs, int bs)
+{
+	fmt_bits[0] = rw;
+	fmt_bits[1] = gw;
+	fmt_bits[2] = bw;
+	fmt_shift[0] = rs;
+	fmt_shift[1] = gs;
+	fmt_shift[2] = bs;
+}
+
+/* A frame has been drawn. It is queued at the next recorder_vsync, if
+ * it is drawn again before that (debugger redraws) the copy is updated. */
+void recorder_frame (const uae_u8 *buf, int pitch, int width, int height, int pixbytes)
+{
+	struct rec_buf *b = rec_pending;
+	int y, linebytes = width * pixbytes;
+
+	if (!recorder_active || !buf || width <= 0 || height <= 0 || (pixbytes != 2 && pixbytes != 4))
+		return;
+	if (b && b->alloc < linebytes * height) {
+		rec_unref (b);
+		b = NULL;
+	}
+	if (!b)
+		b = rec_getbuf (frames, REC_FRAMES, linebytes * height);
+	rec_pending = b;
+	if (!b) {
+		/* the encoder holds all frame buffers */
+		rec_lost = 1;
+		return;
+	}
+	b->len = linebytes * height;
+	b->width = width;
+	b->height = height;
+	b->pixbytes = pixbytes;
+	memcpy (b->bits, fmt_bits, 3);
+	memcpy (b->shift, fmt_shift, 3);
+	for (y = 0; y < height; y++)
+		memcpy (b->data + y * linebytes, buf + y * pitch, linebytes);
+	stats.bytes_in += b->len;
+}
+
+/* End of a displayed frame: queue the new frame or, if nothing was
+ * drawn, a repeat of the previous one. */
+void recorder_vsync (void)
+{
+	struct rec_buf *b = rec_pending;
+
+	if (!recorder_active)
+		return;
+	rec_pending = NULL;
+	if (b) {
+		rec_ref (b);
+		if (rec_push (b, RECP_VIDEO, rec_frameno)) {
+			if (rec_last)
+				rec_unref (rec_last);
+			rec_last = b;
+			rec_lost = 0;
+			stats.frames++;
+		} else {
+			rec_unref (b);
+			rec_unref (b);
+			rec_lost = 1;
+			stats.frames_dropped++;
+		}
+	} else if (rec_lost) {
+		/* a new frame that couldn't be kept, or a repeat of one:
+		 * repeating rec_last would record the wrong picture */
+		stats.frames_dropped++;
+	} else if (rec_last) {
+		if (rec_push (NULL, RECP_REPEAT, rec_frameno)) {
+			stats.frames++;
+			stats.repeats++;
+		} else {
+			stats.frames_dropped++;
+		}
+	}
+	rec_frameno++;
+}
+
+/* A sound buffer of signed 16 bit samples is complete. */
+void recorder_audio (const uae_u8 *buf, int bytes)
+{
+	struct rec_buf *b;
+	uae_u32 stamp = (uae_u32)rec_samples;
+
+	if (!recorder_active || bytes <= 0)
+		return;
+	rec_samples += bytes / (2 * rec_channels);
+	b = rec_getbuf (audiobufs, REC_AUDIOBUFS, bytes);
+	if (!b) {
+		stats.audio_dropped++;
+		return;
+	}
+	memcpy (b->data, buf, bytes);
+	stats.bytes_in += bytes;
+	if (rec_push (b, RECP_AUDIO, stamp)) {
+		stats.audio_blocks++;
+	} else {
+		rec_unref (b);
+		stats.audio_dropped++;
+	}
+}
+
+void recorder_getstats (struct recorder_stats *st)
+{
+	*st = stats;
+	st->queue_depth = q_head - q_tail;
+}
+
+static int rec_start (void)
+{
+	struct recorder_header h;
+
+	memset (&h, 0, sizeof h);
+	h.magic = RECORDER_MAGIC;
+	h.version = RECORDER_VERSION;
+	h.hdrsize = sizeof h;
+	h.fps_milli = (uae_u32)(vblank_hz * 1000.0 + 0.5);
+	h.audio_freq = currprefs.sound_freq;
+	rec_channels = get_audio_nativechannels (currprefs.sound_stereo);
+	if (rec_channels <= 0)
+		rec_channels = 2;
+	h.audio_channels = rec_channels;
+
+	rec_codec = currprefs.record_codec;
+	if (rec_codec < 0 || rec_codec >= (int)(sizeof writers / sizeof *writers))
+		rec_codec = 0;
+	writer = &writers[rec_codec];
+	writer_handle = writer->open (currprefs.record_file, &h);
+	if (!writer_handle) {
+		write_log ("Recorder: can't create '%s'\n", currprefs.record_file);
+		return 0;
+	}
+	_tcscpy (rec_file, currprefs.record_file);
+	memset (&stats, 0, sizeof stats);
+	q_head = q_tail = 0;
+	rec_pending = rec_last = enc_prev = NULL;
+	rec_lost = 0;
+	rec_frameno = 0;
+	rec_samples = 0;
+	rec_writeerror = 0;
+	rec_quit = 0;
+	uae_sem_init (&rec_avail, 0, 0);
+	uae_start_thread ("recorder", rec_thread, NULL, &rec_tid);
+	recorder_active = 1;
+	write_log ("Recorder: writing to '%s' (%s)\n", rec_file, writer->name);
+	return 1;
+}
+
+static void rec_freepool (struct rec_buf *pool, int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++) {
+		xfree (pool[i].data);
+		memset (&pool[i], 0, sizeof pool[i]);
+	}
+}
+
+void recorder_stop (void)
+{
+	if (!recorder_active)
+		return;
+	recorder_active = 0;
+	rec_quit = 1;
+	uae_sem_post (&rec_avail);
+	uae_wait_thread (rec_tid);
+	writer->close (writer_handle);
+	writer_handle = NULL;
+	uae_sem_destroy (&rec_avail);
+	rec_pending = rec_last = NULL;
+	rec_freepool (frames, REC_FRAMES);
+	rec_freepool (audiobufs, REC_AUDIOBUFS);
+	write_log ("Recorder: '%s': %u frames (%u repeated, %u dropped), %u audio blocks (%u dropped), %llu -> %llu bytes, queue max %d\n",
+		rec_file, stats.frames, stats.repeats, stats.frames_dropped, stats.audio_blocks, stats.audio_dropped,
+		(unsigned long long)stats.bytes_in, (unsigned long long)stats.bytes_out, stats.queue_max);
+}
+
+/* Start, stop or restart recording to match currprefs. */
+void recorder_setup (void)
+{
+	if (recorder_active) {
+		if (!_tcscmp (rec_file, currprefs.record_file) && rec_codec == currprefs.record_codec)
+			return;
+		recorder_stop ();
+	}
+	if (currprefs.record_file[0])
+		rec_start ();
+}
+
+#endif /* RECORDER */
@@ -15,6 +15,7 @@
 #include "memory.h"
 #include "zfile.h"
 #include "crc32.h"
+#include "threaddep/thread.h"
 
 static struct romlist *rl;
 static int romlist_cnt;
@@ -918,6 +919,328 @@ struct romdata *getromdatabyzfile (struct zfile *f)
 	return rd;
 }
 
+/* ROM directory scanning
+ *
+ * Every file below the ROM paths is identified by its SHA1 (see
+ * getromdatabydata). The result is remembered in an index file keyed by
+ * path, size and modification time, so a rescan only hashes new or
+ * changed files. Hashing runs on a small pool of threads; zfile is not
+ * thread safe, so compressed files are unpacked on the calling thread
+ * and only hashed by the pool. Encrypted (AMIROMTYPE1) ROMs need the
+ * keys found by the scan itself and are decoded last, on the calling
+ * thread too.
+ */
+
+#define ROMSCAN_MAXSIZE (2048 * 1024 + 11)
+#define ROMSCAN_MAXDEPTH 4
+#define ROMSCAN_MAXTHREADS 8
+#define ROMSCAN_INDEXVERSION 1
+
+struct romscan_file
+{
+	TCHAR *path;
+	uae_s64 size, mtime;
+	int id, group;		/* id -1: not a known ROM */
+	int cached;
+	int encrypted;
+	uae_u8 *data;		/* preloaded by the scanning thread, or NULL */
+	int datasize;
+	struct romdata *rd;
+};
+
+struct romscan
+{
+	struct romscan_file *index;
+	int indexnum;
+	struct romscan_file *files;
+	int filenum, filemax;
+	volatile int next;
+};
+
+static int romscan_cmp (const void *a, const void *b)
+{
+	return _tcscmp (((const struct romscan_file*)a)->path, ((const struct romscan_file*)b)->path);
+}
+
+/* Index file: a version line, then "size mtime id group path" per file. */
+static void romscan_loadindex (struct romscan *rs, const TCHAR *name)
+{
+	TCHAR line[MAX_DPATH + 100];
+	int version, romid, max = 0;
+	FILE *f;
+
+	f = _tfopen (name, "r");
+	if (!f)
+		return;
+	/* a new ROM database may identify files the old one did not */
+	if (!fgets (line, sizeof line, f) || sscanf (line, "romindex %d %d", &version, &romid) != 2
+		|| version != ROMSCAN_INDEXVERSION || romid != NEXT_ROM_ID) {
+		fclose (f);
+		return;
+	}
+	while (fgets (line, sizeof line, f)) {
+		struct romscan_file *rf;
+		long long size, mtime;
+		int id, group, pos = 0, len;
+
+		if (sscanf (line, "%lld %lld %d %d %n", &size, &mtime, &id, &group, &pos) < 4 || !pos)
+			continue;
+		len = _tcslen (line);
+		while (len > pos && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = 0;
+		if (len == pos)
+			continue;
+		if (rs->indexnum >= max) {
+			max = max ? max * 2 : 256;
+			rs->index = xrealloc (struct romscan_file, rs->index, max);
+		}
+		rf = &rs->index[rs->indexnum++];
+		memset (rf, 0, sizeof *rf);
+		rf->path = my_strdup (line + pos);
+		rf->size = size;
+		rf->mtime = mtime;
+		rf->id = id;
+		rf->group = group;
+	}
+	fclose (f);
+	qsort (rs->index, rs->indexnum, sizeof (struct romscan_file), romscan_cmp);
+}
+
+static void romscan_saveindex (struct romscan *rs, const TCHAR *name)
+{
+	TCHAR tmp[MAX_DPATH];
+	FILE *f;
+	int i;
+
+	_stprintf (tmp, "%s.tmp", name);
+	f = _tfopen (tmp, "w");
+	if (!f) {
+		write_log ("ROM scan: can't create '%s'\n", tmp);
+		return;
+	}
+	fprintf (f, "romindex %d %d\n", ROMSCAN_INDEXVERSION, NEXT_ROM_ID);
+	for (i = 0; i < rs->filenum; i++) {
+		struct romscan_file *rf = &rs->files[i];
+		/* the key may show up later */
+		if (rf->encrypted && !rf->rd)
+			continue;
+		fprintf (f, "%lld %lld %d %d %s\n", (long long)rf->size, (long long)rf->mtime,
+			rf->rd ? rf->rd->id : -1, rf->rd ? rf->rd->group : 0, rf->path);
+	}
+	if (fclose (f) || rename (tmp, name))
+		write_log ("ROM scan: can't write '%s'\n", name);
+}
+
+static int romscan_compressed (const TCHAR *path)
+{
+	static const TCHAR *exts[] = { "gz", "xz", "adz", "roz", NULL };
+	const TCHAR *ext = _tcsrchr (path, '.');
+	int i;
+
+	if (!ext)
+		return 0;
+	ext++;
+	for (i = 0; uae_archive_extensions[i]; i++) {
+		if (!_tcsicmp (ext, uae_archive_extensions[i]))
+			return 1;
+	}
+	for (i = 0; exts[i]; i++) {
+		if (!_tcsicmp (ext, exts[i]))
+			return 1;
+	}
+	return 0;
+}
+
+static void romscan_addfile (struct romscan *rs, const TCHAR *path, struct stat *st)
+{
+	struct romscan_file key, *rf, *old;
+
+	if (rs->filenum >= rs->filemax) {
+		rs->filemax = rs->filemax ? rs->filemax * 2 : 256;
+		rs->files = xrealloc (struct romscan_file, rs->files, rs->filemax);
+	}
+	rf = &rs->files[rs->filenum++];
+	memset (rf, 0, sizeof *rf);
+	rf->path = my_strdup (path);
+	rf->size = st->st_size;
+	rf->mtime = st->st_mtime;
+	rf->id = -1;
+
+	key.path = rf->path;
+	old = rs->indexnum ? (struct romscan_file*)bsearch (&key, rs->index, rs->indexnum, sizeof (struct romscan_file), romscan_cmp) : NULL;
+	if (old && old->size == rf->size && old->mtime == rf->mtime) {
+		rf->cached = 1;
+		rf->id = old->id;
+		rf->group = old->group;
+		if (rf->id >= 0)
+			rf->rd = getromdatabyidgroup (rf->id, rf->group >> 16, rf->group & 0xffff);
+		return;
+	}
+	if (romscan_compressed (path)) {
+		struct zfile *zf = zfile_fopen (path, "rb", ZFD_NORMAL);
+		if (zf) {
+			uae_s64 size = zfile_size (zf);
+			if (size > 0 && size <= ROMSCAN_MAXSIZE) {
+				rf->data = xmalloc (uae_u8, size);
+				rf->datasize = zfile_fread (rf->data, 1, size, zf);
+			}
+			zfile_fclose (zf);
+		}
+	}
+}
+
+static void romscan_dir (struct romscan *rs, const TCHAR *dirname, int depth)
+{
+	TCHAR path[MAX_DPATH];
+	struct dirent *de;
+	DIR *dir;
+
+	dir = opendir (dirname);
+	if (!dir)
+		return;
+	while ((de = readdir (dir))) {
+		struct stat st;
+		if (de->d_name[0] == '.')
+			continue;
+		_stprintf (path, "%s%s%s", dirname, dirname[_tcslen (dirname) - 1] == '/' ? "" : "/", de->d_name);
+		if (stat (path, &st))
+			continue;
+		if (S_ISDIR (st.st_mode)) {
+			if (depth < ROMSCAN_MAXDEPTH)
+				romscan_dir (rs, path, depth + 1);
+		} else if (S_ISREG (st.st_mode) && st.st_size > 0 && (romscan_compressed (path) || st.st_size <= ROMSCAN_MAXSIZE)) {
+			romscan_addfile (rs, path, &st);
+		}
+	}
+	closedir (dir);
+}
+
+static void romscan_hash (struct romscan_file *rf)
+{
+	uae_u8 *data = rf->data;
+	int size = rf->datasize;
+
+	if (!data) {
+		FILE *f = _tfopen (rf->path, "rb");
+		if (!f)
+			return;
+		data = xmalloc (uae_u8, rf->size);
+		size = fread (data, 1, rf->size, f);
+		fclose (f);
+	}
+	if (size > 11 && !memcmp (data, "AMIROMTYPE1", 11)) {
+		/* decoding needs the keyring, leave it to romscan_encrypted */
+		rf->encrypted = 1;
+		rf->data = data;
+		rf->datasize = size;
+		return;
+	}
+	if (size > 0)
+		rf->rd = getromdatabydata (data, size);
+	xfree (data);
+	rf->data = NULL;
+}
+
+static void *romscan_thread (void *v)
+{
+	struct romscan *rs = (struct romscan*)v;
+	int i;
+
+	while ((i = __sync_fetch_and_add (&rs->next, 1)) < rs->filenum) {
+		if (!rs->files[i].cached)
+			romscan_hash (&rs->files[i]);
+	}
+	return NULL;
+}
+
+static int romscan_threads (void)
+{
+	int n = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+	n = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+	if (n < 1)
+		n = 1;
+	if (n > ROMSCAN_MAXTHREADS)
+		n = ROMSCAN_MAXTHREADS;
+	return n;
+}
+
+static void romscan_encrypted (struct romscan *rs)
+{
+	int i;
+
+	if (!get_keyring ()) {
+		for (i = 0; i < rs->filenum; i++) {
+			struct romscan_file *rf = &rs->files[i];
+			if (rf->rd && (rf->rd->type & ROMTYPE_KEY))
+				addkeyfile (rf->path);
+		}
+	}
+	for (i = 0; i < rs->filenum; i++) {
+		struct romscan_file *rf = &rs->files[i];
+		if (!rf->encrypted)
+			continue;
+		/* decode_rom complains through the GUI when there is no key */
+		if (get_keyring ())
+			rf->rd = getromdatabydata (rf->data, rf->datasize);
+		else
+			write_log ("ROM scan: '%s' is encrypted and no rom.key was found\n", rf->path);
+		xfree (rf->data);
+		rf->data = NULL;
+	}
+}
+
+/* Rebuild the ROM list from everything found below the given
+ * directories. indexfile may be NULL. Returns the number of ROMs found. */
+int romscan_paths (const TCHAR **paths, int num, const TCHAR *indexfile)
+{
+	struct romscan rs;
+	uae_thread_id tids[ROMSCAN_MAXTHREADS];
+	int i, threads, cached = 0, found = 0;
+
+	memset (&rs, 0, sizeof rs);
+	/* also fixes up roms[] types, which the hashing threads read */
+	romlist_clear ();
+	if (indexfile)
+		romscan_loadindex (&rs, indexfile);
+	for (i = 0; i < num; i++) {
+		if (paths[i] && paths[i][0])
+			romscan_dir (&rs, paths[i], 0);
+	}
+
+	threads = romscan_threads ();
+	if (threads > rs.filenum)
+		threads = rs.filenum;
+	for (i = 0; i < threads; i++)
+		uae_start_thread ("romscan", romscan_thread, &rs, &tids[i]);
+	for (i = 0; i < threads; i++)
+		uae_wait_thread (tids[i]);
+	romscan_encrypted (&rs);
+
+	for (i = 0; i < rs.filenum; i++) {
+		struct romscan_file *rf = &rs.files[i];
+		if (rf->cached)
+			cached++;
+		if (rf->rd) {
+			romlist_add (rf->path, rf->rd);
+			found++;
+		}
+	}
+	romlist_add (NULL, NULL);
+	if (indexfile)
+		romscan_saveindex (&rs, indexfile);
+	write_log ("ROM scan: %d files, %d unchanged, %d ROMs, %d threads\n", rs.filenum, cached, found, threads);
+
+	for (i = 0; i < rs.filenum; i++)
+		xfree (rs.files[i].path);
+	for (i = 0; i < rs.indexnum; i++)
+		xfree (rs.index[i].path);
+	xfree (rs.files);
+	xfree (rs.index);
+	return romlist_count ();
+}
+
 void getromname	(const struct romdata *rd, TCHAR *name)
 {
 	name[0] = 0;
@@ -63,6 +63,9 @@
 #include "filesys.h"
 #include "inputrecord.h"
 #include "version.h"
+#include "xwin.h"
+#include "drawing.h"
+#include "hostprof.h"
 
 #ifndef _WIN32
 #define console_out printf
@@ -1121,7 +1124,8 @@ void savestate_quick (int slot, int save)
 
 bool savestate_check (void)
 {
-	if (vpos == 0 && !savestate_state) {
+	/* not in frames emulated ahead, they are thrown away */
+	if (vpos == 0 && !savestate_state && !runahead_frame) {
 		if (hsync_counter == 0 && input_play == INPREC_PLAY_NORMAL)
 			savestate_memorysave ();
 		savestate_capture (0);
@@ -1738,6 +1742,208 @@ void statefile_save_recording (const TCHAR *filename)
 }
 
 
+/* Run-ahead
+ *
+ * With run_ahead=N each real frame is followed by N frames emulated
+ * ahead, silently and with only the last one drawn and shown. Then the
+ * state saved after the real frame is put back and emulation continues
+ * from there, so what is on screen reacts to input N frames earlier.
+ *
+ * Saving and restoring happens at the first instruction boundary after
+ * vsync, savestate_runahead () is called from m68k_go when vsync ends
+ * the CPU loop. It doesn't go through the statefile chunks: restoring
+ * those resets sound, reinserts disks and rebuilds the memory map, far
+ * too slow for every frame. Instead each module lists its variables
+ * (runahead_var tables) and RAM is copied page by page, only what was
+ * written since the last save or restore (snapshot.c).
+ */
+
+int runahead_frame, runahead_frames;
+
+enum { RA_NONE, RA_NEXT, RA_SAVE, RA_RESTORE };
+static int runahead_action, runahead_next;
+static uae_u8 *runahead_buf;
+static int runahead_size;
+static bool runahead_refused;
+static unsigned long runahead_saves, runahead_restores, runahead_commits, runahead_pages;
+
+static const struct runahead_var *const runahead_tables[] = {
+	cpu_runahead_vars,
+	custom_runahead_vars,
+	blitter_runahead_vars,
+	audio_runahead_vars,
+	cia_runahead_vars,
+	disk_runahead_vars,
+	keybuf_runahead_vars,
+	inputstate_runahead_vars,
+	NULL
+};
+
+/* Only state that runahead_tables and the RAM snapshot cover can be
+ * rolled back. Hard disks and CD drives have host side effects and
+ * Zorro III or RTG memory isn't tracked. */
+static const TCHAR *runahead_unsupported (void)
+{
+	if (currprefs.cachesize)
+		return "JIT";
+	if (currprefs.mmu_model)
+		return "MMU emulation";
+	if (currprefs.z3fastmem_size || currprefs.z3fastmem2_size || currprefs.z3chipmem_size
+		|| currprefs.mbresmem_low_size || currprefs.mbresmem_high_size || currprefs.gfxmem_size)
+		return "Zorro III, motherboard or RTG memory";
+#ifdef FILESYS
+	if (nr_units ())
+		return "hard disks";
+#endif
+	if (currprefs.cs_cd32cd || currprefs.cs_cdtvcd)
+		return "CD32/CDTV CD drive";
+	if (input_record || input_play)
+		return "input recording";
+	/* these talk to the host, replayed frames would repeat the I/O */
+	if ((currprefs.use_serial && currprefs.sername[0]) || currprefs.uaeserial)
+		return "serial port";
+	if (currprefs.prtname[0])
+		return "printer";
+	if (currprefs.socket_emu)
+		return "bsdsocket.library";
+	if (currprefs.a2065name[0] || currprefs.sana2)
+		return "network card";
+	return NULL;
+}
+
+static int runahead_start (void)
+{
+	const struct runahead_var *const *t;
+	const struct runahead_var *v;
+
+	if (!runahead_buf) {
+		runahead_size = disk_runahead_size ();
+		for (t = runahead_tables; *t; t++) {
+			for (v = *t; v->ptr; v++)
+				runahead_size += v->size;
+		}
+		runahead_buf = xmalloc (uae_u8, runahead_size);
+		if (!runahead_buf)
+			return 0;
+	}
+	write_log ("run-ahead: %d frames, %d bytes of state\n", currprefs.runahead, runahead_size);
+	return 1;
+}
+
+void savestate_runahead_stop (void)
+{
+	if (runahead_saves)
+		write_log ("run-ahead: %lu saves, %lu restores, %lu kept, %lu pages copied\n",
+			runahead_saves, runahead_restores, runahead_commits, runahead_pages);
+	runahead_saves = runahead_restores = runahead_commits = runahead_pages = 0;
+	memory_snapshot_stop ();
+	xfree (runahead_buf);
+	runahead_buf = NULL;
+	runahead_frame = runahead_frames = 0;
+	runahead_action = RA_NONE;
+	runahead_refused = false;
+	clear_inhibit_frame (IHF_RUNAHEAD);
+}
+
+static void runahead_abandon (void)
+{
+	runahead_frame = 0;
+	runahead_action = RA_NONE;
+	clear_inhibit_frame (IHF_RUNAHEAD);
+}
+
+/* Something that can't be undone happened in a frame emulated ahead
+ * (a disk write): keep going from here instead of rolling back. */
+void savestate_runahead_commit (void)
+{
+	if (!runahead_frame)
+		return;
+	runahead_commits++;
+	runahead_abandon ();
+}
+
+/* vsync, before the frame is finished: decide what happens next */
+void savestate_runahead_vsync (void)
+{
+	const TCHAR *why;
+
+	if (!currprefs.runahead) {
+		if (runahead_buf)
+			savestate_runahead_stop ();
+		return;
+	}
+	if (runahead_refused)
+		return;
+	if (!runahead_buf) {
+		why = runahead_unsupported ();
+		if (why || !runahead_start ()) {
+			write_log ("run-ahead disabled: %s\n", why ? why : "out of memory");
+			runahead_refused = true;
+			return;
+		}
+	}
+	runahead_frames = currprefs.runahead;
+	/* runahead_frame still counts the ending frame until the CPU stops */
+	runahead_next = runahead_frame < runahead_frames ? runahead_frame + 1 : 0;
+	/* the next frame is drawn only if it is the one that gets shown */
+	if (runahead_next == runahead_frames)
+		clear_inhibit_frame (IHF_RUNAHEAD);
+	else
+		set_inhibit_frame (IHF_RUNAHEAD);
+	runahead_action = runahead_frame == 0 ? RA_SAVE : runahead_next == 0 ? RA_RESTORE : RA_NEXT;
+	set_special (SPCFLAG_MODE_CHANGE);
+}
+
+/* called from m68k_go when the CPU loop returns */
+void savestate_runahead (void)
+{
+	const struct runahead_var *const *t;
+	const struct runahead_var *v;
+	uae_u8 *p;
+
+	if (runahead_action == RA_NONE)
+		return;
+	/* a reset stops the RAM snapshot (memory_reset), the first save
+	 * after it takes a full copy again */
+	if (quit_program > 0 || (runahead_action == RA_RESTORE && !memory_snapshot_active ())) {
+		runahead_abandon ();
+		return;
+	}
+	if (runahead_action == RA_SAVE && !memory_snapshot_active () && !memory_snapshot_start ()) {
+		write_log ("run-ahead disabled: out of memory\n");
+		runahead_refused = true;
+		runahead_abandon ();
+		return;
+	}
+	HOSTPROF_ENTER (HP_SNAPSHOT);
+	p = runahead_buf;
+	if (runahead_action == RA_SAVE) {
+		for (t = runahead_tables; *t; t++) {
+			for (v = *t; v->ptr; v++) {
+				memcpy (p, v->ptr, v->size);
+				p += v->size;
+			}
+		}
+		save_disk_runahead (p);
+		runahead_pages += memory_snapshot_save ();
+		runahead_saves++;
+	} else if (runahead_action == RA_RESTORE) {
+		for (t = runahead_tables; *t; t++) {
+			for (v = *t; v->ptr; v++) {
+				memcpy (v->ptr, p, v->size);
+				p += v->size;
+			}
+		}
+		restore_disk_runahead (p);
+		runahead_pages += memory_snapshot_restore ();
+		restore_custom_runahead_finish ();
+		runahead_restores++;
+	}
+	runahead_frame = runahead_next;
+	runahead_action = RA_NONE;
+	HOSTPROF_LEAVE ();
+}
+
 /*
 
 My (Toni Wilen <twilen@arabuusimiehet.com>)
@@ -8,6 +8,7 @@
   */
 
 #include <alsa/asoundlib.h>
+#include "recorder.h"
 
 #define SOUNDSTUFF 1
 #define AUDIO_NAME "alsa"
@@ -67,6 +68,9 @@ static void check_sound_buffers (void)
     int frames = paula_sndbufsize / bytes_per_frame;
     char *buf = (char *) paula_sndbuffer;
     int ret;
+#ifdef RECORDER
+    recorder_audio ((uae_u8 *) paula_sndbuffer, paula_sndbufsize);
+#endif
     while (frames > 0) {
       ret = snd_pcm_writei(alsa_playback_handle, buf, frames);
       if (ret < 0) {
@@ -21,6 +21,7 @@
 #include "driveclick.h"
 #include "sounddep/sound.h"
 #include "threaddep/thread.h"
+#include "recorder.h"
 #include <SDL_audio.h>
 
 int have_sound = 0;
@@ -74,6 +75,9 @@ void finish_sound_buffer (void)
 		return;
 #ifdef DRIVESOUND
 	driveclick_mix ((uae_s16*)paula_sndbuffer, paula_sndbufsize / 2, currprefs.dfxclickchannelmask);
+#endif
+#ifdef RECORDER
+	recorder_audio ((uae_u8*)paula_sndbuffer, paula_sndbufsize);
 #endif
 	if (!have_sound)
 		return;
@@ -0,0 +1,83 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Page tracked RAM snapshots
+  *
+  * Run-ahead saves and restores the whole machine every frame, and
+  * copying all of chip and fast RAM each time would cost more than the
+  * emulation of the frame. Memory writes mark the page they hit (see
+  * the snapshot put functions in memory.c), so only the pages written
+  * since the last save or restore are copied. A game typically touches
+  * a few hundred kilobytes per frame, whatever the memory size.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#ifdef SAVESTATE
+
+#include "snapshot.h"
+
+int snapshot_ram_init (struct snapshot_ram *r, uae_u8 *mem, uae_u32 size)
+{
+	r->mem = mem;
+	r->size = size;
+	r->pages = (size + SNAPSHOT_PAGE_SIZE - 1) >> SNAPSHOT_PAGE_SHIFT;
+	r->copy = xmalloc (uae_u8, size);
+	r->dirty = xcalloc (uae_u8, (r->pages + 7) & ~7);
+	if (!r->copy || !r->dirty) {
+		snapshot_ram_free (r);
+		return 0;
+	}
+	memcpy (r->copy, mem, size);
+	return 1;
+}
+
+void snapshot_ram_free (struct snapshot_ram *r)
+{
+	xfree (r->copy);
+	xfree (r->dirty);
+	r->copy = r->dirty = NULL;
+	r->mem = NULL;
+	r->size = r->pages = 0;
+}
+
+/* Copy the marked pages from src to dst and clear the marks. Eight
+ * pages are tested at a time, most of them are clean. The marks are
+ * bytes, memcpy reads them as one word without breaking aliasing. */
+static int copy_dirty (struct snapshot_ram *r, uae_u8 *dst, const uae_u8 *src)
+{
+	uae_u32 i, j;
+	int copied = 0;
+
+	for (i = 0; i < r->pages; i += 8) {
+		uae_u64 marks;
+		memcpy (&marks, r->dirty + i, sizeof marks);
+		if (!marks)
+			continue;
+		for (j = i; j < i + 8 && j < r->pages; j++) {
+			uae_u32 offset, len;
+			if (!r->dirty[j])
+				continue;
+			offset = j << SNAPSHOT_PAGE_SHIFT;
+			len = r->size - offset < SNAPSHOT_PAGE_SIZE ? r->size - offset : SNAPSHOT_PAGE_SIZE;
+			memcpy (dst + offset, src + offset, len);
+			copied++;
+		}
+		memset (r->dirty + i, 0, sizeof marks);
+	}
+	return copied;
+}
+
+/* returns the number of pages copied */
+int snapshot_ram_save (struct snapshot_ram *r)
+{
+	return copy_dirty (r, r->copy, r->mem);
+}
+
+int snapshot_ram_restore (struct snapshot_ram *r)
+{
+	return copy_dirty (r, r->mem, r->copy);
+}
+
+#endif /* SAVESTATE */
@@ -11,6 +11,7 @@
 #include "custom.h"
 #include "drawing.h"
 #include "statusline.h"
+#include "hostprof.h"
 
 /*
 * Some code to put status information on the screen.
@@ -237,3 +238,56 @@ void draw_status_line_single (uae_u8 *buf, int bpp, int y, int totalwidth, uae_u
 		}
 	}
 }
+
+#ifdef HOSTPROF
+
+#define HOSTPROF_BAR_WIDTH 200
+
+static const uae_u32 hostprof_colors[HP_MAX] = {
+	0x00cc00, /* cpu */
+	0x666666, /* hsync */
+	0x0000cc, /* vsync */
+	0xcc6600, /* blitter */
+	0xcccc00, /* copper */
+	0x00cccc, /* draw */
+	0xcc00cc, /* audio */
+	0xcc0000, /* disk */
+	0xcccccc, /* cia */
+	0x6666cc  /* snapshot */
+};
+
+/* One bar showing how the host time of the last frame was split
+ * between the instrumented sections, on the opposite side of the LEDs. */
+void draw_status_line_hostprof (uae_u8 *buf, int bpp, int y, int totalwidth, uae_u32 *rc, uae_u32 *gc, uae_u32 *bc, uae_u32 *alpha)
+{
+	const struct hostprof_frame *f = hostprof_getframe (0);
+	int x_start, x, i, end;
+	uae_u32 c, acc;
+
+	if (td_pos & TD_RIGHT)
+		x_start = TD_PADX;
+	else
+		x_start = totalwidth - TD_PADX - HOSTPROF_BAR_WIDTH;
+	if (y == 0 || y == TD_TOTAL_HEIGHT - 1 || !f || !f->total) {
+		c = ledcolor (TD_BORDER, rc, gc, bc, alpha);
+		for (x = 0; x < HOSTPROF_BAR_WIDTH; x++)
+			putpixel (buf, bpp, x_start + x, c, 0);
+		return;
+	}
+	x = 0;
+	acc = 0;
+	for (i = 0; i < HP_MAX; i++) {
+		acc += f->time[i];
+		end = (int)((uae_u64)acc * HOSTPROF_BAR_WIDTH / f->total);
+		if (end > HOSTPROF_BAR_WIDTH)
+			end = HOSTPROF_BAR_WIDTH;
+		c = ledcolor (hostprof_colors[i] | 0x33000000, rc, gc, bc, alpha);
+		for (; x < end; x++)
+			putpixel (buf, bpp, x_start + x, c, 0);
+	}
+	c = ledcolor (0x33000000, rc, gc, bc, alpha);
+	for (; x < HOSTPROF_BAR_WIDTH; x++)
+		putpixel (buf, bpp, x_start + x, c, 0);
+}
+
+#endif
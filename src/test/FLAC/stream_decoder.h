@@ -0,0 +1,140 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * The part of the libFLAC stream decoder interface cdda_stream.c uses,
+  * for test_cddastream which provides its own decoder. Found before the
+  * real header since the test directory comes first in the include path.
+  */
+
+#ifndef FLAC__STREAM_DECODER_H
+#define FLAC__STREAM_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int FLAC__bool;
+typedef int16_t FLAC__int16;
+typedef int32_t FLAC__int32;
+typedef uint64_t FLAC__uint64;
+typedef uint8_t FLAC__byte;
+
+typedef enum {
+	FLAC__STREAM_DECODER_SEARCH_FOR_METADATA,
+	FLAC__STREAM_DECODER_READ_METADATA,
+	FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC,
+	FLAC__STREAM_DECODER_READ_FRAME,
+	FLAC__STREAM_DECODER_END_OF_STREAM,
+	FLAC__STREAM_DECODER_OGG_ERROR,
+	FLAC__STREAM_DECODER_SEEK_ERROR,
+	FLAC__STREAM_DECODER_ABORTED,
+	FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR,
+	FLAC__STREAM_DECODER_UNINITIALIZED
+} FLAC__StreamDecoderState;
+
+typedef enum {
+	FLAC__STREAM_DECODER_INIT_STATUS_OK,
+	FLAC__STREAM_DECODER_INIT_STATUS_UNSUPPORTED_CONTAINER,
+	FLAC__STREAM_DECODER_INIT_STATUS_INVALID_CALLBACKS,
+	FLAC__STREAM_DECODER_INIT_STATUS_MEMORY_ALLOCATION_ERROR,
+	FLAC__STREAM_DECODER_INIT_STATUS_ERROR_OPENING_FILE,
+	FLAC__STREAM_DECODER_INIT_STATUS_ALREADY_INITIALIZED
+} FLAC__StreamDecoderInitStatus;
+
+typedef enum {
+	FLAC__STREAM_DECODER_READ_STATUS_CONTINUE,
+	FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM,
+	FLAC__STREAM_DECODER_READ_STATUS_ABORT
+} FLAC__StreamDecoderReadStatus;
+
+typedef enum {
+	FLAC__STREAM_DECODER_SEEK_STATUS_OK,
+	FLAC__STREAM_DECODER_SEEK_STATUS_ERROR,
+	FLAC__STREAM_DECODER_SEEK_STATUS_UNSUPPORTED
+} FLAC__StreamDecoderSeekStatus;
+
+typedef enum {
+	FLAC__STREAM_DECODER_TELL_STATUS_OK,
+	FLAC__STREAM_DECODER_TELL_STATUS_ERROR,
+	FLAC__STREAM_DECODER_TELL_STATUS_UNSUPPORTED
+} FLAC__StreamDecoderTellStatus;
+
+typedef enum {
+	FLAC__STREAM_DECODER_LENGTH_STATUS_OK,
+	FLAC__STREAM_DECODER_LENGTH_STATUS_ERROR,
+	FLAC__STREAM_DECODER_LENGTH_STATUS_UNSUPPORTED
+} FLAC__StreamDecoderLengthStatus;
+
+typedef enum {
+	FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE,
+	FLAC__STREAM_DECODER_WRITE_STATUS_ABORT
+} FLAC__StreamDecoderWriteStatus;
+
+typedef enum {
+	FLAC__STREAM_DECODER_ERROR_STATUS_LOST_SYNC,
+	FLAC__STREAM_DECODER_ERROR_STATUS_BAD_HEADER,
+	FLAC__STREAM_DECODER_ERROR_STATUS_FRAME_CRC_MISMATCH,
+	FLAC__STREAM_DECODER_ERROR_STATUS_UNPARSEABLE_STREAM
+} FLAC__StreamDecoderErrorStatus;
+
+typedef enum {
+	FLAC__METADATA_TYPE_STREAMINFO = 0
+} FLAC__MetadataType;
+
+typedef struct {
+	unsigned min_blocksize, max_blocksize;
+	unsigned min_framesize, max_framesize;
+	unsigned sample_rate;
+	unsigned channels;
+	unsigned bits_per_sample;
+	FLAC__uint64 total_samples;
+	FLAC__byte md5sum[16];
+} FLAC__StreamMetadata_StreamInfo;
+
+typedef struct {
+	FLAC__MetadataType type;
+	FLAC__bool is_last;
+	unsigned length;
+	union {
+		FLAC__StreamMetadata_StreamInfo stream_info;
+	} data;
+} FLAC__StreamMetadata;
+
+typedef struct {
+	unsigned blocksize;
+	unsigned sample_rate;
+	unsigned channels;
+	unsigned bits_per_sample;
+	FLAC__uint64 sample_number;
+} FLAC__FrameHeader;
+
+typedef struct {
+	FLAC__FrameHeader header;
+} FLAC__Frame;
+
+typedef struct FLAC__StreamDecoder FLAC__StreamDecoder;
+
+typedef FLAC__StreamDecoderReadStatus (*FLAC__StreamDecoderReadCallback)(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
+typedef FLAC__StreamDecoderSeekStatus (*FLAC__StreamDecoderSeekCallback)(const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data);
+typedef FLAC__StreamDecoderTellStatus (*FLAC__StreamDecoderTellCallback)(const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data);
+typedef FLAC__StreamDecoderLengthStatus (*FLAC__StreamDecoderLengthCallback)(const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data);
+typedef FLAC__bool (*FLAC__StreamDecoderEofCallback)(const FLAC__StreamDecoder *decoder, void *client_data);
+typedef FLAC__StreamDecoderWriteStatus (*FLAC__StreamDecoderWriteCallback)(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data);
+typedef void (*FLAC__StreamDecoderMetadataCallback)(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data);
+typedef void (*FLAC__StreamDecoderErrorCallback)(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data);
+
+FLAC__StreamDecoder *FLAC__stream_decoder_new (void);
+void FLAC__stream_decoder_delete (FLAC__StreamDecoder *decoder);
+FLAC__bool FLAC__stream_decoder_set_md5_checking (FLAC__StreamDecoder *decoder, FLAC__bool value);
+FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_stream (FLAC__StreamDecoder *decoder,
+	FLAC__StreamDecoderReadCallback read_callback, FLAC__StreamDecoderSeekCallback seek_callback,
+	FLAC__StreamDecoderTellCallback tell_callback, FLAC__StreamDecoderLengthCallback length_callback,
+	FLAC__StreamDecoderEofCallback eof_callback, FLAC__StreamDecoderWriteCallback write_callback,
+	FLAC__StreamDecoderMetadataCallback metadata_callback, FLAC__StreamDecoderErrorCallback error_callback,
+	void *client_data);
+FLAC__StreamDecoderState FLAC__stream_decoder_get_state (const FLAC__StreamDecoder *decoder);
+FLAC__bool FLAC__stream_decoder_flush (FLAC__StreamDecoder *decoder);
+FLAC__bool FLAC__stream_decoder_process_single (FLAC__StreamDecoder *decoder);
+FLAC__bool FLAC__stream_decoder_process_until_end_of_metadata (FLAC__StreamDecoder *decoder);
+FLAC__bool FLAC__stream_decoder_seek_absolute (FLAC__StreamDecoder *decoder, FLAC__uint64 sample);
+
+#endif
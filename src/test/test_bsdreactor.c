@@ -0,0 +1,697 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Test for the Linux bsdsocket reactor.
+  *
+  * Runs the host_* calls unmodified on top of a minimal exec: every Amiga
+  * task is a host thread, one of them at a time runs "on the CPU", and
+  * Wait()/SetSignal()/Signal() work on per task signal masks. Amiga memory
+  * is a flat big endian RAM bank. Checks WaitSelect wakeups and timeouts,
+  * aborting a blocking call and a WaitSelect, connect being retried until
+  * the listener accepts, and an echo server that serves many concurrent
+  * clients from one WaitSelect loop. Reports connections per second.
+  */
+
+#include "sysconfig.h"
+
+#ifndef __linux__
+
+#include <stdio.h>
+
+int main (int argc, char **argv)
+{
+    printf ("bsdsocket reactor test needs Linux, skipped.\n");
+    return 0;
+}
+
+#else
+
+#ifndef BSDSOCKET
+#define BSDSOCKET
+#endif
+#include "../bsdsocket-posix-new.c"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#define RAMSIZE 0x100000
+#define TASKS 80
+#define TASKMEM 0x2000
+#define DTABLE 256
+#define CLIENTS 16
+#define BENCH_CLIENTS 64
+#define RUN_SECONDS 2
+
+#define SIGF_SOCKET 8
+#define SIGF_USER 20
+#define SIGBREAKF_CTRL_C (1 << 12)
+
+/* task memory layout */
+#define T_HOSTENT 0x0000
+#define T_ADDR 0x0400
+#define T_ADDRLEN 0x0410
+#define T_TIMEOUT 0x0418
+#define T_SIGMP 0x0420
+#define T_SETS 0x0500	/* three sets of DTABLE bits */
+#define T_BUF 0x0600
+
+struct task
+{
+    struct socketbase sb;
+    SOCKET_TYPE dtable[DTABLE];
+    int ftable[DTABLE];
+    uaecptr mem;
+    uae_sem_t wake, done;
+    volatile uae_u32 sigs;
+    volatile int running;
+    void (*func)(struct task *);
+    void *arg;
+    int result;
+};
+
+static uae_u8 ram[RAMSIZE];
+static struct task tasks[TASKS];
+static __thread struct task *curtask;
+static uae_sem_t cpu, siglock;
+static int failures;
+
+struct regstruct regs;
+addrbank *mem_banks[MEMORY_BANKS];
+
+void write_log (const char *format, ...)
+{
+    va_list ap;
+    va_start (ap, format);
+    vprintf (format, ap);
+    va_end (ap);
+}
+
+/* flat RAM, mirrored all over the address space */
+
+static uae_u32 REGPARAM2 ram_lget (uaecptr a) { return do_get_mem_long ((uae_u32*)(ram + (a & (RAMSIZE - 1)))); }
+static uae_u32 REGPARAM2 ram_wget (uaecptr a) { return do_get_mem_word ((uae_u16*)(ram + (a & (RAMSIZE - 1)))); }
+static uae_u32 REGPARAM2 ram_bget (uaecptr a) { return ram[a & (RAMSIZE - 1)]; }
+static void REGPARAM2 ram_lput (uaecptr a, uae_u32 v) { do_put_mem_long ((uae_u32*)(ram + (a & (RAMSIZE - 1))), v); }
+static void REGPARAM2 ram_wput (uaecptr a, uae_u32 v) { do_put_mem_word ((uae_u16*)(ram + (a & (RAMSIZE - 1))), v); }
+static void REGPARAM2 ram_bput (uaecptr a, uae_u32 v) { ram[a & (RAMSIZE - 1)] = v; }
+static uae_u8 *REGPARAM2 ram_xlate (uaecptr a) { return ram + (a & (RAMSIZE - 1)); }
+static int REGPARAM2 ram_check (uaecptr a, uae_u32 size) { return (a & (RAMSIZE - 1)) + size <= RAMSIZE; }
+
+static addrbank ram_bank = {
+    ram_lget, ram_wget, ram_bget,
+    ram_lput, ram_wput, ram_bput,
+    ram_xlate, ram_check, NULL, "RAM",
+    ram_lget, ram_wget, ABFLAG_RAM
+};
+
+/* the parts of bsdsocket.c and exec the host code calls */
+
+uae_u32 addstr (uae_u32 *dst, const char *src)
+{
+    uae_u32 res = *dst;
+    strcpy ((char*)get_real_address (*dst), src);
+    *dst += strlen (src) + 1;
+    return res;
+}
+
+uae_u32 addmem (uae_u32 *dst, const char *src, int len)
+{
+    uae_u32 res = *dst;
+    if (!src)
+	return 0;
+    memcpy (get_real_address (*dst), src, len);
+    *dst += len;
+    return res;
+}
+
+uae_u32 strncpyha (uae_u32 dst, const char *src, int size)
+{
+    strncpy ((char*)get_real_address (dst), src, size);
+    return dst;
+}
+
+void bsdsocklib_seterrno (SB, int sb_errno)
+{
+    sb->sb_errno = sb_errno;
+}
+
+void bsdsocklib_setherrno (SB, int sb_herrno)
+{
+    sb->sb_herrno = sb_herrno;
+}
+
+void setsd (SB, int sd, SOCKET_TYPE s)
+{
+    sb->dtable[sd - 1] = s;
+}
+
+int getsd (SB, SOCKET_TYPE s)
+{
+    int i;
+
+    for (i = 0; i < sb->dtablesize; i++) {
+	if (sb->dtable[i] == -1) {
+	    sb->dtable[i] = s;
+	    sb->ftable[i] = SF_BLOCKING;
+	    return i + 1;
+	}
+    }
+    bsdsocklib_seterrno (sb, 24); /* EMFILE */
+    return -1;
+}
+
+SOCKET_TYPE getsock (SB, int sd)
+{
+    if ((unsigned int)(sd - 1) >= (unsigned int)sb->dtablesize) {
+	bsdsocklib_seterrno (sb, 38); /* ENOTSOCK */
+	return -1;
+    }
+    return sb->dtable[sd - 1];
+}
+
+void releasesock (SB, int sd)
+{
+    if ((unsigned int)(sd - 1) < (unsigned int)sb->dtablesize)
+	sb->dtable[sd - 1] = -1;
+}
+
+uaecptr uae_AllocMem (TrapContext *context, uae_u32 size, uae_u32 flags)
+{
+    return curtask->mem + T_HOSTENT;
+}
+
+void uae_FreeMem (TrapContext *context, uaecptr memory, uae_u32 size)
+{
+}
+
+void uae_Signal (uaecptr task, uae_u32 mask)
+{
+    struct task *t = &tasks[task - 1];
+
+    uae_sem_wait (&siglock);
+    t->sigs |= mask;
+    uae_sem_post (&siglock);
+    uae_sem_post (&t->wake);
+}
+
+uae_u32 CallLib (TrapContext *context, uaecptr base, uae_s16 offset)
+{
+    struct task *t = curtask;
+    uae_u32 d0 = m68k_dreg (regs, 0), d1 = m68k_dreg (regs, 1), old;
+
+    if (offset == -0x132) { /* SetSignal */
+	uae_sem_wait (&siglock);
+	old = t->sigs;
+	t->sigs = (old & ~d1) | (d0 & d1);
+	uae_sem_post (&siglock);
+	return old;
+    }
+    if (offset == -0x13e) { /* Wait, gives up the CPU while nothing is there */
+	for (;;) {
+	    uae_sem_wait (&siglock);
+	    old = t->sigs & d0;
+	    t->sigs &= ~old;
+	    uae_sem_post (&siglock);
+	    if (old)
+		return old;
+	    uae_sem_post (&cpu);
+	    uae_sem_wait (&t->wake);
+	    uae_sem_wait (&cpu);
+	}
+    }
+    printf ("CallLib: unexpected offset %d\n", offset);
+    return 0;
+}
+
+void waitsig (TrapContext *context, SB)
+{
+    long sigs;
+    m68k_dreg (regs, 0) = (((uae_u32) 1) << sb->signal) | sb->eintrsigs;
+    if ((sigs = CallLib (context, get_long (4), -0x13e)) & sb->eintrsigs) { /* Wait */
+	sockabort (sb);
+	bsdsocklib_seterrno (sb, 4); /* EINTR */
+
+	// Set signal
+	m68k_dreg (regs, 0) = sigs;
+	m68k_dreg (regs, 1) = sb->eintrsigs;
+	sigs = CallLib (context, get_long (4), -0x132); /* SetSignal() */
+
+	sb->eintr = 1;
+    } else
+	sb->eintr = 0;
+}
+
+/* tasks */
+
+static void *task_thread (void *arg)
+{
+    struct task *t = (struct task*)arg;
+
+    curtask = t;
+    uae_sem_wait (&cpu);
+    t->func (t);
+    t->running = 0;
+    uae_sem_post (&cpu);
+    uae_sem_post (&t->done);
+    return NULL;
+}
+
+static struct task *task_new (int i)
+{
+    struct task *t = &tasks[i];
+    int j;
+
+    memset (&t->sb, 0, sizeof t->sb);
+    for (j = 0; j < DTABLE; j++)
+	t->dtable[j] = -1;
+    t->sb.dtable = t->dtable;
+    t->sb.ftable = t->ftable;
+    t->sb.dtablesize = DTABLE;
+    t->sb.ownertask = i + 1;
+    t->sb.signal = SIGF_SOCKET;
+    t->sb.eintrsigs = SIGBREAKF_CTRL_C;
+    t->mem = 0x10000 + i * TASKMEM;
+    t->sigs = 0;
+    uae_sem_init (&t->wake, 0, 0);
+    uae_sem_init (&t->done, 0, 0);
+    curtask = t;
+    if (!host_sbinit (NULL, &t->sb)) {
+	printf ("host_sbinit failed\n");
+	exit (1);
+    }
+    return t;
+}
+
+static void task_free (struct task *t)
+{
+    curtask = t;
+    host_sbcleanup (&t->sb);
+    uae_sem_destroy (&t->wake);
+    uae_sem_destroy (&t->done);
+}
+
+static void task_start (struct task *t, void (*func)(struct task *), void *arg)
+{
+    uae_thread_id tid;
+
+    t->func = func;
+    t->arg = arg;
+    t->result = 0;
+    t->running = 1;
+    uae_start_thread ("task", task_thread, t, &tid);
+}
+
+/* wait at most ms milliseconds for the task to finish, a task that
+ * hangs would take the cleanup down with it, so give up */
+static int task_wait (struct task *t, int ms)
+{
+    while (ms-- > 0) {
+	if (uae_sem_trywait (&t->done) == 0)
+	    return 1;
+	usleep (1000);
+    }
+    printf ("task %d hangs\nFAILED\n", t->sb.ownertask - 1);
+    exit (1);
+}
+
+static int sigs_wait (struct task *t, uae_u32 mask, int ms)
+{
+    while (ms-- > 0) {
+	if (t->sigs & mask)
+	    return 1;
+	usleep (1000);
+    }
+    return 0;
+}
+
+static uae_u64 now_ms (void)
+{
+    return reactor_ms ();
+}
+
+static void check (int cond, const char *what)
+{
+    printf ("%-56s %s\n", what, cond ? "ok" : "FAILED");
+    if (!cond)
+	failures++;
+}
+
+/* Amiga side helpers, run by tasks */
+
+static uaecptr sockaddr (struct task *t, uae_u32 ip, int port)
+{
+    uaecptr a = t->mem + T_ADDR;
+
+    put_byte (a, 16);
+    put_byte (a + 1, AF_INET);
+    put_word (a + 2, port);
+    put_long (a + 4, ip);
+    put_long (a + 8, 0);
+    put_long (a + 12, 0);
+    return a;
+}
+
+static uaecptr fdset (struct task *t, int set)
+{
+    return t->mem + T_SETS + set * (DTABLE / 8);
+}
+
+static void fdset_clear (struct task *t)
+{
+    memset (get_real_address (fdset (t, 0)), 0, 3 * DTABLE / 8);
+}
+
+/* sd of a host descriptor in the task's table */
+static int adopt (struct task *t, int fd)
+{
+    return getsd (&t->sb, fd) - 1;
+}
+
+/* WaitSelect */
+
+static int pairs[4][2];
+static int ws_sd[4];
+static int ws_timeout_ms;
+static uae_u64 ws_time;
+
+static void ws_task (struct task *t)
+{
+    uae_u64 t0 = now_ms ();
+    uaecptr tv = 0;
+    int i, first = (int)(intptr_t)t->arg;
+
+    fdset_clear (t);
+    for (i = first; i < first + 2; i++)
+	bsd_amigaside_FD_SET (ws_sd[i], fdset (t, 0));
+    if (ws_timeout_ms) {
+	tv = t->mem + T_TIMEOUT;
+	put_long (tv, ws_timeout_ms / 1000);
+	put_long (tv + 4, (ws_timeout_ms % 1000) * 1000);
+    }
+    host_WaitSelect (NULL, &t->sb, DTABLE, fdset (t, 0), 0, 0, tv, 0);
+    t->result = t->sb.resultval;
+    ws_time = now_ms () - t0;
+}
+
+static int ws_isset (struct task *t, int i)
+{
+    return bsd_amigaside_FD_ISSET (ws_sd[i], fdset (t, 0));
+}
+
+static void test_waitselect (struct task *a, struct task *b)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+	socketpair (AF_UNIX, SOCK_STREAM, 0, pairs[i]);
+	ws_sd[i] = adopt (a, pairs[i][0]);
+	b->dtable[ws_sd[i]] = pairs[i][0];
+    }
+
+    /* two tasks wait on their own sockets, only b's become ready */
+    ws_timeout_ms = 0;
+    task_start (a, ws_task, (void*)0);
+    task_start (b, ws_task, (void*)2);
+    usleep (50 * 1000);
+    check (a->running && b->running, "WaitSelect blocks until something is ready");
+    write (pairs[3][1], "x", 1);
+    check (task_wait (b, 2000), "WaitSelect wakes up when a socket gets ready");
+    check (b->result == 1 && ws_isset (b, 3) && !ws_isset (b, 2), "WaitSelect reports just the ready socket");
+    usleep (50 * 1000);
+    check (a->running, "other task's WaitSelect keeps waiting");
+    write (pairs[0][1], "y", 1);
+    check (task_wait (a, 2000), "other task wakes up for its own socket");
+    check (a->result == 1 && ws_isset (a, 0) && !ws_isset (a, 1), "other task gets its own socket");
+
+    /* still readable */
+    task_start (a, ws_task, (void*)0);
+    check (task_wait (a, 2000) && a->result == 1 && ws_isset (a, 0), "socket that is ready already returns at once");
+    read (pairs[0][0], &i, 1);
+    read (pairs[3][0], &i, 1);
+
+    ws_timeout_ms = 200;
+    task_start (a, ws_task, (void*)0);
+    check (task_wait (a, 2000) && a->result == 0 && !ws_isset (a, 0) && !ws_isset (a, 1),
+	"WaitSelect times out with cleared sets");
+    check (ws_time >= 190 && ws_time < 1000, "timeout takes as long as asked");
+    ws_timeout_ms = 0;
+}
+
+/* aborts */
+
+static void recv_task (struct task *t)
+{
+    host_recvfrom (NULL, &t->sb, ws_sd[1], t->mem + T_BUF, 16, 0, 0, 0);
+    t->result = t->sb.resultval;
+}
+
+static void ws_sigmp_task (struct task *t)
+{
+    put_long (t->mem + T_SIGMP, 1 << SIGF_USER);
+    fdset_clear (t);
+    bsd_amigaside_FD_SET (ws_sd[1], fdset (t, 0));
+    host_WaitSelect (NULL, &t->sb, DTABLE, fdset (t, 0), 0, 0, 0, t->mem + T_SIGMP);
+    t->result = t->sb.resultval;
+}
+
+static void test_abort (struct task *a)
+{
+    uae_u32 sockbit = 1 << SIGF_SOCKET;
+
+    task_start (a, recv_task, NULL);
+    usleep (50 * 1000);
+    check (a->running && a->sb.pending == PENDING_OP, "blocking recv is parked in the reactor");
+    uae_Signal (a->sb.ownertask, SIGBREAKF_CTRL_C);
+    check (task_wait (a, 2000), "Ctrl-C aborts a blocking recv");
+    check (a->sb.eintr && a->sb.sb_errno == 4, "aborted recv fails with EINTR");
+    check (sigs_wait (a, sockbit, 2000) && a->sb.pending == PENDING_NONE && a->sb.resultval == -1,
+	"reactor drops the aborted recv");
+    a->sigs = 0;
+    write (pairs[1][1], "z", 1);
+    task_start (a, recv_task, NULL);
+    check (task_wait (a, 2000) && a->result == 1 && get_byte (a->mem + T_BUF) == 'z',
+	"next recv gets the data");
+
+    task_start (a, ws_sigmp_task, NULL);
+    usleep (50 * 1000);
+    check (a->running && a->sb.pending == PENDING_WS, "WaitSelect is parked in the reactor");
+    uae_Signal (a->sb.ownertask, 1 << SIGF_USER);
+    check (task_wait (a, 2000), "signal in sigmp ends WaitSelect");
+    check (a->result == 0 && get_long (a->mem + T_SIGMP) == (1 << SIGF_USER) && !ws_isset (a, 1)
+	&& a->sb.pending == PENDING_NONE, "WaitSelect returns 0 with the signal");
+    a->sigs = 0;
+}
+
+/* connect */
+
+static int listen_port;
+static int connect_errno;
+
+static void connect_task (struct task *t)
+{
+    int s = host_socket (&t->sb, AF_INET, SOCK_STREAM, 0);
+    host_connect (NULL, &t->sb, s, sockaddr (t, 0x7f000001, listen_port), 16);
+    t->result = t->sb.resultval;
+    connect_errno = t->sb.sb_errno;
+    if (t->result < 0)
+	host_CloseSocket (NULL, &t->sb, s);
+}
+
+static void test_connect (struct task *a, struct task *b)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof addr;
+    int ls, s;
+
+    /* a backlog of 0 holds one connection, the next one's SYN is
+     * dropped until that one is accepted */
+    ls = socket (AF_INET, SOCK_STREAM, 0);
+    memset (&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl (0x7f000001);
+    bind (ls, (struct sockaddr*)&addr, sizeof addr);
+    listen (ls, 0);
+    getsockname (ls, (struct sockaddr*)&addr, &len);
+    listen_port = ntohs (addr.sin_port);
+
+    task_start (a, connect_task, NULL);
+    check (task_wait (a, 2000) && a->result == 0, "connect to a listener");
+    task_start (b, connect_task, NULL);
+    usleep (200 * 1000);
+    check (b->running && b->sb.pending == PENDING_OP, "connect to a full listener is retried");
+    s = accept (ls, NULL, NULL);
+    check (task_wait (b, 5000) && b->result == 0, "connect completes once the listener accepts");
+    close (s);
+    s = accept (ls, NULL, NULL);
+    close (s);
+    close (ls);
+
+    /* nothing listens there any more */
+    task_start (a, connect_task, NULL);
+    check (task_wait (a, 2000) && a->result == -1 && connect_errno == 61, "connect to a closed port is refused");
+}
+
+/* echo server */
+
+static volatile int server_quit;
+static volatile int connections, echo_errors;
+static uae_u64 client_end;
+static int client_count;
+
+static void server_task (struct task *t)
+{
+    static char open[DTABLE];
+    int ls, i, nfds;
+    uaecptr tv = t->mem + T_TIMEOUT, addrlen = t->mem + T_ADDRLEN;
+
+    memset (open, 0, sizeof open);
+    ls = host_socket (&t->sb, AF_INET, SOCK_STREAM, 0);
+    if (host_bind (&t->sb, ls, sockaddr (t, 0x7f000001, 0), 16) || host_listen (&t->sb, ls, 128)) {
+	t->result = -1;
+	return;
+    }
+    put_long (addrlen, 16);
+    host_getsockname (&t->sb, ls, t->mem + T_ADDR, addrlen);
+    listen_port = get_word (t->mem + T_ADDR + 2);
+    t->result = 1;
+
+    while (!server_quit) {
+	fdset_clear (t);
+	bsd_amigaside_FD_SET (ls, fdset (t, 0));
+	nfds = ls + 1;
+	for (i = 0; i < DTABLE; i++) {
+	    if (open[i]) {
+		bsd_amigaside_FD_SET (i, fdset (t, 0));
+		if (i >= nfds)
+		    nfds = i + 1;
+	    }
+	}
+	put_long (tv, 0);
+	put_long (tv + 4, 100 * 1000);
+	host_WaitSelect (NULL, &t->sb, nfds, fdset (t, 0), 0, 0, tv, 0);
+	if (t->sb.resultval <= 0)
+	    continue;
+	for (i = 0; i < nfds; i++) {
+	    if (!bsd_amigaside_FD_ISSET (i, fdset (t, 0)))
+		continue;
+	    if (i == ls) {
+		put_long (addrlen, 16);
+		host_accept (NULL, &t->sb, ls, t->mem + T_ADDR, addrlen);
+		if (t->sb.resultval >= 0)
+		    open[t->sb.resultval] = 1;
+		continue;
+	    }
+	    host_recvfrom (NULL, &t->sb, i, t->mem + T_BUF, 64, 0, 0, 0);
+	    if (t->sb.resultval > 0) {
+		host_sendto (NULL, &t->sb, i, t->mem + T_BUF, t->sb.resultval, 0, 0, 0);
+	    } else {
+		host_CloseSocket (NULL, &t->sb, i);
+		open[i] = 0;
+	    }
+	}
+    }
+    for (i = 0; i < DTABLE; i++) {
+	if (open[i])
+	    host_CloseSocket (NULL, &t->sb, i);
+    }
+    host_CloseSocket (NULL, &t->sb, ls);
+}
+
+/* connect, send a sequence number, check the echo, close */
+static void client_task (struct task *t)
+{
+    uaecptr buf = t->mem + T_BUF;
+    uae_u32 seq = (uae_u32)(intptr_t)t->arg << 20;
+    int n = 0;
+
+    while (client_end ? now_ms () < client_end : n < client_count) {
+	int s = host_socket (&t->sb, AF_INET, SOCK_STREAM, 0);
+	host_connect (NULL, &t->sb, s, sockaddr (t, 0x7f000001, listen_port), 16);
+	if (t->sb.resultval == 0) {
+	    put_long (buf, ++seq);
+	    host_sendto (NULL, &t->sb, s, buf, 4, 0, 0, 0);
+	    put_long (buf, 0);
+	    host_recvfrom (NULL, &t->sb, s, buf, 4, 0, 0, 0);
+	    if (t->sb.resultval != 4 || get_long (buf) != seq)
+		__sync_fetch_and_add (&echo_errors, 1);
+	} else {
+	    __sync_fetch_and_add (&echo_errors, 1);
+	}
+	host_CloseSocket (NULL, &t->sb, s);
+	__sync_fetch_and_add (&connections, 1);
+	n++;
+    }
+}
+
+static double run_echo (int clients, int count, int seconds)
+{
+    struct task *server = task_new (0);
+    uae_u64 t0;
+    int i;
+
+    server_quit = 0;
+    connections = echo_errors = 0;
+    task_start (server, server_task, NULL);
+    while (!server->result)
+	usleep (1000);
+    if (server->result < 0) {
+	printf ("echo server didn't start\n");
+	failures++;
+	return 0;
+    }
+    t0 = now_ms ();
+    client_count = count;
+    client_end = seconds ? t0 + seconds * 1000 : 0;
+    for (i = 0; i < clients; i++)
+	task_start (task_new (i + 1), client_task, (void*)(intptr_t)i);
+    for (i = 0; i < clients; i++)
+	task_wait (&tasks[i + 1], 30000);
+    t0 = now_ms () - t0;
+    server_quit = 1;
+    task_wait (server, 2000);
+    for (i = 0; i <= clients; i++)
+	task_free (&tasks[i]);
+    return connections * 1000.0 / (t0 ? t0 : 1);
+}
+
+int main (int argc, char **argv)
+{
+    struct task *a, *b;
+    double rate;
+    int i;
+
+    for (i = 0; i < MEMORY_BANKS; i++)
+	mem_banks[i] = &ram_bank;
+    put_long (4, 0x1000);
+    uae_sem_init (&cpu, 0, 1);
+    uae_sem_init (&siglock, 0, 1);
+    init_socket_layer ();
+
+    a = task_new (0);
+    b = task_new (1);
+    test_waitselect (a, b);
+    test_abort (a);
+    test_connect (a, b);
+    b->dtable[ws_sd[0]] = b->dtable[ws_sd[1]] = b->dtable[ws_sd[2]] = b->dtable[ws_sd[3]] = -1;
+    task_free (a);
+    task_free (b);
+    for (i = 0; i < 4; i++)
+	close (pairs[i][1]);
+
+    rate = run_echo (CLIENTS, 20, 0);
+    check (connections == CLIENTS * 20 && echo_errors == 0, "concurrent clients all get their echo");
+
+    if (argc < 2 || strcmp (argv[1], "-q")) {
+	rate = run_echo (BENCH_CLIENTS, 0, RUN_SECONDS);
+	printf ("%d connections from %d clients in %d seconds, %.0f connections/s, %d errors\n",
+	    connections, BENCH_CLIENTS, RUN_SECONDS, rate, echo_errors);
+	if (echo_errors)
+	    failures++;
+    }
+
+    printf ("%s\n", failures ? "FAILED" : "all tests passed");
+    return failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,238 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Test for the bsdsocket name lookup cache.
+  *
+  * Host lookups are answered from a private hosts file instead of NSS,
+  * so the test neither depends on the machine's resolver setup nor
+  * touches the network. Checks caching, negative caching, expiry,
+  * that parallel lookups of one name share a single backend call and
+  * that tasks waiting for two different names at once each get woken
+  * up for their own answer.
+  */
+
+#include "sysconfig.h"
+#include "../bsdresolver.c"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#define THREADS 8
+#define WAITERS 3
+
+static const char *hosts =
+    "# test hosts\n"
+    "10.0.0.1\talpha alpha.local\n"
+    "10.0.0.2\tbeta\n"
+    "192.168.1.20\tgamma.example gamma\n";
+
+static char hostsfile[64];
+static volatile int calls;
+static int delay_ms, slow_ms;
+static int failures;
+static uae_sem_t done_sem;
+
+void write_log (const char *format, ...)
+{
+    va_list ap;
+    va_start (ap, format);
+    vprintf (format, ap);
+    va_end (ap);
+}
+
+/* minimal /etc/hosts reader */
+static struct hostent *hosts_lookup (const char *name, const void *addr, int len, int type, int *herr)
+{
+    char line[256], *aliases[8];
+    struct in_addr ina;
+    char *addrs[2] = { (char*)&ina, NULL };
+    struct hostent he, *out = NULL;
+    FILE *f;
+
+    __sync_fetch_and_add (&calls, 1);
+    if (delay_ms)
+	usleep (delay_ms * 1000);
+    if (slow_ms && name && !strcmp (name, "gamma"))
+	usleep (slow_ms * 1000);
+    f = fopen (hostsfile, "r");
+    if (!f) {
+	*herr = NO_RECOVERY;
+	return NULL;
+    }
+    while (!out && fgets (line, sizeof line, f)) {
+	char *tok, *save, *first;
+	int n = 0, match = 0;
+
+	if (line[0] == '#')
+	    continue;
+	tok = strtok_r (line, " \t\n", &save);
+	if (!tok || inet_pton (AF_INET, tok, &ina) != 1)
+	    continue;
+	first = strtok_r (NULL, " \t\n", &save);
+	if (!first)
+	    continue;
+	if (name)
+	    match = !strcmp (first, name);
+	else
+	    match = type == AF_INET && len == 4 && !memcmp (addr, &ina, 4);
+	while (n < 7 && (tok = strtok_r (NULL, " \t\n", &save))) {
+	    if (name && !strcmp (tok, name))
+		match = 1;
+	    aliases[n++] = tok;
+	}
+	aliases[n] = NULL;
+	if (!match)
+	    continue;
+	he.h_name = first;
+	he.h_aliases = aliases;
+	he.h_addrtype = AF_INET;
+	he.h_length = 4;
+	he.h_addr_list = addrs;
+	out = bsdres_copyhost (&he);
+    }
+    fclose (f);
+    if (!out)
+	*herr = HOST_NOT_FOUND;
+    return out;
+}
+
+static void check (int cond, const char *what)
+{
+    printf ("%-48s %s\n", what, cond ? "ok" : "FAILED");
+    if (!cond)
+	failures++;
+}
+
+static int resolves_to (struct bsdres_entry *e, const char *ip)
+{
+    char buf[32];
+
+    if (!e || !e->host || !e->host->h_addr_list[0])
+	return 0;
+    inet_ntop (AF_INET, e->host->h_addr_list[0], buf, sizeof buf);
+    return !strcmp (buf, ip);
+}
+
+static void parallel_lookup (void *arg)
+{
+    struct bsdres_entry *e = bsdres_gethostbyname ("beta", 0);
+    if (!resolves_to (e, "10.0.0.2"))
+	__sync_fetch_and_add (&failures, 1);
+    bsdres_release (e);
+    uae_sem_post (&done_sem);
+}
+
+static void *two_names_lookup (void *arg)
+{
+    const char *name = (const char*)arg;
+    struct bsdres_entry *e = bsdres_gethostbyname (name, 0);
+    if (!resolves_to (e, strcmp (name, "beta") ? "192.168.1.20" : "10.0.0.2"))
+	__sync_fetch_and_add (&failures, 1);
+    bsdres_release (e);
+    uae_sem_post (&done_sem);
+    return NULL;
+}
+
+/* wait for n posts of done_sem, at most ms milliseconds */
+static int wait_done (int n, int ms)
+{
+    while (n > 0 && ms > 0) {
+	if (uae_sem_trywait (&done_sem) == 0) {
+	    n--;
+	    continue;
+	}
+	usleep (1000);
+	ms--;
+    }
+    return n;
+}
+
+int main (int argc, char **argv)
+{
+    struct bsdres_entry *e;
+    struct in_addr ina;
+    FILE *f;
+    int fd, i, n;
+
+    strcpy (hostsfile, "/tmp/uaehostsXXXXXX");
+    fd = mkstemp (hostsfile);
+    if (fd < 0 || !(f = fdopen (fd, "w"))) {
+	printf ("can't create %s\n", hostsfile);
+	return 1;
+    }
+    fputs (hosts, f);
+    fclose (f);
+
+    bsdres_init ();
+    bsdres_setbackend (hosts_lookup);
+    uae_sem_init (&done_sem, 0, 0);
+
+    e = bsdres_gethostbyname ("alpha", 0);
+    check (resolves_to (e, "10.0.0.1") && calls == 1, "lookup by name");
+    bsdres_release (e);
+    e = bsdres_gethostbyname ("alpha", 1);
+    check (resolves_to (e, "10.0.0.1") && calls == 1, "second lookup is served from the cache");
+    bsdres_release (e);
+    e = bsdres_gethostbyname ("gamma", 0);
+    check (resolves_to (e, "192.168.1.20") && !strcmp (e->host->h_name, "gamma.example")
+	&& e->host->h_aliases[0] && !strcmp (e->host->h_aliases[0], "gamma"), "lookup by alias");
+    bsdres_release (e);
+
+    n = calls;
+    e = bsdres_gethostbyname ("nosuchhost", 0);
+    check (e && !e->host && e->herr == HOST_NOT_FOUND, "unknown name fails");
+    bsdres_release (e);
+    e = bsdres_gethostbyname ("nosuchhost", 0);
+    check (e && !e->host && calls == n + 1, "failure is cached");
+    bsdres_release (e);
+    check (bsdres_gethostbyname ("delta", 1) == NULL && calls == n + 1, "cache only lookup doesn't resolve");
+
+    inet_pton (AF_INET, "10.0.0.2", &ina);
+    e = bsdres_gethostbyaddr (&ina, 4, AF_INET, 0);
+    check (e && e->host && !strcmp (e->host->h_name, "beta"), "lookup by address");
+    bsdres_release (e);
+
+    /* everything expires at once from now on */
+    bsdres_setttl (0, 0);
+    bsdres_flush ();
+    n = calls;
+    e = bsdres_gethostbyname ("alpha", 0);
+    bsdres_release (e);
+    e = bsdres_gethostbyname ("alpha", 0);
+    check (resolves_to (e, "10.0.0.1") && calls == n + 2, "expired entry is looked up again");
+    bsdres_release (e);
+
+    bsdres_setttl (BSDRES_TTL, BSDRES_NEGTTL);
+    bsdres_flush ();
+    n = calls;
+    delay_ms = 100;
+    for (i = 0; i < THREADS; i++)
+	bsdres_async (parallel_lookup, NULL);
+    for (i = 0; i < THREADS; i++)
+	uae_sem_wait (&done_sem);
+    check (calls == n + 1, "parallel lookups share the backend call");
+    check (failures == 0, "parallel lookups got the right answer");
+
+    /* the answer for beta arrives while gamma is still pending: waking
+     * a gamma waiter instead of a beta one would leave beta's hanging */
+    bsdres_flush ();
+    n = calls;
+    slow_ms = 300;
+    for (i = 0; i < 2 * (WAITERS + 1); i++) {
+	uae_thread_id tid;
+	uae_start_thread ("lookup", two_names_lookup, (void*)(i & 1 ? "gamma" : "beta"), &tid);
+	if (i < 2)
+	    usleep (20 * 1000);
+    }
+    i = wait_done (2 * (WAITERS + 1), 5000);
+    check (i == 0, "waiters for two names all get woken up");
+    check (calls == n + 2 && failures == 0, "two names in parallel got the right answers");
+    delay_ms = slow_ms = 0;
+
+    bsdres_flush ();
+    unlink (hostsfile);
+    printf ("%s\n", failures ? "FAILED" : "all tests passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Check and benchmark the Akiko chunky to planar conversion against
+  * the original bit by bit implementation.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "akiko.h"
+
+#define BENCH_LOOPS 2000000
+
+static void c2p_reference (const uae_u32 *src, uae_u32 *dst)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+	dst[i] = 0;
+    for (i = 0; i < 8 * 32; i++) {
+	if (src[7 - (i >> 5)] & (1 << (i & 31)))
+	    dst[i & 7] |= 1 << (i >> 3);
+    }
+}
+
+static uae_u32 rnd32 (void)
+{
+    return ((uae_u32)rand () << 16) ^ (uae_u32)rand ();
+}
+
+static double bench (void (*f)(const uae_u32*, uae_u32*), uae_u32 *check)
+{
+    uae_u32 src[8], dst[8];
+    clock_t start;
+    int i, j;
+
+    for (i = 0; i < 8; i++)
+	src[i] = rnd32 ();
+    *check = 0;
+    start = clock ();
+    for (i = 0; i < BENCH_LOOPS; i++) {
+	f (src, dst);
+	for (j = 0; j < 8; j++)
+	    *check += dst[j];
+	src[i & 7] ^= dst[(i + 1) & 7] + i;
+    }
+    return (double)(clock () - start) / CLOCKS_PER_SEC;
+}
+
+static void c2p_fast (const uae_u32 *src, uae_u32 *dst)
+{
+    akiko_c2p_convert (src, dst);
+}
+
+int main (int argc, char **argv)
+{
+    uae_u32 src[8], dst1[8], dst2[8];
+    uae_u32 check1, check2;
+    double t1, t2;
+    int num_fails = 0;
+    int i, j;
+
+    for (i = 0; i < 100000; i++) {
+	for (j = 0; j < 8; j++)
+	    src[j] = i < 256 ? (i & 1 ? 1u << (i / 8) : 0x01010101 * (i & 0xff)) : rnd32 ();
+	c2p_reference (src, dst1);
+	akiko_c2p_convert (src, dst2);
+	if (memcmp (dst1, dst2, sizeof dst1)) {
+	    if (num_fails++ < 10)
+		printf ("Mismatch for %08x %08x %08x %08x %08x %08x %08x %08x\n",
+		    src[0], src[1], src[2], src[3], src[4], src[5], src[6], src[7]);
+	}
+    }
+
+    srand (1);
+    t1 = bench (c2p_reference, &check1);
+    srand (1);
+    t2 = bench (c2p_fast, &check2);
+    if (check1 != check2) {
+	printf ("Failed: benchmark results differ.\n");
+	num_fails++;
+    }
+    printf ("%d conversions: reference %.3fs, transpose %.3fs (%.1fx)\n",
+	BENCH_LOOPS, t1, t2, t2 > 0 ? t1 / t2 : 0.0);
+
+    if (num_fails)
+	printf ("%d tests failed.\n", num_fails);
+    return num_fails ? 1 : 0;
+}
@@ -0,0 +1,328 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Test for FLAC CD audio streaming.
+  *
+  * A stand-in decoder (see FLAC/stream_decoder.h here) decodes a raw PCM
+  * file through the same callbacks libFLAC uses, in frames of 4608
+  * samples, and seeks like seek_absolute does by delivering the frame
+  * from the target sample on. Checks sequential reads through several
+  * ring wraps, random seeks, the partial last frame, that reads past what
+  * a truncated file can decode are zero filled, and that closing a
+  * stream releases its decoder.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "../cdda_stream.c"
+
+#define SECTOR 2352
+#define SECTORS 1500
+#define SAMPLES (SECTORS * SECTOR / 4 + 100)
+#define FRAME 4608
+
+struct zfile
+{
+    uae_u8 *data;
+    uae_s64 size, pos;
+};
+
+struct FLAC__StreamDecoder
+{
+    FLAC__StreamDecoderReadCallback read;
+    FLAC__StreamDecoderSeekCallback seek;
+    FLAC__StreamDecoderWriteCallback write;
+    FLAC__StreamDecoderMetadataCallback metadata;
+    void *client;
+    FLAC__StreamDecoderState state;
+    FLAC__uint64 sample;
+};
+
+static int decoders, seeks;
+static int failures;
+
+void write_log (const char *format, ...)
+{
+}
+
+TCHAR *zfile_getname (struct zfile *f) { return "test.flac"; }
+uae_s64 zfile_size (struct zfile *z) { return z->size; }
+uae_s64 zfile_ftell (struct zfile *z) { return z->pos; }
+
+uae_s64 zfile_fseek (struct zfile *z, uae_s64 offset, int mode)
+{
+    z->pos = offset < 0 ? 0 : offset > z->size ? z->size : offset;
+    return 0;
+}
+
+size_t zfile_fread (void *b, size_t l1, size_t l2, struct zfile *z)
+{
+    size_t n = l2;
+
+    if (n > (z->size - z->pos) / l1)
+	n = (z->size - z->pos) / l1;
+    memcpy (b, z->data + z->pos, n * l1);
+    z->pos += n * l1;
+    return n;
+}
+
+/* the file is an 8 byte header with the declared length in samples,
+ * then 16 bit stereo samples */
+static uae_u16 left (int i) { return i * 3; }
+static uae_u16 right (int i) { return i ^ 0x5a5a; }
+
+static void make_file (struct zfile *z, int samples, int declared)
+{
+    int i;
+
+    z->size = 8 + samples * 4;
+    z->data = xmalloc (uae_u8, z->size);
+    z->pos = 0;
+    memcpy (z->data, "fLaC", 4);
+    memcpy (z->data + 4, &declared, 4);
+    for (i = 0; i < samples; i++) {
+	uae_u16 l = left (i), r = right (i);
+	uae_u8 *p = z->data + 8 + i * 4;
+	p[0] = l; p[1] = l >> 8; p[2] = r; p[3] = r >> 8;
+    }
+}
+
+/* what the ring should hold: host order 16 bit samples */
+static void expect (uae_u8 *dst, uae_s64 pos, int len)
+{
+    while (len-- > 0) {
+	int i = (int)(pos / 4);
+	uae_u16 v = (pos & 2) ? right (i) : left (i);
+	*dst++ = ((uae_u8*)&v)[pos & 1];
+	pos++;
+    }
+}
+
+FLAC__StreamDecoder *FLAC__stream_decoder_new (void)
+{
+    decoders++;
+    return xcalloc (FLAC__StreamDecoder, 1);
+}
+
+void FLAC__stream_decoder_delete (FLAC__StreamDecoder *d)
+{
+    decoders--;
+    xfree (d);
+}
+
+FLAC__bool FLAC__stream_decoder_set_md5_checking (FLAC__StreamDecoder *d, FLAC__bool value) { return true; }
+FLAC__StreamDecoderState FLAC__stream_decoder_get_state (const FLAC__StreamDecoder *d) { return d->state; }
+FLAC__bool FLAC__stream_decoder_flush (FLAC__StreamDecoder *d) { return true; }
+
+FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_stream (FLAC__StreamDecoder *d,
+    FLAC__StreamDecoderReadCallback read_callback, FLAC__StreamDecoderSeekCallback seek_callback,
+    FLAC__StreamDecoderTellCallback tell_callback, FLAC__StreamDecoderLengthCallback length_callback,
+    FLAC__StreamDecoderEofCallback eof_callback, FLAC__StreamDecoderWriteCallback write_callback,
+    FLAC__StreamDecoderMetadataCallback metadata_callback, FLAC__StreamDecoderErrorCallback error_callback,
+    void *client_data)
+{
+    d->read = read_callback;
+    d->seek = seek_callback;
+    d->write = write_callback;
+    d->metadata = metadata_callback;
+    d->client = client_data;
+    d->state = FLAC__STREAM_DECODER_SEARCH_FOR_METADATA;
+    return FLAC__STREAM_DECODER_INIT_STATUS_OK;
+}
+
+FLAC__bool FLAC__stream_decoder_process_until_end_of_metadata (FLAC__StreamDecoder *d)
+{
+    FLAC__StreamMetadata m;
+    FLAC__byte hdr[8];
+    size_t len = sizeof hdr;
+    uae_u32 declared;
+
+    if (d->read (d, hdr, &len, d->client) != FLAC__STREAM_DECODER_READ_STATUS_CONTINUE || len != sizeof hdr)
+	return false;
+    memcpy (&declared, hdr + 4, 4);
+    memset (&m, 0, sizeof m);
+    m.type = FLAC__METADATA_TYPE_STREAMINFO;
+    m.data.stream_info.channels = 2;
+    m.data.stream_info.bits_per_sample = 16;
+    m.data.stream_info.total_samples = declared;
+    d->metadata (d, &m, d->client);
+    d->state = FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC;
+    d->sample = 0;
+    return true;
+}
+
+/* one frame, or what is left of it, in reads as short as the file gives */
+static FLAC__bool decode_frame (FLAC__StreamDecoder *d, int samples)
+{
+    static FLAC__byte buf[FRAME * 4];
+    static FLAC__int32 l[FRAME], r[FRAME];
+    const FLAC__int32 *channels[2] = { l, r };
+    size_t got = 0;
+    FLAC__Frame frame;
+    int i;
+
+    while (got < (size_t)samples * 4) {
+	size_t len = samples * 4 - got;
+	FLAC__StreamDecoderReadStatus st = d->read (d, buf + got, &len, d->client);
+	if (st == FLAC__STREAM_DECODER_READ_STATUS_ABORT) {
+	    d->state = FLAC__STREAM_DECODER_ABORTED;
+	    return false;
+	}
+	if (st == FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM)
+	    break;
+	got += len;
+    }
+    if (got < 4) {
+	d->state = FLAC__STREAM_DECODER_END_OF_STREAM;
+	return true;
+    }
+    for (i = 0; i < (int)got / 4; i++) {
+	l[i] = (FLAC__int16)(buf[i * 4 + 0] | (buf[i * 4 + 1] << 8));
+	r[i] = (FLAC__int16)(buf[i * 4 + 2] | (buf[i * 4 + 3] << 8));
+    }
+    memset (&frame, 0, sizeof frame);
+    frame.header.blocksize = got / 4;
+    frame.header.sample_number = d->sample;
+    d->sample += got / 4;
+    d->state = FLAC__STREAM_DECODER_READ_FRAME;
+    return d->write (d, &frame, channels, d->client) == FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+FLAC__bool FLAC__stream_decoder_process_single (FLAC__StreamDecoder *d)
+{
+    if (d->state == FLAC__STREAM_DECODER_END_OF_STREAM)
+	return true;
+    return decode_frame (d, FRAME - (int)(d->sample % FRAME));
+}
+
+/* libFLAC hands over the frame holding the target sample, starting
+ * at that sample, before it returns */
+FLAC__bool FLAC__stream_decoder_seek_absolute (FLAC__StreamDecoder *d, FLAC__uint64 sample)
+{
+    struct cdda_stream *s = (struct cdda_stream*)d->client;
+
+    seeks++;
+    if (sample * 4 + 8 >= (FLAC__uint64)zfile_size (s->zf)) {
+	d->state = FLAC__STREAM_DECODER_SEEK_ERROR;
+	return false;
+    }
+    d->seek (d, 8 + sample * 4, d->client);
+    d->sample = sample;
+    d->state = FLAC__STREAM_DECODER_READ_FRAME;
+    return decode_frame (d, FRAME - (int)(sample % FRAME));
+}
+
+static void check (int cond, const char *what)
+{
+    printf ("%-56s %s\n", what, cond ? "ok" : "FAILED");
+    if (!cond)
+	failures++;
+}
+
+static int read_ok (struct cdda_stream *s, uae_s64 pos, int len)
+{
+    uae_u8 got[SECTOR], want[SECTOR];
+
+    expect (want, pos, len);
+    return cdda_stream_read (s, got, pos, len) == len && !memcmp (got, want, len);
+}
+
+static void test_stream (void)
+{
+    struct zfile z;
+    struct cdda_stream *s;
+    uae_u8 buf[SECTOR], want[SECTOR];
+    int i, got, ok, zero;
+
+    make_file (&z, SAMPLES, SAMPLES);
+    check (cdda_stream_size (&z) == (uae_s64)SAMPLES * 4 && decoders == 0, "size from the stream info");
+
+    z.pos = 0;
+    s = cdda_stream_open (&z);
+    check (s && decoders == 1, "stream opened");
+    if (!s)
+	return;
+
+    ok = 1;
+    for (i = 0; i < SECTORS; i++)
+	ok &= read_ok (s, (uae_s64)i * SECTOR, SECTOR);
+    check (ok, "sequential sectors through several ring wraps");
+    check (seeks == 0, "sequential reads don't seek");
+    check (read_ok (s, (uae_s64)(SECTORS - 3) * SECTOR, SECTOR) && seeks == 0, "going back a little is served from the ring");
+
+    memset (buf, 0xaa, sizeof buf);
+    expect (want, (uae_s64)SECTORS * SECTOR, 400);
+    got = cdda_stream_read (s, buf, (uae_s64)SECTORS * SECTOR, SECTOR);
+    zero = 1;
+    for (i = 400; i < SECTOR; i++)
+	zero &= buf[i] == 0;
+    check (got == 400 && !memcmp (buf, want, 400) && zero, "partial last frame, zeroes after the end");
+
+    srand (1);
+    ok = 1;
+    for (i = 0; i < 300; i++) {
+	uae_s64 pos = (uae_s64)(rand () % (SAMPLES * 4 - SECTOR));
+	ok &= read_ok (s, pos, SECTOR);
+    }
+    check (ok && seeks > 0, "random seeks");
+    ok = read_ok (s, 0, SECTOR);
+    check (ok && read_ok (s, SECTOR, SECTOR), "back to the start");
+
+    cdda_stream_close (s);
+    check (decoders == 0, "close releases the decoder");
+    xfree (z.data);
+}
+
+/* the stream info promises more than the file holds */
+static void test_truncated (void)
+{
+    struct zfile z;
+    struct cdda_stream *s;
+    uae_u8 buf[SECTOR];
+    int i, got, zero;
+
+    make_file (&z, SAMPLES / 2, SAMPLES);
+    check (cdda_stream_size (&z) == (uae_s64)SAMPLES * 4, "truncated file reports the declared size");
+    z.pos = 0;
+    s = cdda_stream_open (&z);
+    if (!s) {
+	check (0, "truncated file opened");
+	return;
+    }
+
+    memset (buf, 0xaa, sizeof buf);
+    got = cdda_stream_read (s, buf, (uae_s64)(SAMPLES / 2) * 4 - 1000, SECTOR);
+    zero = 1;
+    for (i = 1000; i < SECTOR; i++)
+	zero &= buf[i] == 0;
+    check (got == 1000 && zero, "read across the end of the data is zero filled");
+
+    memset (buf, 0xaa, sizeof buf);
+    got = cdda_stream_read (s, buf, (uae_s64)(SAMPLES - 1000) * 4, SECTOR);
+    zero = 1;
+    for (i = 0; i < SECTOR; i++)
+	zero &= buf[i] == 0;
+    check (got == 0 && zero, "seek past the end of the data is zero filled");
+    check (read_ok (s, 4 * SECTOR, SECTOR), "data before the end still reads");
+
+    cdda_stream_close (s);
+    check (decoders == 0, "close releases the decoder");
+    xfree (z.data);
+}
+
+int main (int argc, char **argv)
+{
+    test_stream ();
+    test_truncated ();
+    if (failures) {
+	printf ("FAILED\n");
+	return 1;
+    }
+    printf ("all tests passed\n");
+    return 0;
+}
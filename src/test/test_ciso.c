@@ -0,0 +1,258 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Test for CISO compressed CD images.
+  *
+  * Writes a CISO image with deflated and stored blocks, opens it through
+  * zfile and compares random, sequential (with read-ahead) and unaligned
+  * reads against the original data. A corrupt block must give a short
+  * read, not wrong data. The read-ahead thread is forced on for this, and
+  * hints must be harmless with it off. Prints the sequential read speed
+  * with the default, which has no thread on a single CPU.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../zfile.c"
+
+#define BLOCKSIZE 2048
+#define BLOCKS 1500
+#define IMAGESIZE (BLOCKS * BLOCKSIZE - 1000)
+
+static uae_u8 image[BLOCKS * BLOCKSIZE];
+static int failures;
+
+void write_log (const char *format, ...)
+{
+}
+
+/* the rest of zfile.c wants these, CISO never gets there */
+uae_u32 get_crc32 (uae_u8 *buf, int len) { return 0; }
+int isfat (uae_u8 *p) { return 0; }
+int my_existsfile (const char *name) { return 0; }
+int my_opentext (const TCHAR *name) { return 0; }
+int au_copy (TCHAR *dst, int maxlen, const char *src) { return 0; }
+USHORT DMS_Process_File (struct zfile *fi, struct zfile *fo, USHORT cmd, USHORT opt, USHORT PCRC, USHORT pwd, int part, struct zfile **extra) { return 0; }
+int isamigatrack (uae_u16 *amigamfmbuffer, uae_u8 *mfmdata, int len, uae_u8 *writebuffer, uae_u8 *writebuffer_ok, int track, int *outsize) { return 0; }
+int ispctrack (uae_u16 *amigamfmbuffer, uae_u8 *mfmdata, int len, uae_u8 *writebuffer, uae_u8 *writebuffer_ok, int track, int *outsize) { return 0; }
+FDI *fdi2raw_header (struct zfile *f) { return NULL; }
+void fdi2raw_header_free (FDI *fdi) { }
+int fdi2raw_get_last_track (FDI *fdi) { return 0; }
+int fdi2raw_loadtrack (FDI *fdi, uae_u16 *mfmbuf, uae_u16 *tracktiming, unsigned int track, unsigned int *tracklength, unsigned int *indexoffset, int *multirev, int mfm) { return 0; }
+
+static uae_u32 rnd32 (void)
+{
+    return ((uae_u32)rand () << 16) ^ (uae_u32)rand ();
+}
+
+static void put32 (uae_u8 *p, uae_u32 v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+/* Text like data that deflates well, with noise every 7th block so
+ * that some blocks get stored. */
+static void make_image (void)
+{
+    int i;
+
+    for (i = 0; i < IMAGESIZE; i++) {
+	if ((i / BLOCKSIZE) % 7 == 3)
+	    image[i] = rnd32 ();
+	else
+	    image[i] = "Amiga CD image "[(i + i / 4096) % 15];
+    }
+}
+
+/* Returns the offset of block 'corrupt' in the file, 0 for none. */
+static long write_ciso (const char *file, int corrupt)
+{
+    static uae_u8 packed[BLOCKSIZE * 2];
+    uae_u8 hdr[24];
+    uae_u32 index[BLOCKS + 1];
+    int blocks = (IMAGESIZE + BLOCKSIZE - 1) / BLOCKSIZE;
+    long pos, corruptpos = 0;
+    FILE *f = fopen (file, "wb");
+    int i;
+
+    if (!f)
+	return -1;
+    memset (hdr, 0, sizeof hdr);
+    memcpy (hdr, "CISO", 4);
+    put32 (hdr + 4, sizeof hdr);
+    put32 (hdr + 8, IMAGESIZE);
+    put32 (hdr + 12, 0);
+    put32 (hdr + 16, BLOCKSIZE);
+    hdr[20] = 1;
+    fwrite (hdr, sizeof hdr, 1, f);
+    pos = sizeof hdr + (blocks + 1) * 4;
+    fseek (f, pos, SEEK_SET);
+    for (i = 0; i < blocks; i++) {
+	z_stream zs;
+	int len;
+	memset (&zs, 0, sizeof zs);
+	deflateInit2 (&zs, 9, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+	zs.next_in = image + i * BLOCKSIZE;
+	zs.avail_in = BLOCKSIZE;
+	zs.next_out = packed;
+	zs.avail_out = sizeof packed;
+	deflate (&zs, Z_FINISH);
+	len = sizeof packed - zs.avail_out;
+	deflateEnd (&zs);
+	put32 ((uae_u8*)&index[i], pos);
+	if (len >= BLOCKSIZE) {
+	    put32 ((uae_u8*)&index[i], pos | 0x80000000);
+	    fwrite (image + i * BLOCKSIZE, BLOCKSIZE, 1, f);
+	    pos += BLOCKSIZE;
+	} else {
+	    if (i == corrupt) {
+		corruptpos = pos;
+		memset (packed, 0xff, len);
+	    }
+	    fwrite (packed, len, 1, f);
+	    pos += len;
+	}
+    }
+    put32 ((uae_u8*)&index[blocks], pos);
+    fseek (f, sizeof hdr, SEEK_SET);
+    fwrite (index, 4, blocks + 1, f);
+    fclose (f);
+    return corruptpos;
+}
+
+static void check_read (struct zfile *zf, uae_s64 offset, int len, const char *what)
+{
+    static uae_u8 buf[64 * 1024];
+    int expect = offset + len > IMAGESIZE ? IMAGESIZE - offset : len;
+
+    zfile_fseek (zf, offset, SEEK_SET);
+    if (zfile_fread (buf, 1, len, zf) != (size_t)expect || memcmp (buf, image + offset, expect)) {
+	printf ("ciso: %s read of %d bytes at %lld differs\n", what, len, offset);
+	failures++;
+    }
+}
+
+static double now_ms (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int main (int argc, char **argv)
+{
+    char file[64];
+    struct zfile *zf;
+    struct zfile_ciso *zc;
+    uae_u8 buf[BLOCKSIZE];
+    int i, round, readahead = ciso_readahead;
+
+    sprintf (file, "/tmp/test_ciso.%d.cso", (int)getpid ());
+    srand (1);
+    make_image ();
+    if (write_ciso (file, -1) < 0) {
+	printf ("ciso: can't create %s\n", file);
+	return 1;
+    }
+
+    ciso_readahead = 1;
+    zf = zfile_fopen (file, "rb", ZFD_NORMAL);
+    if (!zf || zf->zfileread != ciso_fread || zfile_size (zf) != IMAGESIZE) {
+	printf ("ciso: %s not opened as a CISO image\n", file);
+	unlink (file);
+	return 1;
+    }
+    zc = (struct zfile_ciso*)zf->userdata;
+    for (i = 0; i < 500; i++)
+	check_read (zf, rnd32 () % IMAGESIZE, 1 + rnd32 () % (8 * BLOCKSIZE), "random");
+    check_read (zf, IMAGESIZE - 10, 100, "past the end");
+    /* sequential 2352 byte raw sectors, which straddle blocks */
+    for (i = 0; i + 2352 <= IMAGESIZE; i += 2352) {
+	if (i % (16 * 2352) == 0)
+	    zfile_readahead (zf, i, 16 * 2352);
+	check_read (zf, i, 2352, "sequential");
+    }
+    if (!zc->prefetched) {
+	printf ("ciso: read-ahead did not unpack anything\n");
+	failures++;
+    }
+    zfile_fclose (zf);
+
+    /* no thread: hints do nothing */
+    ciso_readahead = 0;
+    zf = zfile_fopen (file, "rb", ZFD_NORMAL);
+    if (zf) {
+	zc = (struct zfile_ciso*)zf->userdata;
+	for (i = 0; i + 2352 <= IMAGESIZE; i += 2352) {
+	    if (i % (16 * 2352) == 0)
+		zfile_readahead (zf, i, 16 * 2352);
+	    check_read (zf, i, 2352, "sequential, no read-ahead thread");
+	}
+	if (zc->prefetched) {
+	    printf ("ciso: read-ahead without a thread\n");
+	    failures++;
+	}
+	zfile_fclose (zf);
+    }
+    ciso_readahead = readahead;
+
+    /* a block that doesn't inflate */
+    if (write_ciso (file, 100) <= 0) {
+	printf ("ciso: can't create %s\n", file);
+	unlink (file);
+	return 1;
+    }
+    zf = zfile_fopen (file, "rb", ZFD_NORMAL);
+    if (zf) {
+	check_read (zf, 99 * BLOCKSIZE, BLOCKSIZE, "before corrupt block");
+	zfile_fseek (zf, 100 * BLOCKSIZE, SEEK_SET);
+	if (zfile_fread (buf, 1, BLOCKSIZE, zf) != 0) {
+	    printf ("ciso: corrupt block returned data\n");
+	    failures++;
+	}
+	check_read (zf, 101 * BLOCKSIZE, BLOCKSIZE, "after corrupt block");
+	zfile_fclose (zf);
+    }
+
+    if (failures) {
+	unlink (file);
+	printf ("ciso: %d failures\n", failures);
+	return 1;
+    }
+    printf ("ciso: reads match the image\n");
+    if (argc < 2 || strcmp (argv[1], "-q")) {
+	double t0;
+	static uae_u8 sector[2352];
+	write_ciso (file, -1);
+	zf = zfile_fopen (file, "rb", ZFD_NORMAL);
+	printf ("read-ahead thread %s by default\n", ((struct zfile_ciso*)zf->userdata)->ra_state > 0 ? "on" : "off");
+	zfile_fclose (zf);
+	for (round = 0; round < 2; round++) {
+	    int n = 0;
+	    zf = zfile_fopen (file, "rb", ZFD_NORMAL);
+	    t0 = now_ms ();
+	    for (i = 0; i + 2352 <= IMAGESIZE; i += 2352, n++) {
+		if (round && i % (16 * 2352) == 0)
+		    zfile_readahead (zf, i + 16 * 2352, 16 * 2352);
+		zfile_fseek (zf, i, SEEK_SET);
+		zfile_fread (sector, 1, sizeof sector, zf);
+	    }
+	    printf ("%s read-ahead hints: %.2f us/sector, %.1f MB/s\n", round ? "with" : "without",
+		(now_ms () - t0) * 1000.0 / n, i / 1024.0 / 1024.0 / ((now_ms () - t0) / 1000.0));
+	    zfile_fclose (zf);
+	}
+    }
+    unlink (file);
+    zfile_exit ();
+    return 0;
+}
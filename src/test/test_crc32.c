@@ -0,0 +1,115 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Check the slice-by-8 CRC32 against a bit by bit implementation, for
+  * all buffer alignments and tail lengths, and benchmark it against the
+  * one table byte at a time loop it replaced.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "crc32.h"
+
+#define BENCH_SIZE (512 * 1024)
+#define BENCH_LOOPS 200
+
+static uae_u32 crc32_reference (const uae_u8 *buf, int len)
+{
+    uae_u32 crc = 0xffffffff;
+    int i;
+
+    while (len-- > 0) {
+	crc ^= *buf++;
+	for (i = 0; i < 8; i++)
+	    crc = (crc >> 1) ^ (crc & 1 ? 0xedb88320 : 0);
+    }
+    return crc ^ 0xffffffff;
+}
+
+/* what get_crc32 used to be */
+static unsigned long crc_table32[256];
+
+static uae_u32 crc32_bytewise (const uae_u8 *buf, int len)
+{
+    uae_u32 crc;
+    int n, k;
+
+    if (!crc_table32[1]) {
+	for (n = 0; n < 256; n++) {
+	    unsigned long c = (unsigned long)n;
+	    for (k = 0; k < 8; k++)
+		c = (c >> 1) ^ (c & 1 ? 0xedb88320 : 0);
+	    crc_table32[n] = c;
+	}
+    }
+    crc = 0xffffffff;
+    while (len-- > 0)
+	crc = crc_table32[(crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffff;
+}
+
+int main (int argc, char **argv)
+{
+    static uae_u8 buf[BENCH_SIZE + 16];
+    uae_u32 crc1, crc2, check = 0;
+    clock_t start;
+    double t1, t2;
+    int num_fails = 0;
+    int i, j, len;
+
+    for (i = 0; i < (int)sizeof buf; i++)
+	buf[i] = rand ();
+
+    /* "123456789" is the standard check value */
+    if (get_crc32 ((uae_u8*)"123456789", 9) != 0xcbf43926) {
+	printf ("Failed: check value %08x\n", get_crc32 ((uae_u8*)"123456789", 9));
+	num_fails++;
+    }
+    for (i = 0; i < 8; i++) {
+	for (len = 0; len < 300; len++) {
+	    crc1 = crc32_reference (buf + i, len);
+	    crc2 = get_crc32 (buf + i, len);
+	    if (crc1 != crc2 && num_fails++ < 10)
+		printf ("Mismatch at offset %d, length %d: %08x != %08x\n", i, len, crc1, crc2);
+	}
+    }
+    crc1 = crc32_reference (buf + 3, BENCH_SIZE);
+    crc2 = get_crc32 (buf + 3, BENCH_SIZE);
+    if (crc1 != crc2) {
+	printf ("Mismatch for %d bytes: %08x != %08x\n", BENCH_SIZE, crc1, crc2);
+	num_fails++;
+    }
+    /* get_crc32_val continues a CRC one byte at a time */
+    crc1 = 0;
+    for (j = 0; j < 1000; j++)
+	crc1 = get_crc32_val (buf[j], crc1);
+    if (crc1 != get_crc32 (buf, 1000)) {
+	printf ("Failed: get_crc32_val %08x != %08x\n", crc1, get_crc32 (buf, 1000));
+	num_fails++;
+    }
+
+    if (crc32_bytewise (buf + 5, BENCH_SIZE) != crc32_reference (buf + 5, BENCH_SIZE)) {
+	printf ("Failed: byte table loop disagrees\n");
+	num_fails++;
+    }
+
+    start = clock ();
+    for (i = 0; i < BENCH_LOOPS; i++)
+	check += crc32_bytewise (buf, BENCH_SIZE);
+    t1 = (double)(clock () - start) / CLOCKS_PER_SEC;
+    start = clock ();
+    for (i = 0; i < BENCH_LOOPS; i++)
+	check += get_crc32 (buf, BENCH_SIZE);
+    t2 = (double)(clock () - start) / CLOCKS_PER_SEC;
+    printf ("%d x %dk: byte table %.3fs, slice-by-8 %.3fs (%.1fx) [%08x]\n",
+	BENCH_LOOPS, BENCH_SIZE / 1024, t1, t2, t2 > 0 ? t1 / t2 : 0.0, check);
+
+    if (num_fails)
+	printf ("%d tests failed.\n", num_fails);
+    return num_fails ? 1 : 0;
+}
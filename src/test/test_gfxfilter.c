@@ -0,0 +1,472 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Check the software display filters against straightforward
+  * implementations and report the time per frame of each filter at
+  * the usual Amiga screen sizes, for a full refresh and for a frame
+  * where only a few lines changed.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "options.h"
+#include "gfxfilter.h"
+
+#ifdef GFXFILTER
+
+#define BENCH_FRAMES 50
+
+struct uae_prefs currprefs;
+struct uae_filter *usedfilter;
+
+static int failures;
+
+void write_log (const char *format, ...)
+{
+}
+
+static uae_u32 rnd32 (void)
+{
+    return ((uae_u32)rand () << 16) ^ (uae_u32)rand ();
+}
+
+/* few distinct colours, so that the edge rules actually trigger */
+static void fill (uae_u8 *buf, int pitch, int width, int height, int bpp)
+{
+    static const uae_u32 pal32[4] = { 0x000000, 0xffffff, 0xff8000, 0x0040c0 };
+    static const uae_u16 pal16[4] = { 0x0000, 0xffff, 0xfc00, 0x0218 };
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+	for (x = 0; x < width; x++) {
+	    int c = rnd32 () & 3;
+	    if (bpp == 4)
+		((uae_u32*)(buf + y * pitch))[x] = pal32[c];
+	    else
+		((uae_u16*)(buf + y * pitch))[x] = pal16[c];
+	}
+    }
+}
+
+static uae_u32 getpix (const uae_u8 *buf, int pitch, int bpp, int width, int height, int x, int y)
+{
+    x = x < 0 ? 0 : (x >= width ? width - 1 : x);
+    y = y < 0 ? 0 : (y >= height ? height - 1 : y);
+    if (bpp == 4)
+	return ((const uae_u32*)(buf + y * pitch))[x];
+    return ((const uae_u16*)(buf + y * pitch))[x];
+}
+
+static void putpix (uae_u8 *buf, int pitch, int bpp, int x, int y, uae_u32 v)
+{
+    if (bpp == 4)
+	((uae_u32*)(buf + y * pitch))[x] = v;
+    else
+	((uae_u16*)(buf + y * pitch))[x] = v;
+}
+
+static void scale2x_reference (const uae_u8 *src, int sp, uae_u8 *dst, int dp, int w, int h, int bpp)
+{
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+	for (x = 0; x < w; x++) {
+	    uae_u32 B = getpix (src, sp, bpp, w, h, x, y - 1);
+	    uae_u32 D = getpix (src, sp, bpp, w, h, x - 1, y);
+	    uae_u32 E = getpix (src, sp, bpp, w, h, x, y);
+	    uae_u32 F = getpix (src, sp, bpp, w, h, x + 1, y);
+	    uae_u32 H = getpix (src, sp, bpp, w, h, x, y + 1);
+	    uae_u32 e0 = E, e1 = E, e2 = E, e3 = E;
+	    if (B != H && D != F) {
+		e0 = D == B ? D : E;
+		e1 = B == F ? F : E;
+		e2 = D == H ? D : E;
+		e3 = H == F ? F : E;
+	    }
+	    putpix (dst, dp, bpp, 2 * x, 2 * y, e0);
+	    putpix (dst, dp, bpp, 2 * x + 1, 2 * y, e1);
+	    putpix (dst, dp, bpp, 2 * x, 2 * y + 1, e2);
+	    putpix (dst, dp, bpp, 2 * x + 1, 2 * y + 1, e3);
+	}
+    }
+}
+
+static void scale3x_reference (const uae_u8 *src, int sp, uae_u8 *dst, int dp, int w, int h, int bpp)
+{
+    int x, y, i;
+
+    for (y = 0; y < h; y++) {
+	for (x = 0; x < w; x++) {
+	    uae_u32 A = getpix (src, sp, bpp, w, h, x - 1, y - 1);
+	    uae_u32 B = getpix (src, sp, bpp, w, h, x, y - 1);
+	    uae_u32 C = getpix (src, sp, bpp, w, h, x + 1, y - 1);
+	    uae_u32 D = getpix (src, sp, bpp, w, h, x - 1, y);
+	    uae_u32 E = getpix (src, sp, bpp, w, h, x, y);
+	    uae_u32 F = getpix (src, sp, bpp, w, h, x + 1, y);
+	    uae_u32 G = getpix (src, sp, bpp, w, h, x - 1, y + 1);
+	    uae_u32 H = getpix (src, sp, bpp, w, h, x, y + 1);
+	    uae_u32 I = getpix (src, sp, bpp, w, h, x + 1, y + 1);
+	    uae_u32 o[9];
+	    for (i = 0; i < 9; i++)
+		o[i] = E;
+	    if (B != H && D != F) {
+		o[0] = D == B ? D : E;
+		o[1] = (D == B && E != C) || (B == F && E != A) ? B : E;
+		o[2] = B == F ? F : E;
+		o[3] = (D == B && E != G) || (D == H && E != A) ? D : E;
+		o[5] = (B == F && E != I) || (H == F && E != C) ? F : E;
+		o[6] = D == H ? D : E;
+		o[7] = (D == H && E != I) || (H == F && E != G) ? H : E;
+		o[8] = H == F ? F : E;
+	    }
+	    for (i = 0; i < 9; i++)
+		putpix (dst, dp, bpp, 3 * x + i % 3, 3 * y + i / 3, o[i]);
+	}
+    }
+}
+
+/* per channel (l + r + 2c) / 4, rounded up at both steps like pavgb */
+static uae_u32 avg_channels (uae_u32 a, uae_u32 b, const int *shift, const int *bits)
+{
+    uae_u32 v = 0;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+	uae_u32 m = (1 << bits[i]) - 1;
+	uae_u32 ca = (a >> shift[i]) & m, cb = (b >> shift[i]) & m;
+	v |= ((ca + cb + 1) >> 1) << shift[i];
+    }
+    return v;
+}
+
+static void pal_reference (const uae_u8 *src, int sp, uae_u8 *dst, int dp, int w, int h, int bpp)
+{
+    static const int shift32[3] = { 16, 8, 0 }, bits32[3] = { 8, 8, 8 };
+    static const int shift16[3] = { 11, 5, 0 }, bits16[3] = { 5, 6, 5 };
+    const int *shift = bpp == 4 ? shift32 : shift16, *bits = bpp == 4 ? bits32 : bits16;
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+	for (x = 0; x < w; x++) {
+	    uae_u32 l = getpix (src, sp, bpp, w, h, x - 1, y);
+	    uae_u32 c = getpix (src, sp, bpp, w, h, x, y);
+	    uae_u32 r = getpix (src, sp, bpp, w, h, x + 1, y);
+	    putpix (dst, dp, bpp, x, y, avg_channels (avg_channels (l, r, shift, bits), c, shift, bits));
+	}
+    }
+}
+
+/* hq, one output block at a time: compare in YUV, smooth the corners
+ * an edge runs across, blend towards differing diagonals */
+static uae_u32 ref_yuv (uae_u32 p, int bpp)
+{
+    int r, g, b;
+
+    if (bpp == 4) {
+	r = (p >> 16) & 0xff; g = (p >> 8) & 0xff; b = p & 0xff;
+    } else {
+	r = ((p >> 11) & 0x1f) << 3; g = ((p >> 5) & 0x3f) << 2; b = (p & 0x1f) << 3;
+    }
+    return (((r + g + b) >> 2) << 16) | ((128 + ((r - b) >> 2)) << 8) | (128 + ((-r + 2 * g - b) >> 3));
+}
+
+static int ref_differ (uae_u32 a, uae_u32 b, int bpp)
+{
+    uae_u32 ya = ref_yuv (a, bpp), yb = ref_yuv (b, bpp);
+    return abs ((int)(ya >> 16) - (int)(yb >> 16)) > 48
+	|| abs ((int)((ya >> 8) & 0xff) - (int)((yb >> 8) & 0xff)) > 7
+	|| abs ((int)(ya & 0xff) - (int)(yb & 0xff)) > 6;
+}
+
+/* weights add up to 4 */
+static uae_u32 ref_blend (uae_u32 a, int wa, uae_u32 b, int wb, uae_u32 c, int wc, int bpp)
+{
+    uae_u32 mrb = bpp == 4 ? 0xff00ff : 0xf81f, mg = bpp == 4 ? 0x00ff00 : 0x07e0;
+    uae_u64 rb = (uae_u64)(a & mrb) * wa + (uae_u64)(b & mrb) * wb + (uae_u64)(c & mrb) * wc;
+    uae_u64 g = (uae_u64)(a & mg) * wa + (uae_u64)(b & mg) * wb + (uae_u64)(c & mg) * wc;
+    return (uae_u32)(((rb >> 2) & mrb) | ((g >> 2) & mg));
+}
+
+static void hq_reference (const uae_u8 *src, int sp, uae_u8 *dst, int dp, int w, int h, int bpp, int mult)
+{
+    int x, y, c, sx, sy;
+
+    for (y = 0; y < h; y++) {
+	for (x = 0; x < w; x++) {
+	    /* per corner TL, TR, BL, BR: the side neighbours and the diagonal */
+	    uae_u32 E = getpix (src, sp, bpp, w, h, x, y);
+	    uae_u32 hs[4], vs[4], dg[4];
+	    int edge[4], cdiff[4];
+	    for (c = 0; c < 4; c++) {
+		int dx = c & 1 ? 1 : -1, dy = c & 2 ? 1 : -1;
+		hs[c] = getpix (src, sp, bpp, w, h, x + dx, y);
+		vs[c] = getpix (src, sp, bpp, w, h, x, y + dy);
+		dg[c] = getpix (src, sp, bpp, w, h, x + dx, y + dy);
+		edge[c] = !ref_differ (hs[c], vs[c], bpp) && ref_differ (E, hs[c], bpp);
+		cdiff[c] = ref_differ (E, dg[c], bpp);
+	    }
+	    for (sy = 0; sy < mult; sy++) {
+		for (sx = 0; sx < mult; sx++) {
+		    int midx = mult == 3 && sx == 1, midy = mult == 3 && sy == 1;
+		    int right = sx >= (mult + 1) / 2, bottom = sy >= (mult + 1) / 2;
+		    int hb = sx == 0 || sx == mult - 1, vb = sy == 0 || sy == mult - 1;
+		    uae_u32 p = E;
+		    c = (bottom ? 2 : 0) + (right ? 1 : 0);
+		    if (midx && midy) {
+			;
+		    } else if (midx) {
+			/* middle of the top or bottom row, shared by two corners */
+			if (edge[c & 2] || edge[(c & 2) + 1])
+			    p = ref_blend (E, 3, vs[c & 2], 1, 0, 0, bpp);
+		    } else if (midy) {
+			if (edge[c & 1] || edge[(c & 1) + 2])
+			    p = ref_blend (E, 3, hs[c & 1], 1, 0, 0, bpp);
+		    } else if (hb && vb) {
+			if (edge[c])
+			    p = ref_blend (E, 2, hs[c], 1, vs[c], 1, bpp);
+			else if (cdiff[c])
+			    p = ref_blend (E, 3, dg[c], 1, 0, 0, bpp);
+		    } else if (hb) {
+			if (edge[c])
+			    p = ref_blend (E, 3, hs[c], 1, 0, 0, bpp);
+		    } else if (vb) {
+			if (edge[c])
+			    p = ref_blend (E, 3, vs[c], 1, 0, 0, bpp);
+		    }
+		    putpix (dst, dp, bpp, x * mult + sx, y * mult + sy, p);
+		}
+	    }
+	}
+    }
+}
+
+static void hq2x_reference (const uae_u8 *src, int sp, uae_u8 *dst, int dp, int w, int h, int bpp)
+{
+    hq_reference (src, sp, dst, dp, w, h, bpp, 2);
+}
+
+static void hq3x_reference (const uae_u8 *src, int sp, uae_u8 *dst, int dp, int w, int h, int bpp)
+{
+    hq_reference (src, sp, dst, dp, w, h, bpp, 3);
+}
+
+static void hq4x_reference (const uae_u8 *src, int sp, uae_u8 *dst, int dp, int w, int h, int bpp)
+{
+    hq_reference (src, sp, dst, dp, w, h, bpp, 4);
+}
+
+static void configure (int bpp)
+{
+    if (bpp == 4)
+	S2X_configure (8, 8, 8, 16, 8, 0);
+    else
+	S2X_configure (5, 6, 5, 11, 5, 0);
+}
+
+/* Run one filter through S2X_render and compare with the reference,
+ * then invalidate a single line and check that only its neighbourhood
+ * is redrawn. */
+static void check (const char *name, int filter, int mode, int w, int h, int bpp,
+    void (*ref)(const uae_u8*, int, uae_u8*, int, int, int, int))
+{
+    int mult, outmult, pitch, dp, first, last, y;
+    uae_u8 *src, *dst, *exp;
+
+    currprefs.gfx_filter = filter;
+    currprefs.gfx_filter_filtermode = mode;
+    mult = S2X_getmult ();
+    outmult = filter == UAE_FILTER_PAL ? 1 : mult;
+    configure (bpp);
+    S2X_init (w * mult, h * mult, w, h, bpp * 8, bpp * 8);
+    src = S2X_getbuffer (&pitch);
+    fill (src, pitch, w, h, bpp);
+    dp = w * outmult * bpp + 4;
+    dst = calloc (dp, h * outmult);
+    exp = calloc (dp, h * outmult);
+    ref (src, pitch, exp, dp, w, h, bpp);
+
+    if (!S2X_render (dst, dp, &first, &last) || first != 0 || last != h * outmult - 1) {
+	printf ("%s %dx%d %d bit: bad render range %d-%d\n", name, w, h, bpp * 8, first, last);
+	failures++;
+    }
+    for (y = 0; y < h * outmult; y++) {
+	if (memcmp (dst + y * dp, exp + y * dp, w * outmult * bpp)) {
+	    printf ("%s %dx%d %d bit: line %d differs\n", name, w, h, bpp * 8, y);
+	    failures++;
+	    break;
+	}
+    }
+
+    if (S2X_render (dst, dp, &first, &last)) {
+	printf ("%s: clean frame was rendered\n", name);
+	failures++;
+    }
+    S2X_invalidate (h / 2, h / 2);
+    if (S2X_render (dst, dp, &first, &last) < 1 || first > (h / 2 - 1) * outmult || last < (h / 2 + 2) * outmult - 1) {
+	printf ("%s: partial update range %d-%d\n", name, first, last);
+	failures++;
+    }
+
+    S2X_free ();
+    free (dst);
+    free (exp);
+}
+
+/* hq has no independent implementation, check the invariants instead:
+ * flat areas stay flat and the output matches the single thread kernel. */
+static void check_hq (int filter, int w, int h, int bpp)
+{
+    int mult, pitch, dp, first, last, x, y;
+    uae_u8 *src, *dst, *exp;
+
+    currprefs.gfx_filter = filter;
+    mult = S2X_getmult ();
+    configure (bpp);
+    S2X_init (w * mult, h * mult, w, h, bpp * 8, bpp * 8);
+    src = S2X_getbuffer (&pitch);
+    dp = w * mult * bpp;
+    dst = calloc (dp, h * mult);
+    exp = calloc (dp, h * mult);
+
+    for (y = 0; y < h; y++) {
+	for (x = 0; x < w; x++)
+	    putpix (src, pitch, bpp, x, y, 0x5a5a5a & (bpp == 4 ? 0xffffff : 0xffff));
+    }
+    S2X_render (dst, dp, &first, &last);
+    for (y = 0; y < h * mult; y++) {
+	for (x = 0; x < w * mult; x++) {
+	    if (getpix (dst, dp, bpp, w * mult, h * mult, x, y) != getpix (src, pitch, bpp, w, h, 0, 0)) {
+		printf ("hq%dx %d bit: flat area changed at %d,%d\n", mult, bpp * 8, x, y);
+		failures++;
+		y = h * mult;
+		break;
+	    }
+	}
+    }
+
+    fill (src, pitch, w, h, bpp);
+    S2X_refresh ();
+    S2X_render (dst, dp, &first, &last);
+    if (bpp == 4)
+	hq_32 (src, pitch, exp, dp, w, 0, h, h, mult);
+    else
+	hq_16 (src, pitch, exp, dp, w, 0, h, h, mult);
+    if (memcmp (dst, exp, dp * h * mult)) {
+	printf ("hq%dx %d bit: banded output differs\n", mult, bpp * 8);
+	failures++;
+    }
+
+    S2X_free ();
+    free (dst);
+    free (exp);
+}
+
+static double now_ms (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void bench (const char *name, int filter, int mode, int w, int h)
+{
+    int mult, outmult, pitch, first, last, i;
+    uae_u8 *src, *dst;
+    double t0, full, part;
+
+    currprefs.gfx_filter = filter;
+    currprefs.gfx_filter_filtermode = mode;
+    mult = S2X_getmult ();
+    outmult = filter == UAE_FILTER_PAL ? 1 : mult;
+    configure (4);
+    S2X_init (w * mult, h * mult, w, h, 32, 32);
+    src = S2X_getbuffer (&pitch);
+    fill (src, pitch, w, h, 4);
+    dst = malloc (w * outmult * 4 * h * outmult);
+
+    t0 = now_ms ();
+    for (i = 0; i < BENCH_FRAMES; i++) {
+	S2X_refresh ();
+	S2X_render (dst, w * outmult * 4, &first, &last);
+    }
+    full = (now_ms () - t0) / BENCH_FRAMES;
+
+    /* a status line and a moving sprite */
+    t0 = now_ms ();
+    for (i = 0; i < BENCH_FRAMES; i++) {
+	S2X_invalidate (h - 8, h - 1);
+	S2X_invalidate ((i * 7) % (h - 16), (i * 7) % (h - 16) + 16);
+	S2X_render (dst, w * outmult * 4, &first, &last);
+    }
+    part = (now_ms () - t0) / BENCH_FRAMES;
+
+    printf ("%-8s %4dx%-4d -> %4dx%-4d %8.3f ms/frame full %8.3f ms/frame partial\n",
+	name, w, h, w * outmult, h * outmult, full, part);
+    S2X_free ();
+    free (dst);
+}
+
+int main (int argc, char **argv)
+{
+    static const struct { const char *name; int filter, mode; } filters[] = {
+	{ "null2x", UAE_FILTER_NULL, 1 },
+	{ "scale2x", UAE_FILTER_SCALE2X, 0 },
+	{ "scale3x", UAE_FILTER_SCALE2X, 2 },
+	{ "hq2x", UAE_FILTER_HQ2X, 0 },
+	{ "hq3x", UAE_FILTER_HQ3X, 0 },
+	{ "hq4x", UAE_FILTER_HQ4X, 0 },
+	{ "pal", UAE_FILTER_PAL, 0 },
+	{ NULL }
+    };
+    static const int sizes[][2] = { { 320, 256 }, { 640, 256 }, { 720, 568 } };
+    int bpp, i, j;
+
+    srand (1);
+    for (bpp = 2; bpp <= 4; bpp += 2) {
+	/* odd widths exercise the vector loop tails */
+	check ("scale2x", UAE_FILTER_SCALE2X, 0, 37, 40, bpp, scale2x_reference);
+	check ("scale2x", UAE_FILTER_SCALE2X, 0, 320, 67, bpp, scale2x_reference);
+	check ("scale3x", UAE_FILTER_SCALE2X, 2, 37, 40, bpp, scale3x_reference);
+	check ("scale3x", UAE_FILTER_SCALE2X, 2, 321, 67, bpp, scale3x_reference);
+	check ("pal", UAE_FILTER_PAL, 0, 37, 40, bpp, pal_reference);
+	check ("pal", UAE_FILTER_PAL, 0, 641, 67, bpp, pal_reference);
+	check ("hq2x", UAE_FILTER_HQ2X, 0, 37, 40, bpp, hq2x_reference);
+	check ("hq2x", UAE_FILTER_HQ2X, 0, 321, 67, bpp, hq2x_reference);
+	check ("hq3x", UAE_FILTER_HQ3X, 0, 37, 40, bpp, hq3x_reference);
+	check ("hq3x", UAE_FILTER_HQ3X, 0, 321, 67, bpp, hq3x_reference);
+	check ("hq4x", UAE_FILTER_HQ4X, 0, 37, 40, bpp, hq4x_reference);
+	check ("hq4x", UAE_FILTER_HQ4X, 0, 321, 67, bpp, hq4x_reference);
+	for (i = UAE_FILTER_HQ2X; i <= UAE_FILTER_HQ4X; i++)
+	    check_hq (i, 101, 50, bpp);
+    }
+    if (failures) {
+	printf ("gfxfilter: %d failures\n", failures);
+	return 1;
+    }
+    printf ("gfxfilter: results match\n");
+
+    if (argc > 1 && !strcmp (argv[1], "-q"))
+	return 0;
+    for (j = 0; j < 3; j++) {
+	for (i = 0; filters[i].name; i++)
+	    bench (filters[i].name, filters[i].filter, filters[i].mode, sizes[j][0], sizes[j][1]);
+    }
+    return 0;
+}
+
+#else
+
+int main (int argc, char **argv)
+{
+    printf ("gfxfilter: skipped, built without GFXFILTER\n");
+    return 0;
+}
+
+#endif
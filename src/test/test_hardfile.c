@@ -0,0 +1,504 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Test for parallel uaehf.device requests and the hardfile block cache.
+  *
+  * Sends IORequests through hardfile_beginio like the Amiga side does and
+  * runs them against an image in host memory whose target functions take
+  * a while, so the worker pool really has several transfers going. Checks
+  * the data and io_Actual of every request, that overlapping requests see
+  * each other's writes in the order they were sent and never reach the
+  * image at the same time, and that other commands wait until all earlier
+  * transfers are done.
+  *
+  * The block cache is checked for hits, writes reaching the image on
+  * flush and eviction, cached data being served while another extent is
+  * loaded, growing the image and read-ahead. Then times random reads with
+  * and without the pool.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../hardfile.c"
+
+#define RAMSIZE 0x800000
+#define IMGSIZE 0x1000000
+#define REQBASE 0x1000
+#define DATABASE 0x10000
+#define DATASIZE 0x10000
+#define REQUESTS 32
+
+static uae_u8 ram[RAMSIZE];
+static uae_u8 image[IMGSIZE];
+static struct hardfiledata hfd;
+static int failures;
+
+struct uae_prefs currprefs;
+struct regstruct regs;
+addrbank *mem_banks[MEMORY_BANKS];
+uae_u16 kickstart_version;
+uaecptr EXPANSION_nullfunc, ROM_hardfile_resname, ROM_hardfile_resid, ROM_hardfile_init, filesys_initcode;
+
+void write_log (const char *format, ...)
+{
+}
+
+/* installing the device and RDB emulation are not tested */
+void dw (uae_u16 v) { }
+void dl (uae_u32 v) { }
+uae_u32 ds (const char *s) { return 0; }
+void calltrap (uae_u32 n) { }
+uae_u32 here (void) { return 0; }
+unsigned int define_trap (TrapHandler handler_func, int flags, const TCHAR *name) { return 0; }
+int is_hardfile (int unit_no) { return FILESYS_HARDFILE; }
+int ua_copy (char *dst, int maxlen, const char *src) { return 0; }
+int get_guid_target (uae_u8 *out) { return 0; }
+void gui_flicker_led (int led, int unitnum, int status) { }
+void uae_Cause (uaecptr interrupt) { }
+struct zfile *zfile_fopen (const TCHAR *name, const TCHAR *mode, int mask) { return NULL; }
+void zfile_fclose (struct zfile *f) { }
+uae_s64 zfile_fseek (struct zfile *z, uae_s64 offset, int mode) { return 0; }
+size_t zfile_fwrite (void *b, size_t l1, size_t l2, struct zfile *z) { return 0; }
+
+static uae_u32 REGPARAM2 ram_lget (uaecptr a) { return do_get_mem_long ((uae_u32*)(ram + (a & (RAMSIZE - 1)))); }
+static uae_u32 REGPARAM2 ram_wget (uaecptr a) { return do_get_mem_word ((uae_u16*)(ram + (a & (RAMSIZE - 1)))); }
+static uae_u32 REGPARAM2 ram_bget (uaecptr a) { return ram[a & (RAMSIZE - 1)]; }
+static void REGPARAM2 ram_lput (uaecptr a, uae_u32 v) { do_put_mem_long ((uae_u32*)(ram + (a & (RAMSIZE - 1))), v); }
+static void REGPARAM2 ram_wput (uaecptr a, uae_u32 v) { do_put_mem_word ((uae_u16*)(ram + (a & (RAMSIZE - 1))), v); }
+static void REGPARAM2 ram_bput (uaecptr a, uae_u32 v) { ram[a & (RAMSIZE - 1)] = v; }
+static uae_u8 *REGPARAM2 ram_xlate (uaecptr a) { return ram + (a & (RAMSIZE - 1)); }
+static int REGPARAM2 ram_check (uaecptr a, uae_u32 size) { return (a & (RAMSIZE - 1)) + size <= RAMSIZE; }
+
+static addrbank ram_bank = {
+    ram_lget, ram_wget, ram_bget,
+    ram_lput, ram_wput, ram_bput,
+    ram_xlate, ram_check, NULL, "RAM",
+    ram_lget, ram_wget, ABFLAG_RAM
+};
+
+struct hardfiledata *get_hardfile_data (int nr)
+{
+    return nr == 0 ? &hfd : NULL;
+}
+
+/* The image. Every access takes target_delay microseconds and is
+ * recorded while it runs, a write overlapping any other access to the
+ * same bytes is a race. */
+static int target_delay;
+static uae_sem_t target_lock;
+static struct { uae_u64 offset; int len, write; } active[MAX_QUEUE_DEPTH + 2];
+static int nactive, maxactive, races;
+static volatile int target_reads, target_writes;
+
+static void target_begin (uae_u64 offset, int len, int write)
+{
+    int i;
+
+    uae_sem_wait (&target_lock);
+    for (i = 0; i < nactive; i++) {
+	if ((write || active[i].write) && offset < active[i].offset + active[i].len && active[i].offset < offset + len)
+	    races++;
+    }
+    active[nactive].offset = offset;
+    active[nactive].len = len;
+    active[nactive].write = write;
+    nactive++;
+    if (nactive > maxactive)
+	maxactive = nactive;
+    uae_sem_post (&target_lock);
+}
+
+static void target_end (uae_u64 offset, int len, int write)
+{
+    int i;
+
+    uae_sem_wait (&target_lock);
+    for (i = 0; i < nactive; i++) {
+	if (active[i].offset == offset && active[i].len == len && active[i].write == write) {
+	    active[i] = active[--nactive];
+	    break;
+	}
+    }
+    uae_sem_post (&target_lock);
+}
+
+int hdf_read_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len)
+{
+    if (offset + len > hfd->physsize)
+	return 0;
+    target_begin (offset, len, 0);
+    target_reads++;
+    usleep (target_delay);
+    memcpy (buffer, image + offset, len);
+    target_end (offset, len, 0);
+    return len;
+}
+
+int hdf_write_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len)
+{
+    if (offset + len > hfd->physsize)
+	return 0;
+    target_begin (offset, len, 1);
+    target_writes++;
+    usleep (target_delay);
+    memcpy (image + offset, buffer, len);
+    target_end (offset, len, 1);
+    return len;
+}
+
+int hdf_direct_target (struct hardfiledata *hfd, int enable)
+{
+    hfd->direct_io = enable;
+    return enable;
+}
+
+int hdf_resize_target (struct hardfiledata *hfd, uae_u64 newsize)
+{
+    if (newsize > IMGSIZE)
+	return 0;
+    hfd->physsize = newsize;
+    return 1;
+}
+
+int hdf_open_target (struct hardfiledata *hfd, const TCHAR *name) { return 0; }
+void hdf_close_target (struct hardfiledata *hfd) { }
+int hdf_dup_target (struct hardfiledata *dhfd, const struct hardfiledata *shfd) { return 0; }
+
+/* replies in the order they arrive */
+static uaecptr replied[REQUESTS * 2];
+static volatile int nreplied;
+static uae_sem_t reply_sem;
+
+void uae_ReplyMsg (uaecptr msg)
+{
+    replied[nreplied++] = msg;
+    uae_sem_post (&reply_sem);
+}
+
+static void check (int cond, const char *what)
+{
+    printf ("%-56s %s\n", what, cond ? "ok" : "FAILED");
+    if (!cond)
+	failures++;
+}
+
+static void open_unit (int depth, int delay)
+{
+    memset (&hardfpd[0], 0, sizeof hardfpd[0]);
+    currprefs.hardfile_queue_depth = depth;
+    target_delay = delay;
+    nreplied = 0;
+    maxactive = races = 0;
+}
+
+static void close_unit (void)
+{
+    write_comm_pipe_u32 (&hardfpd[0].requests, 0, 1);
+    uae_sem_wait (&hardfpd[0].sync_sem);
+}
+
+static uaecptr request (int i, int cmd, uae_u32 offset, uae_u32 len)
+{
+    uaecptr r = REQBASE + i * 0x40;
+
+    memset (ram + r, 0, 0x40);
+    put_long (r + 24, 0);
+    put_word (r + 28, cmd);
+    put_long (r + 36, len);
+    put_long (r + 40, DATABASE + i * DATASIZE);
+    put_long (r + 44, offset);
+    return r;
+}
+
+static void send (uaecptr r)
+{
+    m68k_areg (regs, 1) = r;
+    hardfile_beginio (NULL);
+}
+
+static void wait_replies (int n)
+{
+    while (n-- > 0)
+	uae_sem_wait (&reply_sem);
+}
+
+static int reply_index (uaecptr r)
+{
+    int i;
+
+    for (i = 0; i < nreplied; i++) {
+	if (replied[i] == r)
+	    return i;
+    }
+    return -1;
+}
+
+static uae_u8 *data (int i)
+{
+    return ram + DATABASE + i * DATASIZE;
+}
+
+/* non-overlapping transfers of different sizes, all sent at once */
+static void test_transfers (int depth)
+{
+    uae_u32 offset[REQUESTS], len[REQUESTS];
+    int i, j, ok = 1, dataok = 1;
+    char what[80];
+
+    open_unit (depth, 200);
+    for (i = 0; i < REQUESTS; i++) {
+	offset[i] = i * (IMGSIZE / REQUESTS) + (rand () % 64) * 512;
+	len[i] = (1 + rand () % 64) * 512;
+	request (i, CMD_WRITE, offset[i], len[i]);
+	for (j = 0; j < (int)len[i]; j++)
+	    data (i)[j] = rand ();
+    }
+    for (i = 0; i < REQUESTS; i++)
+	send (REQBASE + i * 0x40);
+    wait_replies (REQUESTS);
+    for (i = 0; i < REQUESTS; i++) {
+	uaecptr r = REQBASE + i * 0x40;
+	if (get_byte (r + 31) != 0 || get_long (r + 32) != len[i])
+	    ok = 0;
+	if (memcmp (image + offset[i], data (i), len[i]))
+	    dataok = 0;
+    }
+
+    nreplied = 0;
+    for (i = 0; i < REQUESTS; i++) {
+	request (i, i & 1 ? NSCMD_TD_READ64 : CMD_READ, offset[i], len[i]);
+	memset (data (i), 0, len[i]);
+    }
+    for (i = 0; i < REQUESTS; i++)
+	send (REQBASE + i * 0x40);
+    wait_replies (REQUESTS);
+    for (i = 0; i < REQUESTS; i++) {
+	uaecptr r = REQBASE + i * 0x40;
+	if (get_byte (r + 31) != 0 || get_long (r + 32) != len[i])
+	    ok = 0;
+	if (memcmp (image + offset[i], data (i), len[i]))
+	    dataok = 0;
+    }
+    close_unit ();
+
+    sprintf (what, "queue depth %d: io_Error and io_Actual", depth);
+    check (ok, what);
+    sprintf (what, "queue depth %d: data written and read back", depth);
+    check (dataok, what);
+    sprintf (what, "queue depth %d: %d transfers at once", depth, maxactive);
+    check (depth > 1 ? maxactive > 1 && maxactive <= depth : maxactive == 1, what);
+}
+
+/* overlapping requests keep their order, anything else waits for them */
+static void test_ordering (void)
+{
+    uaecptr w1, w2, w3, r1, r2, upd;
+    int i, unrelated = 1;
+
+    open_unit (4, 500);
+    w1 = request (0, CMD_WRITE, 0x40000, 0x2000);
+    memset (data (0), 0x11, 0x2000);
+    w2 = request (1, CMD_WRITE, 0x41000, 0x1000);
+    memset (data (1), 0x22, 0x1000);
+    r1 = request (2, CMD_READ, 0x40000, 0x2000);
+    w3 = request (3, TD_WRITE64, 0x40000, 0x1000);
+    memset (data (3), 0x33, 0x1000);
+    r2 = request (4, CMD_READ, 0x40000, 0x2000);
+    for (i = 5; i < 13; i++)
+	request (i, CMD_READ, 0x100000 + i * 0x10000, 0x4000);
+    upd = request (13, CMD_UPDATE, 0, 0);
+
+    send (w1);
+    send (request (5, CMD_READ, 0x150000, 0x4000));
+    send (w2);
+    send (request (6, CMD_READ, 0x160000, 0x4000));
+    send (r1);
+    send (w3);
+    for (i = 7; i < 13; i++)
+	send (REQBASE + i * 0x40);
+    send (r2);
+    send (upd);
+    wait_replies (14);
+    close_unit ();
+
+    check (races == 0, "overlapping requests never run at once");
+    check (reply_index (w1) < reply_index (w2) && reply_index (w2) < reply_index (r1)
+	&& reply_index (r1) < reply_index (w3) && reply_index (w3) < reply_index (r2),
+	"overlapping requests complete in order");
+    check (data (2)[0] == 0x11 && data (2)[0xfff] == 0x11 && data (2)[0x1000] == 0x22 && data (2)[0x1fff] == 0x22,
+	"read sees the writes sent before it");
+    check (data (4)[0] == 0x33 && data (4)[0xfff] == 0x33 && data (4)[0x1000] == 0x22,
+	"read after a rewrite sees the new data");
+    for (i = 0; i < 14; i++) {
+	if (reply_index (REQBASE + i * 0x40) < 0)
+	    unrelated = 0;
+    }
+    check (unrelated && reply_index (upd) == 13, "other commands wait for all transfers");
+}
+
+static double now_ms (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* a 1M cache (16 extents) on an image that ends inside an extent */
+#define CACHEIMG (0x400000 + 0x3000)
+static struct hardfiledata chfd;
+static uae_sem_t loader_done;
+static uae_u8 loader_buf[0x1000];
+static int loader_got;
+
+static void *loader (void *v)
+{
+    loader_got = hdf_read (&chfd, loader_buf, 0x300000, sizeof loader_buf);
+    uae_sem_post (&loader_done);
+    return NULL;
+}
+
+static void test_cache (void)
+{
+    struct hdf_blockcache *bc;
+    uae_u8 buf[0x2000], pattern[0x2000];
+    uae_u32 hits, reads, writes;
+    uae_thread_id tid;
+    double t;
+    int i, ok;
+
+    memset (&chfd, 0, sizeof chfd);
+    chfd.physsize = chfd.virtsize = CACHEIMG;
+    chfd.blocksize = 512;
+    currprefs.hardfile_cache_size = 1;
+    target_delay = 0;
+    hdf_cache_init (&chfd);
+    bc = chfd.bcache;
+    check (bc && bc->count == 16, "cache set up");
+
+    hdf_read (&chfd, buf, 0x20000, 0x1000);
+    hits = bc->hits;
+    reads = target_reads;
+    ok = hdf_read (&chfd, buf, 0x20000, 0x1000) == 0x1000;
+    check (ok && target_reads == reads && bc->hits == hits + 1 && !memcmp (buf, image + 0x20000, 0x1000),
+	"second read is a hit");
+
+    for (i = 0; i < 0x400; i++)
+	pattern[i] = i * 7;
+    writes = target_writes;
+    ok = hdf_write (&chfd, pattern, 0x30200, 0x400) == 0x400;
+    hdf_read (&chfd, buf, 0x30000, 0x1000);
+    check (ok && target_writes == writes && !memcmp (buf + 0x200, pattern, 0x400) && memcmp (image + 0x30200, pattern, 0x400),
+	"write is cached");
+    ok = hdf_cache_flush (&chfd);
+    check (ok && target_writes == writes + 1 && !memcmp (image + 0x30200, pattern, 0x400),
+	"flush writes it to the image");
+
+    /* more extents than the cache holds */
+    for (i = 0; i < 20; i++) {
+	memset (pattern, 0x40 + i, 0x200);
+	hdf_write (&chfd, pattern, 0x100000 + i * 0x10000 + 0x800, 0x200);
+    }
+    check (image[0x100800] == 0x40 && image[0x110800] == 0x41, "evicted extents are written back");
+    hdf_cache_flush (&chfd);
+    ok = 1;
+    for (i = 0; i < 20; i++) {
+	if (image[0x100000 + i * 0x10000 + 0x800] != 0x40 + i || image[0x100000 + i * 0x10000 + 0x9ff] != 0x40 + i)
+	    ok = 0;
+    }
+    check (ok, "all written data in the image after flush");
+
+    /* one thread waits for the file, another reads cached data */
+    hdf_read (&chfd, buf, 0x20000, 0x1000);
+    target_delay = 200000;
+    uae_sem_init (&loader_done, 0, 0);
+    uae_start_thread ("loader", loader, NULL, &tid);
+    usleep (20000);
+    t = now_ms ();
+    ok = hdf_read (&chfd, buf, 0x20000, 0x1000) == 0x1000 && !memcmp (buf, image + 0x20000, 0x1000);
+    t = now_ms () - t;
+    uae_sem_wait (&loader_done);
+    target_delay = 0;
+    check (ok && t < 100, "cached data is served while the file is read");
+    check (loader_got == sizeof loader_buf && !memcmp (loader_buf, image + 0x300000, sizeof loader_buf),
+	"data loaded meanwhile is correct");
+
+    /* the last extent is short, write to it and grow the image */
+    memset (pattern, 0x5a, 0x200);
+    ok = hdf_read (&chfd, buf, CACHEIMG - 0x1000, 0x1000) == 0x1000
+	&& hdf_read (&chfd, buf, CACHEIMG - 0x1000, 0x2000) == 0x1000
+	&& hdf_write (&chfd, pattern, CACHEIMG - 0x200, 0x200) == 0x200;
+    check (ok, "image end limits reads and writes");
+    ok = hdf_cache_resize (&chfd, CACHEIMG + 0x10000);
+    chfd.virtsize = chfd.physsize;
+    check (ok && !memcmp (image + CACHEIMG - 0x200, pattern, 0x200), "resize writes back the last extent");
+    ok = hdf_read (&chfd, buf, CACHEIMG - 0x1000, 0x2000) == 0x2000;
+    check (ok && !memcmp (buf, image + CACHEIMG - 0x1000, 0x2000), "data past the old end is read after resize");
+
+    /* a sequential reader that takes its time with the data */
+    hits = bc->readahead_hits;
+    for (i = 0; i < 32; i++) {
+	hdf_read (&chfd, buf, 0x280000 + i * 0x2000, 0x2000);
+	usleep (2000);
+    }
+    check (bc->readahead_hits > hits, "sequential reads use read-ahead");
+
+    hdf_cache_free (&chfd);
+    currprefs.hardfile_cache_size = 0;
+}
+
+/* random 64K reads from a disk with a 2 ms access time */
+static void bench (void)
+{
+    int depths[] = { 1, 2, 4, 8 };
+    int d, i;
+
+    for (d = 0; d < 4; d++) {
+	double t;
+	open_unit (depths[d], 2000);
+	t = now_ms ();
+	for (i = 0; i < REQUESTS; i++)
+	    send (request (i, CMD_READ, (rand () % (IMGSIZE / DATASIZE)) * DATASIZE, DATASIZE));
+	wait_replies (REQUESTS);
+	t = now_ms () - t;
+	close_unit ();
+	printf ("queue depth %d: %d random 64K reads %6.1f ms, %5.0f requests/s\n",
+	    depths[d], REQUESTS, t, REQUESTS * 1000.0 / t);
+    }
+}
+
+int main (int argc, char **argv)
+{
+    int i;
+
+    for (i = 0; i < MEMORY_BANKS; i++)
+	mem_banks[i] = &ram_bank;
+    uae_sem_init (&change_sem, 0, 1);
+    uae_sem_init (&target_lock, 0, 1);
+    uae_sem_init (&reply_sem, 0, 0);
+    srand (1);
+    for (i = 0; i < IMGSIZE; i++)
+	image[i] = rand ();
+    hfd.physsize = hfd.virtsize = IMGSIZE;
+    hfd.blocksize = 512;
+    hfd.handle_valid = 1;
+
+    test_transfers (1);
+    test_transfers (4);
+    test_ordering ();
+    test_cache ();
+    if (failures) {
+	printf ("FAILED\n");
+	return 1;
+    }
+    printf ("all tests passed\n");
+    if (argc < 2 || strcmp (argv[1], "-q"))
+	bench ();
+    return 0;
+}
@@ -0,0 +1,106 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Test for the JIT FPU fallback counters.
+  *
+  * Plays the part of the translated code: takes the counter the compiler
+  * would hand to the generated increment for each instruction and bumps
+  * it once per simulated execution. Checks that opmodes and instruction
+  * classes land in their own counters, that compiling the same
+  * instruction again does not count anything, and that the report adds
+  * the executions up.
+  */
+
+#include "sysconfig.h"
+
+#ifndef JIT
+#define JIT
+#endif
+#include "../compemu_fpp_stat.c"
+
+#include <stdio.h>
+#include <stdarg.h>
+
+static char logbuf[4096];
+static int failures;
+
+void write_log (const char *format, ...)
+{
+    va_list parms;
+    size_t len = strlen (logbuf);
+
+    va_start (parms, format);
+    vsnprintf (logbuf + len, sizeof logbuf - len, format, parms);
+    va_end (parms);
+}
+
+static void check (int cond, const char *what)
+{
+    printf ("%-56s %s\n", what, cond ? "ok" : "FAILED");
+    if (!cond)
+	failures++;
+}
+
+/* what the generated code does each time the instruction runs */
+static void run (uae_u16 opcode, uae_u16 extra, int times)
+{
+    uae_u32 *counter = comp_fpp_fallback_counter (opcode, extra);
+
+    while (times-- > 0)
+	(*counter)++;
+}
+
+static int logged (const char *line)
+{
+    return strstr (logbuf, line) != NULL;
+}
+
+int main (int argc, char **argv)
+{
+    check (comp_fpp_fallback_counter (0xf200, 0x0022) == comp_fpp_fallback_counter (0xf200, 0x0422)
+	&& comp_fpp_fallback_counter (0xf200, 0x0022) == comp_fpp_fallback_counter (0xf228, 0x4022),
+	"FADD shares one counter for all operands");
+    check (comp_fpp_fallback_counter (0xf200, 0x0022) != comp_fpp_fallback_counter (0xf200, 0x0062)
+	&& comp_fpp_fallback_counter (0xf200, 0x0062) != comp_fpp_fallback_counter (0xf200, 0x0066),
+	"FADD, FSADD and FDADD counted apart");
+    check (comp_fpp_fallback_counter (0xf200, 0xc000) == comp_fpp_fallback_counter (0xf200, 0xe0ff)
+	&& comp_fpp_fallback_counter (0xf280, 0x0000) == comp_fpp_fallback_counter (0xf2c0, 0x1234)
+	&& comp_fpp_fallback_counter (0xf200, 0x6000) != comp_fpp_fallback_counter (0xf200, 0x8000),
+	"classes ignore the operands");
+
+    /* compiling alone counts nothing */
+    comp_fpp_fallback_dump (write_log);
+    check (logbuf[0] == 0, "nothing reported before execution");
+
+    run (0xf200, 0x0022, 3);	/* FADD */
+    run (0xf200, 0x4422, 2);	/* FADD <ea> */
+    run (0xf200, 0x000e, 7);	/* FSIN */
+    run (0xf200, 0x0066, 1);	/* FDADD */
+    run (0xf200, 0x6000, 4);	/* FMOVE FPx,<ea> */
+    run (0xf200, 0xe0ff, 5);	/* FMOVEM */
+    run (0xf240, 0x0001, 6);	/* FScc */
+    run (0xf280, 0x0000, 10);	/* FBcc */
+    run (0xf2c0, 0x0000, 1);	/* FBcc.L */
+    run (0xf300, 0x0000, 1);	/* FSAVE */
+    comp_fpp_fallback_dump (write_log);
+    check (logged ("40 FPU instructions executed"), "total of all executions");
+    check (logged ("arithmetic           13\n"), "general operations summed");
+    check (logged (" 22 FADD         5\n") && logged (" 0e FSIN         7\n")
+	&& logged (" 66 FADD     (D) 1\n"), "general operations by opmode");
+    check (!logged ("FSCALE"), "68040 opmodes named after their operation");
+    check (logged ("FMOVE FPx,<ea>       4\n") && logged ("FMOVEM               5\n")
+	&& logged ("FScc/FDBcc/FTRAPcc   6\n") && logged ("FBcc                 11\n")
+	&& logged ("FSAVE                1\n") && !logged ("FRESTORE"), "instruction classes");
+
+    comp_fpp_fallback_reset ();
+    logbuf[0] = 0;
+    comp_fpp_fallback_dump (write_log);
+    check (logbuf[0] == 0, "reset clears the counters");
+
+    if (failures) {
+	printf ("FAILED\n");
+	return 1;
+    }
+    printf ("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,389 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Test for the run-ahead write tracking of memory.c.
+  *
+  * Sets up chip, slow and fast RAM the way memory.c and expansion.c map
+  * them, starts a snapshot and writes through the bank put functions,
+  * the chipmem_*_indirect pointers used by DMA and straight into chip
+  * RAM with memory_snapshot_chipblock, then checks that a restore gives
+  * back the RAM as it was saved and that stopping puts the original
+  * functions back. Also times a frame's save and restore with the put
+  * functions and DMA writes that lead up to it.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+
+#ifdef SAVESTATE
+
+struct romdata;
+struct zfile;
+struct romdata *getromdatabyzfile (struct zfile *f);
+#ifdef JIT
+/* memory.c uses these from od-generic/memory.c without a prototype */
+#include <sys/shm.h>
+void *my_shmat (int shmid, void *shmaddr, int shmflg);
+int my_shmdt (const void *shmaddr);
+int my_shmget (key_t key, size_t size, int shmflg, const char *name);
+int my_shmctl (int shmid, int cmd, struct shmid_ds *buf);
+#endif
+
+#include "../memory.c"
+
+#define CHIPSIZE (2 * 1024 * 1024)
+#define BOGOSIZE (512 * 1024)
+#define FASTSIZE (8 * 1024 * 1024)
+#define FASTSTART 0x200000
+#define BOGOSTART 0xc00000
+#define ROUNDS 50
+
+static int failures;
+
+void write_log (const char *format, ...)
+{
+}
+
+/* Zorro II fast RAM, as expansion.c has it */
+static uae_u8 *fastmemory;
+#define FAST_OFFSET(addr) (((addr) - FASTSTART) & (FASTSIZE - 1))
+static uae_u32 REGPARAM2 fastmem_lget (uaecptr addr) { return do_get_mem_long ((uae_u32*)(fastmemory + FAST_OFFSET (addr))); }
+static uae_u32 REGPARAM2 fastmem_wget (uaecptr addr) { return do_get_mem_word ((uae_u16*)(fastmemory + FAST_OFFSET (addr))); }
+static uae_u32 REGPARAM2 fastmem_bget (uaecptr addr) { return fastmemory[FAST_OFFSET (addr)]; }
+static void REGPARAM2 fastmem_lput (uaecptr addr, uae_u32 l) { do_put_mem_long ((uae_u32*)(fastmemory + FAST_OFFSET (addr)), l); }
+static void REGPARAM2 fastmem_wput (uaecptr addr, uae_u32 w) { do_put_mem_word ((uae_u16*)(fastmemory + FAST_OFFSET (addr)), w); }
+static void REGPARAM2 fastmem_bput (uaecptr addr, uae_u32 b) { fastmemory[FAST_OFFSET (addr)] = b; }
+static int REGPARAM2 fastmem_check (uaecptr addr, uae_u32 size) { return FAST_OFFSET (addr) + size <= FASTSIZE; }
+static uae_u8 *REGPARAM2 fastmem_xlate (uaecptr addr) { return fastmemory + FAST_OFFSET (addr); }
+
+addrbank fastmem_bank = {
+	fastmem_lget, fastmem_wget, fastmem_bget,
+	fastmem_lput, fastmem_wput, fastmem_bput,
+	fastmem_xlate, fastmem_check, NULL, "Fast memory",
+	fastmem_lget, fastmem_wget, ABFLAG_RAM
+};
+
+/* what memory.c needs from the rest of the emulator */
+struct uae_prefs currprefs, changed_prefs;
+struct regstruct regs;
+int quit_program, savestate_state;
+signed long pissoff;
+bool cloanto_rom, kickstart_rom, uae_boot_rom;
+int uae_boot_rom_size;
+uae_u8 *rtarea;
+uaecptr rtarea_base;
+TCHAR start_path_data[MAX_DPATH];
+unsigned char arosrom[1];
+unsigned int arosrom_len;
+addrbank cia_bank, clock_bank, custom_bank, expamem_bank, rtarea_bank;
+void action_replay_cleanup (void) { }
+void action_replay_init (int enable) { }
+int action_replay_load (void) { return 0; }
+void action_replay_memory_reset (void) { }
+int hrtmon_load (void) { return 0; }
+int enforcer_disable (void) { return 0; }
+int debug_bankchange (int mode) { return 0; }
+void memory_map_dump (void) { }
+void mmu_flush_host_cache (void) { }
+void m68k_dumpstate (void *f, uaecptr *nextpc) { }
+uae_u32 wait_cpu_cycle_read (uaecptr addr, int mode) { return 0; }
+void expansion_clear (void) { }
+void free_fastmemory (void) { }
+uaecptr need_uae_boot_rom (void) { return 0; }
+void uae_reset (int hardreset) { }
+void uae_restart (int opengui, TCHAR *cfgfile) { }
+void gui_message (const char *format, ...) { }
+void addkeydir (const TCHAR *path) { }
+uae_u32 get_crc32 (uae_u8 *buf, int len) { return 0; }
+int decode_rom (uae_u8 *mem, int size, int mode, int real_size) { return 0; }
+int kickstart_checksum (uae_u8 *mem, int size) { return 0; }
+void kickstart_fix_checksum (uae_u8 *mem, int size) { }
+struct romdata *getromdatabydata (uae_u8 *rom, int size) { return NULL; }
+struct romdata *getromdatabypath (const TCHAR *path) { return NULL; }
+struct romdata *getromdatabyzfile (struct zfile *f) { return NULL; }
+struct zfile *read_rom_name (const TCHAR *filename) { return NULL; }
+struct zfile *read_rom_name_guess (const TCHAR *filename) { return NULL; }
+struct zfile *rom_fopen (const TCHAR *name, const TCHAR *mode, int mask) { return NULL; }
+int romlist_count (void) { return 0; }
+struct romlist *romlist_getit (void) { return NULL; }
+void restore_ram (size_t filepos, uae_u8 *memory) { }
+TCHAR *restore_string_func (uae_u8 **dstp) { return NULL; }
+uae_u32 restore_u32_func (uae_u8 **dstp) { return 0; }
+void save_string_func (uae_u8 **dstp, const TCHAR *from) { }
+void save_u32_func (uae_u8 **dstp, uae_u32 v) { }
+int zfile_exists (const TCHAR *name) { return 0; }
+void zfile_fclose (struct zfile *z) { }
+struct zfile *zfile_fopen_data (const TCHAR *name, uae_u64 size, uae_u8 *data) { return NULL; }
+size_t zfile_fread (void *b, size_t l1, size_t l2, struct zfile *z) { return 0; }
+uae_s64 zfile_fseek (struct zfile *z, uae_s64 offset, int mode) { return -1; }
+uae_s64 zfile_ftell (struct zfile *z) { return 0; }
+struct zfile *zfile_gunzip (struct zfile *z) { return z; }
+#ifdef JIT
+/* the test maps its RAM with xmalloc, the shm code is never reached */
+uae_u8 *natmem_offset, *natmem_offset_end;
+void mapped_free (uae_u8 *p) { xfree (p); }
+void flush_icache (uaecptr ptr, int n) { }
+void *my_shmat (int shmid, void *shmaddr, int shmflg) { return (void*)-1; }
+int my_shmdt (const void *shmaddr) { return -1; }
+int my_shmget (key_t key, size_t size, int shmflg, const char *name) { return -1; }
+int my_shmctl (int shmid, int cmd, struct shmid_ds *buf) { return -1; }
+#endif
+#ifdef CDTV
+void cdtv_loadcardmem (uae_u8 *p, int size) { }
+void cdtv_savecardmem (uae_u8 *p, int size) { }
+#endif
+#ifdef GAYLE
+addrbank gayle_bank, mbres_bank;
+void gayle_map_pcmcia (void) { }
+#endif
+#if defined GAYLE || defined CD32
+addrbank gayle2_bank;
+#endif
+#ifdef CD32
+addrbank akiko_bank;
+void cdtv_check_banks (void) { }
+void a3000scsi_reset (void) { }
+#endif
+
+static uae_u8 *ref_chip, *ref_bogo, *ref_fast;
+
+static void check (int cond, const char *what)
+{
+    printf ("%-56s %s\n", what, cond ? "ok" : "FAILED");
+    if (!cond)
+	failures++;
+}
+
+static uae_u32 rnd32 (void)
+{
+    return ((uae_u32)rand () << 16) ^ (uae_u32)rand ();
+}
+
+static void fill (uae_u8 *mem, int size)
+{
+    int i;
+
+    for (i = 0; i < size; i++)
+	mem[i] = rnd32 ();
+}
+
+static void setup (void)
+{
+    allocated_chipmem = chipmem_full_size = CHIPSIZE;
+    chipmem_mask = chipmem_full_mask = CHIPSIZE - 1;
+    allocated_bogomem = BOGOSIZE;
+    bogomem_mask = BOGOSIZE - 1;
+    allocated_fastmem = FASTSIZE;
+    chipmemory = chipmem_bank.baseaddr = xmalloc (uae_u8, CHIPSIZE);
+    bogomemory = bogomem_bank.baseaddr = xmalloc (uae_u8, BOGOSIZE);
+    fastmemory = fastmem_bank.baseaddr = xmalloc (uae_u8, FASTSIZE);
+    fill (chipmemory, CHIPSIZE);
+    fill (bogomemory, BOGOSIZE);
+    fill (fastmemory, FASTSIZE);
+    chipmem_setindirect ();
+    ref_chip = xmalloc (uae_u8, CHIPSIZE);
+    ref_bogo = xmalloc (uae_u8, BOGOSIZE);
+    ref_fast = xmalloc (uae_u8, FASTSIZE);
+}
+
+static void keep (void)
+{
+    memcpy (ref_chip, chipmemory, CHIPSIZE);
+    memcpy (ref_bogo, bogomemory, BOGOSIZE);
+    memcpy (ref_fast, fastmemory, FASTSIZE);
+}
+
+static int same (void)
+{
+    return !memcmp (ref_chip, chipmemory, CHIPSIZE) && !memcmp (ref_bogo, bogomemory, BOGOSIZE)
+	&& !memcmp (ref_fast, fastmemory, FASTSIZE);
+}
+
+/* CPU writes of all sizes to every bank, DMA to chip RAM */
+static void scribble (int writes)
+{
+    int i;
+
+    for (i = 0; i < writes; i++) {
+	uae_u32 v = rnd32 ();
+	switch (i % 6)
+	{
+	case 0:
+	    chipmem_bank.lput ((rnd32 () % CHIPSIZE) & ~3, v);
+	    break;
+	case 1:
+	    chipmem_bank.wput ((rnd32 () % CHIPSIZE) & ~1, v);
+	    chipmem_bank.bput (rnd32 () % CHIPSIZE, v);
+	    break;
+	case 2:
+	    bogomem_bank.lput (BOGOSTART + ((rnd32 () % BOGOSIZE) & ~3), v);
+	    bogomem_bank.wput (BOGOSTART + ((rnd32 () % BOGOSIZE) & ~1), v);
+	    bogomem_bank.bput (BOGOSTART + rnd32 () % BOGOSIZE, v);
+	    break;
+	case 3:
+	    fastmem_bank.lput (FASTSTART + ((rnd32 () % FASTSIZE) & ~3), v);
+	    fastmem_bank.wput (FASTSTART + ((rnd32 () % FASTSIZE) & ~1), v);
+	    fastmem_bank.bput (FASTSTART + rnd32 () % FASTSIZE, v);
+	    break;
+	case 4:
+	    chipmem_lput_indirect ((rnd32 () % CHIPSIZE) & ~3, v);
+	    break;
+	case 5:
+	    chipmem_wput_indirect ((rnd32 () % CHIPSIZE) & ~1, v);
+	    chipmem_bput_indirect (rnd32 () % CHIPSIZE, v);
+	    break;
+	}
+    }
+}
+
+/* DMA that writes chip RAM directly, a blit of rows bytes x 40 */
+static void blit (uaecptr addr, int rows)
+{
+    int x, y;
+
+    for (y = 0; y < rows; y++) {
+	uae_u8 v = rnd32 ();
+	for (x = 0; x < 40; x++)
+	    chipmemory[(addr + y * 80 + x) & chipmem_full_mask] = v;
+    }
+    memory_snapshot_chipblock (addr, 40, 80, rows);
+}
+
+static void test_roundtrip (void)
+{
+    mem_put_func chip_wput = chipmem_bank.wput, fast_lput = fastmem_bank.lput;
+    void (REGPARAM2 *indirect_wput)(uaecptr, uae_u32) = chipmem_wput_indirect;
+    int i, pages, ok;
+
+    check (memory_snapshot_start () && memory_snapshot_active (), "snapshot starts");
+    check (chipmem_bank.wput != chip_wput && fastmem_bank.lput != fast_lput
+	&& chipmem_wput_indirect != indirect_wput, "put functions are replaced");
+
+    ok = 1;
+    for (i = 0; i < ROUNDS; i++) {
+	/* the real frame: kept */
+	scribble (1 + rnd32 () % 500);
+	blit (rnd32 () % CHIPSIZE, 1 + rnd32 () % 200);
+	memory_snapshot_save ();
+	keep ();
+	/* frames ahead: thrown away */
+	scribble (1 + rnd32 () % 500);
+	blit (rnd32 () % CHIPSIZE, 1 + rnd32 () % 200);
+	pages = memory_snapshot_restore ();
+	if (!same () || pages < 1 || memory_snapshot_restore ())
+	    ok = 0;
+    }
+    check (ok, "restore brings back the saved chip, slow and fast RAM");
+
+    /* a long write across a page boundary marks both pages */
+    chipmem_bank.lput (SNAPSHOT_PAGE_SIZE * 3 - 2, 0x12345678);
+    pages = memory_snapshot_restore ();
+    check (pages == 2 && same (), "write across a page boundary");
+    chipmem_lput_indirect (SNAPSHOT_PAGE_SIZE * 5 - 2, 0x12345678);
+    pages = memory_snapshot_restore ();
+    check (pages == 2 && same (), "DMA write across a page boundary");
+
+    /* chip RAM written behind the put functions' back stays as it is,
+     * memory_snapshot_chipblock is what makes it restored */
+    chipmemory[1000] ^= 0xff;
+    check (memory_snapshot_restore () == 0 && chipmemory[1000] != ref_chip[1000], "unmarked write is not restored");
+    memory_snapshot_chipblock (1000, 1, 0, 1);
+    check (memory_snapshot_restore () == 1 && same (), "chipblock marks direct writes");
+
+    memory_snapshot_stop ();
+    check (!memory_snapshot_active () && chipmem_bank.wput == chip_wput && fastmem_bank.lput == fast_lput
+	&& chipmem_wput_indirect == indirect_wput, "stop puts the put functions back");
+    memory_snapshot_chipblock (0, 40, 80, 10);
+    check (memory_snapshot_save () == 0 && memory_snapshot_restore () == 0, "stopped snapshot does nothing");
+}
+
+static double now_ms (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static double puts_ms (int writes)
+{
+    double t = now_ms ();
+    int i;
+
+    for (i = 0; i < writes; i++) {
+	chipmem_bank.wput ((i * 2) & chipmem_mask, i);
+	chipmem_wput_indirect ((i * 6) & chipmem_mask, i);
+	fastmem_bank.lput (FASTSTART + ((i * 4) & (FASTSIZE - 1)), i);
+    }
+    return now_ms () - t;
+}
+
+/* a frame with writes spread over 80 chip and 8 fast pages, like in
+ * test_snapshot, and a 320x256 blit */
+static void frame (void)
+{
+    int i;
+
+    for (i = 0; i < 2000; i++) {
+	uae_u32 v = rnd32 ();
+	chipmem_bank.wput (((v % 80) << SNAPSHOT_PAGE_SHIFT) + (v & 0xffe), v);
+	fastmem_bank.lput (FASTSTART + ((v % 8) << SNAPSHOT_PAGE_SHIFT) + (v & 0xffc), v);
+    }
+    blit (0x10000, 256);
+}
+
+static void bench (void)
+{
+    double t, plain, tracked, save = 0, restore = 0, full = 0;
+    int i, writes = 1000000;
+
+    plain = puts_ms (writes);
+    memory_snapshot_start ();
+    tracked = puts_ms (writes);
+    printf ("1M CPU + DMA + fast writes: %.1f ms plain, %.1f ms tracked\n", plain, tracked);
+
+    for (i = 0; i < ROUNDS; i++) {
+	double f = now_ms ();
+	frame ();
+	t = now_ms ();
+	memory_snapshot_save ();
+	save += now_ms () - t;
+	frame ();
+	t = now_ms ();
+	memory_snapshot_restore ();
+	restore += now_ms () - t;
+	full += now_ms () - f;
+    }
+    printf ("2MB chip + 512KB slow + 8MB fast: %.3f ms/save, %.3f ms/restore, %.3f ms for both frames\n",
+	save / ROUNDS, restore / ROUNDS, full / ROUNDS);
+    memory_snapshot_stop ();
+}
+
+int main (int argc, char **argv)
+{
+    srand (1);
+    setup ();
+    test_roundtrip ();
+    if (failures) {
+	printf ("FAILED\n");
+	return 1;
+    }
+    printf ("all tests passed\n");
+    if (argc < 2 || strcmp (argv[1], "-q"))
+	bench ();
+    return 0;
+}
+
+#else
+
+int main (int argc, char **argv)
+{
+    printf ("memsnapshot: skipped, built without SAVESTATE\n");
+    return 0;
+}
+
+#endif
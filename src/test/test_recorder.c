@@ -0,0 +1,295 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Test for the video and audio recorder.
+  *
+  * Records a sequence of changing, repeated and unchanged frames plus
+  * sound with both writers and decodes the file again. A writer that
+  * stalls checks that the emulation side drops frames instead of
+  * waiting, that every frame not written is counted as dropped and
+  * that what did get written is still consistent. Also prints what a
+  * frame costs the emulation thread and the encoder.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef RECORDER
+
+#include "../recorder.c"
+
+#define W 360
+#define H 284
+#define FRAMES 40
+#define AUDIOBYTES 3528
+
+struct uae_prefs currprefs;
+double vblank_hz = 50.0;
+
+static uae_u32 src[FRAMES][W * H];
+static int shown[FRAMES];	/* stamp -> index of the frame on screen, -1 = none */
+static uae_s16 audio[FRAMES][AUDIOBYTES / 2];
+static int failures;
+static uae_sem_t stall_sem;
+
+void write_log (const char *format, ...)
+{
+}
+
+static uae_u32 rnd32 (void)
+{
+    return ((uae_u32)rand () << 16) ^ (uae_u32)rand ();
+}
+
+static void make_frames (void)
+{
+    int i, j;
+
+    for (j = 0; j < W * H; j++)
+	src[0][j] = (j % W) * 0x010203;
+    for (i = 1; i < FRAMES; i++) {
+	memcpy (src[i], src[i - 1], sizeof src[i]);
+	/* a moving block, like a sprite */
+	for (j = 0; j < 16 * W; j++)
+	    src[i][(i * 5) * W + j] = rnd32 () & 0xffffff;
+    }
+    for (i = 0; i < FRAMES; i++) {
+	for (j = 0; j < AUDIOBYTES / 2; j++)
+	    audio[i][j] = rnd32 ();
+    }
+}
+
+/* Every third vsync has no new frame (frame skip). With pace set each
+ * frame waits for the encoder, as if the emulation was running at 50Hz. */
+static void run (int pace)
+{
+    int i, last = -1;
+
+    for (i = 0; i < FRAMES; i++) {
+	if (i % 3 != 2) {
+	    recorder_frame ((uae_u8*)src[i], W * 4, W, H, 4);
+	    last = i;
+	}
+	recorder_vsync ();
+	shown[i] = last;
+	recorder_audio ((uae_u8*)audio[i], AUDIOBYTES);
+	while (pace && q_head != q_tail)
+	    usleep (50);
+    }
+}
+
+/* Decode the recording and compare. With drops allowed, missing frames
+ * and audio are fine but whatever is in the file has to be right. */
+static void verify (const char *file, int dropsok)
+{
+    struct recorder_header h;
+    struct recorder_packet p;
+    static uae_u8 frame[W * H * 4], data[W * H * 4 + 1024], packed[W * H * 4 + 1024];
+    int videos = 0, audios = 0, stamp = -1, haveframe = 0;
+    FILE *f = fopen (file, "rb");
+
+    if (!f || fread (&h, sizeof h, 1, f) != 1 || h.magic != RECORDER_MAGIC || h.fps_milli != 50000
+	|| h.audio_channels != 2 || h.audio_freq != 44100) {
+	printf ("%s: bad header\n", file);
+	failures++;
+	if (f)
+	    fclose (f);
+	return;
+    }
+    while (fread (&p, sizeof p, 1, f) == 1) {
+	uLongf len = p.rawsize;
+	const uae_u8 *d = packed;
+	if (p.size > sizeof packed || fread (packed, 1, p.size, f) != p.size) {
+	    printf ("%s: truncated\n", file);
+	    failures++;
+	    break;
+	}
+	if (p.flags & RECF_ZLIB) {
+	    if (uncompress (data, &len, packed, p.size) != Z_OK || len != p.rawsize) {
+		printf ("%s: bad zlib data\n", file);
+		failures++;
+		break;
+	    }
+	    d = data;
+	}
+	if (p.type == RECP_AUDIO) {
+	    int blk = p.stamp / (AUDIOBYTES / 4);
+	    if (p.stamp % (AUDIOBYTES / 4) || blk >= FRAMES || p.rawsize != AUDIOBYTES || memcmp (d, audio[blk], AUDIOBYTES)) {
+		printf ("%s: audio block at %u differs\n", file, p.stamp);
+		failures++;
+	    }
+	    audios++;
+	    continue;
+	}
+	if ((int)p.stamp <= stamp || p.stamp >= FRAMES || (!dropsok && (int)p.stamp != stamp + 1)) {
+	    printf ("%s: unexpected frame stamp %u after %d\n", file, p.stamp, stamp);
+	    failures++;
+	    break;
+	}
+	stamp = p.stamp;
+	videos++;
+	if (p.type == RECP_VIDEO) {
+	    int i;
+	    if (p.width != W || p.height != H || p.pixbytes != 4 || p.rawsize != sizeof frame
+		|| p.bits[0] != 8 || p.shift[0] != 16 || p.shift[2] != 0) {
+		printf ("%s: bad frame geometry\n", file);
+		failures++;
+		break;
+	    }
+	    if (p.flags & RECF_DELTA) {
+		if (!haveframe) {
+		    printf ("%s: delta without a key frame\n", file);
+		    failures++;
+		    break;
+		}
+		for (i = 0; i < (int)sizeof frame; i++)
+		    frame[i] ^= d[i];
+	    } else {
+		memcpy (frame, d, sizeof frame);
+	    }
+	    haveframe = 1;
+	    if (memcmp (frame, src[shown[stamp]], sizeof frame)) {
+		printf ("%s: frame %d differs\n", file, stamp);
+		failures++;
+	    }
+	} else if (p.type == RECP_REPEAT) {
+	    if (shown[stamp] == stamp) {
+		printf ("%s: frame %d was drawn but recorded as a repeat\n", file, stamp);
+		failures++;
+	    }
+	    /* even with drops, a repeat must show what was on screen */
+	    if (!haveframe || memcmp (frame, src[shown[stamp]], sizeof frame)) {
+		printf ("%s: repeat of frame %d is wrong\n", file, stamp);
+		failures++;
+	    }
+	}
+    }
+    fclose (f);
+    if (!dropsok && (videos != FRAMES || audios != FRAMES)) {
+	printf ("%s: %d frames and %d audio blocks, expected %d\n", file, videos, audios, FRAMES);
+	failures++;
+    }
+}
+
+static int stall_write (void *handle, struct recorder_packet *p, const uae_u8 *data, int len, const uae_u8 *prev)
+{
+    uae_sem_wait (&stall_sem);
+    uae_sem_post (&stall_sem);
+    return writers[1].write (handle, p, data, len, prev);
+}
+
+static const struct recorder_writer stall_writer = { "stall", zlib_open, stall_write, zlib_close };
+
+static double now_ms (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void bench (const char *file, int codec)
+{
+    double t0, t1, emu = 0, total;
+    int i;
+
+    currprefs.record_codec = codec;
+    _tcscpy (currprefs.record_file, file);
+    recorder_setup ();
+    t0 = now_ms ();
+    for (i = 0; i < FRAMES; i++) {
+	t1 = now_ms ();
+	recorder_frame ((uae_u8*)src[i], W * 4, W, H, 4);
+	recorder_vsync ();
+	emu += now_ms () - t1;
+	while (q_head != q_tail)
+	    usleep (50);
+    }
+    total = now_ms () - t0;
+    recorder_stop ();
+    printf ("%-5s %dx%d: %.3f ms/frame to encode, %.3f ms/frame on the emulation thread, %u bytes/frame\n",
+	writers[codec].name, W, H, total / FRAMES, emu / FRAMES, (unsigned int)(stats.bytes_out / FRAMES));
+    currprefs.record_file[0] = 0;
+}
+
+int main (int argc, char **argv)
+{
+    char file[64];
+    int codec;
+
+    sprintf (file, "/tmp/test_recorder.%d", (int)getpid ());
+    currprefs.sound_freq = 44100;
+    currprefs.sound_stereo = SND_STEREO;
+    recorder_setformat (8, 8, 8, 16, 8, 0);
+    srand (1);
+    make_frames ();
+
+    for (codec = 0; codec < 2; codec++) {
+	currprefs.record_codec = codec;
+	_tcscpy (currprefs.record_file, file);
+	recorder_setup ();
+	if (!recorder_active) {
+	    printf ("recorder: can't create %s\n", file);
+	    return 1;
+	}
+	run (1);
+	recorder_stop ();
+	if (stats.frames != FRAMES || stats.frames_dropped || stats.audio_dropped) {
+	    printf ("%s: %u frames, %u dropped\n", writers[codec].name, stats.frames, stats.frames_dropped);
+	    failures++;
+	}
+	verify (file, 0);
+    }
+
+    /* the encoder stalls on its first packet: nothing may block */
+    uae_sem_init (&stall_sem, 0, 0);
+    currprefs.record_codec = 1;
+    recorder_setup ();
+    writer = &stall_writer;
+    run (0);
+    if (!stats.frames_dropped || !stats.audio_dropped || stats.queue_max > REC_QUEUE) {
+	printf ("stalled writer: %u frames dropped, %u audio dropped, queue max %d\n",
+	    stats.frames_dropped, stats.audio_dropped, stats.queue_max);
+	failures++;
+    }
+    /* each vsync is either in the file or counted as dropped, and a
+     * frame that was drawn is never recorded as a repeat */
+    if (stats.frames + stats.frames_dropped != FRAMES || stats.audio_blocks + stats.audio_dropped != FRAMES
+	|| stats.repeats > FRAMES / 3) {
+	printf ("stalled writer: %u frames (%u repeats) + %u dropped, %u audio blocks + %u dropped, expected %d\n",
+	    stats.frames, stats.repeats, stats.frames_dropped, stats.audio_blocks, stats.audio_dropped, FRAMES);
+	failures++;
+    }
+    uae_sem_post (&stall_sem);
+    recorder_stop ();
+    verify (file, 1);
+    uae_sem_destroy (&stall_sem);
+
+    if (failures) {
+	unlink (file);
+	printf ("recorder: %d failures\n", failures);
+	return 1;
+    }
+    printf ("recorder: recordings decode correctly\n");
+    if (argc < 2 || strcmp (argv[1], "-q")) {
+	bench (file, 0);
+	bench (file, 1);
+    }
+    unlink (file);
+    return 0;
+}
+
+#else
+
+int main (int argc, char **argv)
+{
+    printf ("recorder: skipped, built without RECORDER\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,214 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Test for the ROM directory scanner and its index.
+  *
+  * Two entries of the ROM database get the SHA1s of generated files, so
+  * scans can find them. Checks that a rescan takes unchanged files from
+  * the index (they are found even when the database no longer matches
+  * their contents), that a changed mtime or size makes a file be hashed
+  * again and that an index written for another ROM database is ignored.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include "../rommgr.c"
+
+#define ROMSIZE 65536
+
+static TCHAR dir[MAX_DPATH], index_file[MAX_DPATH], file_a[MAX_DPATH], file_b[MAX_DPATH], file_junk[MAX_DPATH];
+static int scan_files, scan_unchanged, scan_roms_found;
+static int failures;
+
+/* the summary line of the scan tells how many files were hashed */
+void write_log (const char *format, ...)
+{
+    va_list ap;
+    va_start (ap, format);
+    if (!strncmp (format, "ROM scan: %d files", 18)) {
+	scan_files = va_arg (ap, int);
+	scan_unchanged = va_arg (ap, int);
+	scan_roms_found = va_arg (ap, int);
+    }
+    va_end (ap);
+}
+
+TCHAR start_path_data[MAX_DPATH];
+bool cloanto_rom;
+const TCHAR *uae_archive_extensions[] = { NULL };
+void gui_message (const char *format, ...) { }
+void descramble_nordicpro (uae_u8 *buf, int size, int odd) { }
+struct zfile *zfile_fopen (const TCHAR *name, const TCHAR *mode, int mask) { return NULL; }
+struct zfile *zfile_fopen_empty (struct zfile *z, const TCHAR *name, uae_u64 size) { return NULL; }
+int zfile_exists (const TCHAR *name) { return 0; }
+void zfile_fclose (struct zfile *z) { }
+uae_s64 zfile_fseek (struct zfile *z, uae_s64 offset, int mode) { return -1; }
+uae_s64 zfile_ftell (struct zfile *z) { return 0; }
+uae_s64 zfile_size (struct zfile *z) { return 0; }
+size_t zfile_fread (void *b, size_t l1, size_t l2, struct zfile *z) { return 0; }
+size_t zfile_fwrite (void *b, size_t l1, size_t l2, struct zfile *z) { return 0; }
+
+static void check (int cond, const char *what)
+{
+    printf ("%-56s %s\n", what, cond ? "ok" : "FAILED");
+    if (!cond)
+	failures++;
+}
+
+static void write_file (const TCHAR *name, const uae_u8 *data, int size)
+{
+    FILE *f = fopen (name, "wb");
+    if (!f || fwrite (data, 1, size, f) != (size_t)size) {
+	printf ("can't write %s\n", name);
+	exit (1);
+    }
+    fclose (f);
+}
+
+static void set_mtime (const TCHAR *name, time_t t)
+{
+    struct utimbuf ut;
+    ut.actime = ut.modtime = t;
+    utime (name, &ut);
+}
+
+/* make rd identify data */
+static void set_sha1 (struct romdata *rd, uae_u8 *data, int size)
+{
+    uae_u8 sha1[SHA1_SIZE];
+    int i;
+
+    get_sha1 (data, size, sha1);
+    for (i = 0; i < 5; i++)
+	rd->sha1[i] = (sha1[i * 4] << 24) | (sha1[i * 4 + 1] << 16) | (sha1[i * 4 + 2] << 8) | sha1[i * 4 + 3];
+}
+
+/* two plain ROMs that stand on their own */
+static struct romdata *pick_rom (struct romdata *not)
+{
+    int i;
+
+    for (i = 0; roms[i].name; i++) {
+	struct romdata *rd = &roms[i];
+	if (rd != not && rd->group == 0 && !notcrc32 (rd->crc32) && rd->size >= ROMSIZE
+	    && !(rd->type & ROMTYPE_KEY) && (!not || rd->id != not->id))
+	    return rd;
+    }
+    return NULL;
+}
+
+static const TCHAR *found (struct romdata *rd)
+{
+    TCHAR *path = romlist_get (rd);
+    return path ? path : "";
+}
+
+static int scan (void)
+{
+    const TCHAR *paths[1] = { dir };
+    scan_files = scan_unchanged = scan_roms_found = -1;
+    return romscan_paths (paths, 1, index_file);
+}
+
+int main (int argc, char **argv)
+{
+    static uae_u8 data_a[ROMSIZE], data_b[ROMSIZE + 1], junk[ROMSIZE / 2];
+    struct romdata *rd_a, *rd_b;
+    uae_u32 sha1_a[5];
+    time_t now = time (NULL);
+    TCHAR sub[MAX_DPATH];
+    FILE *f;
+    int i;
+
+    for (i = 0; i < ROMSIZE; i++) {
+	data_a[i] = rand ();
+	data_b[i] = rand ();
+    }
+    data_b[ROMSIZE] = 0x55;
+    for (i = 0; i < ROMSIZE / 2; i++)
+	junk[i] = rand ();
+
+    sprintf (dir, "/tmp/test_romscan.%d", (int)getpid ());
+    sprintf (sub, "%s/sub", dir);
+    sprintf (index_file, "%s.index", dir);
+    sprintf (file_a, "%s/a.rom", dir);
+    sprintf (file_b, "%s/b.rom", sub);
+    sprintf (file_junk, "%s/junk.bin", dir);
+    if (mkdir (dir, 0700) || mkdir (sub, 0700)) {
+	printf ("can't create %s\n", dir);
+	return 1;
+    }
+    write_file (file_a, data_a, ROMSIZE);
+    write_file (file_b, data_b, ROMSIZE);
+    write_file (file_junk, junk, sizeof junk);
+    set_mtime (file_a, now - 100);
+    set_mtime (file_b, now - 100);
+    set_mtime (file_junk, now - 100);
+
+    rd_a = pick_rom (NULL);
+    rd_b = pick_rom (rd_a);
+    if (!rd_a || !rd_b) {
+	printf ("no ROM entries to use\n");
+	return 1;
+    }
+    set_sha1 (rd_a, data_a, ROMSIZE);
+    set_sha1 (rd_b, data_b, ROMSIZE);
+    memcpy (sha1_a, rd_a->sha1, sizeof sha1_a);
+
+    scan ();
+    check (scan_files == 3 && scan_unchanged == 0 && scan_roms_found == 2, "first scan hashes everything");
+    check (!_tcscmp (found (rd_a), file_a) && !_tcscmp (found (rd_b), file_b), "ROMs are found, also in subdirectories");
+
+    /* the database no longer knows a.rom: only a rehash would notice */
+    rd_a->sha1[0] ^= 1;
+    scan ();
+    check (scan_files == 3 && scan_unchanged == 3 && scan_roms_found == 2, "rescan takes every file from the index");
+    check (!_tcscmp (found (rd_a), file_a), "cached entry is not hashed again");
+
+    set_mtime (file_a, now - 50);
+    scan ();
+    check (scan_unchanged == 2 && scan_roms_found == 1 && !romlist_get (rd_a), "changed mtime makes the file be hashed again");
+
+    /* unknown files are cached as such, a.rom stays unknown */
+    memcpy (rd_a->sha1, sha1_a, sizeof sha1_a);
+    scan ();
+    check (scan_unchanged == 3 && !romlist_get (rd_a), "files that are no ROM are cached too");
+
+    /* same mtime, one byte more */
+    write_file (file_b, data_b, ROMSIZE + 1);
+    set_mtime (file_b, now - 100);
+    set_sha1 (rd_b, data_b, ROMSIZE + 1);
+    scan ();
+    check (scan_unchanged == 2 && !_tcscmp (found (rd_b), file_b), "changed size makes the file be hashed again");
+
+    /* an index from another ROM database */
+    f = fopen (index_file, "r+");
+    if (f) {
+	fprintf (f, "romindex %d %d\n", ROMSCAN_INDEXVERSION, NEXT_ROM_ID - 1);
+	fclose (f);
+    }
+    scan ();
+    check (scan_files == 3 && scan_unchanged == 0 && scan_roms_found == 2, "index of another ROM database is dropped");
+    check (!_tcscmp (found (rd_a), file_a) && !_tcscmp (found (rd_b), file_b), "rehash finds both ROMs again");
+
+    /* no index at all */
+    unlink (index_file);
+    scan ();
+    check (scan_files == 3 && scan_unchanged == 0, "missing index means a full scan");
+
+    unlink (file_a);
+    unlink (file_b);
+    unlink (file_junk);
+    unlink (index_file);
+    rmdir (sub);
+    rmdir (dir);
+    printf ("%s\n", failures ? "FAILED" : "all tests passed");
+    return failures ? 1 : 0;
+}
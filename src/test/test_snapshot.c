@@ -0,0 +1,188 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Test for the page tracked RAM snapshots used by run-ahead.
+  *
+  * Writes random bytes over a block of memory, marking the pages like
+  * the memory put functions do, and checks that a restore brings back
+  * exactly what was saved, including a partial last page. Also prints
+  * what a save and restore cost for 2MB chip plus 8MB fast RAM with a
+  * typical number of pages written per frame and with all of them.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+
+#ifdef SAVESTATE
+
+#include "../snapshot.c"
+
+#define ROUNDS 50
+
+static int failures;
+
+void write_log (const char *format, ...)
+{
+}
+
+static uae_u32 rnd32 (void)
+{
+    return ((uae_u32)rand () << 16) ^ (uae_u32)rand ();
+}
+
+static void scribble (struct snapshot_ram *r, uae_u8 *mem, int writes)
+{
+    int i;
+
+    for (i = 0; i < writes; i++) {
+	uae_u32 offset = rnd32 () % r->size;
+	mem[offset] = rnd32 ();
+	snapshot_ram_mark (r, offset);
+    }
+}
+
+/* An odd size so that the last page is only partly used. */
+static void check (uae_u32 size)
+{
+    struct snapshot_ram r;
+    uae_u8 *mem = xmalloc (uae_u8, size);
+    uae_u8 *ref = xmalloc (uae_u8, size);
+    int i;
+
+    for (i = 0; i < (int)size; i++)
+	mem[i] = rnd32 ();
+    if (!snapshot_ram_init (&r, mem, size)) {
+	printf ("snapshot: init failed\n");
+	failures++;
+	return;
+    }
+    if (snapshot_ram_restore (&r) || memcmp (mem, r.copy, size)) {
+	printf ("snapshot: fresh snapshot differs or has dirty pages\n");
+	failures++;
+    }
+    /* marks beyond the end are ignored */
+    snapshot_ram_mark (&r, size);
+    snapshot_ram_mark (&r, 0xffffffff);
+
+    for (i = 0; i < ROUNDS; i++) {
+	int pages;
+	scribble (&r, mem, 1 + rnd32 () % 200);
+	if (i & 1) {
+	    /* frame 0: keep it */
+	    snapshot_ram_save (&r);
+	    if (memcmp (mem, r.copy, size)) {
+		printf ("snapshot: round %d: save differs\n", i);
+		failures++;
+	    }
+	    continue;
+	}
+	/* ahead frames: thrown away */
+	memcpy (ref, r.copy, size);
+	scribble (&r, mem, 1 + rnd32 () % 200);
+	scribble (&r, mem, 1);
+	mem[size - 1] ^= 0xff;
+	snapshot_ram_mark (&r, size - 1);
+	pages = snapshot_ram_restore (&r);
+	if (memcmp (mem, ref, size)) {
+	    printf ("snapshot: round %d: restore differs\n", i);
+	    failures++;
+	}
+	if (pages < 1 || pages > (int)r.pages) {
+	    printf ("snapshot: round %d: %d pages restored\n", i, pages);
+	    failures++;
+	}
+	if (snapshot_ram_restore (&r)) {
+	    printf ("snapshot: round %d: pages still dirty after restore\n", i);
+	    failures++;
+	}
+    }
+    snapshot_ram_free (&r);
+    xfree (mem);
+    xfree (ref);
+}
+
+static double now_ms (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void mark_pages (struct snapshot_ram *r, int pages)
+{
+    int i;
+
+    if (pages >= (int)r->pages) {
+	memset (r->dirty, 1, r->pages);
+	return;
+    }
+    for (i = 0; i < pages; i++)
+	snapshot_ram_mark (r, (rnd32 () % r->pages) << SNAPSHOT_PAGE_SHIFT);
+}
+
+/* chip gets most of the writes, as with a game drawing into bitplanes */
+static void bench (struct snapshot_ram *chip, struct snapshot_ram *fast, int chippages, int fastpages, const char *what)
+{
+    double t, save = 0, restore = 0;
+    int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+	mark_pages (chip, chippages);
+	mark_pages (fast, fastpages);
+	t = now_ms ();
+	snapshot_ram_save (chip);
+	snapshot_ram_save (fast);
+	save += now_ms () - t;
+	mark_pages (chip, chippages);
+	mark_pages (fast, fastpages);
+	t = now_ms ();
+	snapshot_ram_restore (chip);
+	snapshot_ram_restore (fast);
+	restore += now_ms () - t;
+    }
+    printf ("2MB chip + 8MB fast, %s: %.3f ms/save, %.3f ms/restore\n", what, save / ROUNDS, restore / ROUNDS);
+}
+
+int main (int argc, char **argv)
+{
+    srand (1);
+    check (3 * SNAPSHOT_PAGE_SIZE + 123);
+    check (64 * SNAPSHOT_PAGE_SIZE);
+    check (1000 * SNAPSHOT_PAGE_SIZE + 1);
+
+    if (failures) {
+	printf ("snapshot: %d failures\n", failures);
+	return 1;
+    }
+    printf ("snapshot: restores match the saved memory\n");
+    if (argc < 2 || strcmp (argv[1], "-q")) {
+	struct snapshot_ram chip, fast;
+	uae_u8 *chipmem = xcalloc (uae_u8, 2 * 1024 * 1024);
+	uae_u8 *fastmem = xcalloc (uae_u8, 8 * 1024 * 1024);
+	snapshot_ram_init (&chip, chipmem, 2 * 1024 * 1024);
+	snapshot_ram_init (&fast, fastmem, 8 * 1024 * 1024);
+	bench (&chip, &fast, 0, 0, "nothing written");
+	bench (&chip, &fast, 80, 8, "~350KB written");
+	bench (&chip, &fast, chip.pages, fast.pages, "everything written");
+	snapshot_ram_free (&chip);
+	snapshot_ram_free (&fast);
+	xfree (chipmem);
+	xfree (fastmem);
+    }
+    return 0;
+}
+
+#else
+
+int main (int argc, char **argv)
+{
+    printf ("snapshot: skipped, built without SAVESTATE\n");
+    return 0;
+}
+
+#endif
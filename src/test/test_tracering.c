@@ -0,0 +1,259 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Test for the CPU execution trace ring.
+  *
+  * A small interpreter stands in for the CPU loop and records each
+  * instruction like count_instr in newcpu.c does. Checks that the trace
+  * file holds every instruction in order with the register changes, and
+  * that with a writer that can't keep up no record goes missing without
+  * a drop record counting it. Then times the interpreter with tracing
+  * off and on to show what the trace costs per instruction.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../tracering.c"
+
+#define MEMSIZE 65536
+#define BENCH_INSNS 20000000
+
+struct uae_prefs currprefs;
+struct regstruct regs;
+
+static uae_u8 mem[MEMSIZE];
+static uae_u32 pc;
+static uae_u64 cycles;
+static int failures;
+
+void write_log (const char *format, ...)
+{
+}
+
+void sleep_millis (int ms)
+{
+    usleep (ms * 1000);
+}
+
+static void check (int cond, const char *what)
+{
+    printf ("%-56s %s\n", what, cond ? "ok" : "FAILED");
+    if (!cond)
+	failures++;
+}
+
+/* memory goes through function pointers like x_get_word */
+static uae_u32 mem_wget (uaecptr a) { return (mem[a & (MEMSIZE - 1)] << 8) | mem[(a + 1) & (MEMSIZE - 1)]; }
+static void mem_wput (uaecptr a, uae_u32 v) { mem[a & (MEMSIZE - 1)] = v >> 8; mem[(a + 1) & (MEMSIZE - 1)] = v; }
+static uae_u32 (*fetch)(uaecptr) = mem_wget;
+static void (*store)(uaecptr, uae_u32) = mem_wput;
+
+/* a handful of register and memory operations, opcode bits 12-14
+ * select the operation, bits 9-11 and 0-2 the registers */
+static unsigned long op_move (uae_u32 op) { regs.regs[(op >> 9) & 7] = regs.regs[op & 7]; return 4; }
+static unsigned long op_add (uae_u32 op) { regs.regs[(op >> 9) & 7] += regs.regs[op & 7]; return 4; }
+static unsigned long op_eor (uae_u32 op) { regs.regs[(op >> 9) & 7] ^= op; return 4; }
+static unsigned long op_lsl (uae_u32 op) { regs.regs[op & 7] <<= 1; return 6; }
+static unsigned long op_load (uae_u32 op) { regs.regs[(op >> 9) & 7] = fetch (regs.regs[8 + (op & 7)]); return 8; }
+static unsigned long op_store (uae_u32 op) { store (regs.regs[8 + (op & 7)], regs.regs[(op >> 9) & 7]); return 8; }
+static unsigned long op_lea (uae_u32 op) { regs.regs[8 + (op & 7)] += op & 0x1fe; return 4; }
+static unsigned long op_nop (uae_u32 op) { return 4; }
+
+static unsigned long (*const ops[8])(uae_u32) = {
+    op_move, op_add, op_eor, op_lsl, op_load, op_store, op_lea, op_nop
+};
+
+static void run (int insns)
+{
+    while (insns-- > 0) {
+	uae_u32 opcode = fetch (pc);
+	if (tracering_active) {
+	    if (tracering_regmask)
+		tracering_regdelta ();
+	    tracering_add (TR_INSN, 0, opcode, pc, (uae_u32)(cycles >> 32), (uae_u32)cycles);
+	}
+	cycles += ops[(opcode >> 12) & 7] (opcode);
+	pc = (pc + 2) & (MEMSIZE - 1);
+    }
+}
+
+static void reset (void)
+{
+    int i;
+
+    srand (1);
+    for (i = 0; i < MEMSIZE; i++)
+	mem[i] = rand ();
+    memset (&regs, 0, sizeof regs);
+    pc = 0;
+    cycles = 0;
+}
+
+static void start (const char *file, uae_u32 regmask)
+{
+    _tcscpy (currprefs.cpu_trace_file, file);
+    currprefs.cpu_trace_registers = regmask;
+    tracering_setup ();
+}
+
+/* run the same program untraced and compare what the trace says */
+static void test_trace (const char *file)
+{
+    struct tracering_header h;
+    struct tracering_rec r;
+    uae_u32 shadow[16], before[16];
+    int insns = 0, regchanges = 0, expect_regchanges = 0, order = 1, regsok = 1;
+    uae_u32 *pcs = xmalloc (uae_u32, 100000);
+    uae_u16 *opcodes = xmalloc (uae_u16, 100000);
+    gzFile f;
+    int i, j;
+
+    reset ();
+    for (i = 0; i < 100000; i++) {
+	memcpy (before, regs.regs, sizeof before);
+	pcs[i] = pc;
+	opcodes[i] = fetch (pc);
+	run (1);
+	for (j = 0; j < 4; j++)
+	    expect_regchanges += i + 1 < 100000 && before[j] != regs.regs[j];
+    }
+
+    reset ();
+    start (file, 0x000f);
+    run (100000);
+    currprefs.cpu_trace_file[0] = 0;
+    tracering_setup ();
+
+    f = gzopen (file, "rb");
+    check (f && gzread (f, &h, sizeof h) == sizeof h && h.magic == TRACERING_MAGIC
+	&& h.recsize == sizeof r && h.regmask == 0x000f, "trace file has a header");
+    for (j = 0; j < 16; j++)
+	shadow[j] = 0;
+    while (f && gzread (f, &r, sizeof r) == sizeof r) {
+	if (r.type == TR_INSN) {
+	    if (insns >= 100000 || r.pc != pcs[insns] || r.opcode != opcodes[insns])
+		order = 0;
+	    insns++;
+	} else if (r.type == TR_REG) {
+	    if (r.size > 3)
+		regsok = 0;
+	    else
+		shadow[r.size] = r.value;
+	    /* the first instruction reports all four */
+	    if (insns > 0)
+		regchanges++;
+	} else {
+	    order = 0;
+	}
+    }
+    if (f)
+	gzclose (f);
+    /* what the last instruction changed is never reported */
+    for (j = 0; j < 4; j++) {
+	if (shadow[j] != before[j])
+	    regsok = 0;
+    }
+    check (insns == 100000 && order, "every instruction recorded in order");
+    check (regsok && regchanges == expect_regchanges, "register changes recorded");
+    xfree (pcs);
+    xfree (opcodes);
+    unlink (file);
+}
+
+/* many more records than the ring holds: whatever the writer can't take
+ * must show up in drop records */
+static void test_drops (const char *file)
+{
+    struct tracering_rec r;
+    struct tracering_header h;
+    uae_u64 insns = 0, dropped = 0;
+    int total = TRACE_BLOCKS * TRACE_BLOCKRECS * 8;
+    gzFile f;
+
+    reset ();
+    start (file, 0);
+    run (total);
+    currprefs.cpu_trace_file[0] = 0;
+    tracering_setup ();
+
+    f = gzopen (file, "rb");
+    if (f && gzread (f, &h, sizeof h) == sizeof h) {
+	while (gzread (f, &r, sizeof r) == sizeof r) {
+	    if (r.type == TR_INSN)
+		insns++;
+	    else if (r.type == TR_DROP)
+		dropped += r.value;
+	}
+    }
+    if (f)
+	gzclose (f);
+    check (insns + dropped == (uae_u64)total, "records written plus dropped add up");
+    unlink (file);
+}
+
+static double now_ms (clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime (clock, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* wall time, and the time of this thread alone: on a single core the
+ * writer's compression shows up in the wall time of the CPU loop */
+static void timed_run (uae_u32 regmask, const char *file, double *wall, double *cpu)
+{
+    reset ();
+    if (file)
+	start (file, regmask);
+    *wall = now_ms (CLOCK_MONOTONIC);
+    *cpu = now_ms (CLOCK_THREAD_CPUTIME_ID);
+    run (BENCH_INSNS);
+    *cpu = now_ms (CLOCK_THREAD_CPUTIME_ID) - *cpu;
+    *wall = now_ms (CLOCK_MONOTONIC) - *wall;
+    if (file) {
+	currprefs.cpu_trace_file[0] = 0;
+	tracering_setup ();
+	unlink (file);
+    }
+}
+
+static void bench (const char *file)
+{
+    double wall[3], cpu[3];
+    const char *what[3] = { "untraced", "traced", "traced, all registers" };
+    int i;
+
+    timed_run (0, NULL, &wall[0], &cpu[0]);
+    timed_run (0, file, &wall[1], &cpu[1]);
+    timed_run (0xffff, file, &wall[2], &cpu[2]);
+    for (i = 0; i < 3; i++) {
+	printf ("%dM instructions %-22s %6.1f ms, CPU thread %6.1f ms", BENCH_INSNS / 1000000, what[i], wall[i], cpu[i]);
+	if (i)
+	    printf (" (%+.0f%%, %+.1f ns/insn)", (cpu[i] - cpu[0]) * 100 / cpu[0], (cpu[i] - cpu[0]) * 1000000.0 / BENCH_INSNS);
+	printf ("\n");
+    }
+}
+
+int main (int argc, char **argv)
+{
+    TCHAR file[MAX_DPATH];
+
+    sprintf (file, "/tmp/test_tracering.%d.gz", (int)getpid ());
+    test_trace (file);
+    test_drops (file);
+    if (failures) {
+	printf ("FAILED\n");
+	return 1;
+    }
+    printf ("all tests passed\n");
+    if (argc < 2 || strcmp (argv[1], "-q"))
+	bench (file);
+    return 0;
+}
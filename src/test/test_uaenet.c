@@ -0,0 +1,215 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * Loopback test for the Linux uaenet backend.
+  *
+  * Packets are queued in an A2065 style transmit descriptor ring, picked
+  * up by the backend thread, sent through an AF_UNIX socket pair to an
+  * echo thread and delivered back into a receive descriptor ring. Reports
+  * packets per second.
+  */
+
+#include "sysconfig.h"
+
+#ifndef __linux__
+
+#include <stdio.h>
+
+int main (int argc, char **argv)
+{
+    printf ("uaenet loopback test needs Linux, skipped.\n");
+    return 0;
+}
+
+#else
+
+#define A2065
+#include "../uaenet.c"
+
+#include <time.h>
+
+#define RING_SIZE 32
+#define PACKET_SIZE 1514
+#define RUN_SECONDS 2
+
+#define DESC_OWN 0x8000 /* owned by the chip */
+
+struct desc
+{
+    volatile uae_u16 flags;
+    int len;
+    uae_u8 data[PACKET_SIZE];
+};
+
+static struct desc txring[RING_SIZE], rxring[RING_SIZE];
+static int tx_chip, tx_host, rx_chip, rx_host;
+static uae_u32 tx_seq, rx_seq;
+static int missed, corrupt;
+static uae_sem_t ring_sem;
+static volatile int echo_quit;
+
+void write_log (const char *format, ...)
+{
+    va_list ap;
+    va_start (ap, format);
+    vprintf (format, ap);
+    va_end (ap);
+}
+
+/* transmit side of the "chip": next descriptor handed over by the host */
+static int getfunc (struct s2devstruct *dev, uae_u8 *d, int *len)
+{
+    struct desc *ds;
+    int ret = 0;
+
+    uae_sem_wait (&ring_sem);
+    ds = &txring[tx_chip];
+    if ((ds->flags & DESC_OWN) && ds->len <= *len) {
+	memcpy (d, ds->data, ds->len);
+	*len = ds->len;
+	ds->flags &= ~DESC_OWN;
+	tx_chip = (tx_chip + 1) % RING_SIZE;
+	ret = 1;
+    }
+    uae_sem_post (&ring_sem);
+    return ret;
+}
+
+/* receive side of the "chip": fill the next free receive descriptor */
+static void gotfunc (struct s2devstruct *dev, const uae_u8 *d, int len)
+{
+    struct desc *ds;
+
+    uae_sem_wait (&ring_sem);
+    ds = &rxring[rx_chip];
+    if (!(ds->flags & DESC_OWN)) {
+	missed++;
+    } else {
+	memcpy (ds->data, d, len);
+	ds->len = len;
+	ds->flags &= ~DESC_OWN;
+	rx_chip = (rx_chip + 1) % RING_SIZE;
+    }
+    uae_sem_post (&ring_sem);
+}
+
+static void *echo_thread (void *arg)
+{
+    int fd = *(int*)arg;
+    struct mmsghdr msgs[UAENET_BATCH];
+    struct iovec iov[UAENET_BATCH];
+    static uae_u8 buf[UAENET_BATCH][PACKET_SIZE];
+    int i, n;
+
+    while (!echo_quit) {
+	memset (msgs, 0, sizeof msgs);
+	for (i = 0; i < UAENET_BATCH; i++) {
+	    iov[i].iov_base = buf[i];
+	    iov[i].iov_len = PACKET_SIZE;
+	    msgs[i].msg_hdr.msg_iov = &iov[i];
+	    msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	n = recvmmsg (fd, msgs, UAENET_BATCH, MSG_WAITFORONE, NULL);
+	if (n <= 0)
+	    break;
+	for (i = 0; i < n; i++)
+	    iov[i].iov_len = msgs[i].msg_len;
+	sendmmsg (fd, msgs, n, 0);
+    }
+    return NULL;
+}
+
+static void fill_packet (struct desc *ds, uae_u32 seq)
+{
+    int i;
+
+    memset (ds->data, 0xff, 6);
+    memcpy (ds->data + 6, "\x02\x00\x00\x00\x00\x01", 6);
+    ds->data[12] = 0x88;
+    ds->data[13] = 0xb5;
+    ds->len = 60 + seq % (PACKET_SIZE - 60);
+    for (i = 14; i < ds->len; i++)
+	ds->data[i] = (uae_u8)(seq + i);
+    memcpy (ds->data + 14, &seq, 4);
+}
+
+static int check_packet (struct desc *ds, uae_u32 seq)
+{
+    uae_u32 got;
+    int i;
+
+    memcpy (&got, ds->data + 14, 4);
+    if (got != seq || ds->len != (int)(60 + seq % (PACKET_SIZE - 60)))
+	return 0;
+    for (i = 18; i < ds->len; i++) {
+	if (ds->data[i] != (uae_u8)(seq + i))
+	    return 0;
+    }
+    return 1;
+}
+
+int main (int argc, char **argv)
+{
+    struct uaenetdatalinux sd;
+    uae_thread_id tid;
+    int sv[2];
+    time_t end;
+    int i;
+
+    if (socketpair (AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+	perror ("socketpair");
+	return 1;
+    }
+    fcntl (sv[0], F_SETFL, O_NONBLOCK);
+    uae_sem_init (&ring_sem, 0, 1);
+    for (i = 0; i < RING_SIZE; i++)
+	rxring[i].flags = DESC_OWN;
+
+    uaeser_initdata (&sd, NULL);
+    if (!uaenet_start (&sd, sv[0], 1, PACKET_SIZE, NULL, gotfunc, getfunc)) {
+	printf ("Failed to start backend\n");
+	return 1;
+    }
+    uae_start_thread ("echo", echo_thread, &sv[1], &tid);
+
+    end = time (NULL) + RUN_SECONDS;
+    while (time (NULL) < end) {
+	int queued = 0;
+	uae_sem_wait (&ring_sem);
+	/* host side: refill transmit ring, recycle received buffers */
+	while (!(txring[tx_host].flags & DESC_OWN) && tx_seq - rx_seq < RING_SIZE) {
+	    fill_packet (&txring[tx_host], tx_seq++);
+	    txring[tx_host].flags |= DESC_OWN;
+	    tx_host = (tx_host + 1) % RING_SIZE;
+	    queued++;
+	}
+	while (!(rxring[rx_host].flags & DESC_OWN)) {
+	    if (!check_packet (&rxring[rx_host], rx_seq))
+		corrupt++;
+	    rx_seq++;
+	    rxring[rx_host].flags |= DESC_OWN;
+	    rx_host = (rx_host + 1) % RING_SIZE;
+	}
+	uae_sem_post (&ring_sem);
+	if (queued)
+	    uaenet_trigger (&sd);
+	else
+	    sched_yield ();
+    }
+
+    uaenet_close (&sd);
+    echo_quit = 1;
+    shutdown (sv[1], SHUT_RDWR);
+    uae_wait_thread (tid);
+    close (sv[1]);
+
+    printf ("%u packets looped in %d seconds, %u packets/s, %d missed, %d corrupt\n",
+	rx_seq, RUN_SECONDS, rx_seq / RUN_SECONDS, missed, corrupt);
+    if (!rx_seq || missed || corrupt) {
+	printf ("Failed.\n");
+	return 1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,210 @@
+ /*
+  * UAE - The Un*x Amiga Emulator
+  *
+  * CPU execution trace ring
+  *
+  * The CPU loop appends fixed size records (see tracering.h) to blocks
+  * of a ring. Only the CPU thread fills blocks and only the writer thread
+  * empties them, so the ring needs no lock: the producer publishes a
+  * full block by advancing trace_head, the writer hands it back by
+  * advancing trace_tail. If the writer can't keep up the CPU never waits,
+  * the block is recycled and a TR_DROP record tells how much was lost.
+  * The writer compresses the stream to cpu_trace_file with zlib.
+  *
+  * Use the readtrace tool to decode a trace file.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include "options.h"
+#include "memory.h"
+#include "custom.h"
+#include "events.h"
+#include "newcpu.h"
+#include "uae.h"
+#include "threaddep/thread.h"
+#include "tracering.h"
+
+#include <zlib.h>
+#include <time.h>
+
+#define TRACE_BLOCKRECS 8192	/* 128k per block */
+#define TRACE_BLOCKS 32
+#define TRACE_FLUSH_SECS 1	/* push buffered data to the file at least this often */
+
+struct traceblock
+{
+	int count;
+	struct tracering_rec recs[TRACE_BLOCKRECS];
+};
+
+int tracering_active, tracering_memory;
+uae_u32 tracering_regmask;
+struct tracering_rec *tracering_ptr, *tracering_end;
+
+static struct traceblock *trace_blocks;
+static volatile unsigned int trace_head, trace_tail;
+static uae_u32 trace_dropped, trace_lastregs[16];
+static int trace_droprec;
+static uae_sem_t trace_avail;
+static uae_thread_id trace_tid;
+static volatile int trace_quit;
+static gzFile trace_gz;
+static TCHAR trace_file[MAX_DPATH];
+static uae_u64 trace_written;
+
+static void *trace_writer (void *arg)
+{
+	time_t lastflush = time (NULL);
+
+	for (;;) {
+		struct traceblock *b;
+
+		uae_sem_wait (&trace_avail);
+		if (trace_tail == trace_head) {
+			if (trace_quit)
+				break;
+			continue;
+		}
+		__sync_synchronize ();
+		b = &trace_blocks[trace_tail % TRACE_BLOCKS];
+		if (gzwrite (trace_gz, b->recs, b->count * sizeof (struct tracering_rec)) <= 0 && b->count)
+			write_log ("CPU trace: write to '%s' failed\n", trace_file);
+		trace_written += b->count;
+		__sync_synchronize ();
+		trace_tail++;
+		if (trace_tail == trace_head && time (NULL) - lastflush >= TRACE_FLUSH_SECS) {
+			/* so a hang or crash leaves a usable file behind */
+			gzflush (trace_gz, Z_SYNC_FLUSH);
+			lastflush = time (NULL);
+		}
+	}
+	return NULL;
+}
+
+static void trace_startblock (void)
+{
+	struct traceblock *b = &trace_blocks[trace_head % TRACE_BLOCKS];
+
+	tracering_ptr = b->recs;
+	tracering_end = b->recs + TRACE_BLOCKRECS;
+	/* the count stays in trace_dropped until this block reaches the
+	 * writer, it may get recycled too */
+	trace_droprec = trace_dropped != 0;
+	if (trace_droprec) {
+		tracering_ptr->type = TR_DROP;
+		tracering_ptr->value = trace_dropped;
+		tracering_ptr->pc = tracering_ptr->cycles = tracering_ptr->opcode = tracering_ptr->size = 0;
+		tracering_ptr++;
+	}
+}
+
+/* Current block is full (or tracing stops): hand it to the writer. */
+void tracering_nextblock (void)
+{
+	struct traceblock *b = &trace_blocks[trace_head % TRACE_BLOCKS];
+
+	b->count = tracering_ptr - b->recs;
+	if (trace_head + 1 - trace_tail >= TRACE_BLOCKS) {
+		/* writer is behind, reuse the block */
+		trace_dropped += b->count - trace_droprec;
+	} else {
+		__sync_synchronize ();
+		trace_head++;
+		uae_sem_post (&trace_avail);
+		trace_dropped = 0;
+	}
+	trace_startblock ();
+}
+
+/* Record the traced registers that changed since the last instruction. */
+void tracering_regdelta (void)
+{
+	uae_u32 mask = tracering_regmask;
+	int i;
+
+	for (i = 0; mask; i++, mask >>= 1) {
+		if (!(mask & 1) || regs.regs[i] == trace_lastregs[i])
+			continue;
+		trace_lastregs[i] = regs.regs[i];
+		tracering_add (TR_REG, i, 0, 0, regs.regs[i], 0);
+	}
+}
+
+static int trace_start (void)
+{
+	struct tracering_header h;
+	int i;
+
+	trace_gz = gzopen (currprefs.cpu_trace_file, "wb1");
+	if (!trace_gz) {
+		write_log ("CPU trace: can't create '%s'\n", currprefs.cpu_trace_file);
+		return 0;
+	}
+	trace_blocks = xmalloc (struct traceblock, TRACE_BLOCKS);
+	if (!trace_blocks) {
+		gzclose (trace_gz);
+		return 0;
+	}
+	_tcscpy (trace_file, currprefs.cpu_trace_file);
+	tracering_regmask = currprefs.cpu_trace_registers & 0xffff;
+	tracering_memory = currprefs.cpu_trace_memory;
+
+	h.magic = TRACERING_MAGIC;
+	h.version = TRACERING_VERSION;
+	h.recsize = sizeof (struct tracering_rec);
+	h.regmask = tracering_regmask;
+	h.flags = tracering_memory ? TRACERING_MEMORY : 0;
+	gzwrite (trace_gz, &h, sizeof h);
+
+	/* first instruction reports every traced register */
+	for (i = 0; i < 16; i++)
+		trace_lastregs[i] = ~regs.regs[i];
+	trace_head = trace_tail = 0;
+	trace_dropped = 0;
+	trace_written = 0;
+	trace_quit = 0;
+	uae_sem_init (&trace_avail, 0, 0);
+	trace_startblock ();
+	uae_start_thread ("tracering", trace_writer, NULL, &trace_tid);
+	tracering_active = 1;
+	write_log ("CPU trace: writing to '%s'\n", trace_file);
+	return 1;
+}
+
+void tracering_stop (void)
+{
+	if (!tracering_active)
+		return;
+	tracering_active = 0;
+	/* the last block and its drop count must not be lost, the CPU
+	 * doesn't run anymore so it can wait for the writer here */
+	while (trace_head + 1 - trace_tail >= TRACE_BLOCKS)
+		sleep_millis (1);
+	tracering_nextblock ();
+	trace_quit = 1;
+	uae_sem_post (&trace_avail);
+	uae_wait_thread (trace_tid);
+	gzclose (trace_gz);
+	trace_gz = NULL;
+	uae_sem_destroy (&trace_avail);
+	xfree (trace_blocks);
+	trace_blocks = NULL;
+	tracering_memory = 0;
+	write_log ("CPU trace: %llu records written to '%s'\n", (unsigned long long)trace_written, trace_file);
+}
+
+/* Start, stop or restart tracing to match currprefs. */
+void tracering_setup (void)
+{
+	if (tracering_active) {
+		if (!_tcscmp (trace_file, currprefs.cpu_trace_file)
+			&& tracering_regmask == (currprefs.cpu_trace_registers & 0xffff)
+			&& tracering_memory == currprefs.cpu_trace_memory)
+			return;
+		tracering_stop ();
+	}
+	if (currprefs.cpu_trace_file[0])
+		trace_start ();
+}
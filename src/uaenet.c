@@ -1,7 +1,7 @@
 /*
  * UAE - The Un*x Amiga Emulator
  *
- * Linux uaenet emulation
+ * uaenet emulation, winpcap or Linux TAP/raw sockets
  *
  * Copyright 2007 Toni Wilen
  *           2010 Mustafa TUFAN
@@ -13,12 +13,27 @@
 
 #include <stdio.h>
 
+#ifdef _WIN32
 #define HAVE_REMOTE
 #define WPCAP
 #include "pcap.h"
 
 #include "packet32.h"
 #include "ntddndis.h"
+#else
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <arpa/inet.h>
+#endif
 
 #include "sysdeps.h"
 #include "options.h"
@@ -29,6 +44,8 @@
 static struct netdriverdata tds[MAX_TOTAL_NET_DEVICES];
 static int enumerated;
 
+#ifdef _WIN32
+
 struct uaenetdatawin32
 {
 	int evttw;
@@ -201,6 +218,8 @@ void uaenet_close (void *vsd)
 	write_log ("uaenet_win32 closed\n");
 }
 
+#endif /* _WIN32 */
+
 void uaenet_enumerate_free (struct netdriverdata *tcp)
 {
 	int i;
@@ -230,6 +249,8 @@ static struct netdriverdata *enumit (const TCHAR *name)
 	return NULL;
 }
 
+#ifdef _WIN32
+
 struct netdriverdata *uaenet_enumerate (struct netdriverdata **out, const TCHAR *name)
 {
 	static int done;
@@ -351,6 +372,404 @@ struct netdriverdata *uaenet_enumerate (struct netdriverdata **out, const TCHAR
 	return enumit (name);
 }
 
+#else /* _WIN32 */
+
+/* Linux backend: TAP devices through /dev/net/tun, any other ethernet
+ * interface through an AF_PACKET raw socket. One thread per open device
+ * waits on the packet fd and an eventfd (uaenet_trigger) with epoll and
+ * moves packets in batches, recvmmsg/sendmmsg when the fd is a socket. */
+
+#define UAENET_BATCH 16
+
+struct uaenetdatalinux
+{
+	int fd, socket;
+	int epfd, evfd;
+
+	uae_sem_t change_sem;
+	volatile int threadactive;
+	uae_thread_id tid;
+	uae_sem_t sync_sem;
+
+	void *user;
+	struct netdriverdata *tc;
+	uae_u8 *readbuffer;
+	uae_u8 *writebuffer;
+	int mtu;
+
+	uaenet_gotfunc *gotfunc;
+	uaenet_getfunc *getfunc;
+
+	uae_u64 rxpackets, rxbatches, txpackets, txbatches;
+};
+
+int uaenet_getdatalength (void)
+{
+	return sizeof (struct uaenetdatalinux);
+}
+
+static void uaeser_initdata (struct uaenetdatalinux *sd, void *user)
+{
+	memset (sd, 0, sizeof (struct uaenetdatalinux));
+	sd->fd = sd->epfd = sd->evfd = -1;
+	sd->user = user;
+}
+
+static void uaenet_receive (struct uaenetdatalinux *sd)
+{
+	struct mmsghdr msgs[UAENET_BATCH];
+	struct iovec iov[UAENET_BATCH];
+	int lens[UAENET_BATCH];
+	int i, cnt;
+
+	for (;;) {
+		if (sd->socket) {
+			memset (msgs, 0, sizeof msgs);
+			for (i = 0; i < UAENET_BATCH; i++) {
+				iov[i].iov_base = sd->readbuffer + i * sd->mtu;
+				iov[i].iov_len = sd->mtu;
+				msgs[i].msg_hdr.msg_iov = &iov[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+			cnt = recvmmsg (sd->fd, msgs, UAENET_BATCH, MSG_DONTWAIT, NULL);
+			if (cnt < 0)
+				cnt = 0;
+			for (i = 0; i < cnt; i++)
+				lens[i] = msgs[i].msg_len;
+		} else {
+			for (cnt = 0; cnt < UAENET_BATCH; cnt++) {
+				int len = read (sd->fd, sd->readbuffer + cnt * sd->mtu, sd->mtu);
+				if (len <= 0)
+					break;
+				lens[cnt] = len;
+			}
+		}
+		if (cnt == 0)
+			break;
+		uae_sem_wait (&sd->change_sem);
+		for (i = 0; i < cnt; i++)
+			sd->gotfunc ((struct s2devstruct*)sd->user, sd->readbuffer + i * sd->mtu, lens[i]);
+		uae_sem_post (&sd->change_sem);
+		sd->rxpackets += cnt;
+		sd->rxbatches++;
+		if (cnt < UAENET_BATCH)
+			break;
+	}
+}
+
+static void uaenet_transmit (struct uaenetdatalinux *sd)
+{
+	struct mmsghdr msgs[UAENET_BATCH];
+	struct iovec iov[UAENET_BATCH];
+	int lens[UAENET_BATCH];
+	int i, cnt;
+
+	for (;;) {
+		uae_sem_wait (&sd->change_sem);
+		for (cnt = 0; cnt < UAENET_BATCH; cnt++) {
+			lens[cnt] = sd->mtu;
+			if (!sd->getfunc ((struct s2devstruct*)sd->user, sd->writebuffer + cnt * sd->mtu, &lens[cnt]))
+				break;
+		}
+		uae_sem_post (&sd->change_sem);
+		if (cnt == 0)
+			break;
+		if (sd->socket) {
+			int sent = 0;
+			memset (msgs, 0, sizeof msgs);
+			for (i = 0; i < cnt; i++) {
+				iov[i].iov_base = sd->writebuffer + i * sd->mtu;
+				iov[i].iov_len = lens[i];
+				msgs[i].msg_hdr.msg_iov = &iov[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+			while (sent < cnt) {
+				int r = sendmmsg (sd->fd, msgs + sent, cnt - sent, 0);
+				if (r <= 0) {
+					write_log ("uaenet: sendmmsg failed, err=%d\n", errno);
+					break;
+				}
+				sent += r;
+			}
+		} else {
+			for (i = 0; i < cnt; i++) {
+				if (write (sd->fd, sd->writebuffer + i * sd->mtu, lens[i]) < 0)
+					write_log ("uaenet: write failed, err=%d\n", errno);
+			}
+		}
+		sd->txpackets += cnt;
+		sd->txbatches++;
+		if (cnt < UAENET_BATCH)
+			break;
+	}
+}
+
+static void *uaenet_trap_thread (void *arg)
+{
+	struct uaenetdatalinux *sd = (struct uaenetdatalinux*)arg;
+	struct epoll_event ev[2];
+
+	sd->threadactive = 1;
+	uae_sem_post (&sd->sync_sem);
+	while (sd->threadactive == 1) {
+		int i, n;
+		n = epoll_wait (sd->epfd, ev, 2, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			write_log ("uaenet: epoll_wait failed, err=%d\n", errno);
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			if (ev[i].data.fd == sd->evfd) {
+				uae_u64 v;
+				if (read (sd->evfd, &v, sizeof v) < 0)
+					v = 0;
+			} else if (ev[i].events & EPOLLIN) {
+				uaenet_receive (sd);
+			}
+		}
+		if (sd->threadactive != 1)
+			break;
+		// received packets may have queued replies, always check
+		uaenet_transmit (sd);
+	}
+	sd->threadactive = 0;
+	uae_sem_post (&sd->sync_sem);
+	return 0;
+}
+
+void uaenet_trigger (void *vsd)
+{
+	struct uaenetdatalinux *sd = (struct uaenetdatalinux*)vsd;
+	uae_u64 v = 1;
+
+	if (!sd || sd->evfd < 0)
+		return;
+	if (write (sd->evfd, &v, sizeof v) < 0)
+		write_log ("uaenet: trigger failed, err=%d\n", errno);
+}
+
+static int istap (const TCHAR *name)
+{
+	TCHAR path[MAX_DPATH];
+
+	_stprintf (path, "/sys/class/net/%s/tun_flags", name);
+	return access (path, F_OK) == 0;
+}
+
+static int opentap (const TCHAR *name)
+{
+	struct ifreq ifr;
+	int fd;
+
+	fd = open ("/dev/net/tun", O_RDWR | O_NONBLOCK);
+	if (fd < 0) {
+		write_log ("uaenet: /dev/net/tun: %s\n", strerror (errno));
+		return -1;
+	}
+	memset (&ifr, 0, sizeof ifr);
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	strncpy (ifr.ifr_name, name, IFNAMSIZ - 1);
+	if (ioctl (fd, TUNSETIFF, &ifr) < 0) {
+		write_log ("uaenet: TUNSETIFF '%s': %s\n", name, strerror (errno));
+		close (fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int openpacket (const TCHAR *name, int promiscuous)
+{
+	struct sockaddr_ll sll;
+	int fd, idx;
+
+	idx = if_nametoindex (name);
+	if (!idx)
+		return -1;
+	fd = socket (AF_PACKET, SOCK_RAW | SOCK_NONBLOCK, htons (ETH_P_ALL));
+	if (fd < 0) {
+		write_log ("uaenet: raw socket: %s\n", strerror (errno));
+		return -1;
+	}
+	memset (&sll, 0, sizeof sll);
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons (ETH_P_ALL);
+	sll.sll_ifindex = idx;
+	if (bind (fd, (struct sockaddr*)&sll, sizeof sll) < 0) {
+		write_log ("uaenet: bind '%s': %s\n", name, strerror (errno));
+		close (fd);
+		return -1;
+	}
+	if (promiscuous) {
+		struct packet_mreq mr;
+		memset (&mr, 0, sizeof mr);
+		mr.mr_ifindex = idx;
+		mr.mr_type = PACKET_MR_PROMISC;
+		if (setsockopt (fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mr, sizeof mr) < 0)
+			write_log ("uaenet: '%s' promiscuous mode failed: %s\n", name, strerror (errno));
+	}
+	return fd;
+}
+
+/* Attach an already open packet fd, also used by the loopback test */
+static int uaenet_start (struct uaenetdatalinux *sd, int fd, int issocket, int mtu, void *user, uaenet_gotfunc *gotfunc, uaenet_getfunc *getfunc)
+{
+	struct epoll_event ev;
+
+	sd->fd = fd;
+	sd->socket = issocket;
+	sd->user = user;
+	sd->mtu = mtu;
+	sd->evfd = eventfd (0, EFD_NONBLOCK);
+	sd->epfd = epoll_create1 (0);
+	if (sd->evfd < 0 || sd->epfd < 0)
+		return 0;
+	memset (&ev, 0, sizeof ev);
+	ev.events = EPOLLIN;
+	ev.data.fd = sd->fd;
+	if (epoll_ctl (sd->epfd, EPOLL_CTL_ADD, sd->fd, &ev) < 0)
+		return 0;
+	ev.data.fd = sd->evfd;
+	if (epoll_ctl (sd->epfd, EPOLL_CTL_ADD, sd->evfd, &ev) < 0)
+		return 0;
+	sd->readbuffer = xmalloc (uae_u8, sd->mtu * UAENET_BATCH);
+	sd->writebuffer = xmalloc (uae_u8, sd->mtu * UAENET_BATCH);
+	sd->gotfunc = gotfunc;
+	sd->getfunc = getfunc;
+
+	uae_sem_init (&sd->change_sem, 0, 1);
+	uae_sem_init (&sd->sync_sem, 0, 0);
+	uae_start_thread ("uaenet", uaenet_trap_thread, sd, &sd->tid);
+	uae_sem_wait (&sd->sync_sem);
+	return 1;
+}
+
+int uaenet_open (void *vsd, struct netdriverdata *tc, void *user, uaenet_gotfunc *gotfunc, uaenet_getfunc *getfunc, int promiscuous)
+{
+	struct uaenetdatalinux *sd = (struct uaenetdatalinux*)vsd;
+	int tap, fd;
+
+	uaeser_initdata (sd, user);
+	tap = istap (tc->name);
+	fd = tap ? opentap (tc->name) : openpacket (tc->name, promiscuous);
+	if (fd < 0) {
+		write_log ("'%s' failed to open\n", tc->name);
+		return 0;
+	}
+	sd->tc = tc;
+	if (!uaenet_start (sd, fd, !tap, tc->mtu, user, gotfunc, getfunc))
+		goto end;
+	write_log ("uaenet: '%s' initialized (%s)\n", tc->name, tap ? "tap" : "raw socket");
+	return 1;
+
+end:
+	uaenet_close (sd);
+	return 0;
+}
+
+void uaenet_close (void *vsd)
+{
+	struct uaenetdatalinux *sd = (struct uaenetdatalinux*)vsd;
+	if (!sd)
+		return;
+	if (sd->threadactive) {
+		sd->threadactive = -1;
+		uaenet_trigger (sd);
+		uae_sem_wait (&sd->sync_sem);
+		uae_wait_thread (sd->tid);
+		write_log ("uaenet: %lld packets received in %lld batches, %lld sent in %lld batches\n",
+			sd->rxpackets, sd->rxbatches, sd->txpackets, sd->txbatches);
+		uae_sem_destroy (&sd->change_sem);
+		uae_sem_destroy (&sd->sync_sem);
+	}
+	if (sd->epfd >= 0)
+		close (sd->epfd);
+	if (sd->evfd >= 0)
+		close (sd->evfd);
+	if (sd->fd >= 0)
+		close (sd->fd);
+	xfree (sd->readbuffer);
+	xfree (sd->writebuffer);
+	uaeser_initdata (sd, sd->user);
+}
+
+static int readsysfs (const TCHAR *name, const TCHAR *entry, char *out, int size)
+{
+	TCHAR path[MAX_DPATH];
+	FILE *f;
+	int ok;
+
+	_stprintf (path, "/sys/class/net/%s/%s", name, entry);
+	f = fopen (path, "r");
+	if (!f)
+		return 0;
+	ok = fgets (out, size, f) != NULL;
+	fclose (f);
+	return ok;
+}
+
+struct netdriverdata *uaenet_enumerate (struct netdriverdata **out, const TCHAR *name)
+{
+	static int done;
+	struct dirent *de;
+	DIR *dir;
+	int cnt;
+
+	if (enumerated) {
+		if (out)
+			*out = tds;
+		return enumit (name);
+	}
+	dir = opendir ("/sys/class/net");
+	if (!dir) {
+		write_log ("uaenet: no /sys/class/net\n");
+		return NULL;
+	}
+	if (!done)
+		write_log ("uaenet: detecting interfaces\n");
+	cnt = 0;
+	while ((de = readdir (dir))) {
+		struct netdriverdata *tc = tds + cnt;
+		unsigned int m[6];
+		char tmp[64];
+
+		if (de->d_name[0] == '.')
+			continue;
+		if (cnt >= MAX_TOTAL_NET_DEVICES) {
+			write_log ("buffer overflow\n");
+			break;
+		}
+		// ARPHRD_ETHER only, this also skips loopback
+		if (!readsysfs (de->d_name, "type", tmp, sizeof tmp) || atoi (tmp) != 1)
+			continue;
+		if (!readsysfs (de->d_name, "address", tmp, sizeof tmp) ||
+			sscanf (tmp, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6)
+			continue;
+		for (int i = 0; i < 6; i++)
+			tc->mac[i] = m[i];
+		tc->active = 1;
+		tc->mtu = 1522;
+		tc->name = my_strdup (de->d_name);
+		tc->desc = my_strdup (istap (de->d_name) ? "TAP device" : "Ethernet (raw socket)");
+		if (!done)
+			write_log ("%s\n- %s\n- MAC %02X:%02X:%02X:%02X:%02X:%02X (%d)\n",
+				tc->name, tc->desc,
+				tc->mac[0], tc->mac[1], tc->mac[2],
+				tc->mac[3], tc->mac[4], tc->mac[5], cnt);
+		cnt++;
+	}
+	closedir (dir);
+	if (!done)
+		write_log ("uaenet: end of detection\n");
+	done = 1;
+	enumerated = 1;
+	if (out)
+		*out = tds;
+	return enumit (name);
+}
+#endif /* _WIN32 */
+
 void uaenet_close_driver (struct netdriverdata *tc)
 {
 	int i;
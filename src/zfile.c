@@ -25,6 +25,7 @@
 #include "zarchive.h"
 #include "diskutil.h"
 #include "fdi2raw.h"
+#include "threaddep/thread.h"
 
 #include "archivers/zip/unzip.h"
 #include "archivers/dms/cdata.h"
@@ -183,6 +184,8 @@ static void zfile_free (struct zfile *f)
 		_wunlink (f->name);
 		write_log ("deleted temporary file '%s'\n", f->name);
 	}
+	if (f->zfileclose)
+		f->zfileclose (f);
 	xfree (f->name);
 	xfree (f->data);
 	xfree (f->mode);
@@ -212,6 +215,10 @@ void zfile_fclose (struct zfile *f)
 	if (f->opencnt > 0)
 		return;
 	f->opencnt = -100;
+	// before the parent goes away, helper threads may still be using it
+	if (f->zfileclose)
+		f->zfileclose (f);
+	f->zfileclose = NULL;
 	if (f->parent) {
 		f->parent->opencnt--;
 		if (f->parent->opencnt <= 0)
@@ -517,6 +524,324 @@ end:
 	return z;
 }
 
+/* CISO compressed CD image: the image is split in fixed size blocks that
+ * are deflated independently, with a block index in front, so any sector
+ * can be reached without unpacking the whole file. Unpacked blocks are kept
+ * in a small LRU cache and a helper thread unpacks ahead of sequential
+ * reads (see zfile_readahead). */
+
+#define CISO_CACHE_SIZE (2 * 1024 * 1024)
+#define CISO_HASH 256
+
+/* Read-ahead thread: 1 always, 0 never, -1 only with more than one CPU.
+ * On a single CPU the thread just competes with the reader for it and
+ * makes sequential reads slower. */
+static int ciso_readahead = -1;
+
+struct ciso_hunk
+{
+	uae_s64 block;
+	uae_u32 lru;
+	int next; // hash chain
+	uae_u8 *data;
+};
+
+struct zfile_ciso
+{
+	uae_s64 virtsize;
+	uae_u32 blocksize;
+	int align;
+	int blocks;
+	uae_u32 *index;
+	uae_u8 *packed;
+	z_stream zs;
+	int hunkcnt;
+	struct ciso_hunk *hunks;
+	int hash[CISO_HASH];
+	uae_u32 lru;
+	uae_sem_t lock;
+	// read-ahead window, written by the reader, consumed by the thread
+	uae_s64 ra_block, ra_end;
+	uae_sem_t ra_wake, ra_done;
+	volatile int ra_state;
+	int hits, misses, prefetched;
+};
+
+static uae_u32 ciso_le32 (uae_u8 *p)
+{
+	return (p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+
+static struct ciso_hunk *ciso_find (struct zfile_ciso *zc, uae_s64 block)
+{
+	int i = zc->hash[block % CISO_HASH];
+	while (i >= 0) {
+		struct ciso_hunk *h = &zc->hunks[i];
+		if (h->block == block)
+			return h;
+		i = h->next;
+	}
+	return NULL;
+}
+
+static void ciso_unhash (struct zfile_ciso *zc, struct ciso_hunk *h)
+{
+	int *pp = &zc->hash[h->block % CISO_HASH];
+	int idx = h - zc->hunks;
+	while (*pp >= 0) {
+		if (*pp == idx) {
+			*pp = h->next;
+			break;
+		}
+		pp = &zc->hunks[*pp].next;
+	}
+	h->block = -1;
+}
+
+// caller holds zc->lock
+static struct ciso_hunk *ciso_load (struct zfile *zf, uae_s64 block)
+{
+	struct zfile_ciso *zc = (struct zfile_ciso*)zf->userdata;
+	struct zfile *zp = zf->parent;
+	struct ciso_hunk *h, *victim;
+	uae_u64 start, end;
+	uae_u32 len;
+	int i;
+
+	h = ciso_find (zc, block);
+	if (h)
+		return h;
+	victim = &zc->hunks[0];
+	for (i = 1; i < zc->hunkcnt; i++) {
+		if (zc->hunks[i].lru < victim->lru)
+			victim = &zc->hunks[i];
+	}
+	if (victim->block >= 0)
+		ciso_unhash (zc, victim);
+	start = (uae_u64)(zc->index[block] & 0x7fffffff) << zc->align;
+	end = (uae_u64)(zc->index[block + 1] & 0x7fffffff) << zc->align;
+	if (end < start || end - start > zc->blocksize + 1024)
+		return NULL;
+	len = end - start;
+	zfile_fseek (zp, start, SEEK_SET);
+	if (zc->index[block] & 0x80000000) {
+		// stored
+		if (len < zc->blocksize || zfile_fread (victim->data, 1, zc->blocksize, zp) != zc->blocksize)
+			return NULL;
+	} else {
+		if (zfile_fread (zc->packed, 1, len, zp) != len)
+			return NULL;
+		inflateReset (&zc->zs);
+		zc->zs.next_in = zc->packed;
+		zc->zs.avail_in = len;
+		zc->zs.next_out = victim->data;
+		zc->zs.avail_out = zc->blocksize;
+		if (inflate (&zc->zs, Z_FINISH) != Z_STREAM_END && zc->zs.avail_out != 0) {
+			write_log ("CISO: block %lld corrupt\n", block);
+			return NULL;
+		}
+	}
+	victim->block = block;
+	victim->next = zc->hash[block % CISO_HASH];
+	zc->hash[block % CISO_HASH] = victim - zc->hunks;
+	return victim;
+}
+
+static uae_s64 ciso_fread (void *data, uae_u64 l1, uae_u64 l2, struct zfile *zf)
+{
+	struct zfile_ciso *zc = (struct zfile_ciso*)zf->userdata;
+	uae_u8 *dataptr = (uae_u8*)data;
+	uae_s64 size = l1 * l2;
+	uae_s64 out = 0;
+
+	if (!size)
+		return 0;
+	if (zf->seek + size > zc->virtsize)
+		size = zf->seek < zc->virtsize ? zc->virtsize - zf->seek : 0;
+	uae_sem_wait (&zc->lock);
+	while (size > 0) {
+		uae_s64 block = zf->seek / zc->blocksize;
+		int offset = zf->seek % zc->blocksize;
+		int len = zc->blocksize - offset;
+		struct ciso_hunk *h;
+
+		if (len > size)
+			len = size;
+		h = ciso_find (zc, block);
+		if (h)
+			zc->hits++;
+		else
+			zc->misses++;
+		if (!h)
+			h = ciso_load (zf, block);
+		if (!h)
+			break;
+		h->lru = ++zc->lru;
+		memcpy (dataptr, h->data + offset, len);
+		dataptr += len;
+		zf->seek += len;
+		size -= len;
+		out += len;
+	}
+	uae_sem_post (&zc->lock);
+	return out / l1;
+}
+
+static void *ciso_thread (void *v)
+{
+	struct zfile *zf = (struct zfile*)v;
+	struct zfile_ciso *zc = (struct zfile_ciso*)zf->userdata;
+
+	// ra_state was set by ciso (), a close may already have cleared it
+	for (;;) {
+		uae_sem_wait (&zc->ra_wake);
+		if (zc->ra_state < 0)
+			break;
+		for (;;) {
+			struct ciso_hunk *h;
+			uae_sem_wait (&zc->lock);
+			if (zc->ra_state < 0 || zc->ra_block >= zc->ra_end) {
+				uae_sem_post (&zc->lock);
+				break;
+			}
+			if (!ciso_find (zc, zc->ra_block)) {
+				h = ciso_load (zf, zc->ra_block);
+				if (h) {
+					// slightly older than anything just read, so
+					// it can't push the current working set out
+					h->lru = zc->lru;
+					zc->prefetched++;
+				}
+			}
+			zc->ra_block++;
+			uae_sem_post (&zc->lock);
+		}
+	}
+	zc->ra_state = 0;
+	uae_sem_post (&zc->ra_done);
+	return NULL;
+}
+
+/* Hint that the caller is about to read len bytes at offset. Only block
+ * indexed compressed images do anything with it, other files ignore it. */
+void zfile_readahead (struct zfile *zf, uae_s64 offset, uae_s64 len)
+{
+	struct zfile_ciso *zc;
+	uae_s64 first, last;
+
+	if (!zf || zf->zfileread != ciso_fread)
+		return;
+	zc = (struct zfile_ciso*)zf->userdata;
+	if (zc->ra_state <= 0 || offset < 0 || offset >= zc->virtsize || len <= 0)
+		return;
+	first = offset / zc->blocksize;
+	last = (offset + len + zc->blocksize - 1) / zc->blocksize;
+	if (last > zc->blocks)
+		last = zc->blocks;
+	// never prefetch more than half of the cache
+	if (last - first > zc->hunkcnt / 2)
+		last = first + zc->hunkcnt / 2;
+	uae_sem_wait (&zc->lock);
+	zc->ra_block = first;
+	zc->ra_end = last;
+	uae_sem_post (&zc->lock);
+	uae_sem_post (&zc->ra_wake);
+}
+
+static void ciso_close (struct zfile *zf)
+{
+	struct zfile_ciso *zc = (struct zfile_ciso*)zf->userdata;
+	int i;
+
+	if (zc->ra_state > 0) {
+		zc->ra_state = -1;
+		uae_sem_post (&zc->ra_wake);
+		uae_sem_wait (&zc->ra_done);
+	}
+	write_log ("CISO: %s cache hits %d misses %d prefetched %d\n",
+		zfile_getname (zf), zc->hits, zc->misses, zc->prefetched);
+	inflateEnd (&zc->zs);
+	for (i = 0; i < zc->hunkcnt; i++)
+		xfree (zc->hunks[i].data);
+	xfree (zc->hunks);
+	xfree (zc->index);
+	xfree (zc->packed);
+	uae_sem_destroy (&zc->lock);
+	uae_sem_destroy (&zc->ra_wake);
+	uae_sem_destroy (&zc->ra_done);
+}
+
+static struct zfile *ciso (struct zfile *z)
+{
+	uae_u8 tmp[24];
+	struct zfile_ciso *zc;
+	uae_u32 headersize;
+	uae_thread_id tid;
+	int i;
+
+	if (zfile_fread (tmp, 1, sizeof tmp, z) != sizeof tmp)
+		return NULL;
+	if (memcmp (tmp, "CISO", 4))
+		return NULL;
+	zc = xcalloc (struct zfile_ciso, 1);
+	headersize = ciso_le32 (tmp + 4);
+	zc->virtsize = ((uae_s64)ciso_le32 (tmp + 12) << 32) | ciso_le32 (tmp + 8);
+	zc->blocksize = ciso_le32 (tmp + 16);
+	zc->align = tmp[21];
+	if (tmp[20] > 1 || zc->virtsize <= 0 || zc->blocksize < 2048 || zc->blocksize > 1024 * 1024 || (zc->blocksize & 2047) || zc->align > 16) {
+		write_log ("CISO: unsupported header (ver %d, block size %d)\n", tmp[20], zc->blocksize);
+		goto end;
+	}
+	zc->blocks = (zc->virtsize + zc->blocksize - 1) / zc->blocksize;
+	zc->index = xmalloc (uae_u32, zc->blocks + 1);
+	zfile_fseek (z, headersize < sizeof tmp ? sizeof tmp : headersize, SEEK_SET);
+	if (zfile_fread (zc->index, sizeof (uae_u32), zc->blocks + 1, z) != (size_t)zc->blocks + 1)
+		goto end;
+	for (i = 0; i <= zc->blocks; i++)
+		zc->index[i] = ciso_le32 ((uae_u8*)&zc->index[i]);
+	zc->packed = xmalloc (uae_u8, zc->blocksize + 1024);
+	if (inflateInit2 (&zc->zs, -MAX_WBITS) != Z_OK)
+		goto end;
+	zc->hunkcnt = CISO_CACHE_SIZE / zc->blocksize;
+	if (zc->hunkcnt < 16)
+		zc->hunkcnt = 16;
+	zc->hunks = xcalloc (struct ciso_hunk, zc->hunkcnt);
+	for (i = 0; i < zc->hunkcnt; i++) {
+		zc->hunks[i].block = -1;
+		zc->hunks[i].data = xmalloc (uae_u8, zc->blocksize);
+	}
+	for (i = 0; i < CISO_HASH; i++)
+		zc->hash[i] = -1;
+	uae_sem_init (&zc->lock, 0, 1);
+	uae_sem_init (&zc->ra_wake, 0, 0);
+	uae_sem_init (&zc->ra_done, 0, 0);
+
+	z = zfile_fopen_parent (z, NULL, 0, zc->virtsize);
+	z->useparent = 0;
+	z->dataseek = 1;
+	z->userdata = zc;
+	z->zfileread = ciso_fread;
+	z->zfileclose = ciso_close;
+	if (ciso_readahead < 0) {
+		ciso_readahead = 0;
+#ifdef _SC_NPROCESSORS_ONLN
+		ciso_readahead = sysconf (_SC_NPROCESSORS_ONLN) > 1;
+#endif
+	}
+	if (ciso_readahead) {
+		zc->ra_state = 1;
+		uae_start_thread ("ciso", ciso_thread, z, &tid);
+	}
+	write_log ("%s is CISO image, virtual size=%dK, %d byte blocks\n",
+		zfile_getname (z), (int)(zc->virtsize / 1024), zc->blocksize);
+	return z;
+end:
+	xfree (zc->index);
+	xfree (zc->packed);
+	xfree (zc);
+	return NULL;
+}
+
 struct zfile *zfile_gunzip (struct zfile *z)
 {
 	uae_u8 header[2 + 1 + 1 + 4 + 1 + 1];
@@ -1367,6 +1692,11 @@ struct zfile *zuncompress (struct znode *parent, struct zfile *z, int dodefault,
 			return NULL;
 		return vhd (z);
 	}
+	if (!memcmp (header, "CISO", 4)) {
+		if (index > 0)
+			return NULL;
+		return ciso (z);
+	}
 	if (mask & ZFD_UNPACK) {
 		if (index == 0) {
 			if (header[0] == 0x1f && header[1] == 0x8b)